@@ -0,0 +1,79 @@
+#!/bin/bash
+# Compression throughput of each format, with the single-threaded tool and
+# with the command chosen by the compressor registry of compress-utils.c
+# (the first available one, with one thread per processor):
+#
+#   compression-throughput.sh [INPUT [LEVEL]]
+#
+# INPUT defaults to 256 MiB of /usr/share in a tar stream, LEVEL to the
+# "normal" level of the registry.  Prints the MB/s of the compression and
+# of the decompression, and the compressed size in percent of the input.
+
+set -o pipefail
+
+INPUT=$1
+LEVEL=$2
+THREADS=`nproc`
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if test -z "$INPUT"; then
+	INPUT=$WORK_DIR/input
+	tar -cf - -C / usr/share 2>/dev/null | head -c $((256 * 1024 * 1024)) > "$INPUT"
+fi
+INPUT_SIZE=`stat -c %s "$INPUT"`
+
+now () {
+	date +%s.%N
+}
+
+# MB/s of size bytes in the seconds between two now
+throughput () {
+	echo "$1 $2 $3" | awk '{ printf "%.1f", $1 / 1000000 / ($3 - $2) }'
+}
+
+# format, level of the format for "normal" in the registry, single-threaded
+# command, parallel commands in the order of the registry
+run () {
+	local format=$1 level=$2 single=$3
+	shift 3
+	local command=$single
+	local candidate
+
+	for candidate in "$@"; do
+		if command -v ${candidate%% *} >/dev/null 2>&1; then
+			command=$candidate
+			break
+		fi
+	done
+	if ! command -v ${single%% *} >/dev/null 2>&1 && test "$command" = "$single"; then
+		printf "%-6s %-22s not installed\n" $format "$single"
+		return
+	fi
+
+	for c in "$single" "$command"; do
+		local start end compressed_size ratio
+		start=`now`
+		$c ${LEVEL:-$level} < "$INPUT" > "$WORK_DIR/out" || return
+		end=`now`
+		compressed_size=`stat -c %s "$WORK_DIR/out"`
+		ratio=`echo $compressed_size $INPUT_SIZE | awk '{ printf "%.1f", 100 * $1 / $2 }'`
+		local c_speed=`throughput $INPUT_SIZE $start $end`
+		start=`now`
+		$c -d < "$WORK_DIR/out" > /dev/null || return
+		end=`now`
+		local d_speed=`throughput $INPUT_SIZE $start $end`
+		printf "%-6s %-22s %8s MB/s %8s MB/s %6s %%\n" $format "$c ${LEVEL:-$level}" $c_speed $d_speed $ratio
+		test "$c" = "$command" && break
+	done
+}
+
+echo "input: $INPUT_SIZE bytes, $THREADS processors"
+printf "%-6s %-22s %13s %13s %8s\n" format command compress decompress size
+run gzip  -6  "gzip -c"  "pigz -c -p $THREADS"
+run bzip2 -6  "bzip2 -c" "lbzip2 -c -n $THREADS" "pbzip2 -c -p$THREADS"
+run xz    -6  "xz -c"    "pixz -p $THREADS" "xz -c -T $THREADS"
+run lzip  -6  "lzip -c"  "plzip -c -n $THREADS"
+run lzop  -6  "lzop -c"
+run zstd  -9  "zstd -q -c" "zstd -q -c -T$THREADS"
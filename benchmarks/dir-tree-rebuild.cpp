@@ -0,0 +1,336 @@
+// Times the two ways Archiver::rebuildDirTree() has built the dir tree of an
+// archive of N entries:
+//
+//   dir-tree-rebuild old|flat N
+//
+// "old" allocates each item on its own with a vector of children, and finds
+// the parents with std::string keys and g_path_get_dirname().  "flat" stores
+// the items in one vector and the children in CSR form, keyed by pointer and
+// length into the paths.  Both are copies of the code of archiver.cpp with
+// FileData reduced to its paths, so that they build without Qt and libfm-qt:
+// qHashBits() is replaced by the FNV-1a hash, and the index of the files by
+// path, built after the tree, is left out.  Built by dir-tree-rebuild.sh.
+
+#include <glib.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+struct FileData {
+    char* full_path;
+    char* original_path;
+    char* name;
+    bool dir;
+};
+
+static FileData* fileDataNew(char* fullPath, char* originalPath, char* name, bool dir) {
+    return new FileData{fullPath, originalPath, name, dir};
+}
+
+static void fileDataFree(FileData* fileData) {
+    g_free(fileData->full_path);
+    g_free(fileData->original_path);
+    g_free(fileData->name);
+    delete fileData;
+}
+
+
+namespace old {
+
+class Item {
+public:
+    Item(FileData* data, bool ownData): data_{data}, ownData_{ownData}, parent_{nullptr} {
+    }
+
+    ~Item() {
+        if(ownData_) {
+            fileDataFree(data_);
+        }
+    }
+
+    const char* fullPath() const {
+        return data_->full_path;
+    }
+
+    const char* originalPath() const {
+        return data_->original_path;
+    }
+
+    bool isDir() const {
+        return data_->dir;
+    }
+
+    void addChild(Item* child) {
+        children_.push_back(child);
+        child->parent_ = this;
+    }
+
+private:
+    FileData* data_;
+    bool ownData_;
+    Item* parent_;
+    std::vector<Item*> children_;
+};
+
+static std::string stripTrailingSlash(std::string dirPath) {
+    if(dirPath != "/" && dirPath.back() == '/') {
+        dirPath.pop_back();
+    }
+    return dirPath;
+}
+
+static size_t rebuild(const std::vector<FileData*>& files) {
+    std::vector<std::unique_ptr<Item>> items;
+    std::unordered_map<std::string, Item*> dirMap;
+
+    items.reserve(files.size());
+    for(auto fileData: files) {
+        items.emplace_back(new Item{fileData, false});
+        auto item = items.back().get();
+        if(item->isDir()) {
+            std::string dirName = stripTrailingSlash(item->fullPath());
+            dirMap[dirName] = item;
+        }
+    }
+
+    for(size_t i = 0; i < files.size(); ++i) {
+        auto item = items[i].get();
+        while(strcmp(item->fullPath(), "/")) {
+            std::string dirName = stripTrailingSlash(item->fullPath());
+            if(dirName.empty() || dirName == "/") {
+                break;
+            }
+            char* parentName = g_path_get_dirname(dirName.c_str());
+            dirName = parentName;
+            g_free(parentName);
+            auto it = dirMap.find(dirName);
+            if(it == dirMap.end()) {
+                char* originalPath = g_path_get_dirname(stripTrailingSlash(item->originalPath()).c_str());
+                auto fileData = fileDataNew(dirName.back() == '/' ? g_strdup(dirName.c_str()) : g_strconcat(dirName.c_str(), "/", nullptr),
+                                            g_strconcat(originalPath, "/", nullptr),
+                                            g_path_get_basename(dirName.c_str()),
+                                            true);
+                g_free(originalPath);
+                items.emplace_back(new Item{fileData, true});
+                auto parent = items.back().get();
+                dirMap.emplace(dirName, parent);
+                parent->addChild(item);
+                item = parent;
+            }
+            else {
+                it->second->addChild(item);
+                break;
+            }
+        }
+    }
+
+    return items.size();
+}
+
+} // namespace old
+
+
+namespace flat {
+
+class Item {
+public:
+    Item(FileData* data, bool ownData): data_{data}, ownData_{ownData}, parent_{nullptr},
+        childrenBegin_{nullptr}, childrenEnd_{nullptr} {
+    }
+
+    Item(Item&& other) noexcept: data_{other.data_}, ownData_{other.ownData_}, parent_{other.parent_},
+        childrenBegin_{other.childrenBegin_}, childrenEnd_{other.childrenEnd_} {
+        other.ownData_ = false;
+    }
+
+    ~Item() {
+        if(ownData_) {
+            fileDataFree(data_);
+        }
+    }
+
+    const char* fullPath() const {
+        return data_->full_path;
+    }
+
+    const char* originalPath() const {
+        return data_->original_path;
+    }
+
+    bool isDir() const {
+        return data_->dir;
+    }
+
+    void setParent(const Item* parent) {
+        parent_ = parent;
+    }
+
+    void setChildren(const Item* const* begin, const Item* const* end) {
+        childrenBegin_ = begin;
+        childrenEnd_ = end;
+    }
+
+private:
+    FileData* data_;
+    bool ownData_;
+    const Item* parent_;
+    const Item* const* childrenBegin_;
+    const Item* const* childrenEnd_;
+};
+
+struct PathKey {
+    const char* str;
+    size_t len;
+
+    bool operator==(const PathKey& other) const {
+        return len == other.len && memcmp(str, other.str, len) == 0;
+    }
+};
+
+struct PathKeyHash {
+    size_t operator()(const PathKey& key) const {
+        size_t hash = 14695981039346656037ULL;
+        for(size_t i = 0; i < key.len; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(key.str[i])) * 1099511628211ULL;
+        }
+        return hash;
+    }
+};
+
+static PathKey dirKey(const char* path) {
+    size_t len = strlen(path);
+    if(len > 1 && path[len - 1] == '/') {
+        --len;
+    }
+    return PathKey{path, len};
+}
+
+static size_t rebuild(const std::vector<FileData*>& files) {
+    std::vector<Item> items;
+    std::vector<const Item*> childItems;
+    std::unordered_map<PathKey, size_t, PathKeyHash> itemMap;
+
+    items.reserve(files.size() + 1);
+    itemMap.reserve(files.size() + 1);
+    for(size_t i = 0; i < files.size(); ++i) {
+        items.emplace_back(files[i], false);
+        if(files[i]->dir) {
+            itemMap[dirKey(files[i]->full_path)] = i;
+        }
+    }
+
+    const size_t noParent = size_t(-1);
+    const PathKey rootKey{"/", 1};
+    std::vector<size_t> parents;
+    parents.reserve(items.size());
+    for(size_t i = 0; i < items.size(); ++i) {
+        PathKey key = dirKey(items[i].fullPath());
+        if(key.len == 0 || key == rootKey) {
+            parents.push_back(noParent);
+            continue;
+        }
+
+        size_t slash = key.len - 1;
+        while(slash > 0 && key.str[slash] != '/') {
+            --slash;
+        }
+        PathKey parentKey = slash > 0 ? PathKey{key.str, slash} : rootKey;
+
+        auto it = itemMap.find(parentKey);
+        if(it == itemMap.end()) {
+            bool isRoot = (parentKey == rootKey);
+            PathKey originalKey = dirKey(items[i].originalPath());
+            size_t originalLen = originalKey.len;
+            while(originalLen > 0 && originalKey.str[originalLen - 1] != '/') {
+                --originalLen;
+            }
+            size_t nameStart = parentKey.len;
+            while(nameStart > 0 && parentKey.str[nameStart - 1] != '/') {
+                --nameStart;
+            }
+            auto fileData = fileDataNew(isRoot ? g_strdup("/") : g_strdup_printf("%.*s/", int(parentKey.len), parentKey.str),
+                                        originalLen > 0 ? g_strndup(originalKey.str, originalLen) : g_strdup("./"),
+                                        isRoot ? g_strdup("/") : g_strndup(parentKey.str + nameStart, parentKey.len - nameStart),
+                                        true);
+            items.emplace_back(fileData, true);
+            it = itemMap.emplace(dirKey(fileData->full_path), items.size() - 1).first;
+        }
+        parents.push_back(it->second);
+    }
+
+    std::vector<size_t> childEnds(items.size() + 1, 0);
+    for(auto parent: parents) {
+        if(parent != noParent) {
+            ++childEnds[parent + 1];
+        }
+    }
+    for(size_t i = 1; i < childEnds.size(); ++i) {
+        childEnds[i] += childEnds[i - 1];
+    }
+    childItems.resize(childEnds.back());
+    for(size_t i = 0; i < items.size(); ++i) {
+        if(parents[i] != noParent) {
+            childItems[childEnds[parents[i]]++] = &items[i];
+            items[i].setParent(&items[parents[i]]);
+        }
+    }
+    for(size_t i = 0; i < items.size(); ++i) {
+        const Item* const* children = childItems.data();
+        items[i].setChildren(children + (i > 0 ? childEnds[i - 1] : 0), children + childEnds[i]);
+    }
+
+    return items.size();
+}
+
+} // namespace flat
+
+
+static long maxRssKib() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char** argv) {
+    if(argc != 3 || (strcmp(argv[1], "old") != 0 && strcmp(argv[1], "flat") != 0)) {
+        fprintf(stderr, "usage: %s old|flat N\n", argv[0]);
+        return 1;
+    }
+    size_t n = strtoul(argv[2], nullptr, 10);
+
+    // the entries of a tar archive of projects: the folders of the files are
+    // listed, their parents up to the root are not
+    std::vector<FileData*> files;
+    files.reserve(n);
+    for(size_t i = 0; files.size() < n; ++i) {
+        if(i % 50 == 0) {
+            char* path = g_strdup_printf("project%zu/module%zu/src/folder%zu/", i / 500000, i / 5000 % 100, i / 50 % 100);
+            files.push_back(fileDataNew(g_strdup_printf("/%s", path), path, g_strdup_printf("folder%zu", i / 50 % 100), true));
+        }
+        else {
+            char* path = g_strdup_printf("project%zu/module%zu/src/folder%zu/file%zu.c", i / 500000, i / 5000 % 100, i / 50 % 100, i);
+            files.push_back(fileDataNew(g_strdup_printf("/%s", path), path, g_strdup_printf("file%zu.c", i), false));
+        }
+    }
+
+    long rssBefore = maxRssKib();
+    auto start = std::chrono::steady_clock::now();
+    size_t nItems = strcmp(argv[1], "old") == 0 ? old::rebuild(files) : flat::rebuild(files);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    printf("%-4s %8zu entries, %8zu items: %.2f s, %ld MiB more peak memory\n",
+           argv[1], n, nItems, seconds.count(), (maxRssKib() - rssBefore) / 1024);
+
+    for(auto fileData: files) {
+        fileDataFree(fileData);
+    }
+    return 0;
+}
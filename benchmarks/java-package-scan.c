@@ -0,0 +1,95 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Times the package scanner of java-utils.c on the class files given on
+ * the command line, or listed one per line on the standard input:
+ *
+ *   java-package-scan [FILE...]
+ *
+ * Prints the time of get_package_name_from_class_file() called on each
+ * file in turn and, if the scanner has it, of get_package_names(), which
+ * reads the files in parallel.  Built by java-package-scan.sh. */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "java-utils.h"
+
+
+static double
+elapsed (gint64 start)
+{
+	return (g_get_monotonic_time () - start) / 1000000.0;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	GPtrArray *paths;
+	gint64     start;
+	guint      found = 0;
+	guint      i;
+
+	paths = g_ptr_array_new ();
+	for (i = 1; i < (guint) argc; i++)
+		g_ptr_array_add (paths, g_strdup (argv[i]));
+	if (paths->len == 0) {
+		char line[4096];
+
+		while (fgets (line, sizeof (line), stdin) != NULL) {
+			line[strcspn (line, "\n")] = '\0';
+			if (*line != '\0')
+				g_ptr_array_add (paths, g_strdup (line));
+		}
+	}
+
+	start = g_get_monotonic_time ();
+	for (i = 0; i < paths->len; i++) {
+		char *package = get_package_name_from_class_file (g_ptr_array_index (paths, i));
+
+		if (package != NULL)
+			found++;
+		g_free (package);
+	}
+	printf ("%u files, one at a time: %.3f s, %u packages\n", paths->len, elapsed (start), found);
+
+#ifdef HAVE_GET_PACKAGE_NAMES
+	{
+		JavaPackage *files;
+
+		files = g_new0 (JavaPackage, paths->len);
+		for (i = 0; i < paths->len; i++)
+			files[i].path = g_ptr_array_index (paths, i);
+
+		start = g_get_monotonic_time ();
+		get_package_names (files, paths->len);
+		printf ("%u files, get_package_names: %.3f s\n", paths->len, elapsed (start));
+
+		for (i = 0; i < paths->len; i++)
+			g_free (files[i].package);
+		g_free (files);
+	}
+#endif
+
+	return 0;
+}
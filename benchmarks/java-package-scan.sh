@@ -0,0 +1,66 @@
+#!/bin/sh
+# Times the package scanner used when adding class files to a jar archive:
+#
+#   java-package-scan.sh [N_FILES [SOURCE_DIR]]
+#
+# Writes N_FILES class files (40000 by default) in 400 packages, each one
+# with a constant pool of about 200 entries, as a compiled class of a real
+# project has.  Then builds java-package-scan.c with the java-utils.c of
+# SOURCE_DIR (src/core of this tree by default, give the src/core of an
+# older checkout to compare) and runs it twice, the second run reads the
+# files from the page cache.  Needs python3, a C compiler and glib.
+
+N_FILES=${1:-40000}
+BENCH_DIR=`cd "\`dirname "$0"\`" && pwd`
+SOURCE_DIR=${2:-$BENCH_DIR/../src/core}
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+python3 - "$WORK_DIR/classes" "$N_FILES" <<'PYTHON'
+import os, struct, sys
+
+root, n_files = sys.argv[1], int(sys.argv[2])
+
+def utf8(s):
+    b = s.encode()
+    return struct.pack('>BH', 1, len(b)) + b
+
+for i in range(n_files):
+    package = 'org/example/module%d/sub%d' % (i % 20, i % 400 // 20)
+    pool = [utf8('java/lang/Object'), struct.pack('>BH', 7, 1)]
+    # method references and integers, no long or double constants, which
+    # the scanners before the rewrite did not read correctly
+    for j in range(40):
+        base = len(pool) + 1
+        pool.append(utf8('method%d' % j))
+        pool.append(utf8('(Ljava/lang/String;I)V'))
+        pool.append(struct.pack('>BHH', 12, base, base + 1))
+        pool.append(struct.pack('>BHH', 10, 2, base + 2))
+        pool.append(struct.pack('>Bi', 3, j))
+    name_index = len(pool) + 1
+    pool.append(utf8('%s/Class%d' % (package, i)))
+    pool.append(struct.pack('>BH', 7, name_index))
+    this_class = len(pool)
+    data = struct.pack('>IHHH', 0xcafebabe, 0, 52, len(pool) + 1)
+    data += b''.join(pool)
+    data += struct.pack('>HHHHHHH', 0x21, this_class, 2, 0, 0, 0, 0)
+    folder = os.path.join(root, package)
+    os.makedirs(folder, exist_ok=True)
+    with open(os.path.join(folder, 'Class%d.class' % i), 'wb') as f:
+        f.write(data)
+PYTHON
+
+if grep -q get_package_names "$SOURCE_DIR/java-utils.h"; then
+	DEFINES=-DHAVE_GET_PACKAGE_NAMES
+fi
+: > "$WORK_DIR/config.h"
+${CC:-cc} -O2 $DEFINES -I"$WORK_DIR" -I"$SOURCE_DIR" \
+	-o "$WORK_DIR/java-package-scan" \
+	"$BENCH_DIR/java-package-scan.c" "$SOURCE_DIR/java-utils.c" \
+	`pkg-config --cflags --libs glib-2.0` || exit 1
+
+find "$WORK_DIR/classes" -name '*.class' > "$WORK_DIR/list"
+echo "`nproc` processors"
+"$WORK_DIR/java-package-scan" < "$WORK_DIR/list"
+"$WORK_DIR/java-package-scan" < "$WORK_DIR/list"
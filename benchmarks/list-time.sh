@@ -0,0 +1,80 @@
+#!/bin/bash
+# Time to list compressed tar archives, as fr-command-tar.c lists them:
+# tar -tv with the single-threaded decompressor used before, then with the
+# command chosen by the decompressor registry of compress-utils.c:
+#
+#   list-time.sh [SIZE_MIB [FOLDER]]
+#
+# Writes a tar archive of about SIZE_MIB MiB (2048 by default) made of
+# copies of FOLDER (/usr/share by default), compresses it once with each
+# installed format at the normal level, and lists each archive twice with
+# each command.  Needs about three times SIZE_MIB of free space in TMPDIR.
+
+set -o pipefail
+
+SIZE_MIB=${1:-2048}
+FOLDER=${2:-/usr/share}
+THREADS=`nproc`
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+now () {
+	date +%s.%N
+}
+
+seconds () {
+	echo "$1 $2" | awk '{ printf "%.1f", $2 - $1 }'
+}
+
+first_available () {
+	local candidate
+	for candidate in "$@"; do
+		if command -v ${candidate%% *} >/dev/null 2>&1; then
+			echo "$candidate"
+			return
+		fi
+	done
+}
+
+TAR=$WORK_DIR/archive.tar
+i=0
+while test `stat -c %s "$TAR" 2>/dev/null || echo 0` -lt $((SIZE_MIB * 1024 * 1024)); do
+	tar -rf "$TAR" --transform "s,^,copy$i/," -C "$FOLDER" . 2>/dev/null
+	i=$((i + 1))
+done
+N_ENTRIES=`tar -tf "$TAR" | wc -l`
+echo "`stat -c %s "$TAR"` bytes, $N_ENTRIES entries, $THREADS processors"
+
+# format, extension, compressor, old list command, registry decompressors
+run () {
+	local format=$1 extension=$2 compressor=$3 old=$4
+	shift 4
+	local new=`first_available "$@"`
+	local archive=$WORK_DIR/archive.tar.$extension
+
+	if ! command -v ${compressor%% *} >/dev/null 2>&1; then
+		printf "%-6s not installed\n" $format
+		return
+	fi
+	$compressor < "$TAR" > "$archive" || return
+
+	local c
+	for c in "$old" "$new"; do
+		local run times=""
+		for run in 1 2; do
+			local start=`now`
+			tar -tv -f "$archive" --use-compress-program="$c" > /dev/null || return
+			times="$times `seconds $start \`now\``"
+		done
+		printf "%-6s %-20s %s s\n" $format "$c" "$times"
+	done
+}
+
+rm -f "$WORK_DIR"/*.tar.*
+printf "%-6s %-20s %s\n" format "list command" "run 1, run 2"
+run gzip  gz   "gzip -6"  gzip  "pigz" "gzip"
+run bzip2 bz2  "bzip2 -6" bzip2 "lbzip2 -n $THREADS" "pbzip2 -p$THREADS" "bzip2"
+run xz    xz   "xz -6" xz "pixz -p $THREADS" "xz -T $THREADS"
+run lzip  lz   "lzip -6"  lzip  "plzip -n $THREADS" "lzip"
+run zstd  zst  "zstd -q -9" "zstd -q" "zstd -q"
@@ -0,0 +1,96 @@
+#!/bin/bash
+# Time to extract a zip archive with a single unzip, then split between
+# several unzip processes as extract_in_parallel() of fr-archive.c does:
+#
+#   parallel-extract.sh [DEST_DIR [JOBS [SIZE_MIB [FOLDER]]]]
+#
+# Writes a zip archive of about SIZE_MIB MiB (512 by default) made of
+# copies of FOLDER (/usr/share by default), and extracts it twice into
+# DEST_DIR (a new folder of TMPDIR by default) with a single unzip and
+# with each count of JOBS (2 and 4 by default, separated by commas).  The
+# single unzip extracts everything, as an "extract all" does.  With
+# several processes the files go to the one with less data, largest
+# first, the folders are created before they start and each one gets its
+# names on its command lines.  Give a DEST_DIR on each disk to compare,
+# it needs about twice SIZE_MIB of free space.
+
+set -o pipefail
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf "$WORK_DIR" "$DEST"' EXIT
+
+DEST=`mktemp -d -p "${1:-$WORK_DIR}"` || exit 1
+JOBS=${2:-2,4}
+SIZE_MIB=${3:-512}
+FOLDER=${4:-/usr/share}
+
+now () {
+	date +%s.%N
+}
+
+seconds () {
+	echo "$1 $2" | awk '{ printf "%.1f", $2 - $1 }'
+}
+
+# the copies are made in WORK_DIR/tree and zipped from there, the sizes
+# of the files are kept in WORK_DIR/sizes for the split
+TREE=$WORK_DIR/tree
+ZIP=$WORK_DIR/archive.zip
+mkdir "$TREE"
+i=0
+while test `du -sm "$TREE" | cut -f1` -lt $SIZE_MIB; do
+	cp -r "$FOLDER" "$TREE/copy$i" 2>/dev/null
+	i=$((i + 1))
+done
+(cd "$TREE" && find . ! -type d ! -name '*
+*' -printf '%s %P\n') | sort -rn > "$WORK_DIR/sizes"
+(cd "$TREE" && zip -q -r -y -6 "$ZIP" .) || exit 1
+rm -rf "$TREE"
+echo "`stat -c %s "$ZIP"` bytes, `wc -l < "$WORK_DIR/sizes"` files, `nproc` processors"
+
+# the names are escaped as fr-command-zip.c escapes them, unzip reads
+# them as patterns
+extract () {
+	local jobs=$1 j
+
+	rm -rf "$DEST"/*
+	if test $jobs -eq 1; then
+		unzip -qq -o -d "$DEST" -- "$ZIP"
+		return
+	fi
+
+	awk -v jobs=$jobs -v dir="$WORK_DIR" '
+		{
+			size = $1
+			sub (/^[0-9]+ /, "")
+			s = 0
+			for (j = 1; j < jobs; j++)
+				if (total[j] < total[s])
+					s = j
+			total[s] += size
+			print > (dir "/shard" s)
+		}' "$WORK_DIR/sizes"
+	sed -n 's,/[^/]*$,,p' "$WORK_DIR/sizes" | cut -d' ' -f2- | sort -u \
+		| (cd "$DEST" && xargs -d '\n' mkdir -p --)
+	for j in `seq 0 $((jobs - 1))`; do
+		sed 's/[][*?!^\\-]/\\&/g' "$WORK_DIR/shard$j" \
+			| xargs -d '\n' unzip -qq -o -d "$DEST" -- "$ZIP" &
+	done
+	wait
+	rm -f "$WORK_DIR"/shard*
+}
+
+printf "%-10s %s\n" processes "run 1, run 2"
+for jobs in 1 ${JOBS//,/ }; do
+	times=""
+	for run in 1 2; do
+		sync
+		start=`now`
+		extract $jobs
+		sync
+		times="$times `seconds $start \`now\``"
+	done
+	test "`find "$DEST" ! -type d | wc -l`" -eq "`wc -l < "$WORK_DIR/sizes"`" \
+		|| echo "$jobs processes: missing files" >&2
+	printf "%-10s %s s\n" $jobs "$times"
+done
@@ -0,0 +1,112 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Times the selection of an "extract all" of N entries as the archiver
+ * builds it and hands it to the core, before and after PathArray:
+ *
+ *   path-array-selection list|array N
+ *
+ * list:  a GList of g_strdup() copies of every path, as
+ *        Archiver::extractFiles() built it, then g_list_length() and
+ *        g_list_copy() as fr_archive_extract() used it;
+ * array: a PathArray that borrows the paths, then the GList view given to
+ *        the command builders.
+ *
+ * The paths stand for the original_path of the FileData of the archive
+ * and are allocated before the timing.  Prints the time and the peak
+ * resident memory of the process.  Built by path-array-selection.sh. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <glib.h>
+#include "path-array.h"
+
+
+static long
+get_max_rss_kib (void)
+{
+	struct rusage usage;
+
+	getrusage (RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	char   **paths;
+	guint    n;
+	guint    i;
+	long     rss_before;
+	gint64   start;
+	double   seconds;
+
+	if ((argc != 3) || ((strcmp (argv[1], "list") != 0) && (strcmp (argv[1], "array") != 0))) {
+		fprintf (stderr, "usage: %s list|array N\n", argv[0]);
+		return 1;
+	}
+	n = strtoul (argv[2], NULL, 10);
+
+	paths = g_new (char *, n);
+	for (i = 0; i < n; i++)
+		paths[i] = g_strdup_printf ("project/module%u/src/folder%u/file%u.txt", i % 100, i % 5000, i);
+	rss_before = get_max_rss_kib ();
+
+	start = g_get_monotonic_time ();
+	if (strcmp (argv[1], "list") == 0) {
+		GList *list = NULL;
+		GList *copy;
+
+		for (i = n; i > 0; i--)
+			list = g_list_prepend (list, g_strdup (paths[i - 1]));
+		if (g_list_length (list) != n)
+			return 1;
+		copy = g_list_copy (list);
+
+		seconds = (g_get_monotonic_time () - start) / 1000000.0;
+		g_list_free (copy);
+		g_list_free_full (list, g_free);
+	}
+	else {
+		PathArray *array;
+		GList     *view;
+
+		array = path_array_new (n);
+		for (i = 0; i < n; i++)
+			path_array_add (array, paths[i]);
+		if (array->len != n)
+			return 1;
+		view = path_array_to_list (array);
+
+		seconds = (g_get_monotonic_time () - start) / 1000000.0;
+		g_list_free (view);
+		path_array_unref (array);
+	}
+
+	printf ("%-5s %8u paths: %.3f s, %ld MiB more peak memory\n",
+		argv[1], n, seconds, (get_max_rss_kib () - rss_before) / 1024);
+
+	return 0;
+}
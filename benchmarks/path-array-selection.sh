@@ -0,0 +1,26 @@
+#!/bin/sh
+# Time and memory of the selection of an "extract all" of 1 million and
+# 5 million entries, as a GList of copies and as a PathArray:
+#
+#   path-array-selection.sh [N...]
+#
+# Builds path-array-selection.c with the path-array.c of this tree, each
+# measure runs in its own process so that the peak memory is its own.
+# Needs a C compiler and glib.
+
+BENCH_DIR=`cd "\`dirname "$0"\`" && pwd`
+SOURCE_DIR=$BENCH_DIR/../src/core
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+: > "$WORK_DIR/config.h"
+${CC:-cc} -O2 -I"$WORK_DIR" -I"$SOURCE_DIR" \
+	-o "$WORK_DIR/path-array-selection" \
+	"$BENCH_DIR/path-array-selection.c" "$SOURCE_DIR/path-array.c" \
+	`pkg-config --cflags --libs glib-2.0` || exit 1
+
+for n in ${*:-1000000 5000000}; do
+	"$WORK_DIR/path-array-selection" list $n
+	"$WORK_DIR/path-array-selection" array $n
+done
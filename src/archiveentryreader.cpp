@@ -0,0 +1,287 @@
+#include "archiveentryreader.h"
+
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+static const qint64 kDefaultReadBufferSize = 1024 * 1024;
+static const qint64 kReadChunkSize = 64 * 1024;
+
+namespace {
+
+// gives the write end of the pipe to the program as its standard output,
+// in the child process right before the program is executed
+class PipeOutputProcess : public QProcess {
+public:
+    explicit PipeOutputProcess(int outputFd, QObject* parent = nullptr):
+        QProcess(parent),
+        outputFd_{outputFd} {
+    }
+
+protected:
+    void setupChildProcess() override {
+        ::dup2(outputFd_, STDOUT_FILENO);
+    }
+
+private:
+    int outputFd_;
+};
+
+} // namespace
+
+
+ArchiveEntryReader::ArchiveEntryReader(const QStringList& argv, qint64 entrySize, QObject* parent):
+    QIODevice(parent),
+    argv_{argv},
+    entrySize_{entrySize},
+    process_{nullptr},
+    fd_{-1},
+    notifier_{nullptr},
+    bufferPos_{0},
+    readBufferSize_{kDefaultReadBufferSize},
+    processExited_{false},
+    finished_{false},
+    hasError_{false} {
+}
+
+ArchiveEntryReader::~ArchiveEntryReader() {
+    cancel();
+}
+
+bool ArchiveEntryReader::start() {
+    if(process_ || argv_.isEmpty()) {
+        return false;
+    }
+
+    int fds[2];
+    if(pipe(fds) != 0) {
+        setErrorString(QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+    // the program gets only the duplicate of the write end made by dup2()
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fd_ = fds[0];
+    notifier_ = new QSocketNotifier{fd_, QSocketNotifier::Read, this};
+    connect(notifier_, &QSocketNotifier::activated, this, &ArchiveEntryReader::onReadable);
+
+    // our own buffer is used, to stop reading from the program when it's full
+    QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    process_ = new PipeOutputProcess{fds[1], this};
+    // no pipe of QProcess for the output, it's replaced by ours in the child
+    process_->setStandardOutputFile(QProcess::nullDevice());
+    connect(process_, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, &ArchiveEntryReader::onProcessFinished);
+    connect(process_, &QProcess::errorOccurred, this, &ArchiveEntryReader::onProcessError);
+    process_->start(argv_.first(), argv_.mid(1));
+    process_->closeWriteChannel();
+
+    // the program has its own copy, the end of the data is seen when it exits
+    ::close(fds[1]);
+
+    return !hasError_;
+}
+
+void ArchiveEntryReader::cancel() {
+    if(process_) {
+        process_->disconnect(this);
+        process_->kill();
+        process_->waitForFinished();
+        delete process_;
+        process_ = nullptr;
+    }
+    closePipe();
+    buffer_.clear();
+    bufferPos_ = 0;
+    if(!finished_) {
+        finished_ = true;
+        hasError_ = true;
+        setErrorString(tr("Cancelled"));
+    }
+}
+
+qint64 ArchiveEntryReader::entrySize() const {
+    return entrySize_;
+}
+
+void ArchiveEntryReader::setReadBufferSize(qint64 size) {
+    readBufferSize_ = qMax<qint64>(size, 1);
+    if(notifier_) {
+        notifier_->setEnabled(buffer_.size() - bufferPos_ < readBufferSize_);
+    }
+}
+
+qint64 ArchiveEntryReader::readBufferSize() const {
+    return readBufferSize_;
+}
+
+bool ArchiveEntryReader::isFinished() const {
+    return finished_;
+}
+
+bool ArchiveEntryReader::hasError() const {
+    return hasError_;
+}
+
+bool ArchiveEntryReader::isSequential() const {
+    return true;
+}
+
+qint64 ArchiveEntryReader::bytesAvailable() const {
+    return buffer_.size() - bufferPos_ + QIODevice::bytesAvailable();
+}
+
+bool ArchiveEntryReader::atEnd() const {
+    return finished_ && bytesAvailable() == 0;
+}
+
+bool ArchiveEntryReader::waitForReadyRead(int msecs) {
+    if(fd_ == -1) {
+        return false;
+    }
+    if(buffer_.size() - bufferPos_ >= readBufferSize_) {
+        return true;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do {
+        ret = ::poll(&pfd, 1, msecs);
+    } while(ret < 0 && errno == EINTR);
+    if(ret <= 0) {
+        return false;
+    }
+
+    bool gotData = (fillBuffer() > 0);
+    if(fd_ == -1 && process_ && !processExited_) {
+        // the data ended, get the exit status of the program
+        process_->waitForFinished(msecs);
+    }
+    if(gotData) {
+        Q_EMIT readyRead();
+    }
+    return gotData;
+}
+
+void ArchiveEntryReader::close() {
+    cancel();
+    QIODevice::close();
+}
+
+qint64 ArchiveEntryReader::readData(char* data, qint64 maxSize) {
+    qint64 n = qMin<qint64>(maxSize, buffer_.size() - bufferPos_);
+    if(n == 0) {
+        return finished_ ? -1 : 0;
+    }
+    memcpy(data, buffer_.constData() + bufferPos_, n);
+    bufferPos_ += n;
+    if(bufferPos_ == buffer_.size()) {
+        buffer_.clear();
+        bufferPos_ = 0;
+    }
+    // there's room again, let the program continue
+    if(notifier_ && !notifier_->isEnabled()) {
+        notifier_->setEnabled(buffer_.size() - bufferPos_ < readBufferSize_);
+    }
+    return n;
+}
+
+qint64 ArchiveEntryReader::writeData(const char* /*data*/, qint64 /*maxSize*/) {
+    return -1;
+}
+
+void ArchiveEntryReader::onReadable() {
+    if(fillBuffer() > 0) {
+        Q_EMIT readyRead();
+    }
+}
+
+void ArchiveEntryReader::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    processExited_ = true;
+    if(exitStatus != QProcess::NormalExit || exitCode != 0) {
+        QString message = QString::fromLocal8Bit(process_->readAllStandardError()).trimmed();
+        hasError_ = true;
+        setErrorString(message.isEmpty() ? tr("The archiver program failed.") : message);
+    }
+    finish();
+}
+
+void ArchiveEntryReader::onProcessError(QProcess::ProcessError error) {
+    if(error == QProcess::FailedToStart) {
+        processExited_ = true;
+        hasError_ = true;
+        setErrorString(process_->errorString());
+        closePipe();
+        finish();
+    }
+}
+
+qint64 ArchiveEntryReader::fillBuffer() {
+    qint64 total = 0;
+    while(fd_ != -1 && buffer_.size() - bufferPos_ < readBufferSize_) {
+        // drop the data already read before growing the buffer
+        if(bufferPos_ > 0 && bufferPos_ >= buffer_.size() / 2) {
+            buffer_.remove(0, bufferPos_);
+            bufferPos_ = 0;
+        }
+
+        int oldSize = buffer_.size();
+        qint64 room = qMin(kReadChunkSize, readBufferSize_ - (oldSize - bufferPos_));
+        buffer_.resize(oldSize + room);
+        ssize_t n = ::read(fd_, buffer_.data() + oldSize, room);
+        buffer_.resize(oldSize + qMax<ssize_t>(n, 0));
+        if(n > 0) {
+            total += n;
+            continue;
+        }
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n == 0 || errno != EAGAIN) { // end of the data or error
+            if(n < 0) {
+                hasError_ = true;
+                setErrorString(QString::fromLocal8Bit(strerror(errno)));
+            }
+            closePipe();
+            finish();
+        }
+        break;
+    }
+
+    // stop reading while the buffer is full, so that the program waits for us
+    if(notifier_) {
+        notifier_->setEnabled(buffer_.size() - bufferPos_ < readBufferSize_);
+    }
+    return total;
+}
+
+void ArchiveEntryReader::closePipe() {
+    if(notifier_) {
+        notifier_->setEnabled(false);
+        delete notifier_;
+        notifier_ = nullptr;
+    }
+    if(fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void ArchiveEntryReader::finish() {
+    // done when both the data and the program have ended
+    if(finished_ || fd_ != -1 || !processExited_) {
+        return;
+    }
+    finished_ = true;
+    Q_EMIT readChannelFinished();
+    Q_EMIT finished();
+}
@@ -0,0 +1,88 @@
+#ifndef ARCHIVEENTRYREADER_H
+#define ARCHIVEENTRYREADER_H
+
+#include <QIODevice>
+#include <QProcess>
+#include <QByteArray>
+#include <QStringList>
+
+class QSocketNotifier;
+
+
+// Reads the content of a file of the archive from the standard output of the
+// archiver program, without extracting it.  The data is read from the program
+// only while the buffer is not full, so a slow reader makes the program wait.
+// Created by Archiver::openEntry().
+class ArchiveEntryReader : public QIODevice {
+    Q_OBJECT
+public:
+    explicit ArchiveEntryReader(const QStringList& argv, qint64 entrySize, QObject* parent = nullptr);
+
+    ~ArchiveEntryReader();
+
+    // starts the archiver program
+    bool start();
+
+    // stops the archiver program, the data not read yet is lost
+    void cancel();
+
+    // the size of the file as listed in the archive
+    qint64 entrySize() const;
+
+    // the most data read from the program and not read by the user yet
+    void setReadBufferSize(qint64 size);
+
+    qint64 readBufferSize() const;
+
+    // whether all the data has been read from the program, or an error occurred
+    bool isFinished() const;
+
+    bool hasError() const;
+
+    bool isSequential() const override;
+
+    qint64 bytesAvailable() const override;
+
+    bool atEnd() const override;
+
+    bool waitForReadyRead(int msecs) override;
+
+    void close() override;
+
+Q_SIGNALS:
+    void finished();
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private Q_SLOTS:
+    void onReadable();
+
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+    void onProcessError(QProcess::ProcessError error);
+
+private:
+    qint64 fillBuffer();
+
+    void closePipe();
+
+    void finish();
+
+private:
+    QStringList argv_;
+    qint64 entrySize_;
+    QProcess* process_;
+    int fd_;                      // the read end of the pipe of the standard output
+    QSocketNotifier* notifier_;
+    QByteArray buffer_;
+    int bufferPos_;
+    qint64 readBufferSize_;
+    bool processExited_;
+    bool finished_;
+    bool hasError_;
+};
+
+#endif // ARCHIVEENTRYREADER_H
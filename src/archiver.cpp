@@ -1,26 +1,40 @@
 #include "archiver.h"
 #include "archiveritem.h"
+#include "archiveentryreader.h"
 
 extern "C" {
 #include "core/fr-command.h"
 #include "core/file-utils.h"
 #include "core/fr-init.h"
+#include "core/compress-utils.h"
+#include "core/copy-utils.h"
 }
 
 #include <glib.h>
 #include <gobject/gobject.h>
 
+#include <QFile>
 #include <QMimeDatabase>
 #include <QMimeType>
+#include <QHash>
+#include <QThread>
 
 #include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
 
+static bool modifyInPlace = false;
 
 Archiver::Archiver(QObject* parent):
     QObject(parent),
     frArchive_{fr_archive_new()},
     rootItem_{nullptr},
     busy_{false},
+    lastRateUpdate_{0},
     isEncrypted_{false},
     uncompressedSize_{0} {
 
@@ -30,6 +44,8 @@ Archiver::Archiver(QObject* parent):
     g_signal_connect(frArchive_, "message", G_CALLBACK(&onMessage), this);
     g_signal_connect(frArchive_, "stoppable", G_CALLBACK(&onStoppable), this);
     g_signal_connect(frArchive_, "working-archive", G_CALLBACK(&onWorkingArchive), this);
+
+    fr_archive_set_modify_in_place(frArchive_, modifyInPlace);
 }
 
 Archiver::~Archiver() {
@@ -101,6 +117,68 @@ bool Archiver::isLoaded() const {
     return frArchive_->file != nullptr;
 }
 
+void Archiver::setModifyInPlace(bool value) {
+    modifyInPlace = value;
+}
+
+void Archiver::avoidedCopyStats(unsigned int& operations, quint64& bytes) {
+    guint n_operations;
+    guint64 n_bytes;
+    get_avoided_copy_stats(&n_operations, &n_bytes);
+    operations = n_operations;
+    bytes = n_bytes;
+}
+
+void Archiver::crossDeviceStats(unsigned int& operations, quint64& bytes) {
+    guint n_operations;
+    guint64 n_bytes;
+    get_cross_device_stats(&n_operations, &n_bytes);
+    operations = n_operations;
+    bytes = n_bytes;
+}
+
+static bool isOnRotationalDisk(const char* uri) {
+#ifdef __linux__
+    Fm::CStrPtr path{g_filename_from_uri(uri, nullptr, nullptr)};
+    struct stat st;
+    if(!path || stat(path.get(), &st) != 0) {
+        return false;
+    }
+    // partitions find the queue of their disk in the parent folder
+    auto device = QStringLiteral("/sys/dev/block/%1:%2/").arg(major(st.st_dev)).arg(minor(st.st_dev));
+    for(const char* queue: {"queue/rotational", "../queue/rotational"}) {
+        QFile file{device + QLatin1String(queue)};
+        if(file.open(QIODevice::ReadOnly)) {
+            return file.readAll().trimmed() == "1";
+        }
+    }
+#else
+    Q_UNUSED(uri);
+#endif
+    return false;
+}
+
+int Archiver::defaultJobCount(const char* destDirUri) {
+    int jobs = std::max(1, QThread::idealThreadCount());
+    if(destDirUri && isOnRotationalDisk(destDirUri)) {
+        // writing several archives at once makes the disk seek between them
+        jobs = std::min(jobs, 2);
+    }
+    return std::min(jobs, 8);
+}
+
+void Archiver::setExtractJobs(unsigned int jobs) {
+    fr_archive_set_extract_jobs(frArchive_, jobs);
+}
+
+void Archiver::setCompressionThreads(unsigned int threads) {
+    compressor_set_thread_budget(threads);
+}
+
+void Archiver::setCompressionTarget(double mbPerSec, unsigned int deadline) {
+    compressor_set_adaptive_target(mbPerSec, deadline);
+}
+
 void Archiver::addFiles(GList* relativefileNames, const char* srcDirUri, const char* destDirPath, bool onlyIfNewer, const char* password, bool encrypt_header, FrCompression compression, unsigned int volume_size) {
     fr_archive_add_files(frArchive_, relativefileNames, srcDirUri, destDirPath, onlyIfNewer, password, encrypt_header, compression, volume_size);
 }
@@ -145,6 +223,12 @@ void Archiver::addDirectory(const Fm::FilePath& directory, const char* destDirPa
                  onlyIfNewer, password, encrypt_header, compression, volume_size);
 }
 
+void Archiver::syncDirectory(const Fm::FilePath& directory, const char* destDirPath, bool compareContent, const char* password, bool encrypt_header, FrCompression compression, unsigned int volume_size) {
+    auto parent = directory.parent();
+    fr_archive_sync_directory(frArchive_, directory.uri().get(), parent.uri().get(), destDirPath,
+                              compareContent, password, encrypt_header, compression, volume_size);
+}
+
 void Archiver::addDroppedItems(GList *item_list, const char *base_dir, const char *dest_dir, bool update, const char *password, bool encrypt_header, FrCompression compression, unsigned int volume_size) {
     fr_archive_add_dropped_items(frArchive_, item_list, base_dir, dest_dir, update, password, encrypt_header, compression, volume_size);
 }
@@ -173,12 +257,11 @@ void Archiver::removeFiles(GList* fileNames, FrCompression compression) {
 }
 
 void Archiver::removeFiles(const std::vector<const FileData*>& files, FrCompression compression) {
-    GList* glist = nullptr;
-    for(int i = files.size() - 1; i >= 0; --i) {
-        glist = g_list_prepend(glist, g_strdup(files[i]->original_path));
-    }
-    removeFiles(glist, compression);
-    freeStrsGList(glist);
+    PathArray* paths = pathArrayFromFiles(files);
+    fr_process_clear(frArchive_->process);
+    fr_archive_remove_paths(frArchive_, paths, compression);
+    fr_process_start(frArchive_->process);
+    path_array_unref(paths);
 }
 
 void Archiver::extractFiles(GList* fileNames, const char* destDirUri, const char* baseDirPath, bool skip_older, bool overwrite, bool junk_path, const char* password) {
@@ -188,12 +271,11 @@ void Archiver::extractFiles(GList* fileNames, const char* destDirUri, const char
 }
 
 void Archiver::extractFiles(const std::vector<const FileData*>& files, const Fm::FilePath& destDir, const char* baseDirPath, bool skip_older, bool overwrite, bool junk_path, const char* password) {
-    GList* glist = nullptr;
-    for(int i = files.size() - 1; i >= 0; --i) {
-        glist = g_list_prepend(glist, g_strdup(files[i]->original_path));
-    }
-    extractFiles(glist, destDir.uri().get(), baseDirPath, skip_older, overwrite, junk_path, password);
-    freeStrsGList(glist);
+    PathArray* paths = pathArrayFromFiles(files);
+    fr_process_clear(frArchive_->process);
+    fr_archive_extract_paths(frArchive_, paths, destDir.uri().get(), baseDirPath, skip_older, overwrite, junk_path, password);
+    fr_process_start(frArchive_->process);
+    path_array_unref(paths);
 }
 
 void Archiver::extractAll(const char* destDirUri, bool skip_older, bool overwrite, bool junk_path, const char* password) {
@@ -213,6 +295,37 @@ const char* Archiver::lastExtractionDestination() const {
     return fr_archive_get_last_extraction_destination(frArchive_);
 }
 
+QStringList Archiver::streamCommand(const FileData* file, const char* password) const {
+    QStringList argv;
+    if(!frArchive_->command || !file || file->dir) {
+        return argv;
+    }
+    g_object_set(frArchive_->command, "password", password, nullptr);
+    if(char** cmd = fr_command_get_stream_command(frArchive_->command, file->original_path)) {
+        for(char** arg = cmd; *arg; ++arg) {
+            argv << QString::fromLocal8Bit(*arg);
+        }
+        g_strfreev(cmd);
+    }
+    return argv;
+}
+
+ArchiveEntryReader* Archiver::openEntry(const ArchiverItem* file, const char* password) {
+    if(!file || file->isDir() || !file->data()) {
+        return nullptr;
+    }
+    auto argv = streamCommand(file->data(), password);
+    if(argv.isEmpty()) {
+        return nullptr;
+    }
+    auto reader = new ArchiveEntryReader{argv, static_cast<qint64>(file->size())};
+    if(!reader->start()) {
+        delete reader;
+        return nullptr;
+    }
+    return reader;
+}
+
 void Archiver::testArchiveIntegrity(const char* password) {
     fr_archive_test(frArchive_, password);
 }
@@ -301,23 +414,43 @@ QStringList Archiver::supportedSaveNameFilters() {
     return mimeDescToNameFilters(save_type);
 }
 
-std::string Archiver::stripTrailingSlash(std::string dirPath) {
-    if(dirPath != "/" && dirPath.back() == '/') {
-        dirPath.pop_back();
+void Archiver::freeStrsGList(GList* strs) {
+    g_list_foreach(strs, (GFunc)g_free, nullptr);
+}
+
+PathArray* Archiver::pathArrayFromFiles(const std::vector<const FileData*>& files) {
+    // the paths are not copied, they belong to the FileData
+    PathArray* paths = path_array_new(files.size());
+    for(auto file: files) {
+        path_array_add(paths, file->original_path);
     }
-    return dirPath;
+    return paths;
 }
 
-void Archiver::freeStrsGList(GList* strs) {
-    g_list_foreach(strs, (GFunc)g_free, nullptr);
+bool Archiver::PathKey::operator==(const PathKey& other) const {
+    return len == other.len && memcmp(str, other.str, len) == 0;
+}
+
+size_t Archiver::PathKeyHash::operator()(const PathKey& key) const {
+    return qHashBits(key.str, key.len);
+}
+
+Archiver::PathKey Archiver::dirKey(const char* path) {
+    size_t len = strlen(path);
+    if(len > 1 && path[len - 1] == '/') {
+        --len;
+    }
+    return PathKey{path, len};
 }
 
 void Archiver::rebuildDirTree() {
     // The archive content is listed by Archiver in a flat list
-    // Let's rebuild the tree structure by mapping dir_path => [file1, file2, ...]
+    // Let's rebuild the tree structure by linking each item to its parent dir
     rootItem_ = nullptr;
+    childItems_.clear();
     items_.clear();
-    dirMap_.clear();
+    itemMap_.clear();
+    originalPathMap_.clear();
 
     isEncrypted_ = false;
     uncompressedSize_ = 0;
@@ -328,15 +461,17 @@ void Archiver::rebuildDirTree() {
 
     auto n_files = frArchive_->command->files->len;
 
-    // create one ArchiverItem per file and build dir_path => ArchiverItem mappings
-    items_.reserve(n_files);
-    for(int i = 0; i < n_files; ++i) {
+    // create one ArchiverItem per file and build dir_path => item index mappings,
+    // the files are added to the index once the missing dirs are created.
+    // The keys point to the paths of the FileData, which outlive the tree.
+    items_.reserve(n_files + 1);
+    itemMap_.reserve(n_files + 1);
+    originalPathMap_.reserve(n_files);
+    for(guint i = 0; i < n_files; ++i) {
         auto fileData = reinterpret_cast<FileData*>(g_ptr_array_index(frArchive_->command->files, i));
-        items_.emplace_back(new ArchiverItem{fileData, false}); // do not take ownership of the existing FileData object
-        auto item = items_.back().get();
-        if(item->isDir()) {
-            std::string dirName = stripTrailingSlash(item->fullPath());
-            dirMap_[dirName] = item;
+        items_.emplace_back(fileData, false); // do not take ownership of the existing FileData object
+        if(file_data_is_dir(fileData)) {
+            itemMap_[dirKey(fileData->full_path)] = i;
         }
 
         if(fileData->encrypted) {
@@ -353,74 +488,104 @@ void Archiver::rebuildDirTree() {
     // FrArchive only generates /example/sub/dir/, /example/sub/dir/file1.txt, /example/sub/dir/file2.txt.
     // However we still need create FileData for /, /example/, /example/sub/ to form a full dir tree.
     // So we create the missing items by ourselves :-(
+    // The created dirs are appended to items_, so they get their own parent when the loop reaches them.
+
+    const size_t noParent = size_t(-1);
+    const PathKey rootKey{"/", 1};
+    std::vector<size_t> parents;
+    parents.reserve(items_.size());
+    for(size_t i = 0; i < items_.size(); ++i) {
+        PathKey key = dirKey(items_[i].fullPath());
+        if(key.len == 0 || key == rootKey) {
+            parents.push_back(noParent);
+            continue;
+        }
 
-    // for each item, ensure all its parent dirs exist and setup the parent-child links
-    for(int i = 0; i < n_files; ++i) {
-        auto item = items_[i].get();
-        while(strcmp(item->fullPath(), "/")) {
-            ArchiverItem* parent = nullptr;
-            std::string dirName = stripTrailingSlash(item->fullPath());
-            if(dirName.empty() || dirName == "/") {
-                break;
-            }
-            // get parent dir of the current file
-            dirName = Fm::CStrPtr{g_path_get_dirname(dirName.c_str())}.get();
-            auto it = dirMap_.find(dirName);
-            if(it == dirMap_.end()) { // parent dir is not found, create an item for it
-                // Create a new FileData item for this parent dir
-                auto fileData = file_data_new();
-
-                // ensure that dir paths end with '/'
-                fileData->full_path = dirName.back() == '/' ? g_strdup(dirName.c_str()) : g_strconcat(dirName.c_str(), "/", nullptr); // ensure slash
-                auto full_path_len = strlen(fileData->full_path);
-                if(fileData->full_path[full_path_len - 1] == '/') {
-                    fileData->full_path[full_path_len] = '\0';
-                }
-
-                fileData->original_path = g_path_get_dirname(stripTrailingSlash(item->originalPath()).c_str());
-                auto original_path_len = strlen(fileData->original_path);
-                if(fileData->original_path[original_path_len - 1] != '/') {
-                    auto tmp = fileData->original_path;
-                    fileData->original_path = g_strconcat(tmp, "/", nullptr);
-                    g_free(tmp);
-                }
-
-                //qDebug("op: %s, %s", fileData->original_path, item->originalPath());
-                //qDebug("fp: %s, %s", fileData->full_path, item->fullPath());
-                fileData->name = g_path_get_basename(dirName.c_str());
-                fileData->dir = 1;
-                file_data_update_content_type(fileData);
-                items_.emplace_back(new ArchiverItem{fileData, true}); // take ownership of the new FileData object
-                parent = items_.back().get();
-                it = dirMap_.emplace(dirName, parent).first;
-
-                // add current file to its children
-                parent->addChild(item);
-                item = parent; // go up one level and continue
+        // get parent dir of the current file
+        size_t slash = key.len - 1;
+        while(slash > 0 && key.str[slash] != '/') {
+            --slash;
+        }
+        PathKey parentKey = slash > 0 ? PathKey{key.str, slash} : rootKey;
+
+        auto it = itemMap_.find(parentKey);
+        if(it == itemMap_.end()) { // parent dir is not found, create an item for it
+            // Create a new FileData item for this parent dir
+            auto fileData = file_data_new();
+
+            // ensure that dir paths end with '/'
+            bool isRoot = (parentKey == rootKey);
+            fileData->full_path = isRoot ? g_strdup("/") : g_strdup_printf("%.*s/", int(parentKey.len), parentKey.str);
+
+            // the original path of the parent is the one of the file up to its last '/'
+            PathKey originalKey = dirKey(items_[i].originalPath());
+            size_t originalLen = originalKey.len;
+            while(originalLen > 0 && originalKey.str[originalLen - 1] != '/') {
+                --originalLen;
             }
-            else { // parent item found, add current file to its children
-                parent = it->second;
-                parent->addChild(item);
-                break;
+            fileData->original_path = originalLen > 0 ? g_strndup(originalKey.str, originalLen) : g_strdup("./");
+
+            size_t nameStart = parentKey.len;
+            while(nameStart > 0 && parentKey.str[nameStart - 1] != '/') {
+                --nameStart;
             }
+            fileData->name = isRoot ? g_strdup("/") : g_strndup(parentKey.str + nameStart, parentKey.len - nameStart);
+            fileData->dir = 1;
+            file_data_update_content_type(fileData);
+            items_.emplace_back(fileData, true); // take ownership of the new FileData object
+            it = itemMap_.emplace(dirKey(fileData->full_path), items_.size() - 1).first;
         }
+        parents.push_back(it->second);
     }
 
     // if the archive is completey empty, at least generate a root node "/"
-    if(dirMap_.empty()) {
+    if(itemMap_.find(rootKey) == itemMap_.end()) {
         auto fileData = file_data_new();
         fileData->full_path = g_strdup("/");
         fileData->original_path = g_strdup("/");
         fileData->name = g_strdup("/");
         fileData->dir = 1;
         file_data_update_content_type(fileData);
-        items_.emplace_back(new ArchiverItem{fileData, true}); // take ownership of the new FileData object
-        dirMap_.emplace("/", items_.back().get());
+        items_.emplace_back(fileData, true); // take ownership of the new FileData object
+        itemMap_.emplace(dirKey(fileData->full_path), items_.size() - 1);
+        parents.push_back(noParent);
+    }
+    rootItem_ = &items_[itemMap_[rootKey]];
+
+    // index the files too, after the dirs so that a file never hides a dir with the same path
+    for(guint i = 0; i < n_files; ++i) {
+        if(!items_[i].isDir()) {
+            itemMap_.emplace(dirKey(items_[i].fullPath()), i);
+        }
+        originalPathMap_.emplace(dirKey(items_[i].originalPath()), i);
+    }
+
+    // store the children of each dir next to each other: count them, reserve
+    // a range of childItems_ for each dir, and fill the ranges
+    std::vector<size_t> childEnds(items_.size() + 1, 0);
+    for(auto parent: parents) {
+        if(parent != noParent) {
+            ++childEnds[parent + 1];
+        }
+    }
+    for(size_t i = 1; i < childEnds.size(); ++i) {
+        childEnds[i] += childEnds[i - 1];
+    }
+    childItems_.resize(childEnds.back());
+    for(size_t i = 0; i < items_.size(); ++i) {
+        if(parents[i] != noParent) {
+            childItems_[childEnds[parents[i]]++] = &items_[i];
+            items_[i].setParent(&items_[parents[i]]);
+        }
+    }
+    // childEnds[i] is now the end of the children of item i and the start of those of item i + 1
+    for(size_t i = 0; i < items_.size(); ++i) {
+        const ArchiverItem* const* children = childItems_.data();
+        items_[i].setChildren(ArchiverItemRange{children + (i > 0 ? childEnds[i - 1] : 0), children + childEnds[i]});
     }
-    rootItem_ = dirMap_["/"];
 
-    /*for(auto& kv: dirMap_) {
-        qDebug("dir: %s: %d", kv.first.c_str(), kv.second->children().size());
+    /*for(auto& kv: itemMap_) {
+        qDebug("dir: %.*s: %d", int(kv.first.len), kv.first.str, int(items_[kv.second].children().size()));
     }*/
 }
 
@@ -466,15 +631,20 @@ ArchiverError Archiver::lastError() const {
 std::vector<const ArchiverItem*> Archiver::flatFileList() const {
     std::vector<const ArchiverItem*> files;
     for(const auto& item: items_) {
-        if(!item->isDir()) {
-            files.emplace_back(item.get());
+        if(!item.isDir()) {
+            files.emplace_back(&item);
         }
     }
     return files;
 }
 
 const ArchiverItem *Archiver::itemByPath(const char *fullPath) const {
-    return nullptr;
+    if(!fullPath) {
+        return nullptr;
+    }
+    // "/path/to/dir" and "/path/to/dir/" are the same path
+    auto it = itemMap_.find(dirKey(fullPath));
+    return it != itemMap_.end() ? &items_[it->second] : nullptr;
 }
 
 const ArchiverItem *Archiver::dirTreeRoot() const {
@@ -482,21 +652,12 @@ const ArchiverItem *Archiver::dirTreeRoot() const {
 }
 
 const ArchiverItem *Archiver::dirByPath(const char *path) const {
-    // strip trailing /
-    std::string dirPath{path};
-    if(dirPath.length() > 1 && dirPath.back() == '/') {
-        dirPath.pop_back();
-    }
-    auto it = dirMap_.find(path);
-    return it != dirMap_.end() ? it->second : nullptr;
+    auto item = itemByPath(path);
+    return item && item->isDir() ? item : nullptr;
 }
 
 const ArchiverItem *Archiver::parentDir(const ArchiverItem *file) const {
-    if(file && strcmp(file->fullPath(), "/")) {
-        auto parentPath = Fm::CStrPtr{g_path_get_dirname(stripTrailingSlash(file->fullPath()).c_str())};
-        return dirByPath(parentPath.get());
-    }
-    return nullptr;
+    return file ? file->parent() : nullptr;
 }
 
 bool Archiver::isDir(const FileData *file) const {
@@ -505,11 +666,12 @@ bool Archiver::isDir(const FileData *file) const {
 
 const FileData* Archiver::fileDataByOriginalPath(const char* originalPath) {
     // FIXME: this searches using file->original_path but sometimes we want file->full_path instead :-(
-    auto idx = find_path_in_file_data_array(frArchive_->command->files, originalPath);
-    if(idx >= 0) {
-        return reinterpret_cast<FileData*>(g_ptr_array_index(frArchive_->command->files, idx));
+    if(!originalPath) {
+        return nullptr;
     }
-    return nullptr;
+    // "path/to/dir" and "path/to/dir/" are the same path
+    auto it = originalPathMap_.find(dirKey(originalPath));
+    return it != originalPathMap_.end() ? items_[it->second].data() : nullptr;
 }
 
 
@@ -522,6 +684,8 @@ void Archiver::onStart(FrArchive*, FrAction action, Archiver* _this) {
     //qDebug("start");
 
     _this->busy_ = true;
+    _this->progressTimer_.start();
+    _this->lastRateUpdate_ = 0;
     QMetaObject::invokeMethod(_this, "start", Qt::QueuedConnection, QGenericReturnArgument(), Q_ARG(FrAction, action));
 }
 
@@ -547,6 +711,28 @@ void Archiver::onDone(FrArchive*, FrAction action, FrProcError* error, Archiver*
 void Archiver::onProgress(FrArchive*, double fraction, Archiver* _this) {
     QMetaObject::invokeMethod(_this, "progress", Qt::QueuedConnection, QGenericReturnArgument(), Q_ARG(double, fraction));
     //qDebug("progress: %lf", fraction);
+    if(fraction > 0.0) {
+        _this->updateTransferRate(fraction);
+    }
+}
+
+void Archiver::updateTransferRate(double fraction) {
+    // the first files say little about the rest, and the estimates don't need
+    // to be updated for every file
+    qint64 elapsed = progressTimer_.elapsed();
+    if(elapsed < 1000 || elapsed - lastRateUpdate_ < 500) {
+        return;
+    }
+    lastRateUpdate_ = elapsed;
+
+    double seconds = elapsed / 1000.0;
+    qint64 totalBytes = frArchive_->command ? frArchive_->command->n_bytes : 0;
+    if(totalBytes > 0) {
+        double bytesPerSecond = fraction * totalBytes / seconds;
+        QMetaObject::invokeMethod(this, "throughput", Qt::QueuedConnection, QGenericReturnArgument(), Q_ARG(double, bytesPerSecond));
+    }
+    qint64 secondsLeft = qint64(seconds * (1.0 - fraction) / fraction);
+    QMetaObject::invokeMethod(this, "timeRemaining", Qt::QueuedConnection, QGenericReturnArgument(), Q_ARG(qint64, secondsLeft));
 }
 
 void Archiver::onMessage(FrArchive*, const char* msg, Archiver* _this) {
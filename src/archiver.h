@@ -3,11 +3,13 @@
 
 #include "core/fr-archive.h"
 #include "archivererror.h"
+#include "archiveritem.h"
 
 #include <libfm-qt/core/filepath.h>
 
 #include <QObject>
 #include <QUrl>
+#include <QElapsedTimer>
 
 #include <vector>
 #include <unordered_map>
@@ -15,7 +17,7 @@
 #include <cstdint>
 
 
-class ArchiverItem;
+class ArchiveEntryReader;
 
 class Archiver : public QObject {
     Q_OBJECT
@@ -79,6 +81,10 @@ public:
     void addDirectory(const Fm::FilePath& directory, const char* destDirPath,
                       bool onlyIfNewer, const char* password, bool encrypt_header, FrCompression compression, unsigned int volume_size);
 
+    // make the content of destDirPath match the directory: adds the new and changed files and deletes the missing ones
+    void syncDirectory(const Fm::FilePath& directory, const char* destDirPath,
+                       bool compareContent, const char* password, bool encrypt_header, FrCompression compression, unsigned int volume_size);
+
     /*
     void addWithWildcard(const char* include_files, const char* exclude_files, const char* exclude_folders, const char* base_dir, const char* dest_dir, bool update, bool follow_links, const char* password, bool encrypt_header, FrCompression compression, unsigned int volume_size);
 
@@ -90,6 +96,33 @@ public:
 
     void addDroppedItems(const Fm::FilePathList& srcPaths, const char *base_dir, const char *dest_dir, bool update, const char *password, bool encrypt_header, FrCompression compression, unsigned int volume_size);
 
+    // zip, 7z and plain tar archives are updated without working on a copy,
+    // applies to the archivers created afterwards
+    static void setModifyInPlace(bool value);
+
+    // copies avoided by cloning or modifying the archives in place, and the
+    // bytes they would have copied, since the program started
+    static void avoidedCopyStats(unsigned int& operations, quint64& bytes);
+
+    // work folders that were not on the file system of the destination, and
+    // the bytes copied from them, since the program started
+    static void crossDeviceStats(unsigned int& operations, quint64& bytes);
+
+    // split the extraction of zip, non-solid 7z and rar archives between
+    // this many extractor processes, 0 or 1 uses a single process
+    void setExtractJobs(unsigned int jobs);
+
+    // number of extractions to run at the same time: one per processor,
+    // fewer if the destination is on a rotational disk
+    static int defaultJobCount(const char* destDirUri);
+
+    // threads used by the parallel compressors, 0 means one per processor
+    static void setCompressionThreads(unsigned int threads);
+
+    // adaptive compression: choose the level that gives the best ratio while
+    // compressing at least mbPerSec MB/s or within deadline seconds, 0 disables
+    static void setCompressionTarget(double mbPerSec, unsigned int deadline);
+
     void removeFiles(GList* fileNames, FrCompression compression);
 
     void removeFiles(const std::vector<const FileData *> &files, FrCompression compression);
@@ -104,6 +137,14 @@ public:
 
     const char* lastExtractionDestination() const;
 
+    // the command line that writes the content of file to its standard output,
+    // empty if the archive type cannot do that
+    QStringList streamCommand(const FileData* file, const char* password) const;
+
+    // reads the content of file without extracting it, nullptr if the archive type
+    // cannot do that.  The caller owns the reader.
+    ArchiveEntryReader* openEntry(const ArchiverItem* file, const char* password = nullptr);
+
     void testArchiveIntegrity(const char* password);
 
     static QStringList supportedCreateMimeTypes();
@@ -132,6 +173,12 @@ Q_SIGNALS:
 
     void progress(double fraction);
 
+    // bytes processed per second, only when the size of the files is known
+    void throughput(double bytesPerSecond);
+
+    // estimated time to complete the current action
+    void timeRemaining(qint64 seconds);
+
     void message(QString msg);
 
     void stoppableChanged(bool value);
@@ -142,10 +189,25 @@ public Q_SLOTS:
 
 private:
 
-    static std::string stripTrailingSlash(std::string dirPath);
+    // a path of the FileData of the archive, not copied
+    struct PathKey {
+        const char* str;
+        size_t len;
+
+        bool operator==(const PathKey& other) const;
+    };
+
+    struct PathKeyHash {
+        size_t operator()(const PathKey& key) const;
+    };
+
+    // the path without the trailing slash, except for "/"
+    static PathKey dirKey(const char* path);
 
     static void freeStrsGList(GList* strs);
 
+    static PathArray* pathArrayFromFiles(const std::vector<const FileData*>& files);
+
     void rebuildDirTree();
 
     static QStringList mimeDescToNameFilters(int *mimeDescIndexes);
@@ -158,6 +220,8 @@ private:
 
     static void onProgress(FrArchive*, double fraction, Archiver* _this);
 
+    void updateTransferRate(double fraction);
+
     static void onMessage(FrArchive*, const char* msg, Archiver* _this);
 
     static void onStoppable(FrArchive*, gboolean value, Archiver* _this);
@@ -166,10 +230,16 @@ private:
 
 private:
     FrArchive* frArchive_;
-    std::unordered_map<std::string, ArchiverItem*> dirMap_;
-    std::vector<std::unique_ptr<ArchiverItem>> items_;
+    // the dir tree is stored flat: the items in one vector, the items of the
+    // archive first, and the children of each dir next to each other in childItems_
+    std::unordered_map<PathKey, size_t, PathKeyHash> itemMap_;  // full path => index in items_
+    std::unordered_map<PathKey, size_t, PathKeyHash> originalPathMap_;  // original path => index in items_
+    std::vector<ArchiverItem> items_;
+    std::vector<const ArchiverItem*> childItems_;
     ArchiverItem* rootItem_;
     bool busy_;
+    QElapsedTimer progressTimer_;
+    qint64 lastRateUpdate_;
     bool isEncrypted_;
     std::uint64_t uncompressedSize_;
 };
@@ -1,17 +1,26 @@
 #include "archiveritem.h"
 
-ArchiverItem::ArchiverItem(): data_{nullptr}, ownData_{false} {
+ArchiverItem::ArchiverItem(): parent_{nullptr}, data_{nullptr}, ownData_{false} {
 }
 
 ArchiverItem::ArchiverItem(const FileData* data, bool ownData):
-    data_{data}, ownData_{ownData} {
+    parent_{nullptr}, data_{data}, ownData_{ownData} {
 }
 
 ArchiverItem::ArchiverItem(const ArchiverItem &other):
+    parent_{nullptr},
     data_{other.data_ ? file_data_copy(const_cast<FileData*>(other.data_)) : nullptr},
     ownData_{true} {
 }
 
+ArchiverItem::ArchiverItem(ArchiverItem&& other) noexcept:
+    children_{other.children_},
+    parent_{other.parent_},
+    data_{other.data_},
+    ownData_{other.ownData_} {
+    other.ownData_ = false;
+}
+
 ArchiverItem::~ArchiverItem() {
     if(ownData_ && data_) {
         file_data_free(const_cast<FileData*>(data_));
@@ -58,10 +67,14 @@ bool ArchiverItem::hasChildren() const {
     return !children_.empty();
 }
 
-const std::vector<const ArchiverItem*>& ArchiverItem::children() const {
+const ArchiverItemRange& ArchiverItem::children() const {
     return children_;
 }
 
+const ArchiverItem* ArchiverItem::parent() const {
+    return parent_;
+}
+
 const FileData *ArchiverItem::data() const {
     return data_;
 }
@@ -74,8 +87,12 @@ void ArchiverItem::setData(const FileData *data, bool ownData) {
     ownData_ = ownData;
 }
 
-void ArchiverItem::addChild(ArchiverItem *child) {
-  children_.emplace_back(child);
+void ArchiverItem::setChildren(ArchiverItemRange children) {
+    children_ = children;
+}
+
+void ArchiverItem::setParent(const ArchiverItem* parent) {
+    parent_ = parent;
 }
 
 std::vector<const ArchiverItem *> &ArchiverItem::allChildren() const {
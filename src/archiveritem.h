@@ -6,6 +6,50 @@
 #include <QMetaType>
 #include <vector>
 
+class ArchiverItem;
+
+
+// A contiguous list of items, such as the children of a dir, which Archiver
+// stores together, or a vector of items.  The items are not owned.
+class ArchiverItemRange {
+public:
+    using const_iterator = const ArchiverItem* const*;
+
+    ArchiverItemRange(): begin_{nullptr}, end_{nullptr} {
+    }
+
+    ArchiverItemRange(const_iterator begin, const_iterator end): begin_{begin}, end_{end} {
+    }
+
+    ArchiverItemRange(const std::vector<const ArchiverItem*>& items):
+        begin_{items.data()}, end_{items.data() + items.size()} {
+    }
+
+    const_iterator begin() const {
+        return begin_;
+    }
+
+    const_iterator end() const {
+        return end_;
+    }
+
+    size_t size() const {
+        return end_ - begin_;
+    }
+
+    bool empty() const {
+        return begin_ == end_;
+    }
+
+    const ArchiverItem* operator[](size_t i) const {
+        return begin_[i];
+    }
+
+private:
+    const_iterator begin_;
+    const_iterator end_;
+};
+
 
 class ArchiverItem {
 public:
@@ -15,6 +59,8 @@ public:
 
     ArchiverItem(const ArchiverItem& other);
 
+    ArchiverItem(ArchiverItem&& other) noexcept;
+
     ~ArchiverItem();
 
     const char* name() const;
@@ -35,13 +81,19 @@ public:
 
     bool hasChildren() const;
 
-    const std::vector<const ArchiverItem*>& children() const;
+    const ArchiverItemRange& children() const;
+
+    // the dir containing the item, nullptr for the root
+    const ArchiverItem* parent() const;
 
     const FileData *data() const;
 
     void setData(const FileData *data, bool ownData);
 
-    void addChild(ArchiverItem* child);
+    // the children are stored by the owner of the items
+    void setChildren(ArchiverItemRange children);
+
+    void setParent(const ArchiverItem* parent);
 
     // recursively get all children of this item
     std::vector<const ArchiverItem*>& allChildren() const;
@@ -49,7 +101,8 @@ public:
     void allChildren(std::vector<const ArchiverItem*>& results) const;
 
 private:
-    std::vector<const ArchiverItem*> children_;
+    ArchiverItemRange children_;
+    const ArchiverItem* parent_;
     const FileData* data_;  // data from FrArchiver (optional)
     bool ownData_;
 };
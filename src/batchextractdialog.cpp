@@ -0,0 +1,239 @@
+#include "batchextractdialog.h"
+
+#include "ui_batchextractdialog.h"
+#include "passworddialog.h"
+
+#include <QHeaderView>
+#include <QProgressBar>
+#include <QTimer>
+#include <QTreeWidgetItem>
+
+#include <algorithm>
+
+#include <libfm-qt/core/filepath.h>
+
+
+BatchExtractDialog::BatchExtractDialog(QWidget* parent) :
+    QDialog(parent),
+    ui_{new Ui::BatchExtractDialog{}},
+    nextJob_{0},
+    jobCount_{1},
+    processesPerArchive_{1},
+    running_{0},
+    finished_{0},
+    failed_{0},
+    cancelled_{false},
+    extractHere_{true},
+    skipOlder_{false},
+    overwrite_{false},
+    reCreateFolders_{true},
+    askingPassword_{false} {
+
+    ui_->setupUi(this);
+
+    ui_->progressBar->setRange(0, 100);
+    ui_->progressBar->setValue(0);
+    ui_->progressBar->setFormat(tr("%p %"));
+    ui_->archives->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui_->archives->header()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+}
+
+BatchExtractDialog::~BatchExtractDialog() {
+}
+
+void BatchExtractDialog::setArchives(const std::vector<std::string>& archiveUris) {
+    for(const auto& uri: archiveUris) {
+        auto path = Fm::FilePath::fromUri(uri.c_str());
+        std::unique_ptr<Job> job{new Job{}};
+        job->uri = uri;
+        job->row = new QTreeWidgetItem(ui_->archives, QStringList{} << QString::fromUtf8(path.displayName().get()) << QString() << tr("Waiting"));
+        job->progressBar = new QProgressBar();
+        job->progressBar->setRange(0, 100);
+        job->progressBar->setValue(0);
+        ui_->archives->setItemWidget(job->row, 1, job->progressBar);
+        job->fraction = 0.0;
+        job->finished = false;
+        jobs_.emplace_back(std::move(job));
+    }
+    updateProgress();
+}
+
+void BatchExtractDialog::setExtractOptions(const char* destDirUri, bool skipOlder, bool overwrite, bool reCreateFolders) {
+    extractHere_ = (destDirUri == nullptr);
+    destDirUri_ = destDirUri ? destDirUri : "";
+    skipOlder_ = skipOlder;
+    overwrite_ = overwrite;
+    reCreateFolders_ = reCreateFolders;
+}
+
+void BatchExtractDialog::setJobCount(int jobs) {
+    jobCount_ = std::max(1, jobs);
+}
+
+void BatchExtractDialog::setProcessesPerArchive(int processes) {
+    processesPerArchive_ = std::max(1, processes);
+}
+
+void BatchExtractDialog::start() {
+    startNextJobs();
+}
+
+void BatchExtractDialog::reject() {
+    if(finished_ == int(jobs_.size()) || cancelled_) {
+        QDialog::reject();
+        return;
+    }
+    cancelled_ = true;
+    for(auto& job: jobs_) {
+        if(job->archiver && !job->finished) {
+            job->archiver->stopCurrentAction();
+        }
+    }
+    QDialog::reject();
+}
+
+void BatchExtractDialog::startNextJobs() {
+    while(!cancelled_ && running_ < jobCount_ && nextJob_ < jobs_.size()) {
+        Job* job = jobs_[nextJob_++].get();
+        job->archiver.reset(new Archiver{});
+        job->archiver->setExtractJobs(processesPerArchive_);
+        ++running_;
+        job->row->setText(2, tr("Reading"));
+        ui_->archives->scrollToItem(job->row);
+
+        connect(job->archiver.get(), &Archiver::progress, this, [this, job](double fraction) {
+            if(job->finished) {
+                return;
+            }
+            if(fraction < 0.0) {
+                // negative progress indicates that progress is unknown
+                job->progressBar->setRange(0, 0);
+            }
+            else {
+                job->progressBar->setRange(0, 100);
+                job->progressBar->setValue(int(100 * fraction));
+                if(job->archiver->currentAction() == FR_ACTION_EXTRACTING_FILES) {
+                    job->fraction = fraction;
+                    updateProgress();
+                }
+            }
+        });
+        connect(job->archiver.get(), &Archiver::finish, this, [this, job](FrAction action, ArchiverError err) {
+            onJobFinished(job, action, err);
+        });
+
+        if(!job->archiver->openArchive(job->uri.c_str(), nullptr)) {
+            finishJob(job, tr("Could not open the archive"));
+        }
+    }
+
+    if(finished_ < int(jobs_.size())) {
+        return;
+    }
+
+    // all the archives are done
+    if(failed_ == 0) {
+        accept();
+        return;
+    }
+    ui_->summary->setText(tr("%n archive(s) could not be extracted.", "", failed_));
+    ui_->buttonBox->setStandardButtons(QDialogButtonBox::Close);
+}
+
+void BatchExtractDialog::onJobFinished(Job* job, FrAction action, ArchiverError err) {
+    if(job->finished) {
+        return;
+    }
+    if(err.hasError()) {
+        finishJob(job, err.message());
+        return;
+    }
+    switch(action) {
+    case FR_ACTION_LISTING_CONTENT:
+        if(job->archiver->isEncrypted()) {
+            askPasswordAndExtract(job);
+        }
+        else {
+            extract(job, nullptr);
+        }
+        break;
+    case FR_ACTION_EXTRACTING_FILES:
+        finishJob(job, QString());
+        break;
+    default:
+        break;
+    }
+}
+
+void BatchExtractDialog::askPasswordAndExtract(Job* job) {
+    // one password dialog at a time, the other archives wait for their turn
+    passwordQueue_.push_back(job);
+    if(askingPassword_) {
+        return;
+    }
+    askingPassword_ = true;
+    while(!passwordQueue_.empty()) {
+        Job* next = passwordQueue_.front();
+        passwordQueue_.pop_front();
+        if(cancelled_ || next->finished) {
+            continue;
+        }
+        next->row->setText(2, tr("Waiting for the password"));
+        auto password = PasswordDialog::askPassword(this).toStdString();
+        if(!cancelled_ && !next->finished) {
+            extract(next, password.empty() ? nullptr : password.c_str());
+        }
+    }
+    askingPassword_ = false;
+}
+
+void BatchExtractDialog::extract(Job* job, const char* password) {
+    job->row->setText(2, tr("Extracting"));
+    if(extractHere_) {
+        if(!job->archiver->extractHere(skipOlder_, overwrite_, reCreateFolders_, password)) {
+            auto err = job->archiver->lastError();
+            finishJob(job, err.hasError() ? err.message() : tr("Could not create the destination folder"));
+        }
+    }
+    else {
+        job->archiver->extractAll(destDirUri_.c_str(), skipOlder_, overwrite_, reCreateFolders_, password);
+    }
+}
+
+void BatchExtractDialog::finishJob(Job* job, const QString& error) {
+    job->finished = true;
+    job->fraction = 1.0;
+    --running_;
+    ++finished_;
+
+    job->progressBar->setRange(0, 100);
+    if(error.isEmpty()) {
+        job->progressBar->setValue(100);
+        job->row->setText(2, tr("Done"));
+    }
+    else {
+        ++failed_;
+        job->row->setText(2, error);
+        job->row->setToolTip(2, error);
+        job->row->setForeground(2, Qt::red);
+    }
+
+    // the archiver is still emitting the signal that got us here
+    job->archiver.release()->deleteLater();
+
+    updateProgress();
+    QTimer::singleShot(0, this, [this]() {
+        startNextJobs();
+    });
+}
+
+void BatchExtractDialog::updateProgress() {
+    double total = 0.0;
+    for(const auto& job: jobs_) {
+        total += job->fraction;
+    }
+    if(!jobs_.empty()) {
+        ui_->progressBar->setValue(int(100 * total / jobs_.size()));
+    }
+    ui_->summary->setText(tr("Extracted %1 of %2 archives").arg(finished_ - failed_).arg(jobs_.size()));
+}
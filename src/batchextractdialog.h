@@ -0,0 +1,90 @@
+#ifndef BATCHEXTRACTDIALOG_H
+#define BATCHEXTRACTDIALOG_H
+
+#include <QDialog>
+#include <QString>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "archiver.h"
+
+namespace Ui {
+class BatchExtractDialog;
+}
+
+class QTreeWidgetItem;
+class QProgressBar;
+
+
+// Extracts a list of archives, several of them at the same time, showing
+// the progress of each archive in a row and collecting the errors
+class BatchExtractDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit BatchExtractDialog(QWidget* parent = 0);
+
+    ~BatchExtractDialog();
+
+    void setArchives(const std::vector<std::string>& archiveUris);
+
+    // destDirUri == nullptr extracts each archive in its folder
+    void setExtractOptions(const char* destDirUri, bool skipOlder, bool overwrite, bool reCreateFolders);
+
+    void setJobCount(int jobs);
+
+    // extractor processes used for each archive, see Archiver::setExtractJobs()
+    void setProcessesPerArchive(int processes);
+
+    void start();
+
+    int failedCount() const {
+        return failed_;
+    }
+
+    void reject() override;
+
+private:
+    struct Job {
+        std::string uri;
+        std::unique_ptr<Archiver> archiver;
+        QTreeWidgetItem* row;
+        QProgressBar* progressBar;
+        double fraction;
+        bool finished;
+    };
+
+    void startNextJobs();
+
+    void onJobFinished(Job* job, FrAction action, ArchiverError err);
+
+    void askPasswordAndExtract(Job* job);
+
+    void extract(Job* job, const char* password);
+
+    void finishJob(Job* job, const QString& error);
+
+    void updateProgress();
+
+private:
+    std::unique_ptr<Ui::BatchExtractDialog> ui_;
+    std::vector<std::unique_ptr<Job>> jobs_;
+    size_t nextJob_;
+    int jobCount_;
+    int processesPerArchive_;
+    int running_;
+    int finished_;
+    int failed_;
+    bool cancelled_;
+    bool extractHere_;
+    std::string destDirUri_;
+    bool skipOlder_;
+    bool overwrite_;
+    bool reCreateFolders_;
+    bool askingPassword_;
+    std::deque<Job*> passwordQueue_;  // encrypted archives waiting for the password dialog
+};
+
+#endif // BATCHEXTRACTDIALOG_H
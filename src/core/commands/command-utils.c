@@ -0,0 +1,114 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <glib.h>
+#include "command-utils.h"
+
+
+#define COPY_BUFFER_SIZE  (128 * 1024)
+
+
+GPtrArray *
+get_names (char       **names,
+	   const char  *list_filename)
+{
+	GPtrArray *result;
+	int        i;
+
+	result = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; (names != NULL) && (names[i] != NULL); i++)
+		g_ptr_array_add (result, g_strdup (names[i]));
+
+	if (list_filename != NULL) {
+		char  *content;
+		char **lines;
+
+		if (! g_file_get_contents (list_filename, &content, NULL, NULL)) {
+			g_ptr_array_free (result, TRUE);
+			return NULL;
+		}
+		lines = g_strsplit (content, "\n", -1);
+		for (i = 0; lines[i] != NULL; i++) {
+			char **parts;
+
+			if (lines[i][0] == '\0')
+				continue;
+
+			/* new lines are escaped in the list */
+
+			parts = g_strsplit (lines[i], "\\n", -1);
+			g_ptr_array_add (result, g_strjoinv ("\n", parts));
+			g_strfreev (parts);
+		}
+		g_strfreev (lines);
+		g_free (content);
+	}
+
+	return result;
+}
+
+
+gboolean
+copy_file_data (int src_fd,
+		int dest_fd)
+{
+	char    *buffer = NULL;
+	ssize_t  n;
+
+#ifdef SYS_copy_file_range
+	while ((n = syscall (SYS_copy_file_range, src_fd, NULL, dest_fd, NULL, COPY_BUFFER_SIZE * 8, 0)) > 0)
+		/* void */;
+	if (n == 0)
+		return TRUE;
+	if ((errno != ENOSYS) && (errno != EXDEV) && (errno != EINVAL) && (errno != EOPNOTSUPP))
+		return FALSE;
+#endif
+
+	/* not supported between these file systems, copy with a buffer from
+	 * the current offsets. */
+
+	buffer = g_malloc (COPY_BUFFER_SIZE);
+	while ((n = read (src_fd, buffer, COPY_BUFFER_SIZE)) > 0) {
+		char *p = buffer;
+
+		while (n > 0) {
+			ssize_t written = write (dest_fd, p, n);
+
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				g_free (buffer);
+				return FALSE;
+			}
+			p += written;
+			n -= written;
+		}
+	}
+	g_free (buffer);
+
+	return n == 0;
+}
@@ -0,0 +1,40 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COMMAND_UTILS_H
+#define COMMAND_UTILS_H
+
+#include <glib.h>
+
+/* Returns the names given on the command line followed by the ones read
+ * from list_filename, one per line with the new lines escaped as "\n",
+ * if it is not NULL.  Returns NULL if the list cannot be read. */
+GPtrArray *  get_names                        (char       **names,
+					       const char  *list_filename);
+
+/* Copies the rest of src_fd to dest_fd from their current offsets, with
+ * copy_file_range() when the file systems allow it.  Returns FALSE on
+ * error, errno tells why. */
+gboolean     copy_file_data                   (int          src_fd,
+					       int          dest_fd);
+
+#endif /* COMMAND_UTILS_H */
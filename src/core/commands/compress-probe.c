@@ -0,0 +1,427 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Chooses the compression level for the adaptive compression:
+ *
+ *   compress-probe --script=FILE [--speed=MB] [--deadline=SECONDS]
+ *                  [--base-dir=DIR] [--files-from=LIST] [--file=FILE...]
+ *                  [--sample-command=COMMAND] [--input-size=SIZE]
+ *                  COMMAND...
+ *
+ * A sample of the input is compressed with every command line, the one
+ * with the best ratio whose throughput meets the target is used, the
+ * fastest one if none does.  The target is the larger of the speed, in
+ * MB/s, and the throughput needed to compress the input in the
+ * deadline.  The input is made of the files, relative to the base
+ * folder, listed in LIST separated by NUL characters or given with
+ * --file, folders are scanned recursively; or of the output of the
+ * sample command, in which case its size is given by --input-size.
+ *
+ * FILE is replaced with a shell script that runs the chosen command line
+ * and FILE.info is written with the estimate:
+ *
+ *   THROUGHPUT RATIO INPUT-SIZE
+ *   COMMAND
+ *
+ * the throughput is in bytes per second.  The exit status is 0 if a
+ * command line was chosen and 1 otherwise, FILE is left unchanged in
+ * that case. */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+
+#define SAMPLE_SIZE        (4 * 1024 * 1024)
+#define SAMPLE_MAX_CHUNKS  16
+#define SAMPLE_MAX_FILES   4096
+#define MEGABYTE           (1024.0 * 1024.0)
+
+
+static char     *script_filename = NULL;
+static double    speed = 0;
+static int       deadline = 0;
+static char     *base_dir = NULL;
+static char     *list_filename = NULL;
+static char    **filenames = NULL;
+static char     *sample_command = NULL;
+static gint64    input_size = -1;
+static char    **command_lines = NULL;
+
+
+static const GOptionEntry options[] = {
+	{ "script", 0, 0, G_OPTION_ARG_FILENAME, &script_filename, "Write the chosen command to FILE", "FILE" },
+	{ "speed", 0, 0, G_OPTION_ARG_DOUBLE, &speed, "Target throughput in MB/s", "MB" },
+	{ "deadline", 0, 0, G_OPTION_ARG_INT, &deadline, "Target time in seconds", "SECONDS" },
+	{ "base-dir", 0, 0, G_OPTION_ARG_FILENAME, &base_dir, "The files are relative to DIR", "DIR" },
+	{ "files-from", 0, 0, G_OPTION_ARG_FILENAME, &list_filename, "Read the files from LIST, separated by NUL characters", "LIST" },
+	{ "file", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, "Sample FILE", "FILE" },
+	{ "sample-command", 0, 0, G_OPTION_ARG_STRING, &sample_command, "Sample the output of COMMAND", "COMMAND" },
+	{ "input-size", 0, 0, G_OPTION_ARG_INT64, &input_size, "Size of the output of the sample command", "SIZE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &command_lines, NULL, "COMMAND..." },
+	{ NULL }
+};
+
+
+static void
+scan_sample_files (const char *path,
+		   GPtrArray  *files,
+		   goffset    *total_size)
+{
+	GStatBuf    st;
+	GDir       *dir;
+	const char *name;
+
+	/* symbolic links are archived as links */
+
+	if (g_lstat (path, &st) != 0)
+		return;
+
+	if (S_ISREG (st.st_mode)) {
+		*total_size += st.st_size;
+		if ((st.st_size > 0) && (files->len < SAMPLE_MAX_FILES))
+			g_ptr_array_add (files, g_strdup (path));
+		return;
+	}
+
+	if (! S_ISDIR (st.st_mode))
+		return;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		char *child = g_build_filename (path, name, NULL);
+
+		scan_sample_files (child, files, total_size);
+		g_free (child);
+	}
+	g_dir_close (dir);
+}
+
+
+static void
+scan_sample_file (const char *name,
+		  GPtrArray  *files,
+		  goffset    *total_size)
+{
+	char *path;
+
+	path = g_build_filename ((base_dir != NULL) ? base_dir : "", name, NULL);
+	scan_sample_files (path, files, total_size);
+	g_free (path);
+}
+
+
+/* appends a chunk from the middle of the file, the beginning of a file
+ * is often a header that compresses differently from the rest. */
+static gboolean
+append_chunk (FILE       *sample,
+	      const char *path,
+	      gsize       chunk_size)
+{
+	FILE     *f;
+	GStatBuf  st;
+	char      buffer[16384];
+	gsize     remaining;
+	gboolean  result = TRUE;
+
+	f = g_fopen (path, "rb");
+	if (f == NULL)
+		return FALSE;
+
+	if ((fstat (fileno (f), &st) == 0) && (st.st_size > (goffset) chunk_size))
+		fseeko (f, (st.st_size - chunk_size) / 2, SEEK_SET);
+
+	for (remaining = chunk_size; remaining > 0; ) {
+		size_t n;
+
+		n = fread (buffer, 1, MIN (remaining, sizeof (buffer)), f);
+		if (n == 0)
+			break;
+		if (fwrite (buffer, 1, n, sample) != n) {
+			result = FALSE;
+			break;
+		}
+		remaining -= n;
+	}
+	fclose (f);
+
+	return result;
+}
+
+
+static goffset
+get_file_size (const char *path)
+{
+	GStatBuf st;
+
+	if (g_stat (path, &st) != 0)
+		return 0;
+	return st.st_size;
+}
+
+
+/* writes chunks of the files spread over the whole input to
+ * sample_file, returns the size of the files */
+static goffset
+create_sample_from_files (const char *sample_file)
+{
+	GPtrArray *files;
+	goffset    total_size = 0;
+	FILE      *sample;
+	guint      step;
+	guint      i;
+
+	files = g_ptr_array_new_with_free_func (g_free);
+
+	if (list_filename != NULL) {
+		char  *list;
+		gsize  length;
+		gsize  start;
+
+		if (g_file_get_contents (list_filename, &list, &length, NULL)) {
+			for (start = 0, i = 0; i <= length; i++) {
+				if ((i < length) && (list[i] != '\0'))
+					continue;
+				if (i > start)
+					scan_sample_file (list + start, files, &total_size);
+				start = i + 1;
+			}
+			g_free (list);
+		}
+	}
+
+	for (i = 0; (filenames != NULL) && (filenames[i] != NULL); i++)
+		scan_sample_file (filenames[i], files, &total_size);
+
+	if (files->len > 0) {
+		sample = g_fopen (sample_file, "wb");
+		if (sample != NULL) {
+			step = MAX (1, files->len / SAMPLE_MAX_CHUNKS);
+			for (i = 0; i < files->len; i += step)
+				if (! append_chunk (sample, g_ptr_array_index (files, i), SAMPLE_SIZE / SAMPLE_MAX_CHUNKS))
+					break;
+			fclose (sample);
+		}
+	}
+
+	g_ptr_array_free (files, TRUE);
+
+	return total_size;
+}
+
+
+static void
+create_sample_from_command (const char *sample_file)
+{
+	char *e_sample_file;
+	char *script;
+	char *argv[4];
+
+	/* the command is killed by SIGPIPE when head has enough data, only
+	 * the size of the sample matters. */
+
+	e_sample_file = g_shell_quote (sample_file);
+	script = g_strdup_printf ("%s | head -c %d > %s", sample_command, SAMPLE_SIZE, e_sample_file);
+	argv[0] = "sh";
+	argv[1] = "-c";
+	argv[2] = script;
+	argv[3] = NULL;
+
+	g_spawn_sync (NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+	g_free (script);
+	g_free (e_sample_file);
+}
+
+
+/* compresses the sample and measures the throughput in bytes per second
+ * and the compression ratio */
+static gboolean
+estimate_command_line (const char *command_line,
+		       const char *sample_file,
+		       goffset     sample_size,
+		       double     *throughput,
+		       double     *ratio)
+{
+	char     *e_sample_file;
+	char     *script;
+	char     *argv[4];
+	char     *output = NULL;
+	int       status;
+	gint64    start_time;
+	gint64    elapsed;
+	gboolean  result;
+
+	e_sample_file = g_shell_quote (sample_file);
+	script = g_strconcat (command_line, " < ", e_sample_file, " | wc -c", NULL);
+	argv[0] = "sh";
+	argv[1] = "-c";
+	argv[2] = script;
+	argv[3] = NULL;
+
+	start_time = g_get_monotonic_time ();
+	result = g_spawn_sync (NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &output, NULL, &status, NULL)
+		 && g_spawn_check_exit_status (status, NULL);
+	elapsed = MAX (g_get_monotonic_time () - start_time, 1);
+
+	if (result) {
+		gint64 compressed_size = g_ascii_strtoll (g_strstrip (output), NULL, 10);
+
+		result = compressed_size > 0;
+		*throughput = sample_size / (elapsed / (double) G_USEC_PER_SEC);
+		*ratio = (double) compressed_size / sample_size;
+	}
+
+	g_free (output);
+	g_free (script);
+	g_free (e_sample_file);
+
+	return result;
+}
+
+
+/* the script is replaced atomically, the compression can start as soon
+ * as the file exists. */
+static gboolean
+write_choice (const char *command_line,
+	      double      throughput,
+	      double      ratio,
+	      goffset     size)
+{
+	char     *info_filename;
+	char     *info;
+	char     *script;
+	char      throughput_str[G_ASCII_DTOSTR_BUF_SIZE];
+	char      ratio_str[G_ASCII_DTOSTR_BUF_SIZE];
+	gboolean  result;
+
+	info_filename = g_strconcat (script_filename, ".info", NULL);
+	info = g_strdup_printf ("%s %s %" G_GINT64_FORMAT "\n%s\n",
+				g_ascii_dtostr (throughput_str, sizeof (throughput_str), throughput),
+				g_ascii_dtostr (ratio_str, sizeof (ratio_str), ratio),
+				(gint64) size,
+				command_line);
+	script = g_strdup_printf ("#!/bin/sh\nexec %s \"$@\"\n", command_line);
+
+	result = g_file_set_contents (info_filename, info, -1, NULL)
+		 && g_file_set_contents (script_filename, script, -1, NULL)
+		 && (g_chmod (script_filename, 0700) == 0);
+
+	g_free (script);
+	g_free (info);
+	g_free (info_filename);
+
+	return result;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError         *error = NULL;
+	char           *sample_file = NULL;
+	goffset         sample_size;
+	goffset         size;
+	double          target;
+	const char     *best = NULL;
+	double          best_throughput = 0;
+	double          best_ratio = 0;
+	gboolean        best_meets_target = FALSE;
+	int             fd;
+	guint           i;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (! g_option_context_parse (context, &argc, &argv, &error)
+	    || (script_filename == NULL)
+	    || (command_lines == NULL))
+	{
+		g_printerr ("%s\n", (error != NULL) ? error->message : "Invalid arguments");
+		return 1;
+	}
+	g_option_context_free (context);
+
+	fd = g_file_open_tmp ("lxqt-archiver-sample-XXXXXX", &sample_file, &error);
+	if (fd == -1) {
+		g_printerr ("%s\n", error->message);
+		return 1;
+	}
+	close (fd);
+
+	if (sample_command != NULL) {
+		create_sample_from_command (sample_file);
+		size = input_size;
+	}
+	else
+		size = create_sample_from_files (sample_file);
+
+	sample_size = get_file_size (sample_file);
+	if (sample_size == 0) {
+		g_unlink (sample_file);
+		g_free (sample_file);
+		return 1;
+	}
+
+	target = speed * MEGABYTE;
+	if ((deadline > 0) && (size > 0))
+		target = MAX (target, (double) size / deadline);
+
+	for (i = 0; command_lines[i] != NULL; i++) {
+		double   throughput;
+		double   ratio;
+		gboolean meets_target;
+
+		if (! estimate_command_line (command_lines[i], sample_file, sample_size, &throughput, &ratio))
+			continue;
+
+		/* the best ratio that meets the target, otherwise the
+		 * fastest */
+
+		meets_target = throughput >= target;
+		if ((best == NULL)
+		    || (meets_target && (! best_meets_target || (ratio < best_ratio)))
+		    || (! meets_target && ! best_meets_target && (throughput > best_throughput)))
+		{
+			best = command_lines[i];
+			best_throughput = throughput;
+			best_ratio = ratio;
+			best_meets_target = meets_target;
+		}
+	}
+
+	g_unlink (sample_file);
+	g_free (sample_file);
+
+	if (best == NULL)
+		return 1;
+
+	return write_choice (best, best_throughput, best_ratio, size) ? 0 : 1;
+}
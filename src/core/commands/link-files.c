@@ -0,0 +1,294 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Recreates files of a folder in a staging folder, so that the files of
+ * several folders can be added to an archive with a single command:
+ *
+ *   link-files [--no-recursion] [--list=FILE] SOURCE_DIR DEST_DIR [NAME...]
+ *
+ * The names are relative to SOURCE_DIR, each one is recreated in
+ * DEST_DIR with the same relative path, folders are recreated with their
+ * content unless --no-recursion is given.  The files are hard links to
+ * the original ones, they are copied only when they cannot be linked
+ * (another file system, protected hard links), the folders keep the
+ * permissions and the modification time of the original ones and the
+ * symbolic links are recreated, so that the archived entries are the
+ * same as if they were added from SOURCE_DIR.  Existing files are
+ * replaced.  The exit status is 0 on success and 1 on error. */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "command-utils.h"
+
+
+#define EXIT_LINK_ERROR   1
+
+
+static gboolean  no_recursion = FALSE;
+static char     *list_filename = NULL;
+static char    **remaining_args = NULL;
+
+
+static const GOptionEntry options[] = {
+	{ "no-recursion", 0, 0, G_OPTION_ARG_NONE, &no_recursion, "Do not recreate the content of the folders", NULL },
+	{ "list", 0, 0, G_OPTION_ARG_FILENAME, &list_filename, "Read the names from FILE, one per line", "FILE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &remaining_args, NULL, "SOURCE_DIR DEST_DIR [NAME...]" },
+	{ NULL }
+};
+
+
+/* a folder whose permissions and time are set when its content is
+ * complete */
+typedef struct {
+	char        *path;
+	struct stat  st;
+} LinkedDir;
+
+
+static gboolean
+copy_regular_file (const char        *src_path,
+		   const char        *dest_path,
+		   const struct stat *src_st)
+{
+	struct timespec times[2];
+	int             src_fd;
+	int             dest_fd;
+	gboolean        result;
+
+	src_fd = open (src_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (src_fd < 0)
+		return FALSE;
+
+	dest_fd = open (dest_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (dest_fd < 0) {
+		close (src_fd);
+		return FALSE;
+	}
+
+	result = copy_file_data (src_fd, dest_fd);
+
+	/* the archived entry has the permissions and the modification time
+	 * of the original file */
+
+	if (result) {
+		times[0] = src_st->st_atim;
+		times[1] = src_st->st_mtim;
+		result = (fchmod (dest_fd, src_st->st_mode & 07777) == 0)
+			 && (futimens (dest_fd, times) == 0);
+	}
+
+	close (src_fd);
+	if ((close (dest_fd) != 0) || ! result) {
+		int saved_errno = errno;
+
+		unlink (dest_path);
+		errno = saved_errno;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean
+link_entry (const char *src_path,
+	    const char *dest_path,
+	    GPtrArray  *dirs)
+{
+	struct stat src_st;
+	struct stat dest_st;
+	gboolean    dest_exists;
+
+	if (lstat (src_path, &src_st) != 0)
+		return FALSE;
+
+	dest_exists = (lstat (dest_path, &dest_st) == 0);
+
+	if (S_ISDIR (src_st.st_mode)) {
+		LinkedDir *dir;
+
+		if (dest_exists && ! S_ISDIR (dest_st.st_mode) && (unlink (dest_path) != 0))
+			return FALSE;
+		if ((! dest_exists || ! S_ISDIR (dest_st.st_mode)) && (mkdir (dest_path, 0700) != 0))
+			return FALSE;
+
+		dir = g_new (LinkedDir, 1);
+		dir->path = g_strdup (dest_path);
+		dir->st = src_st;
+		g_ptr_array_add (dirs, dir);
+
+		if (! no_recursion) {
+			GDir       *src_dir;
+			const char *name;
+			gboolean    result = TRUE;
+
+			src_dir = g_dir_open (src_path, 0, NULL);
+			if (src_dir == NULL)
+				return FALSE;
+
+			while ((name = g_dir_read_name (src_dir)) != NULL) {
+				char *child_src = g_build_filename (src_path, name, NULL);
+				char *child_dest = g_build_filename (dest_path, name, NULL);
+
+				if (! link_entry (child_src, child_dest, dirs)) {
+					g_printerr ("%s: %s\n", child_src, g_strerror (errno));
+					result = FALSE;
+				}
+
+				g_free (child_dest);
+				g_free (child_src);
+			}
+			g_dir_close (src_dir);
+
+			return result;
+		}
+
+		return TRUE;
+	}
+
+	/* the files of a later folder replace the ones of a previous one,
+	 * as a later add command would do */
+
+	if (dest_exists) {
+		if (S_ISDIR (dest_st.st_mode)) {
+			errno = EISDIR;
+			return FALSE;
+		}
+		if (unlink (dest_path) != 0)
+			return FALSE;
+	}
+
+	if (S_ISLNK (src_st.st_mode)) {
+		char    target[4096];
+		ssize_t len;
+
+		len = readlink (src_path, target, sizeof (target) - 1);
+		if (len < 0)
+			return FALSE;
+		target[len] = '\0';
+
+		return symlink (target, dest_path) == 0;
+	}
+
+	if (S_ISREG (src_st.st_mode)) {
+		if (link (src_path, dest_path) == 0)
+			return TRUE;
+		return copy_regular_file (src_path, dest_path, &src_st);
+	}
+
+	return mknod (dest_path, src_st.st_mode, src_st.st_rdev) == 0;
+}
+
+
+static void
+linked_dir_free (LinkedDir *dir)
+{
+	g_free (dir->path);
+	g_free (dir);
+}
+
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError         *error = NULL;
+	GPtrArray      *names;
+	GPtrArray      *dirs;
+	gboolean        result = TRUE;
+	guint           i;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (! g_option_context_parse (context, &argc, &argv, &error)
+	    || (remaining_args == NULL)
+	    || (remaining_args[0] == NULL)
+	    || (remaining_args[1] == NULL))
+	{
+		g_printerr ("%s\n", (error != NULL) ? error->message : "Invalid arguments");
+		return EXIT_LINK_ERROR;
+	}
+	g_option_context_free (context);
+
+	names = get_names (remaining_args + 2, list_filename);
+	if (names == NULL) {
+		g_printerr ("%s: %s\n", list_filename, g_strerror (errno));
+		return EXIT_LINK_ERROR;
+	}
+
+	dirs = g_ptr_array_new_with_free_func ((GDestroyNotify) linked_dir_free);
+
+	for (i = 0; i < names->len; i++) {
+		const char *name = g_ptr_array_index (names, i);
+		char       *src_path;
+		char       *dest_path;
+		char       *dest_parent;
+
+		/* the parent folders in the names, such as the destination
+		 * folder in the archive, go through the links of SOURCE_DIR
+		 * and are not archived themselves. */
+
+		src_path = g_build_filename (remaining_args[0], name, NULL);
+		dest_path = g_build_filename (remaining_args[1], name, NULL);
+		dest_parent = g_path_get_dirname (dest_path);
+
+		if ((g_mkdir_with_parents (dest_parent, 0700) != 0)
+		    || ! link_entry (src_path, dest_path, dirs))
+		{
+			g_printerr ("%s: %s\n", src_path, g_strerror (errno));
+			result = FALSE;
+		}
+
+		g_free (dest_parent);
+		g_free (dest_path);
+		g_free (src_path);
+	}
+
+	/* the content changes the time of the folders, the innermost ones
+	 * are set first.  The folders stay writable to be removed with the
+	 * staging folder. */
+
+	for (i = dirs->len; i > 0; i--) {
+		LinkedDir       *dir = g_ptr_array_index (dirs, i - 1);
+		struct timespec  times[2];
+
+		times[0] = dir->st.st_atim;
+		times[1] = dir->st.st_mtim;
+		if ((chmod (dir->path, (dir->st.st_mode & 07777) | S_IRWXU) != 0)
+		    || (utimensat (AT_FDCWD, dir->path, times, 0) != 0))
+		{
+			g_printerr ("%s: %s\n", dir->path, g_strerror (errno));
+			result = FALSE;
+		}
+	}
+
+	g_ptr_array_free (dirs, TRUE);
+	g_ptr_array_free (names, TRUE);
+
+	return result ? 0 : EXIT_LINK_ERROR;
+}
@@ -0,0 +1,434 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Moves the files extracted in a temporary folder to the destination,
+ * as 'mv' would do for each name, in a single process:
+ *
+ *   move-files [--overwrite] [--list=FILE] SOURCE_DIR DEST_DIR [NAME...]
+ *
+ * The names are relative to SOURCE_DIR, each one is moved to DEST_DIR
+ * with its base name.  A folder that already exists in DEST_DIR receives
+ * the content of the moved folder, existing files are replaced only with
+ * --overwrite.  The files are renamed, they are copied only when the two
+ * folders are on different file systems.  The exit status is 0 on
+ * success and 1 on error. */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <glib.h>
+#include "command-utils.h"
+
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+
+#define EXIT_MOVE_ERROR   1
+
+
+static gboolean  overwrite = FALSE;
+static char     *list_filename = NULL;
+static char    **remaining_args = NULL;
+
+
+static const GOptionEntry options[] = {
+	{ "overwrite", 0, 0, G_OPTION_ARG_NONE, &overwrite, "Overwrite existing files", NULL },
+	{ "list", 0, 0, G_OPTION_ARG_FILENAME, &list_filename, "Read the names from FILE, one per line", "FILE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &remaining_args, NULL, "SOURCE_DIR DEST_DIR [NAME...]" },
+	{ NULL }
+};
+
+
+static gboolean move_entry (int         src_dirfd,
+			    const char *src_name,
+			    int         dest_dirfd,
+			    const char *dest_name);
+
+
+/* renames without replacing an existing destination unless overwriting,
+ * returns 0, or -1 and sets errno as renameat. */
+static int
+rename_entry (int         src_dirfd,
+	      const char *src_name,
+	      int         dest_dirfd,
+	      const char *dest_name)
+{
+	static gboolean noreplace_supported = TRUE;
+	struct stat     dest_st;
+
+	if (overwrite)
+		return renameat (src_dirfd, src_name, dest_dirfd, dest_name);
+
+#ifdef SYS_renameat2
+	if (noreplace_supported) {
+		if (syscall (SYS_renameat2, src_dirfd, src_name, dest_dirfd, dest_name, RENAME_NOREPLACE) == 0)
+			return 0;
+		if ((errno != EINVAL) && (errno != ENOSYS))
+			return -1;
+
+		/* not supported by the kernel or by the file system */
+
+		noreplace_supported = FALSE;
+	}
+#endif
+
+	if (fstatat (dest_dirfd, dest_name, &dest_st, AT_SYMLINK_NOFOLLOW) == 0) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	return renameat (src_dirfd, src_name, dest_dirfd, dest_name);
+}
+
+
+/* moves the content of the source folder into the existing destination
+ * folder, then removes the source folder if it is empty. */
+static gboolean
+merge_directories (int         src_dirfd,
+		   const char *src_name,
+		   int         dest_dirfd,
+		   const char *dest_name)
+{
+	DIR           *dir;
+	struct dirent *entry;
+	GPtrArray     *names;
+	int            src_fd;
+	int            dest_fd;
+	gboolean       result = TRUE;
+	guint          i;
+
+	src_fd = openat (src_dirfd, src_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (src_fd < 0) {
+		g_printerr ("%s: %s\n", src_name, g_strerror (errno));
+		return FALSE;
+	}
+
+	dest_fd = openat (dest_dirfd, dest_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dest_fd < 0) {
+		g_printerr ("%s: %s\n", dest_name, g_strerror (errno));
+		close (src_fd);
+		return FALSE;
+	}
+
+	dir = fdopendir (src_fd);
+	if (dir == NULL) {
+		g_printerr ("%s: %s\n", src_name, g_strerror (errno));
+		close (src_fd);
+		close (dest_fd);
+		return FALSE;
+	}
+
+	/* read all the names first, the folder changes while moving */
+
+	names = g_ptr_array_new_with_free_func (g_free);
+	while ((entry = readdir (dir)) != NULL) {
+		if ((strcmp (entry->d_name, ".") == 0) || (strcmp (entry->d_name, "..") == 0))
+			continue;
+		g_ptr_array_add (names, g_strdup (entry->d_name));
+	}
+
+	for (i = 0; i < names->len; i++) {
+		const char *name = g_ptr_array_index (names, i);
+
+		if (! move_entry (dirfd (dir), name, dest_fd, name))
+			result = FALSE;
+	}
+
+	g_ptr_array_free (names, TRUE);
+	closedir (dir);
+	close (dest_fd);
+
+	/* the files that were not replaced are left in the temporary
+	 * folder, which is removed later. */
+
+	unlinkat (src_dirfd, src_name, AT_REMOVEDIR);
+
+	return result;
+}
+
+
+static gboolean
+copy_regular_file (int                src_dirfd,
+		   const char        *src_name,
+		   int                dest_dirfd,
+		   const char        *dest_name,
+		   const struct stat *src_st)
+{
+	struct timespec times[2];
+	int             src_fd;
+	int             dest_fd;
+	gboolean        result;
+
+	src_fd = openat (src_dirfd, src_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (src_fd < 0)
+		return FALSE;
+
+	dest_fd = openat (dest_dirfd,
+			  dest_name,
+			  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (overwrite ? 0 : O_EXCL),
+			  src_st->st_mode & 07777);
+	if (dest_fd < 0) {
+		close (src_fd);
+		return FALSE;
+	}
+
+	result = copy_file_data (src_fd, dest_fd);
+
+	/* keep the permissions and the modification time, as mv does */
+
+	if (result) {
+		times[0] = src_st->st_atim;
+		times[1] = src_st->st_mtim;
+		result = (fchmod (dest_fd, src_st->st_mode & 07777) == 0)
+			 && (futimens (dest_fd, times) == 0);
+	}
+
+	close (src_fd);
+	if ((close (dest_fd) != 0) || ! result) {
+		int saved_errno = errno;
+
+		unlinkat (dest_dirfd, dest_name, 0);
+		errno = saved_errno;
+		return FALSE;
+	}
+
+	return unlinkat (src_dirfd, src_name, 0) == 0;
+}
+
+
+/* moves an entry to another file system */
+static gboolean
+copy_entry (int         src_dirfd,
+	    const char *src_name,
+	    int         dest_dirfd,
+	    const char *dest_name)
+{
+	struct stat src_st;
+	struct stat dest_st;
+	gboolean    dest_exists;
+
+	if (fstatat (src_dirfd, src_name, &src_st, AT_SYMLINK_NOFOLLOW) != 0)
+		return FALSE;
+
+	dest_exists = (fstatat (dest_dirfd, dest_name, &dest_st, AT_SYMLINK_NOFOLLOW) == 0);
+
+	if (S_ISDIR (src_st.st_mode)) {
+		if (! dest_exists && (mkdirat (dest_dirfd, dest_name, src_st.st_mode & 07777) != 0))
+			return FALSE;
+		if (dest_exists && ! S_ISDIR (dest_st.st_mode)) {
+			if (! overwrite)
+				return TRUE;
+			errno = ENOTDIR;
+			return FALSE;
+		}
+		return merge_directories (src_dirfd, src_name, dest_dirfd, dest_name);
+	}
+
+	if (dest_exists && ! overwrite)
+		return TRUE;
+
+	if (S_ISLNK (src_st.st_mode)) {
+		char    target[4096];
+		ssize_t len;
+
+		len = readlinkat (src_dirfd, src_name, target, sizeof (target) - 1);
+		if (len < 0)
+			return FALSE;
+		target[len] = '\0';
+
+		if (dest_exists && ! S_ISDIR (dest_st.st_mode))
+			unlinkat (dest_dirfd, dest_name, 0);
+		if (symlinkat (target, dest_dirfd, dest_name) != 0)
+			return FALSE;
+
+		return unlinkat (src_dirfd, src_name, 0) == 0;
+	}
+
+	if (S_ISREG (src_st.st_mode))
+		return copy_regular_file (src_dirfd, src_name, dest_dirfd, dest_name, &src_st);
+
+	errno = ENOTSUP;
+
+	return FALSE;
+}
+
+
+static gboolean
+move_entry (int         src_dirfd,
+	    const char *src_name,
+	    int         dest_dirfd,
+	    const char *dest_name)
+{
+	struct stat src_st;
+	struct stat dest_st;
+	int         rename_errno;
+
+	if (rename_entry (src_dirfd, src_name, dest_dirfd, dest_name) == 0)
+		return TRUE;
+
+	rename_errno = errno;
+
+	switch (rename_errno) {
+	case ENOENT:
+		/* already moved along with its folder */
+		if (fstatat (src_dirfd, src_name, &src_st, AT_SYMLINK_NOFOLLOW) != 0)
+			return TRUE;
+		break;
+
+	case EEXIST:
+	case ENOTEMPTY:
+		if ((fstatat (src_dirfd, src_name, &src_st, AT_SYMLINK_NOFOLLOW) == 0)
+		    && S_ISDIR (src_st.st_mode)
+		    && (fstatat (dest_dirfd, dest_name, &dest_st, 0) == 0)
+		    && S_ISDIR (dest_st.st_mode))
+		{
+			return merge_directories (src_dirfd, src_name, dest_dirfd, dest_name);
+		}
+		if (! overwrite)
+			return TRUE;
+		break;
+
+	case EXDEV:
+		if (copy_entry (src_dirfd, src_name, dest_dirfd, dest_name))
+			return TRUE;
+		rename_errno = errno;
+		break;
+
+	default:
+		break;
+	}
+
+	g_printerr ("%s: %s\n", src_name, g_strerror (rename_errno));
+
+	return FALSE;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError         *error = NULL;
+	GPtrArray      *names;
+	char           *cached_parent = NULL;
+	int             cached_fd = -1;
+	int             cached_errno = 0;
+	int             source_fd;
+	int             dest_fd;
+	gboolean        result = TRUE;
+	guint           i;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (! g_option_context_parse (context, &argc, &argv, &error)
+	    || (remaining_args == NULL)
+	    || (remaining_args[0] == NULL)
+	    || (remaining_args[1] == NULL))
+	{
+		g_printerr ("%s\n", (error != NULL) ? error->message : "Invalid arguments");
+		return EXIT_MOVE_ERROR;
+	}
+	g_option_context_free (context);
+
+	names = get_names (remaining_args + 2, list_filename);
+	if (names == NULL) {
+		g_printerr ("%s: %s\n", list_filename, g_strerror (errno));
+		return EXIT_MOVE_ERROR;
+	}
+
+	source_fd = open (remaining_args[0], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (source_fd < 0) {
+		g_printerr ("%s: %s\n", remaining_args[0], g_strerror (errno));
+		return EXIT_MOVE_ERROR;
+	}
+
+	dest_fd = open (remaining_args[1], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dest_fd < 0) {
+		g_printerr ("%s: %s\n", remaining_args[1], g_strerror (errno));
+		return EXIT_MOVE_ERROR;
+	}
+
+	/* the names are sorted by the archive, the folder of the previous
+	 * name is usually the folder of the next one. */
+
+	for (i = 0; i < names->len; i++) {
+		char *name = g_ptr_array_index (names, i);
+		char *basename;
+		char *parent;
+		gsize len;
+
+		while (name[0] == '/')
+			name++;
+		len = strlen (name);
+		while ((len > 0) && (name[len - 1] == '/'))
+			name[--len] = '\0';
+		if (len == 0)
+			continue;
+
+		basename = strrchr (name, '/');
+		if (basename != NULL) {
+			parent = name;
+			*basename++ = '\0';
+		}
+		else {
+			parent = ".";
+			basename = name;
+		}
+
+		if (g_strcmp0 (parent, cached_parent) != 0) {
+			if (cached_fd >= 0)
+				close (cached_fd);
+			g_free (cached_parent);
+			cached_parent = g_strdup (parent);
+			cached_fd = openat (source_fd, parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			cached_errno = errno;
+		}
+
+		if (cached_fd < 0) {
+			/* already moved along with its folder */
+			if (cached_errno != ENOENT) {
+				g_printerr ("%s: %s\n", parent, g_strerror (cached_errno));
+				result = FALSE;
+			}
+			continue;
+		}
+
+		if (! move_entry (cached_fd, basename, dest_fd, basename))
+			result = FALSE;
+	}
+
+	if (cached_fd >= 0)
+		close (cached_fd);
+	g_free (cached_parent);
+	g_ptr_array_free (names, TRUE);
+	close (source_fd);
+	close (dest_fd);
+
+	return result ? 0 : EXIT_MOVE_ERROR;
+}
@@ -0,0 +1,245 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Copies the entries of the tar archive read from the standard input to
+ * the standard output, without the end-of-archive marker, so that the
+ * output can be followed by the entries of another archive.  The exit
+ * status is 0 on success and 2 if the input is not a valid tar archive,
+ * as for tar. */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <glib.h>
+
+
+#define BLOCK_SIZE       512
+#define EXIT_TAR_ERROR   2
+
+
+static gboolean
+read_block (guchar   *block,
+	    gboolean *eof)
+{
+	size_t n;
+
+	n = fread (block, 1, BLOCK_SIZE, stdin);
+	*eof = (n == 0) && feof (stdin);
+
+	return n == BLOCK_SIZE;
+}
+
+
+static gboolean
+write_block (const guchar *block)
+{
+	return fwrite (block, 1, BLOCK_SIZE, stdout) == BLOCK_SIZE;
+}
+
+
+static gboolean
+is_zero_block (const guchar *block)
+{
+	int i;
+
+	for (i = 0; i < BLOCK_SIZE; i++)
+		if (block[i] != 0)
+			return FALSE;
+
+	return TRUE;
+}
+
+
+/* numeric fields are octal, or base-256 when the high bit of the first
+ * byte is set (GNU and star extension for large values). */
+static gint64
+get_number (const guchar *field,
+	    int           len)
+{
+	gint64 value = 0;
+	int    i;
+
+	if (field[0] & 0x80) {
+		value = field[0] & 0x3f;
+		for (i = 1; i < len; i++)
+			value = (value << 8) | field[i];
+		return value;
+	}
+
+	for (i = 0; (i < len) && (field[i] == ' '); i++)
+		/* void */;
+	for (; (i < len) && (field[i] >= '0') && (field[i] <= '7'); i++)
+		value = (value << 3) | (field[i] - '0');
+
+	return value;
+}
+
+
+static gboolean
+checksum_is_valid (const guchar *block)
+{
+	gint64 expected;
+	gint64 unsigned_sum = 0;
+	gint64 signed_sum = 0;
+	int    i;
+
+	expected = get_number (block + 148, 8);
+	for (i = 0; i < BLOCK_SIZE; i++) {
+		int c = ((i >= 148) && (i < 156)) ? ' ' : block[i];
+
+		unsigned_sum += (guchar) c;
+		signed_sum += (signed char) c;
+	}
+
+	return (expected == unsigned_sum) || (expected == signed_sum);
+}
+
+
+/* returns the value of the "size" record of a pax extended header, or
+ * -1 if the header does not have one. */
+static gint64
+get_pax_size (const char *data,
+	      gint64      len)
+{
+	const char *p = data;
+	const char *end = data + len;
+
+	while (p < end) {
+		char   *keyword;
+		gint64  record_len;
+
+		record_len = g_ascii_strtoll (p, &keyword, 10);
+		if ((record_len <= 0) || (record_len > end - p) || (*keyword != ' '))
+			break;
+		keyword++;
+		if (strncmp (keyword, "size=", 5) == 0)
+			return g_ascii_strtoll (keyword + 5, NULL, 10);
+		p += record_len;
+	}
+
+	return -1;
+}
+
+
+static gboolean
+copy_data (gint64  size,
+	   GString *keep)
+{
+	guchar block[BLOCK_SIZE];
+	gboolean eof;
+
+	for (; size > 0; size -= BLOCK_SIZE) {
+		if (! read_block (block, &eof) || ! write_block (block))
+			return FALSE;
+		if (keep != NULL)
+			g_string_append_len (keep, (char *) block, MIN (size, BLOCK_SIZE));
+	}
+
+	return TRUE;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	guchar  block[BLOCK_SIZE];
+	gint64  global_size = -1;
+	gint64  next_size = -1;
+	gboolean eof;
+
+	for (;;) {
+		char     type;
+		gint64   size;
+		GString *pax_data = NULL;
+
+		if (! read_block (block, &eof)) {
+			/* an archive can end without the marker */
+			if (eof)
+				break;
+			return EXIT_TAR_ERROR;
+		}
+
+		if (is_zero_block (block)) {
+			/* read what follows the marker, the process that
+			 * writes the archive must not get a broken pipe. */
+			while (fread (block, 1, BLOCK_SIZE, stdin) > 0)
+				/* void */;
+			break;
+		}
+
+		if (! checksum_is_valid (block))
+			return EXIT_TAR_ERROR;
+
+		if (! write_block (block))
+			return EXIT_TAR_ERROR;
+
+		type = block[156];
+		size = get_number (block + 124, 12);
+
+		if ((type == 'x') || (type == 'g')) {
+			pax_data = g_string_new (NULL);
+		}
+		else {
+			if (next_size >= 0)
+				size = next_size;
+			else if (global_size >= 0)
+				size = global_size;
+			next_size = -1;
+		}
+
+		/* links, devices, directories and fifos have no data */
+
+		if ((type >= '1') && (type <= '6'))
+			size = 0;
+
+		/* the sparse map continues in extension blocks */
+
+		if ((type == 'S') && (block[482] != 0)) {
+			do {
+				if (! read_block (block, &eof) || ! write_block (block))
+					return EXIT_TAR_ERROR;
+			}
+			while (block[504] != 0);
+		}
+
+		if (! copy_data (size, pax_data))
+			return EXIT_TAR_ERROR;
+
+		if (pax_data != NULL) {
+			gint64 pax_size = get_pax_size (pax_data->str, pax_data->len);
+
+			if (pax_size >= 0) {
+				if (type == 'x')
+					next_size = pax_size;
+				else
+					global_size = pax_size;
+			}
+			g_string_free (pax_data, TRUE);
+		}
+	}
+
+	if (fflush (stdout) != 0)
+		return EXIT_TAR_ERROR;
+
+	return 0;
+}
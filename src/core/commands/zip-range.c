@@ -0,0 +1,541 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+/* Extracts or tests the entries of a zip archive reading only the ranges
+ * it needs, so that the entries of a large remote archive can be
+ * extracted without downloading the whole archive:
+ *
+ *   zip-range --extract=DIR [--overwrite] [--skip-older] [--junk-paths]
+ *             [--list=FILE] URI [NAME...]
+ *   zip-range --test URI
+ *   zip-range --copy=FILE URI
+ *
+ * The names are the paths stored in the archive, a name that ends with
+ * '/' selects the folder content too.  --copy downloads the archive.
+ * One line is printed for each entry, the exit status is 0 on success
+ * and 2 on error, as for unzip. */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "../zip-index.h"
+
+
+#define EXIT_ZIP_ERROR 2
+
+
+static char     *extract_dir = NULL;
+static char     *list_filename = NULL;
+static char     *copy_filename = NULL;
+static gboolean  test = FALSE;
+static gboolean  overwrite = FALSE;
+static gboolean  skip_older = FALSE;
+static gboolean  junk_paths = FALSE;
+static char    **remaining_args = NULL;
+
+
+static const GOptionEntry options[] = {
+	{ "extract", 0, 0, G_OPTION_ARG_FILENAME, &extract_dir, "Extract the entries to DIR", "DIR" },
+	{ "test", 0, 0, G_OPTION_ARG_NONE, &test, "Test the entries", NULL },
+	{ "copy", 0, 0, G_OPTION_ARG_FILENAME, &copy_filename, "Copy the whole archive to FILE", "FILE" },
+	{ "overwrite", 0, 0, G_OPTION_ARG_NONE, &overwrite, "Overwrite existing files", NULL },
+	{ "skip-older", 0, 0, G_OPTION_ARG_NONE, &skip_older, "Do not overwrite newer files", NULL },
+	{ "junk-paths", 0, 0, G_OPTION_ARG_NONE, &junk_paths, "Do not create the folders", NULL },
+	{ "list", 0, 0, G_OPTION_ARG_FILENAME, &list_filename, "Read the names from FILE, one per line", "FILE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &remaining_args, NULL, "URI [NAME...]" },
+	{ NULL }
+};
+
+
+static GHashTable *
+get_selected_names (char **names)
+{
+	GHashTable *selected;
+	int         i;
+
+	selected = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (i = 0; (names != NULL) && (names[i] != NULL); i++)
+		g_hash_table_add (selected, g_strdup (names[i]));
+
+	if (list_filename != NULL) {
+		char  *content;
+		char **lines;
+
+		if (! g_file_get_contents (list_filename, &content, NULL, NULL)) {
+			g_hash_table_unref (selected);
+			return NULL;
+		}
+		lines = g_strsplit (content, "\n", -1);
+		for (i = 0; lines[i] != NULL; i++) {
+			char **parts;
+
+			if (lines[i][0] == '\0')
+				continue;
+
+			/* new lines are escaped in the list */
+
+			parts = g_strsplit (lines[i], "\\n", -1);
+			g_hash_table_add (selected, g_strjoinv ("\n", parts));
+			g_strfreev (parts);
+		}
+		g_strfreev (lines);
+		g_free (content);
+	}
+
+	return selected;
+}
+
+
+static gboolean
+entry_is_selected (ZipEntry   *entry,
+		   GHashTable *selected)
+{
+	char *parent;
+
+	if (g_hash_table_size (selected) == 0)
+		return TRUE;
+	if (g_hash_table_contains (selected, entry->name))
+		return TRUE;
+
+	/* the entries of a selected folder */
+
+	parent = g_strdup (entry->name);
+	for (;;) {
+		char *slash = strrchr (parent, '/');
+
+		if (slash == NULL)
+			break;
+		if (slash[1] == '\0') {
+			*slash = '\0';
+			continue;
+		}
+		slash[1] = '\0';
+		if (g_hash_table_contains (selected, parent)) {
+			g_free (parent);
+			return TRUE;
+		}
+		*slash = '\0';
+	}
+	g_free (parent);
+
+	return FALSE;
+}
+
+
+/* the path relative to the extraction folder, NULL if the entry cannot
+ * be extracted safely. */
+static char *
+get_relative_path (ZipEntry *entry)
+{
+	const char  *name = entry->name;
+	char       **elements;
+	gboolean     valid = TRUE;
+	int          i;
+
+	while (*name == '/')
+		name++;
+
+	elements = g_strsplit (name, "/", -1);
+	for (i = 0; elements[i] != NULL; i++)
+		if (strcmp (elements[i], "..") == 0)
+			valid = FALSE;
+	g_strfreev (elements);
+
+	if (! valid || (*name == '\0'))
+		return NULL;
+
+	if (junk_paths) {
+		const char *base = strrchr (name, '/');
+		return g_strdup ((base != NULL) ? base + 1 : name);
+	}
+
+	return g_strdup (name);
+}
+
+
+/* whether a folder of relative_path in the extraction folder is a
+ * symbolic link, the file would be written where the link points to. */
+static gboolean
+path_goes_through_link (const char *relative_path)
+{
+	char     *path;
+	char     *slash;
+	gboolean  result = FALSE;
+
+	path = g_build_filename (extract_dir, relative_path, NULL);
+	slash = path + strlen (extract_dir);
+	while ((slash = strchr (slash + 1, '/')) != NULL) {
+		GStatBuf buf;
+
+		*slash = '\0';
+		if ((g_lstat (path, &buf) == 0) && S_ISLNK (buf.st_mode))
+			result = TRUE;
+		*slash = '/';
+		if (result)
+			break;
+	}
+	g_free (path);
+
+	return result;
+}
+
+
+static gboolean
+destination_is_newer (const char *filename,
+		      ZipEntry   *entry,
+		      gboolean   *exists)
+{
+	GStatBuf buf;
+
+	*exists = (g_lstat (filename, &buf) == 0);
+	return *exists && (buf.st_mtime >= entry->modified);
+}
+
+
+static gboolean
+extract_link (GInputStream  *stream,
+	      ZipEntry      *entry,
+	      const char    *filename,
+	      GError       **error)
+{
+	GOutputStream *output;
+	char          *target;
+	gboolean       result;
+
+	output = g_memory_output_stream_new_resizable ();
+	result = zip_entry_extract (stream, entry, output, NULL, error)
+		 && g_output_stream_write_all (output, "", 1, NULL, NULL, error)
+		 && g_output_stream_close (output, NULL, error);
+	if (result) {
+		target = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output));
+		g_unlink (filename);
+		if (symlink (target, filename) != 0) {
+			g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno), "%s: %s", filename, g_strerror (errno));
+			result = FALSE;
+		}
+	}
+	g_object_unref (output);
+
+	return result;
+}
+
+
+static gboolean
+extract_file (GInputStream  *stream,
+	      ZipEntry      *entry,
+	      const char    *filename,
+	      GError       **error)
+{
+	GFile             *file;
+	GFileOutputStream *output;
+	gboolean           result;
+
+	file = g_file_new_for_path (filename);
+	output = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+	g_object_unref (file);
+	if (output == NULL)
+		return FALSE;
+
+	result = zip_entry_extract (stream, entry, G_OUTPUT_STREAM (output), NULL, error);
+	if (result)
+		result = g_output_stream_close (G_OUTPUT_STREAM (output), NULL, error);
+	else
+		g_output_stream_close (G_OUTPUT_STREAM (output), NULL, NULL);
+	g_object_unref (output);
+
+	if (result && (entry->mode != 0))
+		g_chmod (filename, entry->mode & 0777);
+
+	return result;
+}
+
+
+static void
+set_modification_time (const char *filename,
+		       time_t      modified)
+{
+	struct utimbuf times;
+
+	times.actime = modified;
+	times.modtime = modified;
+	g_utime (filename, &times);
+}
+
+
+static gboolean
+extract_entries (GInputStream *stream,
+		 GPtrArray    *entries,
+		 GHashTable   *selected)
+{
+	GList    *dirs = NULL;
+	GList    *links = NULL;
+	GList    *scan;
+	gboolean  result = TRUE;
+	guint     i;
+
+	for (i = 0; i < entries->len; i++) {
+		ZipEntry *entry = g_ptr_array_index (entries, i);
+		char     *relative_path;
+		char     *filename;
+		char     *parent;
+		gboolean  exists;
+		GError   *error = NULL;
+
+		if (! entry_is_selected (entry, selected))
+			continue;
+		if (entry->dir && junk_paths)
+			continue;
+
+		/* the links are created last, so that no entry is
+		 * extracted through a link of the archive. */
+
+		if (entry->link) {
+			links = g_list_prepend (links, entry);
+			continue;
+		}
+
+		relative_path = get_relative_path (entry);
+		if ((relative_path == NULL) || path_goes_through_link (relative_path)) {
+			g_printerr ("skipping: %s\n", entry->name);
+			g_free (relative_path);
+			continue;
+		}
+		filename = g_build_filename (extract_dir, relative_path, NULL);
+		g_free (relative_path);
+
+		if (entry->dir) {
+			if (g_mkdir_with_parents (filename, 0777) != 0) {
+				g_printerr ("%s: %s\n", filename, g_strerror (errno));
+				result = FALSE;
+			}
+			else
+				dirs = g_list_prepend (dirs, entry);
+			printf ("   creating: %s\n", entry->name);
+			fflush (stdout);
+			g_free (filename);
+			continue;
+		}
+
+		if (destination_is_newer (filename, entry, &exists) && skip_older) {
+			g_free (filename);
+			continue;
+		}
+		if (exists && ! overwrite) {
+			g_free (filename);
+			continue;
+		}
+
+		parent = g_path_get_dirname (filename);
+		g_mkdir_with_parents (parent, 0777);
+		g_free (parent);
+
+		if (extract_file (stream, entry, filename, &error)) {
+			set_modification_time (filename, entry->modified);
+			printf ("  inflating: %s\n", entry->name);
+		}
+		fflush (stdout);
+
+		if (error != NULL) {
+			g_printerr ("%s\n", error->message);
+			g_error_free (error);
+			result = FALSE;
+		}
+		g_free (filename);
+	}
+
+	links = g_list_reverse (links);
+	for (scan = links; scan; scan = scan->next) {
+		ZipEntry *entry = scan->data;
+		char     *relative_path;
+		char     *filename;
+		char     *parent;
+		gboolean  exists;
+		GError   *error = NULL;
+
+		/* a link may still point to another link of the archive */
+
+		relative_path = get_relative_path (entry);
+		if ((relative_path == NULL) || path_goes_through_link (relative_path)) {
+			g_printerr ("skipping: %s\n", entry->name);
+			g_free (relative_path);
+			continue;
+		}
+		filename = g_build_filename (extract_dir, relative_path, NULL);
+
+		if ((destination_is_newer (filename, entry, &exists) && skip_older)
+		    || (exists && ! overwrite))
+		{
+			g_free (filename);
+			g_free (relative_path);
+			continue;
+		}
+
+		parent = g_path_get_dirname (filename);
+		g_mkdir_with_parents (parent, 0777);
+		g_free (parent);
+
+		if (extract_link (stream, entry, filename, &error))
+			printf ("    linking: %s\n", entry->name);
+		fflush (stdout);
+
+		if (error != NULL) {
+			g_printerr ("%s\n", error->message);
+			g_error_free (error);
+			result = FALSE;
+		}
+		g_free (filename);
+		g_free (relative_path);
+	}
+	g_list_free (links);
+
+	/* set the time of the folders last, extracting their content
+	 * changes it. */
+
+	for (scan = dirs; scan; scan = scan->next) {
+		ZipEntry *entry = scan->data;
+		char     *relative_path;
+		char     *filename;
+
+		relative_path = get_relative_path (entry);
+		filename = g_build_filename (extract_dir, relative_path, NULL);
+		set_modification_time (filename, entry->modified);
+
+		g_free (filename);
+		g_free (relative_path);
+	}
+	g_list_free (dirs);
+
+	return result;
+}
+
+
+static gboolean
+test_entries (GInputStream *stream,
+	      GPtrArray    *entries)
+{
+	gboolean result = TRUE;
+	guint    i;
+
+	for (i = 0; i < entries->len; i++) {
+		ZipEntry *entry = g_ptr_array_index (entries, i);
+		GError   *error = NULL;
+
+		if (entry->dir)
+			continue;
+
+		if (zip_entry_extract (stream, entry, NULL, NULL, &error))
+			printf ("    testing: %s   OK\n", entry->name);
+		else {
+			printf ("    testing: %s   %s\n", entry->name, error->message);
+			g_error_free (error);
+			result = FALSE;
+		}
+		fflush (stdout);
+	}
+
+	return result;
+}
+
+
+static gboolean
+copy_archive (GFile  *source,
+	      GError **error)
+{
+	GFile    *destination;
+	gboolean  result;
+
+	destination = g_file_new_for_path (copy_filename);
+	result = g_file_copy (source, destination, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, error);
+	g_object_unref (destination);
+
+	return result;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext   *context;
+	GFile            *file;
+	GFileInputStream *stream;
+	GPtrArray        *entries;
+	GHashTable       *selected;
+	GError           *error = NULL;
+	gboolean          result;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (! g_option_context_parse (context, &argc, &argv, &error)
+	    || (remaining_args == NULL)
+	    || ((extract_dir == NULL) + ! test + (copy_filename == NULL) != 2))
+	{
+		g_printerr ("%s\n", (error != NULL) ? error->message : "Invalid arguments");
+		return EXIT_ZIP_ERROR;
+	}
+	g_option_context_free (context);
+
+	file = g_file_new_for_commandline_arg (remaining_args[0]);
+
+	if (copy_filename != NULL) {
+		result = copy_archive (file, &error);
+		if (! result)
+			g_printerr ("%s\n", error->message);
+		g_object_unref (file);
+		return result ? 0 : EXIT_ZIP_ERROR;
+	}
+
+	stream = g_file_read (file, NULL, &error);
+	g_object_unref (file);
+	if (stream == NULL) {
+		g_printerr ("%s\n", error->message);
+		return EXIT_ZIP_ERROR;
+	}
+
+	entries = zip_index_read (G_INPUT_STREAM (stream), NULL, &error);
+	if (entries == NULL) {
+		g_printerr ("%s\n", error->message);
+		g_object_unref (stream);
+		return EXIT_ZIP_ERROR;
+	}
+
+	if (test)
+		result = test_entries (G_INPUT_STREAM (stream), entries);
+	else {
+		selected = get_selected_names (remaining_args + 1);
+		result = (selected != NULL) && extract_entries (G_INPUT_STREAM (stream), entries, selected);
+		if (selected != NULL)
+			g_hash_table_unref (selected);
+	}
+
+	g_ptr_array_free (entries, TRUE);
+	g_object_unref (stream);
+
+	return result ? 0 : EXIT_ZIP_ERROR;
+}
@@ -0,0 +1,534 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "compress-utils.h"
+#include "file-utils.h"
+#include "glib-utils.h"
+
+
+typedef struct {
+	const char *mime_type;
+	const char *command;
+	const char *threads_option;  /* NULL if single-threaded, %u is
+				      * replaced by the number of threads */
+	const char *options[4];      /* compressors: the level option
+				      * indexed by FrCompression, NULL if it
+				      * cannot be chosen; decompressors: the
+				      * decompression option */
+	const char *large_input_option; /* compressors: added when the
+					 * input is larger than
+					 * LARGE_INPUT_SIZE */
+} CompressorInfo;
+
+
+/* zstd compresses with a window of at most 8 MiB by default, long
+ * distance matching uses 128 MiB, which any decompressor accepts. */
+#define LARGE_INPUT_SIZE (64 * 1024 * 1024)
+
+
+/* fastest first */
+
+static const CompressorInfo compressors[] = {
+	{ "application/x-gzip",  "pigz",   "-p %u", { "-1", "-3", "-6", "-9" } },
+	{ "application/x-gzip",  "gzip",   NULL,    { "-1", "-3", "-6", "-9" } },
+	{ "application/x-bzip",  "lbzip2", "-n %u", { "-1", "-3", "-6", "-9" } },
+	{ "application/x-bzip",  "pbzip2", "-p%u",  { "-1", "-3", "-6", "-9" } },
+	{ "application/x-bzip",  "bzip2",  NULL,    { "-1", "-3", "-6", "-9" } },
+	{ "application/x-xz",    "pixz",   "-p %u", { "-1", "-3", "-6", "-9" } },
+	{ "application/x-xz",    "xz",     "-T %u", { "-1", "-3", "-6", "-9" } },
+	{ "application/x-lzip",  "plzip",  "-n %u", { "-1", "-3", "-6", "-9" } },
+	{ "application/x-lzip",  "lzip",   NULL,    { "-1", "-3", "-6", "-9" } },
+	{ "application/x-lzma",  "lzma",   NULL,    { "-1", "-3", "-6", "-9" } },
+	{ "application/x-lzop",  "lzop",   NULL,    { "-1", "-3", "-6", "-9" } },
+	{ "application/zstd",    "zstd",   "-T%u",  { "-1", "-3", "-9", "-19" }, "--long" },
+	{ "application/x-compress", "compress", NULL, { NULL, NULL, NULL, NULL } },
+};
+
+
+/* fastest first, the command lines decompress the standard input to the
+ * standard output and still work if tar appends another -d. */
+
+static const CompressorInfo decompressors[] = {
+	{ "application/x-gzip",  "pigz",   NULL,    { "-d" } },
+	{ "application/x-gzip",  "gzip",   NULL,    { "-d" } },
+	{ "application/x-bzip",  "lbzip2", "-n %u", { "-d" } },
+	{ "application/x-bzip",  "pbzip2", "-p%u",  { "-d" } },
+	{ "application/x-bzip",  "bzip2",  NULL,    { "-d" } },
+	{ "application/x-xz",    "pixz",   "-p %u", { "-d" } },
+	{ "application/x-xz",    "xz",     "-T %u", { "-d" } },
+	{ "application/x-lzip",  "plzip",  "-n %u", { "-d" } },
+	{ "application/x-lzip",  "lzip",   NULL,    { "-d" } },
+	{ "application/x-lzma",  "lzma",   NULL,    { "-d" } },
+	{ "application/x-lzop",  "lzop",   NULL,    { "-d" } },
+	{ "application/zstd",    "zstd",   NULL,    { "-d" } },
+	{ "application/x-compress", "gzip", NULL,   { "-d" } },
+	{ "application/x-compress", "uncompress", NULL, { "-c" } },
+};
+
+
+static guint thread_budget = 0;
+static double target_throughput = 0;  /* MB/s */
+static guint  target_deadline = 0;    /* seconds */
+
+
+void
+compressor_set_thread_budget (guint n_threads)
+{
+	thread_budget = n_threads;
+}
+
+
+guint
+compressor_get_thread_budget (void)
+{
+	if (thread_budget == 0)
+		return g_get_num_processors ();
+	return thread_budget;
+}
+
+
+static const CompressorInfo *
+find_in_registry (const CompressorInfo *registry,
+		  guint                 n_entries,
+		  const char           *mime_type)
+{
+	guint i;
+
+	for (i = 0; i < n_entries; i++)
+		if (is_mime_type (mime_type, registry[i].mime_type)
+		    && is_program_in_path (registry[i].command))
+		{
+			return registry + i;
+		}
+
+	return NULL;
+}
+
+
+static char *
+get_command_line (const CompressorInfo *info,
+		  const char           *option)
+{
+	GString *command_line;
+
+	command_line = g_string_new (info->command);
+	if (option != NULL) {
+		g_string_append_c (command_line, ' ');
+		g_string_append (command_line, option);
+	}
+	if (info->threads_option != NULL) {
+		g_string_append_c (command_line, ' ');
+		g_string_append_printf (command_line, info->threads_option, compressor_get_thread_budget ());
+	}
+
+	return g_string_free (command_line, FALSE);
+}
+
+
+static char *
+get_compress_command_line (const CompressorInfo *compressor,
+			   const char           *option,
+			   goffset               input_size)
+{
+	char *command_line;
+
+	command_line = get_command_line (compressor, option);
+	if ((compressor->large_input_option != NULL) && (input_size > LARGE_INPUT_SIZE)) {
+		char *tmp = command_line;
+
+		command_line = g_strconcat (tmp, " ", compressor->large_input_option, NULL);
+		g_free (tmp);
+	}
+
+	return command_line;
+}
+
+
+static const CompressorInfo *
+find_compressor (const char *mime_type)
+{
+	return find_in_registry (compressors, G_N_ELEMENTS (compressors), mime_type);
+}
+
+
+gboolean
+compressor_is_available (const char *mime_type)
+{
+	return find_compressor (mime_type) != NULL;
+}
+
+
+char *
+compressor_get_command_line (const char    *mime_type,
+			     FrCompression  compression,
+			     goffset        input_size)
+{
+	const CompressorInfo *compressor;
+	char                 *command_line;
+
+	compressor = find_compressor (mime_type);
+	if (compressor == NULL)
+		return NULL;
+
+	command_line = get_compress_command_line (compressor, compressor->options[compression], input_size);
+	debug (DEBUG_INFO, "compressor for %s: %s\n", mime_type, command_line);
+
+	return command_line;
+}
+
+
+gboolean
+decompressor_is_available (const char *mime_type)
+{
+	return find_in_registry (decompressors, G_N_ELEMENTS (decompressors), mime_type) != NULL;
+}
+
+
+char *
+decompressor_get_command_line (const char *mime_type)
+{
+	const CompressorInfo *decompressor;
+	char                 *command_line;
+
+	decompressor = find_in_registry (decompressors, G_N_ELEMENTS (decompressors), mime_type);
+	if (decompressor == NULL)
+		return NULL;
+
+	command_line = get_command_line (decompressor, decompressor->options[0]);
+	debug (DEBUG_INFO, "decompressor for %s: %s\n", mime_type, command_line);
+
+	return command_line;
+}
+
+
+gboolean
+decompressor_has_warning_status (const char *mime_type)
+{
+	const CompressorInfo *decompressor;
+
+	/* gzip and pigz exit with 2 after a warning, e.g. trailing garbage
+	 * after the compressed data. */
+
+	decompressor = find_in_registry (decompressors, G_N_ELEMENTS (decompressors), mime_type);
+
+	return (decompressor != NULL)
+		&& ((strcmp (decompressor->command, "gzip") == 0)
+		    || (strcmp (decompressor->command, "pigz") == 0));
+}
+
+
+/* -- adaptive compression -- */
+
+
+void
+compressor_set_adaptive_target (double mb_per_sec,
+				guint  deadline)
+{
+	target_throughput = MAX (mb_per_sec, 0);
+	target_deadline = deadline;
+}
+
+
+gboolean
+compressor_is_adaptive (void)
+{
+	return (target_throughput > 0) || (target_deadline > 0);
+}
+
+
+
+#define COMPRESS_PROBE_COMMAND PRIVEXECDIR "compress-probe"
+
+
+struct _CompressorChoice {
+	char      *dir;
+	char      *script;        /* runs the chosen command line */
+	char      *command_line;  /* the quoted script */
+	GPtrArray *candidates;    /* every level of every installed
+				   * compressor for the format */
+	gint64     start_time;
+};
+
+
+static gboolean
+write_script (const char *script,
+	      const char *command_line)
+{
+	char     *content;
+	gboolean  result;
+
+	content = g_strdup_printf ("#!/bin/sh\nexec %s \"$@\"\n", command_line);
+	result = g_file_set_contents (script, content, -1, NULL) && (g_chmod (script, 0700) == 0);
+	g_free (content);
+
+	return result;
+}
+
+
+CompressorChoice *
+compressor_choice_new (const char    *mime_type,
+		       FrCompression  compression,
+		       goffset        input_size)
+{
+	CompressorChoice *choice;
+	char             *command_line;
+	guint             i, j;
+
+	if (! compressor_is_adaptive ()
+	    || ! g_file_test (COMPRESS_PROBE_COMMAND, G_FILE_TEST_IS_EXECUTABLE))
+	{
+		return NULL;
+	}
+
+	command_line = compressor_get_command_line (mime_type, compression, input_size);
+	if (command_line == NULL)
+		return NULL;
+
+	choice = g_new0 (CompressorChoice, 1);
+	choice->candidates = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < G_N_ELEMENTS (compressors); i++) {
+		const CompressorInfo *compressor = compressors + i;
+
+		if (! is_mime_type (mime_type, compressor->mime_type)
+		    || ! is_program_in_path (compressor->command))
+		{
+			continue;
+		}
+
+		for (j = 0; j < G_N_ELEMENTS (compressor->options); j++) {
+			if ((compressor->options[j] == NULL) && (j > 0))
+				continue;
+			g_ptr_array_add (choice->candidates, get_compress_command_line (compressor, compressor->options[j], input_size));
+		}
+	}
+
+	/* the script runs the default level until the probe replaces it */
+
+	choice->dir = g_dir_make_tmp ("lxqt-archiver-XXXXXX", NULL);
+	if (choice->dir != NULL) {
+		choice->script = g_build_filename (choice->dir, "compress", NULL);
+		choice->command_line = g_shell_quote (choice->script);
+	}
+
+	if ((choice->dir == NULL) || ! write_script (choice->script, command_line)) {
+		compressor_choice_free (choice);
+		choice = NULL;
+	}
+
+	g_free (command_line);
+
+	return choice;
+}
+
+
+const char *
+compressor_choice_get_command_line (CompressorChoice *choice)
+{
+	return choice->command_line;
+}
+
+
+static void
+begin_probe_command (CompressorChoice *choice,
+		     FrProcess        *process)
+{
+	fr_process_begin_command (process, COMPRESS_PROBE_COMMAND);
+	fr_process_set_ignore_error (process, TRUE);
+	fr_process_add_arg_concat (process, "--script=", choice->script, NULL);
+	if (target_throughput > 0) {
+		char speed[G_ASCII_DTOSTR_BUF_SIZE];
+
+		fr_process_add_arg_concat (process, "--speed=", g_ascii_dtostr (speed, sizeof (speed), target_throughput), NULL);
+	}
+	if (target_deadline > 0)
+		fr_process_add_arg_printf (process, "--deadline=%u", target_deadline);
+}
+
+
+static void
+end_probe_command (CompressorChoice *choice,
+		   FrProcess        *process)
+{
+	guint i;
+
+	fr_process_add_arg (process, "--");
+	for (i = 0; i < choice->candidates->len; i++)
+		fr_process_add_arg (process, g_ptr_array_index (choice->candidates, i));
+	fr_process_end_command (process);
+}
+
+
+void
+compressor_choice_add_probe_for_files (CompressorChoice *choice,
+				       FrProcess        *process,
+				       GList            *file_list,
+				       const char       *base_dir)
+{
+	char    *list_filename;
+	GString *list;
+	GList   *scan;
+
+	/* the files are read by the probe, when the previous commands
+	 * have created them. */
+
+	list = g_string_new (NULL);
+	for (scan = file_list; scan; scan = scan->next) {
+		g_string_append (list, scan->data);
+		g_string_append_c (list, '\0');
+	}
+	list_filename = g_build_filename (choice->dir, "files", NULL);
+	if (! g_file_set_contents (list_filename, list->str, list->len, NULL)) {
+		g_free (list_filename);
+		g_string_free (list, TRUE);
+		return;
+	}
+
+	begin_probe_command (choice, process);
+	if (base_dir != NULL)
+		fr_process_add_arg_concat (process, "--base-dir=", base_dir, NULL);
+	fr_process_add_arg_concat (process, "--files-from=", list_filename, NULL);
+	end_probe_command (choice, process);
+
+	g_free (list_filename);
+	g_string_free (list, TRUE);
+}
+
+
+void
+compressor_choice_add_probe_for_command (CompressorChoice *choice,
+					 FrProcess        *process,
+					 const char       *command,
+					 goffset           input_size)
+{
+	begin_probe_command (choice, process);
+	fr_process_add_arg_concat (process, "--sample-command=", command, NULL);
+	if (input_size >= 0)
+		fr_process_add_arg_printf (process, "--input-size=%" G_GOFFSET_FORMAT, input_size);
+	end_probe_command (choice, process);
+}
+
+
+void
+compressor_choice_begin (CompressorChoice *choice)
+{
+	choice->start_time = g_get_monotonic_time ();
+}
+
+
+void
+compressor_choice_end (CompressorChoice *choice,
+		       goffset           output_size)
+{
+	char    *info_filename;
+	char    *info = NULL;
+	char   **lines;
+	char   **fields;
+	double   throughput;
+	double   ratio;
+	goffset  input_size;
+	double   seconds;
+
+	if (choice->start_time == 0)
+		return;
+
+	seconds = MAX (g_get_monotonic_time () - choice->start_time, 1) / (double) G_USEC_PER_SEC;
+	choice->start_time = 0;
+
+	/* the estimate written by the probe, missing if the probe failed
+	 * and the default level was used */
+
+	info_filename = g_strconcat (choice->script, ".info", NULL);
+	if (! g_file_get_contents (info_filename, &info, NULL, NULL)) {
+		debug (DEBUG_INFO, "adaptive compression: no estimate, default level used\n");
+		g_free (info_filename);
+		return;
+	}
+
+	lines = g_strsplit (info, "\n", 2);
+	fields = g_strsplit (lines[0], " ", 3);
+	if ((g_strv_length (fields) == 3) && (lines[1] != NULL)) {
+		throughput = g_ascii_strtod (fields[0], NULL);
+		ratio = g_ascii_strtod (fields[1], NULL);
+		input_size = g_ascii_strtoll (fields[2], NULL, 10);
+		g_strstrip (lines[1]);
+
+		if (input_size > 0)
+			g_message ("adaptive compression: %s, estimated %.1f MB/s, actual %.1f MB/s, estimated ratio %.3f, actual %.3f",
+				   lines[1],
+				   throughput / MEGABYTE,
+				   input_size / seconds / MEGABYTE,
+				   ratio,
+				   (double) output_size / input_size);
+		else
+			g_message ("adaptive compression: %s, estimated %.1f MB/s, compressed to %" G_GOFFSET_FORMAT " bytes in %.1f s",
+				   lines[1],
+				   throughput / MEGABYTE,
+				   output_size,
+				   seconds);
+	}
+
+	g_strfreev (fields);
+	g_strfreev (lines);
+	g_free (info);
+	g_free (info_filename);
+}
+
+
+void
+compressor_choice_free (CompressorChoice *choice)
+{
+	if (choice == NULL)
+		return;
+
+	if (choice->dir != NULL) {
+		GDir       *dir;
+		const char *name;
+
+		dir = g_dir_open (choice->dir, 0, NULL);
+		if (dir != NULL) {
+			while ((name = g_dir_read_name (dir)) != NULL) {
+				char *path = g_build_filename (choice->dir, name, NULL);
+
+				g_unlink (path);
+				g_free (path);
+			}
+			g_dir_close (dir);
+		}
+		g_rmdir (choice->dir);
+	}
+
+	g_ptr_array_free (choice->candidates, TRUE);
+	g_free (choice->command_line);
+	g_free (choice->script);
+	g_free (choice->dir);
+	g_free (choice);
+}
@@ -0,0 +1,99 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COMPRESS_UTILS_H
+#define COMPRESS_UTILS_H
+
+#include <glib.h>
+#include "typedefs.h"
+#include "fr-process.h"
+
+/* The compressors known for each single stream format (application/x-gzip,
+ * application/x-bzip, application/x-xz, ...), fastest first.  The
+ * returned command line reads the standard input and writes the
+ * standard output, it uses the fastest compressor installed with the
+ * level corresponding to compression and, if the compressor is
+ * multi-threaded, the thread budget.  input_size is the size of the
+ * data to compress, -1 if unknown, large inputs can use specific options
+ * (zstd long distance matching).  Returns NULL if no compressor is
+ * installed for the format. */
+char *       compressor_get_command_line      (const char    *mime_type,
+					       FrCompression  compression,
+					       goffset        input_size);
+gboolean     compressor_is_available          (const char    *mime_type);
+
+/* The same for the decompressors, the fastest installed one is chosen,
+ * with the thread budget if it decompresses in parallel. */
+char *       decompressor_get_command_line    (const char    *mime_type);
+gboolean     decompressor_is_available        (const char    *mime_type);
+/* TRUE if the decompressor exits with 2 after a warning */
+gboolean     decompressor_has_warning_status  (const char    *mime_type);
+
+/* The number of threads a compressor can use, 0 means one per
+ * processor, which is the default. */
+void         compressor_set_thread_budget     (guint          n_threads);
+guint        compressor_get_thread_budget     (void);
+
+/* Adaptive compression: when a target is set the compression level is
+ * chosen by compressing a sample of the input with every level of the
+ * compressor, the level with the best ratio whose estimated throughput
+ * meets the target is used, the fastest one if none does.  The target
+ * is the larger of mb_per_sec and the throughput needed to compress the
+ * input in deadline seconds, 0 disables the corresponding limit. */
+void         compressor_set_adaptive_target   (double         mb_per_sec,
+					       guint          deadline);
+gboolean     compressor_is_adaptive           (void);
+
+/* The choice of the level for one compression.  The command line runs
+ * the default level until a probe, queued before the compression
+ * command, compresses a sample of the input in a separate process and
+ * chooses the level.  Returns NULL if the compression is not adaptive
+ * or no compressor is installed. */
+typedef struct _CompressorChoice CompressorChoice;
+
+CompressorChoice *
+	     compressor_choice_new            (const char    *mime_type,
+					       FrCompression  compression,
+					       goffset        input_size);
+const char * compressor_choice_get_command_line
+					      (CompressorChoice *choice);
+/* The input is the files, relative to base_dir, directories are scanned
+ * recursively. */
+void         compressor_choice_add_probe_for_files
+					      (CompressorChoice *choice,
+					       FrProcess        *process,
+					       GList            *file_list,
+					       const char       *base_dir);
+/* The input is the output of a shell command, e.g. a decompressor,
+ * input_size is its size, -1 if unknown. */
+void         compressor_choice_add_probe_for_command
+					      (CompressorChoice *choice,
+					       FrProcess        *process,
+					       const char       *command,
+					       goffset           input_size);
+/* log the estimate and the actual throughput of the compression */
+void         compressor_choice_begin          (CompressorChoice *choice);
+void         compressor_choice_end            (CompressorChoice *choice,
+					       goffset           output_size);
+void         compressor_choice_free           (CompressorChoice *choice);
+
+#endif /* COMPRESS_UTILS_H */
@@ -0,0 +1,378 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include <glib.h>
+
+#include "copy-utils.h"
+#include "file-utils.h"
+#include "glib-utils.h"
+
+
+#define JOURNAL_SIGNATURE  "fr-journal 1"
+#define TAIL_BLOCK_SIZE    512
+
+
+G_LOCK_DEFINE_STATIC (copy_stats);
+static guint   avoided_copies = 0;
+static guint64 avoided_copy_bytes = 0;
+
+
+gboolean
+clone_file (const char *source,
+	    const char *destination)
+{
+#ifdef FICLONE
+	struct stat st;
+	int         src_fd;
+	int         dest_fd;
+	gboolean    result = FALSE;
+
+	src_fd = open (source, O_RDONLY);
+	if (src_fd < 0)
+		return FALSE;
+
+	if (fstat (src_fd, &st) != 0) {
+		close (src_fd);
+		return FALSE;
+	}
+
+	dest_fd = open (destination, O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 0777);
+	if (dest_fd >= 0) {
+		result = (ioctl (dest_fd, FICLONE, src_fd) == 0);
+		if (close (dest_fd) != 0)
+			result = FALSE;
+		if (! result)
+			unlink (destination);
+	}
+	close (src_fd);
+
+	if (result) {
+		debug (DEBUG_INFO, "cloned %s: %" G_GOFFSET_FORMAT " bytes not copied\n", source, (goffset) st.st_size);
+		count_avoided_copy (st.st_size);
+	}
+
+	return result;
+#else
+	return FALSE;
+#endif
+}
+
+
+void
+count_avoided_copy (goffset n_bytes)
+{
+	G_LOCK (copy_stats);
+	avoided_copies++;
+	avoided_copy_bytes += n_bytes;
+	G_UNLOCK (copy_stats);
+}
+
+
+void
+get_avoided_copy_stats (guint   *n_operations,
+			guint64 *n_bytes)
+{
+	G_LOCK (copy_stats);
+	if (n_operations != NULL)
+		*n_operations = avoided_copies;
+	if (n_bytes != NULL)
+		*n_bytes = avoided_copy_bytes;
+	G_UNLOCK (copy_stats);
+}
+
+
+/* -- journal -- */
+
+
+/* returns the hidden file next to the archive with the given suffix */
+static char *
+get_sidecar_filename (const char *archive_filename,
+		      const char *suffix)
+{
+	char *dir;
+	char *name;
+	char *sidecar;
+
+	dir = g_path_get_dirname (archive_filename);
+	name = g_strconcat (".", file_name_from_path (archive_filename), suffix, NULL);
+	sidecar = g_build_filename (dir, name, NULL);
+
+	g_free (name);
+	g_free (dir);
+
+	return sidecar;
+}
+
+
+static char *
+get_journal_filename (const char *archive_filename)
+{
+	return get_sidecar_filename (archive_filename, ".fr-journal");
+}
+
+
+/* Returns the offset where the run of zero blocks at the end of the file
+ * starts.  Appending tools (tar -r) overwrite the end-of-archive marker,
+ * which lies in this region, and nothing before it. */
+static goffset
+get_zero_tail_offset (int     fd,
+		      goffset size)
+{
+	goffset offset = size - (size % TAIL_BLOCK_SIZE);
+	char    block[TAIL_BLOCK_SIZE];
+	char    zero[TAIL_BLOCK_SIZE];
+
+	memset (zero, 0, sizeof (zero));
+
+	if (offset < size) {
+		/* a partial last block is left untouched */
+		return size;
+	}
+
+	while (offset >= TAIL_BLOCK_SIZE) {
+		if (pread (fd, block, TAIL_BLOCK_SIZE, offset - TAIL_BLOCK_SIZE) != TAIL_BLOCK_SIZE)
+			break;
+		if (memcmp (block, zero, TAIL_BLOCK_SIZE) != 0)
+			break;
+		offset -= TAIL_BLOCK_SIZE;
+	}
+
+	return offset;
+}
+
+
+static gboolean
+sync_parent_directory (const char *filename)
+{
+	char *dir;
+	int   fd;
+	int   result;
+
+	dir = g_path_get_dirname (filename);
+	fd = open (dir, O_RDONLY);
+	g_free (dir);
+	if (fd < 0)
+		return FALSE;
+
+	result = fsync (fd);
+	close (fd);
+
+	return (result == 0);
+}
+
+
+gboolean
+archive_journal_begin (const char *archive_filename)
+{
+	struct stat st;
+	char       *journal;
+	char       *content;
+	goffset     zero_tail;
+	int         fd;
+	gboolean    result;
+
+	fd = open (archive_filename, O_RDONLY);
+	if (fd < 0)
+		return FALSE;
+	if (fstat (fd, &st) != 0) {
+		close (fd);
+		return FALSE;
+	}
+	zero_tail = get_zero_tail_offset (fd, st.st_size);
+	close (fd);
+
+	journal = get_journal_filename (archive_filename);
+	content = g_strdup_printf ("%s\n%" G_GOFFSET_FORMAT "\n%" G_GOFFSET_FORMAT "\n",
+				   JOURNAL_SIGNATURE,
+				   (goffset) st.st_size,
+				   zero_tail);
+
+	/* g_file_set_contents writes a temp file and renames it, but does
+	 * not sync the directory entry. */
+
+	result = g_file_set_contents (journal, content, -1, NULL)
+		 && sync_parent_directory (journal);
+	if (! result)
+		unlink (journal);
+
+	g_free (content);
+	g_free (journal);
+
+	return result;
+}
+
+
+void
+archive_journal_commit (const char *archive_filename)
+{
+	char *journal;
+	int   fd;
+
+	/* make the new content durable before dropping the undo data */
+
+	fd = open (archive_filename, O_RDONLY);
+	if (fd >= 0) {
+		fsync (fd);
+		close (fd);
+	}
+
+	journal = get_journal_filename (archive_filename);
+	unlink (journal);
+	g_free (journal);
+}
+
+
+gboolean
+archive_journal_rollback (const char *archive_filename)
+{
+	char     *journal;
+	char     *content = NULL;
+	char    **lines = NULL;
+	gboolean  result = FALSE;
+
+	journal = get_journal_filename (archive_filename);
+	if (! g_file_get_contents (journal, &content, NULL, NULL)) {
+		g_free (journal);
+		return FALSE;
+	}
+
+	lines = g_strsplit (content, "\n", 4);
+	if ((lines[0] != NULL)
+	    && (strcmp (lines[0], JOURNAL_SIGNATURE) == 0)
+	    && (lines[1] != NULL)
+	    && (lines[2] != NULL))
+	{
+		goffset size;
+		goffset zero_tail;
+		int     fd;
+
+		size = g_ascii_strtoll (lines[1], NULL, 10);
+		zero_tail = g_ascii_strtoll (lines[2], NULL, 10);
+
+		/* cut what was appended and restore the zero blocks that
+		 * were overwritten. */
+
+		fd = open (archive_filename, O_WRONLY);
+		if ((fd >= 0) && (zero_tail <= size)) {
+			result = (ftruncate (fd, zero_tail) == 0)
+				 && (ftruncate (fd, size) == 0)
+				 && (fsync (fd) == 0);
+		}
+		if (fd >= 0)
+			close (fd);
+
+		if (result)
+			debug (DEBUG_INFO, "rolled back %s to %" G_GOFFSET_FORMAT " bytes\n", archive_filename, size);
+		else
+			g_warning ("could not roll back the interrupted modification of %s", archive_filename);
+	}
+
+	/* keep the journal if the archive could not be opened, the
+	 * rollback can still succeed later. */
+	if (result || (lines[0] == NULL) || (strcmp (lines[0], JOURNAL_SIGNATURE) != 0))
+		unlink (journal);
+
+	g_strfreev (lines);
+	g_free (content);
+	g_free (journal);
+
+	return result;
+}
+
+
+/* -- backup -- */
+
+
+gboolean
+archive_backup_begin (const char *archive_filename)
+{
+	char     *backup;
+	gboolean  result;
+
+	/* a clone shares the data blocks with the archive without sharing
+	 * the inode: a hard link would not do, zip updates an archive
+	 * with more than one link in place, and the backup would change
+	 * with it.  Without clones the caller works on a copy instead. */
+
+	backup = get_sidecar_filename (archive_filename, ".fr-backup");
+	unlink (backup);
+	result = clone_file (archive_filename, backup)
+		 && sync_parent_directory (backup);
+	if (! result)
+		unlink (backup);
+	g_free (backup);
+
+	return result;
+}
+
+
+void
+archive_backup_commit (const char *archive_filename)
+{
+	char *backup;
+	int   fd;
+
+	fd = open (archive_filename, O_RDONLY);
+	if (fd >= 0) {
+		fsync (fd);
+		close (fd);
+	}
+
+	backup = get_sidecar_filename (archive_filename, ".fr-backup");
+	unlink (backup);
+	g_free (backup);
+}
+
+
+gboolean
+archive_backup_rollback (const char *archive_filename)
+{
+	struct stat  st;
+	char        *backup;
+	gboolean     result = FALSE;
+
+	backup = get_sidecar_filename (archive_filename, ".fr-backup");
+	if (lstat (backup, &st) == 0) {
+		result = (rename (backup, archive_filename) == 0)
+			 && sync_parent_directory (archive_filename);
+		if (result)
+			debug (DEBUG_INFO, "restored %s from the backup\n", archive_filename);
+		else
+			g_warning ("could not restore %s from %s", archive_filename, backup);
+	}
+	g_free (backup);
+
+	return result;
+}
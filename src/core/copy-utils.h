@@ -0,0 +1,57 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COPY_UTILS_H
+#define COPY_UTILS_H
+
+#include <glib.h>
+
+/* Creates destination as a copy-on-write clone of source.  Returns FALSE
+ * without leaving anything behind when the file system cannot share the
+ * data blocks, the caller has to copy the file then. */
+gboolean     clone_file                       (const char  *source,
+					       const char  *destination);
+
+/* Counts the bytes that were not copied thanks to a clone or to an
+ * archive modified in place, for the whole process. */
+void         count_avoided_copy               (goffset      n_bytes);
+void         get_avoided_copy_stats           (guint       *n_operations,
+					       guint64     *n_bytes);
+
+/* Undo journal for archives modified in place by appending to them.
+ * The journal is written next to the archive before the modification
+ * and removed when the modification succeeded, if it is still there
+ * when the archive is loaded again the append is rolled back. */
+gboolean     archive_journal_begin            (const char  *archive_filename);
+void         archive_journal_commit           (const char  *archive_filename);
+gboolean     archive_journal_rollback         (const char  *archive_filename);
+
+/* Backup of archives modified in place by tools that write a new archive
+ * and rename it over the original one: the original content is kept as
+ * a clone next to the archive until the modification succeeded, if it
+ * is still there when the archive is loaded again it is restored.
+ * archive_backup_begin() fails if the file system cannot clone files. */
+gboolean     archive_backup_begin             (const char  *archive_filename);
+void         archive_backup_commit            (const char  *archive_filename);
+gboolean     archive_backup_rollback          (const char  *archive_filename);
+
+#endif /* COPY_UTILS_H */
@@ -904,40 +904,121 @@ ith_temp_folder_to_try (int n)
 }
 
 
-char *
-get_temp_work_dir (const char *parent_folder)
+/* -- temporary work folders -- */
+
+
+#define FREE_SPACE_CACHE_TIME (5 * G_USEC_PER_SEC)  /* the free space of a
+						     * file system is read
+						     * again after this time */
+
+
+typedef struct {
+	guint64 free_space;
+	gint64  time;
+} FreeSpace;
+
+
+G_LOCK_DEFINE_STATIC (temp_space);
+static GHashTable *free_space_cache = NULL;  /* device -> FreeSpace */
+static guint       cross_device_operations = 0;
+static guint64     cross_device_bytes = 0;
+
+
+/* gets the device of path, or of its closest existing parent folder if
+ * path does not exist yet. */
+static gboolean
+get_path_device (const char *path,
+		 dev_t      *device)
 {
-	guint64  max_size = 0;
-	char    *best_folder = NULL;
-	int      i;
-	char    *template;
-	char    *result = NULL;
-
-	if (parent_folder == NULL) {
-		/* find the folder with more free space. */
-
-		for (i = 0; try_folder[i] != NULL; i++) {
-			char    *folder;
-			guint64  size;
-
-			folder = ith_temp_folder_to_try (i);
-			size = get_dest_free_space (folder);
-			if (max_size < size) {
-				max_size = size;
-				g_free (best_folder);
-				best_folder = folder;
-			}
-			else
-				g_free (folder);
+	char        *folder;
+	struct stat  st;
+	gboolean     result = FALSE;
+
+	folder = g_strdup (path);
+	for (;;) {
+		char *parent;
+
+		if (stat (folder, &st) == 0) {
+			*device = st.st_dev;
+			result = TRUE;
+			break;
 		}
+
+		parent = g_path_get_dirname (folder);
+		if (strcmp (parent, folder) == 0) {
+			g_free (parent);
+			break;
+		}
+		g_free (folder);
+		folder = parent;
 	}
-	else
-		best_folder = g_strdup (parent_folder);
+	g_free (folder);
 
-	if (best_folder == NULL)
-		return NULL;
+	return result;
+}
+
+
+/* returns the free space of the file system mounted on device, reading
+ * it once for all the folders on the same file system. */
+static guint64
+get_device_free_space (const char *path,
+		       dev_t       device)
+{
+	FreeSpace *cached;
+	gint64     key = device;
+	gint64     now;
+	guint64    free_space;
+
+	now = g_get_monotonic_time ();
+
+	G_LOCK (temp_space);
+	if (free_space_cache == NULL)
+		free_space_cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+	cached = g_hash_table_lookup (free_space_cache, &key);
+	if ((cached == NULL) || (now - cached->time > FREE_SPACE_CACHE_TIME)) {
+		if (cached == NULL) {
+			gint64 *new_key;
+
+			new_key = g_new (gint64, 1);
+			*new_key = key;
+			cached = g_new0 (FreeSpace, 1);
+			g_hash_table_insert (free_space_cache, new_key, cached);
+		}
+		cached->free_space = get_dest_free_space (path);
+		cached->time = now;
+	}
+	free_space = cached->free_space;
+	G_UNLOCK (temp_space);
+
+	return free_space;
+}
+
+
+/* the space used by a new work folder is not free anymore, even before
+ * the file system is read again. */
+static void
+reserve_device_space (dev_t   device,
+		      guint64 size)
+{
+	FreeSpace *cached = NULL;
+	gint64     key = device;
+
+	G_LOCK (temp_space);
+	if (free_space_cache != NULL)
+		cached = g_hash_table_lookup (free_space_cache, &key);
+	if (cached != NULL)
+		cached->free_space = (cached->free_space > size) ? cached->free_space - size : 0;
+	G_UNLOCK (temp_space);
+}
+
+
+static char *
+create_temp_work_dir (const char *folder)
+{
+	char *template;
+	char *result;
 
-	template = g_strconcat (best_folder, "/.fr-XXXXXX", NULL);
+	template = g_strconcat (folder, "/.fr-XXXXXX", NULL);
 	result = mkdtemp (template);
 
 	if ((result == NULL) || (*result == '\0')) {
@@ -949,6 +1030,136 @@ get_temp_work_dir (const char *parent_folder)
 }
 
 
+/* Creates a work folder for the files that will be moved to destination,
+ * or for files not moved anywhere if destination is NULL.  needed_size is
+ * the estimated size of the files, 0 if not known.
+ *
+ * The folders to try on the file system of destination are preferred, so
+ * that the files are renamed instead of copied, then destination itself,
+ * then the folder with more free space.  A work folder on another file
+ * system is counted, see get_cross_device_stats(), or not created at all
+ * if same_device_only is TRUE. */
+static char *
+create_temp_work_dir_for (const char *destination,
+			  guint64     needed_size,
+			  gboolean    same_device_only)
+{
+	dev_t     dest_device = 0;
+	gboolean  dest_device_known = FALSE;
+	char     *best_folder = NULL;
+	dev_t     best_device = 0;
+	guint64   max_size = 0;
+	gboolean  same_device = FALSE;
+	char     *result;
+	int       i;
+
+	if (destination != NULL)
+		dest_device_known = get_path_device (destination, &dest_device);
+
+	for (i = 0; ! same_device && (try_folder[i] != NULL); i++) {
+		char    *folder;
+		dev_t    device;
+		guint64  size;
+
+		folder = ith_temp_folder_to_try (i);
+		if (! get_path_device (folder, &device)) {
+			g_free (folder);
+			continue;
+		}
+
+		size = get_device_free_space (folder, device);
+		if (dest_device_known && (device == dest_device) && (size >= needed_size)) {
+			g_free (best_folder);
+			best_folder = folder;
+			best_device = device;
+			same_device = TRUE;
+		}
+		else if (max_size < size) {
+			max_size = size;
+			g_free (best_folder);
+			best_folder = folder;
+			best_device = device;
+		}
+		else
+			g_free (folder);
+	}
+
+	if (! same_device
+	    && dest_device_known
+	    && g_file_test (destination, G_FILE_TEST_IS_DIR)
+	    && (access (destination, W_OK) == 0)
+	    && (get_device_free_space (destination, dest_device) >= needed_size))
+	{
+		g_free (best_folder);
+		best_folder = g_strdup (destination);
+		best_device = dest_device;
+		same_device = TRUE;
+	}
+
+	if ((best_folder == NULL) || (same_device_only && ! same_device)) {
+		g_free (best_folder);
+		return NULL;
+	}
+
+	result = create_temp_work_dir (best_folder);
+	if (result != NULL) {
+		reserve_device_space (best_device, needed_size);
+
+		if ((destination != NULL) && ! same_device) {
+			G_LOCK (temp_space);
+			cross_device_operations++;
+			cross_device_bytes += needed_size;
+			G_UNLOCK (temp_space);
+
+			debug (DEBUG_INFO, "%s is not on the file system of %s, %" G_GUINT64_FORMAT " bytes will be copied\n", result, destination, needed_size);
+		}
+	}
+
+	g_free (best_folder);
+
+	return result;
+}
+
+
+char *
+get_temp_work_dir_for (const char *destination,
+		       guint64     needed_size)
+{
+	return create_temp_work_dir_for (destination, needed_size, FALSE);
+}
+
+
+char *
+get_temp_work_dir_on_device_of (const char *destination,
+				guint64     needed_size)
+{
+	return create_temp_work_dir_for (destination, needed_size, TRUE);
+}
+
+
+char *
+get_temp_work_dir (const char *parent_folder)
+{
+	if (parent_folder == NULL)
+		return get_temp_work_dir_for (NULL, 0);
+	else
+		return create_temp_work_dir (parent_folder);
+}
+
+
+void
+get_cross_device_stats (guint   *n_operations,
+			guint64 *n_bytes)
+{
+	G_LOCK (temp_space);
+	if (n_operations != NULL)
+		*n_operations = cross_device_operations;
+	if (n_bytes != NULL)
+		*n_bytes = cross_device_bytes;
+	G_UNLOCK (temp_space);
+}
+
+
 gboolean
 is_temp_work_dir (const char *dir)
 {
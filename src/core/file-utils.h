@@ -81,6 +81,12 @@ guint64             get_dest_free_space          (const char  *path);
 gboolean            remove_directory             (const char  *uri);
 gboolean            remove_local_directory       (const char  *directory);
 char *              get_temp_work_dir            (const char  *parent_folder);
+char *              get_temp_work_dir_for        (const char  *destination,
+						  guint64      needed_size);
+char *              get_temp_work_dir_on_device_of (const char *destination,
+						  guint64      needed_size);
+void                get_cross_device_stats       (guint       *n_operations,
+						  guint64     *n_bytes);
 gboolean            is_temp_work_dir             (const char *dir);
 gboolean            is_temp_dir                  (const char *dir);
 
@@ -26,11 +26,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include "tr-wrapper.h"
 #include <gio/gio.h>
 #include "glib-utils.h"
+#include "copy-utils.h"
 #include "file-utils.h"
 #include "gio-utils.h"
 #include "file-data.h"
@@ -41,6 +43,10 @@
 #include "fr-proc-error.h"
 #include "fr-process.h"
 #include "fr-init.h"
+#include "path-set.h"
+#include "stat-utils.h"
+#include "sync-index.h"
+#include "zip-index.h"
 
 #if ENABLE_MAGIC
 #include <magic.h>
@@ -64,9 +70,14 @@ typedef struct {
 	gboolean       encrypt_header;
 	FrCompression  compression;
 	guint          volume_size;
+	GList         *groups;         /* AddGroup list, items by folder */
+	GList         *current_group;
 } DroppedItemsData;
 
 
+static void add_groups_list_free (GList *groups);
+
+
 static DroppedItemsData *
 dropped_items_data_new (FrArchive     *archive,
 			GList         *item_list,
@@ -104,6 +115,7 @@ dropped_items_data_free (DroppedItemsData *data)
 	if (data == NULL)
 		return;
 	path_list_free (data->item_list);
+	add_groups_list_free (data->groups);
 	g_free (data->base_dir);
 	g_free (data->dest_dir);
 	g_free (data->password);
@@ -125,6 +137,23 @@ struct _FrArchivePrivData {
 	char                *extraction_destination;
 	gboolean             remote_extraction;
 	gboolean             extract_here;
+
+	gboolean             modify_in_place;               /* Whether archives whose tools
+								     * update them safely are modified
+								     * without working on a copy. */
+	char                *journal_filename;              /* Archive appended to in place,
+								     * see archive_journal_begin(). */
+	char                *backup_filename;               /* Archive rewritten in place,
+								     * see archive_backup_begin(). */
+	gboolean             remote_listing;                /* The remote archive was listed
+								     * without downloading it, see
+								     * read_remote_zip_index(). */
+	GHashTable          *sync_index;                    /* Saved when the synchronization
+								     * started by fr_archive_sync_directory()
+								     * completes. */
+	char                *sync_index_filename;
+	guint                extract_jobs;                  /* Extractor processes used at the same
+								     * time, see extract_in_parallel(). */
 };
 
 
@@ -168,6 +197,10 @@ xfer_data_free (XferData *data)
 #define NO_DOT_FILES (FALSE)
 #define IGNORE_CASE (FALSE)
 #define LIST_LENGTH_TO_USE_FILE 10 /* FIXME: find a good value */
+#define ZIP_RANGE_COMMAND PRIVEXECDIR "zip-range"
+#define MOVE_FILES_COMMAND PRIVEXECDIR "move-files"
+#define LINK_FILES_COMMAND PRIVEXECDIR "link-files"
+#define MIN_EXTRACT_SHARD_SIZE (16 * 1024 * 1024) /* Data that is worth another extractor process */
 
 
 enum {
@@ -435,6 +468,7 @@ fr_archive_set_uri (FrArchive  *archive,
 		archive->local_copy = NULL;
 	}
 	archive->content_type = NULL;
+	archive->priv->remote_listing = FALSE;
 
 	if (uri == NULL)
 		return;
@@ -480,6 +514,11 @@ fr_archive_finalize (GObject *object)
 	}
 	g_free (archive->priv->temp_extraction_dir);
 	g_free (archive->priv->extraction_destination);
+	g_free (archive->priv->journal_filename);
+	g_free (archive->priv->backup_filename);
+	if (archive->priv->sync_index != NULL)
+		g_hash_table_unref (archive->priv->sync_index);
+	g_free (archive->priv->sync_index_filename);
 	g_free (archive->priv);
 
 	/* Chain up */
@@ -563,6 +602,7 @@ get_mime_type_from_magic_numbers (GFile *file)
 		{ 0,  4, "PK\003\004",                           "application/zip"             },
 		{ 0,  8, "PK00PK\003\004",                       "application/zip"             },
 		{ 0,  4, "LRZI",                                 "application/x-lrzip"         },
+		{ 0,  4, "\x28\xb5\x2f\xfd",                     "application/zstd"            },
 	};
 
 	char buffer[32];
@@ -916,6 +956,42 @@ fr_archive_change_name (FrArchive  *archive,
 }
 
 
+static void
+discard_sync_index (FrArchive *archive)
+{
+	if (archive->priv->sync_index != NULL) {
+		g_hash_table_unref (archive->priv->sync_index);
+		archive->priv->sync_index = NULL;
+	}
+	g_free (archive->priv->sync_index_filename);
+	archive->priv->sync_index_filename = NULL;
+}
+
+
+static void
+save_sync_index (FrArchive *archive)
+{
+	GError *error = NULL;
+	char   *archive_filename;
+
+	/* the index is bound to the archive as it is now */
+
+	archive_filename = g_file_get_path (archive->file);
+	if ((archive->priv->sync_index != NULL)
+	    && (archive_filename != NULL)
+	    && ! sync_index_save (archive->priv->sync_index,
+				  archive->priv->sync_index_filename,
+				  archive_filename,
+				  &error))
+	{
+		g_warning ("could not save the sync index: %s", error->message);
+		g_clear_error (&error);
+	}
+	g_free (archive_filename);
+	discard_sync_index (archive);
+}
+
+
 static void
 action_performed (FrCommand   *command,
 		  FrAction     action,
@@ -926,6 +1002,33 @@ action_performed (FrCommand   *command,
 	debug (DEBUG_INFO, "%s [DONE] (FR::Archive)\n", action_names[action]);
 #endif
 
+	if (archive->priv->journal_filename != NULL) {
+		if (error->type == FR_PROC_ERROR_NONE)
+			archive_journal_commit (archive->priv->journal_filename);
+		else
+			archive_journal_rollback (archive->priv->journal_filename);
+		g_free (archive->priv->journal_filename);
+		archive->priv->journal_filename = NULL;
+	}
+
+	if (archive->priv->backup_filename != NULL) {
+		if (error->type == FR_PROC_ERROR_NONE)
+			archive_backup_commit (archive->priv->backup_filename);
+		else
+			archive_backup_rollback (archive->priv->backup_filename);
+		g_free (archive->priv->backup_filename);
+		archive->priv->backup_filename = NULL;
+	}
+
+	if ((archive->priv->sync_index != NULL)
+	    && ((action == FR_ACTION_ADDING_FILES) || (action == FR_ACTION_DELETING_FILES)))
+	{
+		if (error->type == FR_PROC_ERROR_NONE)
+			save_sync_index (archive);
+		else
+			discard_sync_index (archive);
+	}
+
 	switch (action) {
 	case FR_ACTION_DELETING_FILES:
 		if (error->type == FR_PROC_ERROR_NONE) {
@@ -1144,6 +1247,19 @@ load_local_archive (FrArchive  *archive,
 	archive->have_permissions = check_file_permissions (archive->file, W_OK);
 	archive->read_only = ! archive->have_permissions;
 
+	/* undo an in place modification that was interrupted */
+
+	if (archive->have_permissions) {
+		char *filename;
+
+		filename = g_file_get_path (archive->local_copy);
+		if (filename != NULL) {
+			archive_journal_rollback (filename);
+			archive_backup_rollback (filename);
+		}
+		g_free (filename);
+	}
+
 	old_command = archive->command;
 
 	mime_type = get_mime_type_from_filename (archive->local_copy);
@@ -1234,6 +1350,210 @@ copy_remote_file_done_cb (gpointer user_data)
 }
 
 
+static void
+download_remote_file (XferData *xfer_data)
+{
+	g_copy_file_async (xfer_data->archive->file,
+			   xfer_data->archive->local_copy,
+			   G_FILE_COPY_OVERWRITE,
+			   G_PRIORITY_DEFAULT,
+			   xfer_data->archive->priv->cancellable,
+			   copy_remote_file_progress,
+			   xfer_data,
+			   copy_remote_file_done,
+			   xfer_data);
+}
+
+
+/* -- read_remote_zip_index -- */
+
+
+static gboolean
+is_zip_mime_type (const char *mime_type)
+{
+	return (mime_type != NULL)
+		&& (is_mime_type (mime_type, "application/zip")
+		    || is_mime_type (mime_type, "application/x-cbz")
+		    || is_mime_type (mime_type, "application/x-ear")
+		    || is_mime_type (mime_type, "application/x-war"));
+}
+
+
+static FileData *
+file_data_from_zip_entry (ZipEntry *entry)
+{
+	FileData *fdata;
+
+	fdata = file_data_new ();
+	fdata->size = entry->size;
+	fdata->modified = entry->modified;
+	fdata->encrypted = (entry->flags & 1) != 0;
+
+	if (*entry->name == '/') {
+		fdata->full_path = g_strdup (entry->name);
+		fdata->original_path = fdata->full_path;
+	}
+	else {
+		fdata->full_path = g_strconcat ("/", entry->name, NULL);
+		fdata->original_path = fdata->full_path + 1;
+	}
+
+	fdata->dir = entry->dir;
+	if (fdata->dir)
+		fdata->name = dir_name_from_path (fdata->full_path);
+	else
+		fdata->name = g_strdup (file_name_from_path (fdata->full_path));
+	fdata->path = remove_level_from_path (fdata->full_path);
+
+	return fdata;
+}
+
+
+static gboolean
+load_remote_archive (FrArchive  *archive,
+		     GPtrArray  *entries,
+		     const char *password)
+{
+	FrCommand  *old_command;
+	const char *mime_type;
+	GPtrArray  *file_list;
+	guint       i;
+
+	old_command = archive->command;
+
+	mime_type = get_mime_type_from_filename (archive->local_copy);
+	if (! create_command_to_load_archive (archive, mime_type)) {
+		archive->command = old_command;
+		return FALSE;
+	}
+
+	if (old_command != NULL) {
+		g_signal_handlers_disconnect_by_data (old_command, archive);
+		g_object_unref (old_command);
+	}
+
+	archive->have_permissions = check_file_permissions (archive->file, W_OK);
+	archive->read_only = ! archive->have_permissions;
+	archive->priv->remote_listing = TRUE;
+
+	fr_archive_connect_to_command (archive);
+	archive->content_type = mime_type;
+	if (! fr_command_is_capable_of (archive->command, FR_COMMAND_CAN_WRITE))
+		archive->read_only = TRUE;
+
+	fr_archive_action_completed (archive,
+				     FR_ACTION_LOADING_ARCHIVE,
+				     FR_PROC_ERROR_NONE,
+				     NULL);
+
+	/**/
+
+	fr_process_clear (archive->process);
+	g_object_set (archive->command,
+		      "file", archive->local_copy,
+		      "password", password,
+		      NULL);
+
+	file_list = g_ptr_array_sized_new (entries->len);
+	for (i = 0; i < entries->len; i++) {
+		FileData *fdata = file_data_from_zip_entry (g_ptr_array_index (entries, i));
+
+		if (*fdata->name == 0)
+			file_data_free (fdata);
+		else
+			g_ptr_array_add (file_list, fdata);
+	}
+	fr_command_list_from_data (archive->command, file_list);
+	g_ptr_array_free (file_list, TRUE);
+
+	return TRUE;
+}
+
+
+static void
+read_remote_zip_index_thread (GTask        *task,
+			      gpointer      source_object,
+			      gpointer      task_data,
+			      GCancellable *cancellable)
+{
+	GFile            *file = task_data;
+	GFileInputStream *stream;
+	GPtrArray        *entries = NULL;
+	GError           *error = NULL;
+	guint             i;
+
+	stream = g_file_read (file, cancellable, &error);
+	if (stream != NULL) {
+		entries = zip_index_read (G_INPUT_STREAM (stream), cancellable, &error);
+		g_object_unref (stream);
+	}
+
+	/* the entries are extracted with zip-range, which cannot extract
+	 * every entry, download the archive in this case. */
+
+	for (i = 0; (entries != NULL) && (i < entries->len); i++)
+		if (! zip_entry_can_extract (g_ptr_array_index (entries, i))) {
+			g_ptr_array_free (entries, TRUE);
+			entries = NULL;
+			g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unsupported zip entry");
+		}
+
+	if (entries != NULL)
+		g_task_return_pointer (task, entries, (GDestroyNotify) g_ptr_array_unref);
+	else
+		g_task_return_error (task, error);
+}
+
+
+static void
+read_remote_zip_index_ready_cb (GObject      *source_object,
+				GAsyncResult *result,
+				gpointer      user_data)
+{
+	XferData  *xfer_data = user_data;
+	GPtrArray *entries;
+	GError    *error = NULL;
+
+	entries = g_task_propagate_pointer (G_TASK (result), &error);
+	if (entries == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			copy_remote_file_done (error, xfer_data);
+			g_error_free (error);
+			return;
+		}
+
+		debug (DEBUG_INFO, "cannot read the zip index: %s\n", error->message);
+		g_error_free (error);
+		download_remote_file (xfer_data);
+		return;
+	}
+
+	if (load_remote_archive (xfer_data->archive, entries, xfer_data->password))
+		xfer_data_free (xfer_data);
+	else
+		download_remote_file (xfer_data);
+	g_ptr_array_unref (entries);
+}
+
+
+/* Reads only the central directory of a remote zip archive, instead of
+ * downloading the whole archive to list it.  The archive is downloaded
+ * when it is modified, see download_remote_listed_archive(). */
+static void
+read_remote_zip_index (XferData *xfer_data)
+{
+	GTask *task;
+
+	task = g_task_new (xfer_data->archive,
+			   xfer_data->archive->priv->cancellable,
+			   read_remote_zip_index_ready_cb,
+			   xfer_data);
+	g_task_set_task_data (task, g_object_ref (xfer_data->archive->file), g_object_unref);
+	g_task_run_in_thread (task, read_remote_zip_index_thread);
+	g_object_unref (task);
+}
+
+
 static void
 copy_remote_file (FrArchive  *archive,
 		  const char *password)
@@ -1261,15 +1581,12 @@ copy_remote_file (FrArchive  *archive,
 		return;
 	}
 
-	g_copy_file_async (archive->file,
-			   archive->local_copy,
-			   G_FILE_COPY_OVERWRITE,
-			   G_PRIORITY_DEFAULT,
-			   archive->priv->cancellable,
-			   copy_remote_file_progress,
-			   xfer_data,
-			   copy_remote_file_done,
-			   xfer_data);
+	if (is_zip_mime_type (get_mime_type_from_filename (archive->local_copy))) {
+		read_remote_zip_index (xfer_data);
+		return;
+	}
+
+	download_remote_file (xfer_data);
 }
 
 
@@ -1396,41 +1713,65 @@ find_file_in_archive (FrArchive *archive,
 static void delete_from_archive (FrArchive *archive, GList *file_list);
 
 
+static int
+compare_file_stat_by_path (const void *a,
+			   const void *b)
+{
+	return strcmp (((const FileStat *) a)->path, ((const FileStat *) b)->path);
+}
+
+
 static GList *
 newer_files_only (FrArchive  *archive,
 		  GList      *file_list,
 		  const char *base_dir)
 {
-	GList *newer_files = NULL;
-	GList *scan;
+	GPtrArray *archive_files = archive->command->files;
+	GList     *newer_files = NULL;
+	FileStat  *files;
+	guint      n_files;
+	guint      i, j;
+	GList     *scan;
 
-	for (scan = file_list; scan; scan = scan->next) {
-		char     *filename = scan->data;
-		char     *fullpath;
-		char     *uri;
-		FileData *fdata;
+	n_files = g_list_length (file_list);
+	files = g_new0 (FileStat, n_files);
+	for (i = 0, scan = file_list; scan; scan = scan->next, i++)
+		files[i].path = scan->data;
 
-		fdata = find_file_in_archive (archive, filename);
+	/* sort the files as the archive index, so that files in the same
+	 * folder are read together and the two lists can be merged. */
 
-		if (fdata == NULL) {
-			newer_files = g_list_prepend (newer_files, g_strdup (scan->data));
-			continue;
+	qsort (files, n_files, sizeof (FileStat), compare_file_stat_by_path);
+	stat_files (base_dir, files, n_files);
+
+	j = 0;
+	for (i = 0; i < n_files; i++) {
+		FileData *fdata = NULL;
+
+		while ((j < archive_files->len)
+		       && (strcmp (((FileData *) g_ptr_array_index (archive_files, j))->original_path, files[i].path) < 0))
+		{
+			j++;
 		}
 
-		fullpath = g_strconcat (base_dir, "/", filename, NULL);
-		uri = g_filename_to_uri (fullpath, NULL, NULL);
+		if ((j < archive_files->len)
+		    && (strcmp (((FileData *) g_ptr_array_index (archive_files, j))->original_path, files[i].path) == 0))
+		{
+			fdata = g_ptr_array_index (archive_files, j);
+		}
+		else {
+			/* a folder can be stored with a trailing slash */
+			fdata = find_file_in_archive (archive, (char *) files[i].path);
+		}
 
-		if (fdata->modified >= get_file_mtime (uri)) {
-			g_free (fullpath);
-			g_free (uri);
+		if ((fdata != NULL) && (fdata->modified >= files[i].mtime))
 			continue;
-		}
-		g_free (fullpath);
-		g_free (uri);
 
-		newer_files = g_list_prepend (newer_files, g_strdup (scan->data));
+		newer_files = g_list_prepend (newer_files, g_strdup (files[i].path));
 	}
 
+	g_free (files);
+
 	return newer_files;
 }
 
@@ -1525,194 +1866,427 @@ split_in_chunks (GList *file_list)
 }
 
 
-void
-fr_archive_add (FrArchive     *archive,
-		GList         *file_list,
-		const char    *base_dir,
-		const char    *dest_dir,
-		gboolean       update,
-		gboolean       recursive,
-		const char    *password,
-		gboolean       encrypt_header,
-		FrCompression  compression,
-		guint          volume_size)
+/* -- working copy -- */
+
+
+static void
+download_remote_listed_archive_end_func (gpointer data)
 {
-	GList    *new_file_list = NULL;
-	gboolean  base_dir_created = FALSE;
-	GList    *scan;
-	char     *tmp_base_dir = NULL;
-	char     *tmp_archive_dir = NULL;
-	char     *archive_filename = NULL;
-	char     *tmp_archive_filename = NULL;
-	gboolean  error_occurred = FALSE;
+	FrArchive *archive = data;
 
-	if (file_list == NULL)
-		return;
+	if (archive->process->error.type == FR_PROC_ERROR_NONE)
+		archive->priv->remote_listing = FALSE;
+}
 
-	if (archive->read_only)
+
+/* Adds the command that downloads an archive listed with
+ * read_remote_zip_index(), the commands that modify the archive work on
+ * the local copy. */
+static void
+download_remote_listed_archive (FrArchive *archive)
+{
+	char *uri;
+	char *local_filename;
+
+	if (! archive->priv->remote_listing)
 		return;
 
-	g_object_set (archive->command,
-		      "password", password,
-		      "encrypt_header", encrypt_header,
-		      "compression", compression,
-		      "volume_size", volume_size,
-		      NULL);
+	uri = g_file_get_uri (archive->file);
+	local_filename = g_file_get_path (archive->local_copy);
 
-	fr_archive_stoppable (archive, TRUE);
+	fr_process_begin_command (archive->process, ZIP_RANGE_COMMAND);
+	fr_process_set_end_func (archive->process, download_remote_listed_archive_end_func, archive);
+	fr_process_add_arg_concat (archive->process, "--copy=", local_filename, NULL);
+	fr_process_add_arg (archive->process, "--");
+	fr_process_add_arg (archive->process, uri);
+	fr_process_end_command (archive->process);
 
-	/* dest_dir is the destination folder inside the archive */
-g_print("src_dir: %s, dst: %s\n", base_dir, dest_dir);
-	if ((dest_dir != NULL) && (*dest_dir != '\0') && (strcmp (dest_dir, "/") != 0)) {
-		const char *rel_dest_dir = dest_dir;
+	g_free (local_filename);
+	g_free (uri);
+}
 
-		tmp_base_dir = create_tmp_base_dir (base_dir, dest_dir);
-		base_dir_created = TRUE;
 
-		if (dest_dir[0] == G_DIR_SEPARATOR)
-			rel_dest_dir = dest_dir + 1;
+void
+fr_archive_set_modify_in_place (FrArchive *archive,
+				gboolean   value)
+{
+	archive->priv->modify_in_place = value;
+}
 
-		new_file_list = NULL;
-		for (scan = file_list; scan != NULL; scan = scan->next) {
-			char *filename = scan->data;
-			new_file_list = g_list_prepend (new_file_list, g_build_filename (rel_dest_dir, filename, NULL));
-            g_print(" dst_fn: %s\n", (char*)new_file_list->data);
-        }
-	}
-	else {
-		tmp_base_dir = g_strdup (base_dir);
-		new_file_list = path_list_dup(file_list);
-	}
 
-	/* if the command cannot update,  get the list of files that are
-	 * newer than the ones in the archive. */
+void
+fr_archive_set_extract_jobs (FrArchive *archive,
+			     guint      n_jobs)
+{
+	archive->priv->extract_jobs = n_jobs;
+}
 
-	if (update && ! archive->command->propAddCanUpdate) {
-		GList *tmp_file_list;
 
-		tmp_file_list = new_file_list;
-		new_file_list = newer_files_only (archive, tmp_file_list, tmp_base_dir);
-		path_list_free (tmp_file_list);
-	}
+static gboolean
+can_modify_in_place (FrArchive *archive,
+		     gboolean   rewriting)
+{
+	FrCommand *command = archive->command;
 
-	if (new_file_list == NULL) {
-		debug (DEBUG_INFO, "nothing to update.\n");
+	if (! archive->priv->modify_in_place)
+		return FALSE;
+	if (command->creating_archive || command->multi_volume || (command->volume_size > 0))
+		return FALSE;
 
-		if (base_dir_created)
-			remove_local_directory (tmp_base_dir);
-		g_free (tmp_base_dir);
+	/* zip and 7z write the updated archive to a temporary file and
+	 * rename it over the original one when done. */
 
-		archive->process->error.type = FR_PROC_ERROR_NONE;
-		g_signal_emit_by_name (G_OBJECT (archive->process),
-				       "done",
-				       &archive->process->error);
-		return;
-	}
+	if (is_mime_type (command->mime_type, "application/zip")
+	    || is_mime_type (command->mime_type, "application/x-7z-compressed"))
+		return TRUE;
+
+	/* tar appends in place, which the journal can undo, but rewrites
+	 * the whole archive in place when deleting, which it cannot. */
+
+	if (is_mime_type (command->mime_type, "application/x-tar"))
+		return ! rewriting;
 
-	archive->command->creating_archive = ! g_file_query_exists (archive->local_copy, archive->priv->cancellable);
+	return FALSE;
+}
+
+
+/* Points the command to a new file in a temporary sub-directory of the
+ * archive folder, and returns the sub-directory. */
+static char *
+prepare_output_file (FrArchive  *archive,
+		     char      **archive_filename,
+		     char      **tmp_archive_filename)
+{
+	GFile *local_copy_parent;
+	char  *archive_dir;
+	char  *tmp_archive_dir;
+	GFile *tmp_file;
 
 	/* create the new archive in a temporary sub-directory, this allows
 	 * to cancel the operation without losing the original archive and
 	 * removing possible temporary files created by the command. */
 
-	{
-		GFile *local_copy_parent;
-		char  *archive_dir;
-		GFile *tmp_file;
+	/* create the new archive in a sub-folder of the original
+	 * archive this way the 'mv' command is fast. */
 
-		/* create the new archive in a sub-folder of the original
-		 * archive this way the 'mv' command is fast. */
+	local_copy_parent = g_file_get_parent (archive->local_copy);
+	archive_dir = g_file_get_path (local_copy_parent);
+	tmp_archive_dir = get_temp_work_dir (archive_dir);
+	*tmp_archive_filename = g_build_filename (tmp_archive_dir, file_name_from_path (*archive_filename), NULL);
+	tmp_file = g_file_new_for_path (*tmp_archive_filename);
+	g_object_set (archive->command, "file", tmp_file, NULL);
 
-		local_copy_parent = g_file_get_parent (archive->local_copy);
-		archive_dir = g_file_get_path (local_copy_parent);
-		tmp_archive_dir = get_temp_work_dir (archive_dir);
-		archive_filename = g_file_get_path (archive->local_copy);
-		tmp_archive_filename = g_build_filename (tmp_archive_dir, file_name_from_path (archive_filename), NULL);
-		tmp_file = g_file_new_for_path (tmp_archive_filename);
-		g_object_set (archive->command, "file", tmp_file, NULL);
+	g_object_unref (tmp_file);
+	g_free (archive_dir);
+	g_object_unref (local_copy_parent);
 
-		if (! archive->command->creating_archive) {
-			/* copy the original archive to the new position */
+	return tmp_archive_dir;
+}
 
-			fr_process_begin_command (archive->process, "cp");
-			fr_process_add_arg (archive->process, "-f");
-			fr_process_add_arg (archive->process, archive_filename);
-			fr_process_add_arg (archive->process, tmp_archive_filename);
-			fr_process_end_command (archive->process);
+
+/* Points the command to the file it has to modify and returns the
+ * temporary directory that contains it, or NULL if the original archive
+ * is modified in place. */
+static char *
+prepare_working_copy (FrArchive  *archive,
+		      gboolean    rewriting,
+		      char      **archive_filename,
+		      char      **tmp_archive_filename)
+{
+	char *tmp_archive_dir;
+
+	*archive_filename = g_file_get_path (archive->local_copy);
+
+	if (can_modify_in_place (archive, rewriting)) {
+		gboolean journaled = is_mime_type (archive->command->mime_type, "application/x-tar");
+
+		/* a failed update must not lose the original entries: tar
+		 * appends are undone with the journal, zip and 7z delete and
+		 * add in two steps and get the original archive back from
+		 * the backup. */
+
+		if (journaled ? archive_journal_begin (*archive_filename) : archive_backup_begin (*archive_filename)) {
+			/* the clone of the backup already counted as an
+			 * avoided copy. */
+
+			if (journaled) {
+				goffset size = get_file_size_for_path (*archive_filename);
+
+				archive->priv->journal_filename = g_strdup (*archive_filename);
+				debug (DEBUG_INFO, "appending to %s in place: %" G_GOFFSET_FORMAT " bytes not copied\n", *archive_filename, size);
+				count_avoided_copy (size);
+			}
+			else
+				archive->priv->backup_filename = g_strdup (*archive_filename);
+
+			*tmp_archive_filename = g_strdup (*archive_filename);
+			g_object_set (archive->command, "file", archive->local_copy, NULL);
+
+			return NULL;
 		}
+	}
+
+	tmp_archive_dir = prepare_output_file (archive, archive_filename, tmp_archive_filename);
 
-		g_object_unref (tmp_file);
-		g_free (archive_dir);
-		g_object_unref (local_copy_parent);
+	/* copy the original archive to the new position, a clone shares
+	 * the data blocks with the original and costs nothing. */
+
+	if (! archive->command->creating_archive
+	    && ! clone_file (*archive_filename, *tmp_archive_filename))
+	{
+		fr_process_begin_command (archive->process, "cp");
+		fr_process_add_arg (archive->process, "-f");
+		fr_process_add_arg (archive->process, *archive_filename);
+		fr_process_add_arg (archive->process, *tmp_archive_filename);
+		fr_process_end_command (archive->process);
 	}
 
-	fr_command_uncompress (archive->command);
+	return tmp_archive_dir;
+}
 
-	/* when files are already present in a tar archive and are added
-	 * again, they are not replaced, so we have to delete them first. */
 
-	/* if we are adding (== ! update) and 'add' cannot replace or
-	 * if we are updating and 'add' cannot update,
-	 * delete the files first. */
+/* -- rewrite -- */
 
-	if ((! update && ! archive->command->propAddCanReplace)
-	    || (update && ! archive->command->propAddCanUpdate))
+
+static GList *get_files_to_delete (FrArchive *archive, GList *file_list);
+
+
+static gboolean
+can_rewrite_in_one_pass (FrArchive *archive)
+{
+	FrCommand *command = archive->command;
+
+	return command->propStreamRewrite
+		&& ! command->creating_archive
+		&& ! command->multi_volume
+		&& (command->volume_size == 0);
+}
+
+
+static void
+emit_list_file_error (FrArchive *archive,
+		      GError    *error)
+{
+	archive->process->error.type = FR_PROC_ERROR_GENERIC;
+	archive->process->error.status = 0;
+	archive->process->error.gerror = g_error_copy (error);
+	g_signal_emit_by_name (G_OBJECT (archive->process),
+			       "done",
+			       &archive->process->error);
+}
+
+
+static void
+remove_temp_dir (FrArchive  *archive,
+		 const char *dir)
+{
+	fr_process_begin_command (archive->process, "rm");
+	fr_process_set_working_dir (archive->process, g_get_tmp_dir());
+	fr_process_set_sticky (archive->process, TRUE);
+	fr_process_add_arg (archive->process, "-rf");
+	fr_process_add_arg (archive->process, dir);
+	fr_process_end_command (archive->process);
+}
+
+
+/* Writes the new archive in a single pass, reading the original archive
+ * and writing the new one at the same time: the only temporary space
+ * needed is the space taken by the new archive.  del_list is the list of
+ * files to remove, as returned by get_files_to_delete, add_list the list
+ * of files to add from base_dir. */
+static void
+rewrite_archive (FrArchive  *archive,
+		 GList      *del_list,
+		 GList      *add_list,
+		 const char *base_dir,
+		 gboolean    recursive)
+{
+	char    *archive_filename;
+	char    *tmp_archive_filename = NULL;
+	char    *tmp_archive_dir;
+	char    *del_list_dir = NULL;
+	char    *del_list_filename = NULL;
+	char    *add_list_dir = NULL;
+	char    *add_list_filename = NULL;
+	GError  *error = NULL;
+
+	if (((del_list != NULL) && ! save_list_to_temp_file (del_list, &del_list_dir, &del_list_filename, &error))
+	    || ((add_list != NULL) && ! save_list_to_temp_file (add_list, &add_list_dir, &add_list_filename, &error)))
 	{
-		GList *del_list = NULL;
+		emit_list_file_error (archive, error);
+		g_clear_error (&error);
+		if (del_list_dir != NULL)
+			remove_local_directory (del_list_dir);
+		if (add_list_dir != NULL)
+			remove_local_directory (add_list_dir);
+		g_free (add_list_filename);
+		g_free (add_list_dir);
+		g_free (del_list_filename);
+		g_free (del_list_dir);
+		return;
+	}
 
-		for (scan = new_file_list; scan != NULL; scan = scan->next) {
+	archive_filename = g_file_get_path (archive->local_copy);
+	tmp_archive_dir = prepare_output_file (archive, &archive_filename, &tmp_archive_filename);
+
+	debug (DEBUG_INFO, "rewriting %s in one pass: %" G_GOFFSET_FORMAT " bytes not copied\n", archive_filename, get_file_size_for_path (archive_filename));
+	count_avoided_copy (get_file_size_for_path (archive_filename));
+
+	fr_command_set_n_files (archive->command, g_list_length (add_list));
+	fr_command_rewrite (archive->command,
+			    archive_filename,
+			    del_list_filename,
+			    add_list_filename,
+			    base_dir,
+			    recursive);
+
+	/* move the new archive to the original position */
+
+	fr_process_begin_command (archive->process, "mv");
+	fr_process_add_arg (archive->process, "-f");
+	fr_process_add_arg (archive->process, tmp_archive_filename);
+	fr_process_add_arg (archive->process, archive_filename);
+	fr_process_end_command (archive->process);
+
+	/* remove the temp sub-directory and the lists */
+
+	remove_temp_dir (archive, tmp_archive_dir);
+	if (del_list_dir != NULL)
+		remove_temp_dir (archive, del_list_dir);
+	if (add_list_dir != NULL)
+		remove_temp_dir (archive, add_list_dir);
+
+	g_free (add_list_filename);
+	g_free (add_list_dir);
+	g_free (del_list_filename);
+	g_free (del_list_dir);
+	g_free (tmp_archive_dir);
+	g_free (tmp_archive_filename);
+	g_free (archive_filename);
+}
+
+
+/* a set of files to add, relative to base_dir */
+typedef struct {
+	char     *base_dir;
+	GList    *file_list;
+	gboolean  base_dir_created;
+} AddGroup;
+
+
+static AddGroup *
+add_group_new (const char *base_dir,
+	       GList      *file_list)
+{
+	AddGroup *group;
+
+	group = g_new0 (AddGroup, 1);
+	group->base_dir = g_strdup (base_dir);
+	group->file_list = file_list;
+
+	return group;
+}
+
+
+static void
+add_group_free (AddGroup *group)
+{
+	if (group == NULL)
+		return;
+	g_free (group->base_dir);
+	path_list_free (group->file_list);
+	g_free (group);
+}
+
+
+static void
+add_groups_list_free (GList *groups)
+{
+	g_list_foreach (groups, (GFunc) add_group_free, NULL);
+	g_list_free (groups);
+}
+
+
+/* puts the files of the group in dest_dir, using a temporary base folder
+ * that links to the original one, and removes the files not newer than
+ * the archived ones if requested. */
+static void
+prepare_add_group (FrArchive  *archive,
+		   AddGroup   *group,
+		   const char *dest_dir,
+		   gboolean    update)
+{
+	GList *scan;
+
+	if ((dest_dir != NULL) && (*dest_dir != '\0') && (strcmp (dest_dir, "/") != 0)) {
+		const char *rel_dest_dir = dest_dir;
+		char       *tmp_base_dir;
+		GList      *new_file_list = NULL;
+
+		tmp_base_dir = create_tmp_base_dir (group->base_dir, dest_dir);
+		g_free (group->base_dir);
+		group->base_dir = tmp_base_dir;
+		group->base_dir_created = TRUE;
+
+		if (dest_dir[0] == G_DIR_SEPARATOR)
+			rel_dest_dir = dest_dir + 1;
+
+		for (scan = group->file_list; scan != NULL; scan = scan->next) {
 			char *filename = scan->data;
-			if (find_file_in_archive (archive, filename))
-				del_list = g_list_prepend (del_list, filename);
+			new_file_list = g_list_prepend (new_file_list, g_build_filename (rel_dest_dir, filename, NULL));
 		}
+		path_list_free (group->file_list);
+		group->file_list = new_file_list;
+	}
+
+	/* if the command cannot update,  get the list of files that are
+	 * newer than the ones in the archive. */
 
-		/* delete */
+	if (update && ! archive->command->propAddCanUpdate) {
+		GList *tmp_file_list;
 
-		if (del_list != NULL) {
-			delete_from_archive (archive, del_list);
-			fr_process_set_ignore_error (archive->process, TRUE);
-			g_list_free (del_list);
-		}
+		tmp_file_list = group->file_list;
+		group->file_list = newer_files_only (archive, tmp_file_list, group->base_dir);
+		path_list_free (tmp_file_list);
 	}
+}
 
-	/* add now. */
 
-	fr_command_set_n_files (archive->command, g_list_length (new_file_list));
+/* adds the files of a group, the archive is already prepared. */
+static gboolean
+add_group_to_archive (FrArchive *archive,
+		      AddGroup  *group,
+		      gboolean   update,
+		      gboolean   recursive)
+{
+	GList *scan;
+
+	if (group->file_list == NULL)
+		return TRUE;
 
 	if (archive->command->propListFromFile
-	    && (archive->command->n_files > LIST_LENGTH_TO_USE_FILE))
+	    && (g_list_length (group->file_list) > LIST_LENGTH_TO_USE_FILE))
 	{
 		char   *list_dir;
 		char   *list_filename;
 		GError *error = NULL;
 
-		if (! save_list_to_temp_file (new_file_list, &list_dir, &list_filename, &error)) {
-			archive->process->error.type = FR_PROC_ERROR_GENERIC;
-			archive->process->error.status = 0;
-			archive->process->error.gerror = g_error_copy (error);
-			g_signal_emit_by_name (G_OBJECT (archive->process),
-					       "done",
-					       &archive->process->error);
+		if (! save_list_to_temp_file (group->file_list, &list_dir, &list_filename, &error)) {
+			emit_list_file_error (archive, error);
 			g_clear_error (&error);
-			error_occurred = TRUE;
+			return FALSE;
 		}
-		else {
-			fr_command_add (archive->command,
-					list_filename,
-					new_file_list,
-					tmp_base_dir,
-					update,
-					recursive);
 
-			/* remove the temp dir */
+		fr_command_add (archive->command,
+				list_filename,
+				group->file_list,
+				group->base_dir,
+				update,
+				recursive);
 
-			fr_process_begin_command (archive->process, "rm");
-			fr_process_set_working_dir (archive->process, g_get_tmp_dir());
-			fr_process_set_sticky (archive->process, TRUE);
-			fr_process_add_arg (archive->process, "-rf");
-			fr_process_add_arg (archive->process, list_dir);
-			fr_process_end_command (archive->process);
-		}
+		/* remove the temp dir */
+
+		remove_temp_dir (archive, list_dir);
 
 		g_free (list_filename);
 		g_free (list_dir);
@@ -1724,14 +2298,14 @@ g_print("src_dir: %s, dst: %s\n", base_dir, dest_dir);
 		 * in more commands to avoid to overflow the command line
 		 * length limit. */
 
-		chunks = split_in_chunks (new_file_list);
+		chunks = split_in_chunks (group->file_list);
 		for (scan = chunks; scan != NULL; scan = scan->next) {
 			GList *chunk = scan->data;
 
 			fr_command_add (archive->command,
 					NULL,
 					chunk,
-					tmp_base_dir,
+					group->base_dir,
 					update,
 					recursive);
 			g_list_free (chunk);
@@ -1740,122 +2314,502 @@ g_print("src_dir: %s, dst: %s\n", base_dir, dest_dir);
 		g_list_free (chunks);
 	}
 
-	path_list_free (new_file_list);
-
-    g_print("final: %s -> %s, %d\n", tmp_archive_filename, archive_filename, error_occurred);
-    if (! error_occurred) {
-		fr_command_recompress (archive->command);
+	return TRUE;
+}
 
-		/* move the new archive to the original position */
 
-		fr_process_begin_command (archive->process, "mv");
-		fr_process_add_arg (archive->process, "-f");
-		fr_process_add_arg (archive->process, tmp_archive_filename);
-		fr_process_add_arg (archive->process, archive_filename);
-		fr_process_end_command (archive->process);
-return;
-		/* remove the temp sub-directory */
+/* the size of path, and of its content if it is a folder and recursive
+ * is TRUE. */
+static guint64
+get_tree_size (const char *path,
+	       gboolean    recursive)
+{
+	struct stat  st;
+	GDir        *dir;
+	const char  *name;
+	guint64      size = 0;
+
+	if (lstat (path, &st) != 0)
+		return 0;
+	if (! S_ISDIR (st.st_mode))
+		return S_ISREG (st.st_mode) ? st.st_size : 0;
+	if (! recursive)
+		return 0;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return 0;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		char *child = g_build_filename (path, name, NULL);
+
+		size += get_tree_size (child, TRUE);
+		g_free (child);
+	}
+	g_dir_close (dir);
 
-		fr_process_begin_command (archive->process, "rm");
-		fr_process_set_working_dir (archive->process, g_get_tmp_dir());
-		fr_process_set_sticky (archive->process, TRUE);
-		fr_process_add_arg (archive->process, "-rf");
-		fr_process_add_arg (archive->process, tmp_archive_dir);
-		fr_process_end_command (archive->process);
+	return size;
+}
 
-		/* remove the base dir */
 
-		if (base_dir_created) {
-			fr_process_begin_command (archive->process, "rm");
-			fr_process_set_working_dir (archive->process, g_get_tmp_dir());
-			fr_process_set_sticky (archive->process, TRUE);
-			fr_process_add_arg (archive->process, "-rf");
-			fr_process_add_arg (archive->process, tmp_base_dir);
-			fr_process_end_command (archive->process);
+/* Returns the folder of the first file of the groups after following the
+ * symbolic links of the temporary base folders, and in size the size of
+ * all their files.  Returns NULL if the files are not all on the same
+ * file system, as they could not be linked to a single folder. */
+static char *
+get_groups_source_dir (GList     *groups,
+		       gboolean   recursive,
+		       guint64   *size)
+{
+	char     *source_dir = NULL;
+	dev_t     source_device = 0;
+	GList    *scan;
+	gboolean  same_device = TRUE;
+
+	*size = 0;
+	for (scan = groups; same_device && (scan != NULL); scan = scan->next) {
+		AddGroup *group = scan->data;
+		GList    *scan_file;
+
+		for (scan_file = group->file_list; scan_file != NULL; scan_file = scan_file->next) {
+			char        *path;
+			char        *folder;
+			char        *real_folder;
+			struct stat  st;
+
+			path = g_build_filename (group->base_dir, (char *) scan_file->data, NULL);
+			folder = g_path_get_dirname (path);
+			real_folder = realpath (folder, NULL);
+			same_device = (real_folder != NULL) && (stat (real_folder, &st) == 0);
+			if (same_device && (source_dir == NULL)) {
+				source_dir = g_strdup (real_folder);
+				source_device = st.st_dev;
+			}
+			else if (same_device)
+				same_device = (st.st_dev == source_device);
+			if (same_device)
+				*size += get_tree_size (path, recursive);
+			free (real_folder);
+			g_free (folder);
+			g_free (path);
+
+			if (! same_device)
+				break;
 		}
 	}
 
-	g_free (tmp_archive_filename);
-	g_free (archive_filename);
-	g_free (tmp_archive_dir);
-	g_free (tmp_base_dir);
+	if (! same_device) {
+		g_free (source_dir);
+		return NULL;
+	}
+
+	return source_dir;
 }
 
 
-static void
-fr_archive_add_local_files (FrArchive     *archive,
-			    GList         *file_list,
-			    const char    *base_dir,
-			    const char    *dest_dir,
-			    gboolean       update,
-			    const char    *password,
-			    gboolean       encrypt_header,
-			    FrCompression  compression,
-			    guint          volume_size)
+/* Returns a single group that replaces the given ones: its base folder
+ * is a staging folder where link-files recreates the files of every
+ * group, with hard links, before the add command.  The staging folder
+ * must be on the file system of the files.  Returns NULL if the files
+ * must be added group by group. */
+static AddGroup *
+stage_add_groups (FrArchive  *archive,
+		  GList      *groups,
+		  gboolean    recursive)
 {
-	fr_process_clear (archive->process);
-	fr_archive_add (archive,
-			file_list,
-			base_dir,
-			dest_dir,
-			update,
-			FALSE,
-			password,
-			encrypt_header,
-			compression,
-			volume_size);
-	fr_process_start (archive->process);
-}
+	char       *source_dir;
+	char       *staging_dir;
+	GPtrArray  *list_dirs;
+	GPtrArray  *list_filenames;
+	GHashTable *names;
+	GList      *file_list = NULL;
+	GList      *scan;
+	AddGroup   *staged_group;
+	guint64     size;
+	gboolean    error_occurred = FALSE;
+	guint       i;
 
+	if (! g_file_test (LINK_FILES_COMMAND, G_FILE_TEST_IS_EXECUTABLE))
+		return NULL;
 
-static void
-copy_remote_files_done (GError   *error,
-			gpointer  user_data)
-{
-	XferData *xfer_data = user_data;
+	source_dir = get_groups_source_dir (groups, recursive, &size);
+	if (source_dir == NULL)
+		return NULL;
 
-	fr_archive_copy_done (xfer_data->archive, FR_ACTION_COPYING_FILES_FROM_REMOTE, error);
+	/* the size is reserved in case link-files has to copy some files,
+	 * a staging folder on another file system would copy all of them. */
 
-	if (error == NULL)
-		fr_archive_add_local_files (xfer_data->archive,
-					    xfer_data->file_list,
-					    xfer_data->tmp_dir,
-					    xfer_data->dest_dir,
-					    FALSE,
-					    xfer_data->password,
-					    xfer_data->encrypt_header,
-					    xfer_data->compression,
-					    xfer_data->volume_size);
-	xfer_data_free (xfer_data);
-}
+	staging_dir = get_temp_work_dir_on_device_of (source_dir, size);
+	g_free (source_dir);
+	if (staging_dir == NULL)
+		return NULL;
 
+	/* save all the lists before queuing any command */
 
-static void
-copy_remote_files_progress (goffset   current_file,
-                            goffset   total_files,
-                            GFile    *source,
-                            GFile    *destination,
-                            goffset   current_num_bytes,
-                            goffset   total_num_bytes,
-                            gpointer  user_data)
-{
-	XferData *xfer_data = user_data;
+	list_dirs = g_ptr_array_new_with_free_func (g_free);
+	list_filenames = g_ptr_array_new_with_free_func (g_free);
+	for (scan = groups; ! error_occurred && (scan != NULL); scan = scan->next) {
+		AddGroup *group = scan->data;
+		char     *list_dir;
+		char     *list_filename;
 
-	g_signal_emit (G_OBJECT (xfer_data->archive),
-		       fr_archive_signals[PROGRESS],
-		       0,
-		       (double) current_file / (total_files + 1));
-}
+		if (group->file_list == NULL)
+			continue;
 
+		if (save_list_to_temp_file (group->file_list, &list_dir, &list_filename, NULL)) {
+			g_ptr_array_add (list_dirs, list_dir);
+			g_ptr_array_add (list_filenames, list_filename);
+		}
+		else
+			error_occurred = TRUE;
+	}
 
-static void
-copy_remote_files (FrArchive     *archive,
-		   GList         *file_list,
-		   const char    *base_uri,
-		   const char    *dest_dir,
-		   gboolean       update,
-		   const char    *password,
-		   gboolean       encrypt_header,
+	if (error_occurred) {
+		for (i = 0; i < list_dirs->len; i++)
+			remove_local_directory (g_ptr_array_index (list_dirs, i));
+		remove_local_directory (staging_dir);
+		g_ptr_array_free (list_filenames, TRUE);
+		g_ptr_array_free (list_dirs, TRUE);
+		g_free (staging_dir);
+		return NULL;
+	}
+
+	names = g_hash_table_new (g_str_hash, g_str_equal);
+	for (scan = groups, i = 0; scan != NULL; scan = scan->next) {
+		AddGroup *group = scan->data;
+		GList    *scan_file;
+
+		if (group->file_list == NULL)
+			continue;
+
+		fr_process_begin_command (archive->process, LINK_FILES_COMMAND);
+		if (! recursive)
+			fr_process_add_arg (archive->process, "--no-recursion");
+		fr_process_add_arg_concat (archive->process, "--list=", g_ptr_array_index (list_filenames, i), NULL);
+		fr_process_add_arg (archive->process, group->base_dir);
+		fr_process_add_arg (archive->process, staging_dir);
+		fr_process_end_command (archive->process);
+
+		/* the base folder of the group is not used by the add command */
+
+		remove_temp_dir (archive, g_ptr_array_index (list_dirs, i));
+		if (group->base_dir_created) {
+			remove_temp_dir (archive, group->base_dir);
+			group->base_dir_created = FALSE;
+		}
+		i++;
+
+		/* a name added by more groups is given once, the files of the
+		 * last group are staged */
+
+		for (scan_file = group->file_list; scan_file != NULL; scan_file = scan_file->next) {
+			char *filename = scan_file->data;
+
+			if (g_hash_table_lookup (names, filename) != NULL)
+				continue;
+			g_hash_table_insert (names, filename, filename);
+			file_list = g_list_prepend (file_list, g_strdup (filename));
+		}
+	}
+	g_hash_table_destroy (names);
+
+	staged_group = add_group_new (staging_dir, g_list_reverse (file_list));
+	staged_group->base_dir_created = TRUE;
+
+	g_ptr_array_free (list_filenames, TRUE);
+	g_ptr_array_free (list_dirs, TRUE);
+	g_free (staging_dir);
+
+	return staged_group;
+}
+
+
+/* Adds the files of all the groups rewriting the archive once: the files
+ * of several groups are staged in a single folder and added with a single
+ * command, or, if they cannot be staged, each group is added from its own
+ * base folder between a single uncompress and recompress of the same
+ * working copy.  The archived files in remove_list, if any, are deleted in
+ * the same rewrite. */
+static void
+add_groups_to_archive (FrArchive  *archive,
+		       GList      *groups,
+		       const char *dest_dir,
+		       gboolean    update,
+		       gboolean    recursive,
+		       GList      *remove_list)
+{
+	GList    *scan;
+	char     *tmp_archive_dir = NULL;
+	char     *archive_filename = NULL;
+	char     *tmp_archive_filename = NULL;
+	GList    *del_list = NULL;
+	GList    *staged_groups = NULL;
+	int       n_files = 0;
+	gboolean  error_occurred = FALSE;
+
+	fr_archive_stoppable (archive, TRUE);
+
+	for (scan = groups; scan != NULL; scan = scan->next) {
+		AddGroup *group = scan->data;
+
+		prepare_add_group (archive, group, dest_dir, update);
+		n_files += g_list_length (group->file_list);
+	}
+
+	if ((n_files == 0) && (remove_list == NULL)) {
+		debug (DEBUG_INFO, "nothing to update.\n");
+
+		for (scan = groups; scan != NULL; scan = scan->next) {
+			AddGroup *group = scan->data;
+
+			if (group->base_dir_created)
+				remove_local_directory (group->base_dir);
+		}
+
+		archive->process->error.type = FR_PROC_ERROR_NONE;
+		g_signal_emit_by_name (G_OBJECT (archive->process),
+				       "done",
+				       &archive->process->error);
+		return;
+	}
+
+	archive->command->creating_archive = (! archive->priv->remote_listing
+					      && ! g_file_query_exists (archive->local_copy, archive->priv->cancellable));
+
+	del_list = g_list_copy (remove_list);
+
+	/* when files are already present in a tar archive and are added
+	 * again, they are not replaced, so we have to delete them first. */
+
+	/* if we are adding (== ! update) and 'add' cannot replace or
+	 * if we are updating and 'add' cannot update,
+	 * delete the files first. */
+
+	if ((! update && ! archive->command->propAddCanReplace)
+	    || (update && ! archive->command->propAddCanUpdate))
+	{
+		for (scan = groups; scan != NULL; scan = scan->next) {
+			AddGroup *group = scan->data;
+			GList    *scan_file;
+
+			for (scan_file = group->file_list; scan_file != NULL; scan_file = scan_file->next) {
+				char *filename = scan_file->data;
+				if (find_file_in_archive (archive, filename))
+					del_list = g_list_prepend (del_list, filename);
+			}
+		}
+	}
+
+	/* the files of several folders are staged in a single one, so that
+	 * a single command writes the archive. */
+
+	if ((groups != NULL) && (groups->next != NULL)) {
+		AddGroup *staged_group;
+
+		staged_group = stage_add_groups (archive, groups, recursive);
+		if (staged_group != NULL) {
+			staged_groups = g_list_prepend (NULL, staged_group);
+			groups = staged_groups;
+			n_files = g_list_length (staged_group->file_list);
+		}
+	}
+
+	/* the one pass rewrite reads the new files from a single folder. */
+
+	if (can_rewrite_in_one_pass (archive) && ((groups == NULL) || (groups->next == NULL))) {
+		GList    *file_list = NULL;
+		char     *base_dir = NULL;
+		gboolean  base_dir_created = FALSE;
+		GList    *tmp_del_list = NULL;
+
+		if (groups != NULL) {
+			AddGroup *group = groups->data;
+
+			file_list = group->file_list;
+			base_dir = group->base_dir;
+			base_dir_created = group->base_dir_created;
+		}
+
+		if (del_list != NULL)
+			tmp_del_list = get_files_to_delete (archive, del_list);
+		rewrite_archive (archive, tmp_del_list, file_list, base_dir, recursive);
+
+		if (base_dir_created)
+			remove_temp_dir (archive, base_dir);
+
+		g_list_free (tmp_del_list);
+		g_list_free (del_list);
+		add_groups_list_free (staged_groups);
+
+		return;
+	}
+
+	tmp_archive_dir = prepare_working_copy (archive,
+						del_list != NULL,
+						&archive_filename,
+						&tmp_archive_filename);
+
+	fr_command_uncompress (archive->command);
+
+	/* delete */
+
+	if (del_list != NULL) {
+		delete_from_archive (archive, del_list);
+		fr_process_set_ignore_error (archive->process, TRUE);
+		g_list_free (del_list);
+	}
+
+	/* add now. */
+
+	fr_command_set_n_files (archive->command, n_files);
+
+	for (scan = groups; ! error_occurred && (scan != NULL); scan = scan->next)
+		error_occurred = ! add_group_to_archive (archive, scan->data, update, recursive);
+
+	if (! error_occurred) {
+		fr_command_recompress (archive->command);
+
+		/* move the new archive to the original position */
+
+		if (tmp_archive_dir != NULL) {
+			fr_process_begin_command (archive->process, "mv");
+			fr_process_add_arg (archive->process, "-f");
+			fr_process_add_arg (archive->process, tmp_archive_filename);
+			fr_process_add_arg (archive->process, archive_filename);
+			fr_process_end_command (archive->process);
+
+			/* remove the temp sub-directory */
+
+			remove_temp_dir (archive, tmp_archive_dir);
+		}
+
+		/* remove the base dirs */
+
+		for (scan = groups; scan != NULL; scan = scan->next) {
+			AddGroup *group = scan->data;
+
+			if (group->base_dir_created)
+				remove_temp_dir (archive, group->base_dir);
+		}
+	}
+
+	add_groups_list_free (staged_groups);
+	g_free (tmp_archive_filename);
+	g_free (archive_filename);
+	g_free (tmp_archive_dir);
+}
+
+
+void
+fr_archive_add (FrArchive     *archive,
+		GList         *file_list,
+		const char    *base_dir,
+		const char    *dest_dir,
+		gboolean       update,
+		gboolean       recursive,
+		const char    *password,
+		gboolean       encrypt_header,
+		FrCompression  compression,
+		guint          volume_size)
+{
+	GList *groups;
+
+	if (file_list == NULL)
+		return;
+
+	if (archive->read_only)
+		return;
+
+	download_remote_listed_archive (archive);
+
+	g_object_set (archive->command,
+		      "password", password,
+		      "encrypt_header", encrypt_header,
+		      "compression", compression,
+		      "volume_size", volume_size,
+		      NULL);
+
+	/* dest_dir is the destination folder inside the archive */
+
+	groups = g_list_prepend (NULL, add_group_new (base_dir, path_list_dup (file_list)));
+	add_groups_to_archive (archive, groups, dest_dir, update, recursive, NULL);
+	add_groups_list_free (groups);
+}
+
+
+void
+fr_archive_add_local_files (FrArchive     *archive,
+			    GList         *file_list,
+			    const char    *base_dir,
+			    const char    *dest_dir,
+			    gboolean       update,
+			    const char    *password,
+			    gboolean       encrypt_header,
+			    FrCompression  compression,
+			    guint          volume_size)
+{
+	fr_process_clear (archive->process);
+	fr_archive_add (archive,
+			file_list,
+			base_dir,
+			dest_dir,
+			update,
+			FALSE,
+			password,
+			encrypt_header,
+			compression,
+			volume_size);
+	fr_process_start (archive->process);
+}
+
+
+static void
+copy_remote_files_done (GError   *error,
+			gpointer  user_data)
+{
+	XferData *xfer_data = user_data;
+
+	fr_archive_copy_done (xfer_data->archive, FR_ACTION_COPYING_FILES_FROM_REMOTE, error);
+
+	if (error == NULL)
+		fr_archive_add_local_files (xfer_data->archive,
+					    xfer_data->file_list,
+					    xfer_data->tmp_dir,
+					    xfer_data->dest_dir,
+					    FALSE,
+					    xfer_data->password,
+					    xfer_data->encrypt_header,
+					    xfer_data->compression,
+					    xfer_data->volume_size);
+	xfer_data_free (xfer_data);
+}
+
+
+static void
+copy_remote_files_progress (goffset   current_file,
+                            goffset   total_files,
+                            GFile    *source,
+                            GFile    *destination,
+                            goffset   current_num_bytes,
+                            goffset   total_num_bytes,
+                            gpointer  user_data)
+{
+	XferData *xfer_data = user_data;
+
+	g_signal_emit (G_OBJECT (xfer_data->archive),
+		       fr_archive_signals[PROGRESS],
+		       0,
+		       (double) current_file / (total_files + 1));
+}
+
+
+static void
+copy_remote_files (FrArchive     *archive,
+		   GList         *file_list,
+		   const char    *base_uri,
+		   const char    *dest_dir,
+		   gboolean       update,
+		   const char    *password,
+		   gboolean       encrypt_header,
 		   FrCompression  compression,
 		   guint          volume_size,
 		   const char    *tmp_dir)
@@ -2207,602 +3161,1721 @@ fr_archive_add_directory (FrArchive     *archive,
 }
 
 
-void
-fr_archive_add_items (FrArchive     *archive,
-		      GList         *item_list,
-		      const char    *base_dir,
-		      const char    *dest_dir,
-		      gboolean       update,
-		      const char    *password,
-		      gboolean       encrypt_header,
-		      FrCompression  compression,
-		      guint          volume_size)
-
-{
-	AddDirectoryData *ad_data;
+/* -- fr_archive_sync_directory -- */
 
-	g_return_if_fail (! archive->read_only);
 
-	ad_data = g_new0 (AddDirectoryData, 1);
-	ad_data->archive = archive;
-	ad_data->base_dir = g_strdup (base_dir);
-	ad_data->dest_dir = g_strdup (dest_dir);
-	ad_data->update = update;
-	ad_data->password = g_strdup (password);
-	ad_data->encrypt_header = encrypt_header;
-	ad_data->compression = compression;
-	ad_data->volume_size = volume_size;
+typedef struct {
+	char    *original_path;
+	goffset  size;
+	time_t   modified;
+} ArchivedFile;
 
-	g_signal_emit (G_OBJECT (archive),
-		       fr_archive_signals[START],
-		       0,
-		       FR_ACTION_GETTING_FILE_LIST);
 
-	g_list_items_async (item_list,
-			    base_dir,
-			    archive->priv->cancellable,
-			    add_directory__step2,
-			    ad_data);
+static void
+archived_file_free (ArchivedFile *archived)
+{
+	g_free (archived->original_path);
+	g_free (archived);
 }
 
 
-/* -- fr_archive_add_dropped_items -- */
+typedef struct {
+	FrArchive     *archive;
+	char          *base_dir;         /* local path */
+	char          *dest_dir;
+	char          *dest_prefix;      /* dest_dir without the slashes */
+	char          *scope;            /* synchronized folder in the archive,
+					  * empty for the whole archive */
+	gboolean       store_folders;
+	char          *password;
+	gboolean       encrypt_header;
+	FrCompression  compression;
+	guint          volume_size;
+	GList         *file_list;        /* relative to base_dir */
+	GList         *dir_list;
+	GHashTable    *archived_files;   /* archive path -> ArchivedFile */
+	GHashTable    *index;            /* NULL if the content is not compared */
+	char          *index_filename;
+	GList         *add_list;         /* relative to base_dir */
+	GList         *remove_list;      /* original paths in the archive */
+} SyncDirectoryData;
 
 
-static gboolean
-all_files_in_same_dir (GList *list)
+static void
+sync_directory_data_free (SyncDirectoryData *sd_data)
 {
-	gboolean  same_dir = TRUE;
-	char     *first_basedir;
-	GList    *scan;
+	g_free (sd_data->base_dir);
+	g_free (sd_data->dest_dir);
+	g_free (sd_data->dest_prefix);
+	g_free (sd_data->scope);
+	g_free (sd_data->password);
+	path_list_free (sd_data->file_list);
+	path_list_free (sd_data->dir_list);
+	if (sd_data->archived_files != NULL)
+		g_hash_table_unref (sd_data->archived_files);
+	if (sd_data->index != NULL)
+		g_hash_table_unref (sd_data->index);
+	g_free (sd_data->index_filename);
+	path_list_free (sd_data->add_list);
+	path_list_free (sd_data->remove_list);
+	g_free (sd_data);
+}
 
-	if (list == NULL)
-		return FALSE;
 
-	first_basedir = remove_level_from_path (list->data);
-	if (first_basedir == NULL)
-		return TRUE;
+/* returns path without the leading and the trailing slashes. */
+static char *
+get_sync_path (const char *path)
+{
+	char *sync_path;
+	int   len;
 
-	for (scan = list->next; scan; scan = scan->next) {
-		char *path = scan->data;
-		char *basedir;
+	while (*path == '/')
+		path++;
+	sync_path = g_strdup (path);
+	len = strlen (sync_path);
+	while ((len > 0) && (sync_path[len - 1] == '/'))
+		sync_path[--len] = '\0';
 
-		basedir = remove_level_from_path (path);
-		if (basedir == NULL) {
-			same_dir = FALSE;
-			break;
-		}
+	return sync_path;
+}
 
-		if (strcmp (first_basedir, basedir) != 0) {
-			same_dir = FALSE;
-			g_free (basedir);
-			break;
-		}
-		g_free (basedir);
-	}
-	g_free (first_basedir);
 
-	return same_dir;
+static char *
+build_sync_path (const char *prefix,
+		 const char *path)
+{
+	if (*prefix == '\0')
+		return g_strdup (path);
+	return g_strconcat (prefix, "/", path, NULL);
 }
 
 
-static void
-add_dropped_items (DroppedItemsData *data)
+static gboolean
+sync_path_in_scope (const char *path,
+		    const char *scope)
 {
-	FrArchive *archive = data->archive;
-	GList     *list = data->item_list;
-	GList     *scan;
+	int len = strlen (scope);
 
-	if (list == NULL) {
-		dropped_items_data_free (archive->priv->dropped_items_data);
-		archive->priv->dropped_items_data = NULL;
-		fr_archive_action_completed (archive,
-					     FR_ACTION_ADDING_FILES,
-					     FR_PROC_ERROR_NONE,
-					     NULL);
-		return;
+	if (len == 0)
+		return TRUE;
+	return (strncmp (path, scope, len) == 0) && (path[len] == '/');
+}
+
+
+static GHashTable *
+get_archived_files (FrArchive *archive)
+{
+	GHashTable *archived_files;
+	int         i;
+
+	archived_files = g_hash_table_new_full (g_str_hash,
+						g_str_equal,
+						g_free,
+						(GDestroyNotify) archived_file_free);
+	for (i = 0; i < archive->command->files->len; i++) {
+		FileData     *fdata = g_ptr_array_index (archive->command->files, i);
+		ArchivedFile *archived;
+
+		archived = g_new (ArchivedFile, 1);
+		archived->original_path = g_strdup (fdata->original_path);
+		archived->size = fdata->size;
+		archived->modified = fdata->modified;
+		g_hash_table_replace (archived_files, get_sync_path (fdata->original_path), archived);
 	}
 
-	/* if all files/dirs are in the same directory call fr_archive_add_items... */
+	return archived_files;
+}
 
-	if (all_files_in_same_dir (list)) {
-		char *first_base_dir;
 
-		first_base_dir = remove_level_from_path (list->data);
-		fr_archive_add_items (data->archive,
-				      list,
-				      first_base_dir,
-				      data->dest_dir,
-				      data->update,
-				      data->password,
-				      data->encrypt_header,
-				      data->compression,
-				      data->volume_size);
-		g_free (first_base_dir);
+typedef enum {
+	SYNC_FILE_UNCHANGED,   /* hashed only to complete the index */
+	SYNC_FILE_CANDIDATE,   /* changed if the hash differs from the index */
+	SYNC_FILE_CHANGED
+} SyncFileState;
 
-		dropped_items_data_free (archive->priv->dropped_items_data);
-		archive->priv->dropped_items_data = NULL;
 
-		return;
+/* Decides which files of the folder are added and which archived files
+ * are deleted: a file is unchanged if its size and modification time are
+ * the archived ones, or the ones recorded in the index; when only the
+ * modification time differs, the file is unchanged if the hash of its
+ * content is the one recorded in the index. */
+static void
+sync_directory_thread (GTask        *task,
+		       gpointer      source_object,
+		       gpointer      task_data,
+		       GCancellable *cancellable)
+{
+	SyncDirectoryData *sd_data = task_data;
+	GHashTable        *source_paths;
+	FileStat          *files;
+	char             **archive_paths;
+	FileHash          *to_hash;
+	guint             *hashed_file;
+	SyncFileState     *hashed_state;
+	guint              n_files;
+	guint              n_to_hash = 0;
+	guint              i;
+	GList             *scan;
+	GHashTableIter     iter;
+	gpointer           key;
+	gpointer           value;
+
+	n_files = g_list_length (sd_data->file_list);
+	files = g_new0 (FileStat, n_files);
+	for (i = 0, scan = sd_data->file_list; scan; scan = scan->next, i++)
+		files[i].path = scan->data;
+	qsort (files, n_files, sizeof (FileStat), compare_file_stat_by_path);
+	stat_files (sd_data->base_dir, files, n_files);
+
+	/* the archive paths present in the folder, the keys are the
+	 * strings of archive_paths */
+	source_paths = g_hash_table_new (g_str_hash, g_str_equal);
+
+	archive_paths = g_new0 (char *, n_files);
+	to_hash = g_new (FileHash, n_files);
+	hashed_file = g_new (guint, n_files);
+	hashed_state = g_new (SyncFileState, n_files);
+
+	for (i = 0; i < n_files; i++) {
+		ArchivedFile   *archived;
+		SyncIndexEntry *entry = NULL;
+		SyncFileState   state;
+
+		archive_paths[i] = build_sync_path (sd_data->dest_prefix, files[i].path);
+		g_hash_table_add (source_paths, archive_paths[i]);
+
+		if (! files[i].exists)
+			continue;
+
+		archived = g_hash_table_lookup (sd_data->archived_files, archive_paths[i]);
+		if (sd_data->index != NULL)
+			entry = g_hash_table_lookup (sd_data->index, archive_paths[i]);
+
+		if ((archived != NULL)
+		    && (archived->size == files[i].size)
+		    /* some formats round the time to two seconds */
+		    && (ABS (archived->modified - files[i].mtime) <= 1))
+		{
+			state = SYNC_FILE_UNCHANGED;
+		}
+		else if ((archived != NULL) && (entry != NULL) && (entry->size == files[i].size))
+			state = (entry->mtime == files[i].mtime) ? SYNC_FILE_UNCHANGED : SYNC_FILE_CANDIDATE;
+		else
+			state = SYNC_FILE_CHANGED;
+
+		if (state == SYNC_FILE_CHANGED)
+			sd_data->add_list = g_list_prepend (sd_data->add_list, g_strdup (files[i].path));
+
+		/* hash the files the index does not describe as they are */
+
+		if ((sd_data->index != NULL)
+		    && ((entry == NULL)
+			|| (entry->size != files[i].size)
+			|| (entry->mtime != files[i].mtime)))
+		{
+			to_hash[n_to_hash].path = files[i].path;
+			hashed_file[n_to_hash] = i;
+			hashed_state[n_to_hash] = state;
+			n_to_hash++;
+		}
 	}
 
-	/* ...else add a directory at a time. */
+	if (! g_cancellable_is_cancelled (cancellable))
+		sync_index_hash_files (sd_data->base_dir, to_hash, n_to_hash);
+	else
+		n_to_hash = 0;
 
-	for (scan = list; scan; scan = scan->next) {
-		char *path = scan->data;
-		char *base_dir;
+	for (i = 0; i < n_to_hash; i++) {
+		guint           f = hashed_file[i];
+		SyncIndexEntry *entry;
 
-		if (! uri_is_dir (path))
-			continue;
+		entry = g_hash_table_lookup (sd_data->index, archive_paths[f]);
+		if ((hashed_state[i] == SYNC_FILE_CANDIDATE)
+		    && ((to_hash[i].hash == NULL) || (strcmp (to_hash[i].hash, entry->hash) != 0)))
+		{
+			sd_data->add_list = g_list_prepend (sd_data->add_list, g_strdup (files[f].path));
+		}
 
-		data->item_list = g_list_remove_link (list, scan);
-		if (data->item_list != NULL)
-			archive->priv->continue_adding_dropped_items = TRUE;
-		base_dir = remove_level_from_path (path);
+		if (to_hash[i].hash != NULL) {
+			entry = sync_index_entry_new (archive_paths[f], files[f].size, files[f].mtime, to_hash[i].hash);
+			g_hash_table_replace (sd_data->index, entry->path, entry);
+		}
+		else
+			g_hash_table_remove (sd_data->index, archive_paths[f]);
+		g_free (to_hash[i].hash);
+	}
 
-		fr_archive_add_directory (archive,
-					  file_name_from_path (path),
-					  base_dir,
-					  data->dest_dir,
-					  data->update,
-					  data->password,
-					  data->encrypt_header,
-					  data->compression,
-					  data->volume_size);
+	/* add the folders not yet in the archive */
 
-		g_free (base_dir);
-		g_free (path);
+	for (scan = sd_data->dir_list; scan; scan = scan->next) {
+		char *dir = scan->data;
+		char *archive_path;
 
-		return;
+		archive_path = build_sync_path (sd_data->dest_prefix, dir);
+		if (sd_data->store_folders && ! g_hash_table_contains (sd_data->archived_files, archive_path))
+			sd_data->add_list = g_list_prepend (sd_data->add_list, g_strdup (dir));
+		g_hash_table_add (source_paths, archive_path);
 	}
 
-	/* if all files are in the same directory call fr_archive_add_files. */
+	/* delete the archived files no longer in the folder */
 
-	if (all_files_in_same_dir (list)) {
-		char  *first_basedir;
-		GList *only_names_list = NULL;
+	g_hash_table_iter_init (&iter, sd_data->archived_files);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		ArchivedFile *archived = value;
 
-		first_basedir = remove_level_from_path (list->data);
+		if (sync_path_in_scope (key, sd_data->scope)
+		    && ! g_hash_table_contains (source_paths, key))
+		{
+			sd_data->remove_list = g_list_prepend (sd_data->remove_list, g_strdup (archived->original_path));
+		}
+	}
 
-		for (scan = list; scan; scan = scan->next) {
-			char *name;
+	/* and their index entries */
 
-			name = g_uri_unescape_string (file_name_from_path (scan->data), NULL);
-			only_names_list = g_list_prepend (only_names_list, name);
-		}
+	if (sd_data->index != NULL) {
+		g_hash_table_iter_init (&iter, sd_data->index);
+		while (g_hash_table_iter_next (&iter, &key, NULL))
+			if (! g_hash_table_contains (source_paths, key)
+			    && (sync_path_in_scope (key, sd_data->scope)
+				|| ! g_hash_table_contains (sd_data->archived_files, key)))
+			{
+				g_hash_table_iter_remove (&iter);
+			}
+	}
 
-		fr_archive_add_files (archive,
-				      only_names_list,
-				      first_basedir,
-				      data->dest_dir,
-				      data->update,
-				      data->password,
-				      data->encrypt_header,
-				      data->compression,
-				      data->volume_size);
+	for (i = 0; i < n_files; i++)
+		g_free (archive_paths[i]);
+	g_free (archive_paths);
+	g_free (hashed_state);
+	g_free (hashed_file);
+	g_free (to_hash);
+	g_free (files);
+	g_hash_table_unref (source_paths);
+
+	if (! g_task_return_error_if_cancelled (task))
+		g_task_return_boolean (task, TRUE);
+}
 
-		path_list_free (only_names_list);
-		g_free (first_basedir);
 
+static void
+sync_directory__step3 (GObject      *source_object,
+		       GAsyncResult *result,
+		       gpointer      user_data)
+{
+	SyncDirectoryData *sd_data = user_data;
+	FrArchive         *archive = sd_data->archive;
+	GList             *groups = NULL;
+	GError            *error = NULL;
+
+	if (! g_task_propagate_boolean (G_TASK (result), &error)) {
+		fr_archive_action_completed (archive,
+					     FR_ACTION_GETTING_FILE_LIST,
+					     (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ? FR_PROC_ERROR_STOPPED : FR_PROC_ERROR_GENERIC),
+					     error->message);
+		g_error_free (error);
+		sync_directory_data_free (sd_data);
 		return;
 	}
 
-	/* ...else call fr_command_add for each file.  This is needed to add
-	 * files without path info. FIXME: doesn't work with remote files. */
+	fr_archive_action_completed (archive,
+				     FR_ACTION_GETTING_FILE_LIST,
+				     FR_PROC_ERROR_NONE,
+				     NULL);
+
+	/* the index is saved when the archive is updated, or now if the
+	 * archive does not change. */
+
+	discard_sync_index (archive);
+	if (sd_data->index != NULL) {
+		archive->priv->sync_index = sd_data->index;
+		archive->priv->sync_index_filename = sd_data->index_filename;
+		sd_data->index = NULL;
+		sd_data->index_filename = NULL;
+	}
+
+	if ((sd_data->add_list == NULL) && (sd_data->remove_list == NULL)) {
+		debug (DEBUG_INFO, "nothing to synchronize.\n");
+		save_sync_index (archive);
+		fr_archive_action_completed (archive,
+					     FR_ACTION_ADDING_FILES,
+					     FR_PROC_ERROR_NONE,
+					     NULL);
+		sync_directory_data_free (sd_data);
+		return;
+	}
 
-	fr_archive_stoppable (archive, FALSE);
-	archive->command->creating_archive = ! g_file_query_exists (archive->local_copy, archive->priv->cancellable);
 	g_object_set (archive->command,
-		      "file", archive->local_copy,
-		      "password", data->password,
-		      "encrypt_header", data->encrypt_header,
-		      "compression", data->compression,
-		      "volume_size", data->volume_size,
+		      "password", sd_data->password,
+		      "encrypt_header", sd_data->encrypt_header,
+		      "compression", sd_data->compression,
+		      "volume_size", sd_data->volume_size,
 		      NULL);
+
 	fr_process_clear (archive->process);
-	fr_command_uncompress (archive->command);
-	for (scan = list; scan; scan = scan->next) {
-		char  *fullpath = scan->data;
-		char  *basedir;
-		GList *singleton;
+	download_remote_listed_archive (archive);
 
-		basedir = remove_level_from_path (fullpath);
-		singleton = g_list_prepend (NULL, (char*)file_name_from_path (fullpath));
-		fr_command_add (archive->command,
-				NULL,
-				singleton,
-				basedir,
-				data->update,
-				FALSE);
-		g_list_free (singleton);
-		g_free (basedir);
+	if (sd_data->add_list != NULL) {
+		groups = g_list_prepend (NULL, add_group_new (sd_data->base_dir, sd_data->add_list));
+		sd_data->add_list = NULL;
 	}
-	fr_command_recompress (archive->command);
+	add_groups_to_archive (archive, groups, sd_data->dest_dir, FALSE, FALSE, sd_data->remove_list);
+	add_groups_list_free (groups);
+
 	fr_process_start (archive->process);
 
-	path_list_free (data->item_list);
-	data->item_list = NULL;
+	sync_directory_data_free (sd_data);
 }
 
 
-void
-fr_archive_add_dropped_items (FrArchive     *archive,
-			      GList         *item_list,
-			      const char    *base_dir,
-			      const char    *dest_dir,
-			      gboolean       update,
-			      const char    *password,
-			      gboolean       encrypt_header,
-			      FrCompression  compression,
-			      guint          volume_size)
+static void
+sync_directory__step2 (GList    *file_list,
+		       GList    *dir_list,
+		       GError   *error,
+		       gpointer  data)
 {
-	GList *scan;
-	char  *archive_uri;
+	SyncDirectoryData *sd_data = data;
+	FrArchive         *archive = sd_data->archive;
+	GTask             *task;
 
-	if (archive->read_only) {
+	if (error != NULL) {
 		fr_archive_action_completed (archive,
-					     FR_ACTION_ADDING_FILES,
-					     FR_PROC_ERROR_GENERIC,
-					     ! archive->have_permissions ? _("You don't have the right permissions.") : _("This archive type cannot be modified"));
+					     FR_ACTION_GETTING_FILE_LIST,
+					     (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ? FR_PROC_ERROR_STOPPED : FR_PROC_ERROR_GENERIC),
+					     error->message);
+		sync_directory_data_free (sd_data);
 		return;
 	}
 
-	/* FIXME: make this check for all the add actions */
-	archive_uri = g_file_get_uri (archive->file);
-	for (scan = item_list; scan; scan = scan->next) {
-		if (uricmp (scan->data, archive_uri) == 0) {
-			g_free (archive_uri);
-			fr_archive_action_completed (archive,
-						     FR_ACTION_ADDING_FILES,
-						     FR_PROC_ERROR_GENERIC,
-						     _("You can't add an archive to itself."));
-			return;
-		}
-	}
-	g_free (archive_uri);
+	sd_data->file_list = file_list;
+	sd_data->dir_list = dir_list;
+	sd_data->archived_files = get_archived_files (archive);
 
-	if (archive->priv->dropped_items_data != NULL)
-		dropped_items_data_free (archive->priv->dropped_items_data);
-	archive->priv->dropped_items_data = dropped_items_data_new (
-						archive,
-				       		item_list,
-				       		base_dir,
-				       		dest_dir,
-				       		update,
-				       		password,
-				       		encrypt_header,
-				       		compression,
-				       		volume_size);
-	add_dropped_items (archive->priv->dropped_items_data);
+	task = g_task_new (archive,
+			   archive->priv->cancellable,
+			   sync_directory__step3,
+			   sd_data);
+	g_task_set_task_data (task, sd_data, NULL);
+	g_task_run_in_thread (task, sync_directory_thread);
+	g_object_unref (task);
 }
 
 
-/* -- remove -- */
-
-
-static gboolean
-file_is_in_subfolder_of (const char *filename,
-		         GList      *folder_list)
+void
+fr_archive_sync_directory (FrArchive     *archive,
+			   const char    *directory,
+			   const char    *base_dir,
+			   const char    *dest_dir,
+			   gboolean       compare_content,
+			   const char    *password,
+			   gboolean       encrypt_header,
+			   FrCompression  compression,
+			   guint          volume_size)
 {
-	GList *scan;
+	SyncDirectoryData *sd_data;
+	GFile             *base;
+	GFile             *dir;
+	char              *relative_dir;
 
-	if (filename == NULL)
-		return FALSE;
+	g_return_if_fail (! archive->read_only);
 
-	for (scan = folder_list; scan; scan = scan->next) {
-		char *folder_in_list = (char*) scan->data;
+	/* the files are compared with stat and read with open, remote
+	 * folders are only updated. */
 
-		if (path_in_path (folder_in_list, filename))
-			return TRUE;
+	if (! uri_is_local (directory) || ! uri_is_local (base_dir)) {
+		fr_archive_add_directory (archive,
+					  directory,
+					  base_dir,
+					  dest_dir,
+					  TRUE,
+					  password,
+					  encrypt_header,
+					  compression,
+					  volume_size);
+		return;
 	}
 
-	return FALSE;
-}
+	sd_data = g_new0 (SyncDirectoryData, 1);
+	sd_data->archive = archive;
+	sd_data->base_dir = g_filename_from_uri (base_dir, NULL, NULL);
+	sd_data->dest_dir = g_strdup (dest_dir);
+	sd_data->dest_prefix = get_sync_path ((dest_dir != NULL) ? dest_dir : "");
+	sd_data->store_folders = archive->command->propAddCanStoreFolders;
+	sd_data->password = g_strdup (password);
+	sd_data->encrypt_header = encrypt_header;
+	sd_data->compression = compression;
+	sd_data->volume_size = volume_size;
+
+	base = g_file_new_for_uri (base_dir);
+	dir = g_file_new_for_uri (directory);
+	relative_dir = g_file_get_relative_path (base, dir);
+	if (relative_dir != NULL)
+		sd_data->scope = build_sync_path (sd_data->dest_prefix, relative_dir);
+	else /* the folder is the base folder */
+		sd_data->scope = g_strdup (sd_data->dest_prefix);
+	g_free (relative_dir);
+	g_object_unref (dir);
+	g_object_unref (base);
+
+	/* the index is saved beside local archives only */
+
+	if (compare_content && g_file_has_uri_scheme (archive->file, "file")) {
+		char *archive_filename = g_file_get_path (archive->file);
+
+		sd_data->index_filename = sync_index_get_filename (archive_filename);
+		sd_data->index = sync_index_load (sd_data->index_filename, archive_filename);
+		g_free (archive_filename);
+	}
 
-static gboolean
-archive_type_has_issues_deleting_non_empty_folders (FrArchive *archive)
-{
-       return ! archive->command->propCanDeleteNonEmptyFolders;
-}
+	g_signal_emit (G_OBJECT (archive),
+		       fr_archive_signals[START],
+		       0,
+		       FR_ACTION_GETTING_FILE_LIST);
+
+	g_directory_list_all_async (directory,
+				    base_dir,
+				    TRUE,
+				    archive->priv->cancellable,
+				    sync_directory__step2,
+				    sd_data);
+}
+
+
+void
+fr_archive_add_items (FrArchive     *archive,
+		      GList         *item_list,
+		      const char    *base_dir,
+		      const char    *dest_dir,
+		      gboolean       update,
+		      const char    *password,
+		      gboolean       encrypt_header,
+		      FrCompression  compression,
+		      guint          volume_size)
+
+{
+	AddDirectoryData *ad_data;
+
+	g_return_if_fail (! archive->read_only);
+
+	ad_data = g_new0 (AddDirectoryData, 1);
+	ad_data->archive = archive;
+	ad_data->base_dir = g_strdup (base_dir);
+	ad_data->dest_dir = g_strdup (dest_dir);
+	ad_data->update = update;
+	ad_data->password = g_strdup (password);
+	ad_data->encrypt_header = encrypt_header;
+	ad_data->compression = compression;
+	ad_data->volume_size = volume_size;
+
+	g_signal_emit (G_OBJECT (archive),
+		       fr_archive_signals[START],
+		       0,
+		       FR_ACTION_GETTING_FILE_LIST);
+
+	g_list_items_async (item_list,
+			    base_dir,
+			    archive->priv->cancellable,
+			    add_directory__step2,
+			    ad_data);
+}
+
+
+/* -- fr_archive_add_dropped_items -- */
+
+
+static gboolean
+all_files_in_same_dir (GList *list)
+{
+	gboolean  same_dir = TRUE;
+	char     *first_basedir;
+	GList    *scan;
+
+	if (list == NULL)
+		return FALSE;
+
+	first_basedir = remove_level_from_path (list->data);
+	if (first_basedir == NULL)
+		return TRUE;
+
+	for (scan = list->next; scan; scan = scan->next) {
+		char *path = scan->data;
+		char *basedir;
+
+		basedir = remove_level_from_path (path);
+		if (basedir == NULL) {
+			same_dir = FALSE;
+			break;
+		}
+
+		if (strcmp (first_basedir, basedir) != 0) {
+			same_dir = FALSE;
+			g_free (basedir);
+			break;
+		}
+		g_free (basedir);
+	}
+	g_free (first_basedir);
+
+	return same_dir;
+}
+
+
+static gboolean
+all_items_are_local (GList *list)
+{
+	GList *scan;
+
+	for (scan = list; scan; scan = scan->next)
+		if (! uri_is_local (scan->data))
+			return FALSE;
+
+	return TRUE;
+}
+
+
+/* returns the items grouped by parent folder, as AddGroup with the folder
+ * and item uris. */
+static GList *
+group_items_by_folder (GList *list)
+{
+	GHashTable *groups_by_folder;
+	GList      *groups = NULL;
+	GList      *scan;
+
+	groups_by_folder = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (scan = list; scan; scan = scan->next) {
+		char     *folder;
+		AddGroup *group;
+
+		folder = remove_level_from_path (scan->data);
+		group = g_hash_table_lookup (groups_by_folder, folder);
+		if (group == NULL) {
+			group = add_group_new (folder, NULL);
+			g_hash_table_insert (groups_by_folder, g_strdup (folder), group);
+			groups = g_list_prepend (groups, group);
+		}
+		group->file_list = g_list_prepend (group->file_list, g_strdup (scan->data));
+		g_free (folder);
+	}
+	g_hash_table_destroy (groups_by_folder);
+
+	return g_list_reverse (groups);
+}
+
+
+static void add_dropped_items__list_next_group (DroppedItemsData *data);
+
+
+static void
+add_dropped_items__group_listed (GList    *file_list,
+				 GList    *dir_list,
+				 GError   *error,
+				 gpointer  user_data)
+{
+	DroppedItemsData *data = user_data;
+	FrArchive        *archive = data->archive;
+	AddGroup         *group = data->current_group->data;
+	char             *local_dir;
+
+	if (error != NULL) {
+		fr_archive_action_completed (archive,
+					     FR_ACTION_GETTING_FILE_LIST,
+					     (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ? FR_PROC_ERROR_STOPPED : FR_PROC_ERROR_GENERIC),
+					     error->message);
+		dropped_items_data_free (archive->priv->dropped_items_data);
+		archive->priv->dropped_items_data = NULL;
+		return;
+	}
+
+	if (archive->command->propAddCanStoreFolders)
+		file_list = g_list_concat (file_list, dir_list);
+	else
+		path_list_free (dir_list);
+
+	/* the group now has the local folder and the paths relative to it */
+
+	local_dir = g_filename_from_uri (group->base_dir, NULL, NULL);
+	if (local_dir == NULL)
+		local_dir = g_strdup ("/");
+	g_free (group->base_dir);
+	group->base_dir = local_dir;
+	path_list_free (group->file_list);
+	group->file_list = file_list;
+
+	data->current_group = data->current_group->next;
+	add_dropped_items__list_next_group (data);
+}
+
+
+static void
+add_dropped_items__list_next_group (DroppedItemsData *data)
+{
+	FrArchive *archive = data->archive;
+
+	if (data->current_group != NULL) {
+		AddGroup *group = data->current_group->data;
+
+		g_list_items_async (group->file_list,
+				    group->base_dir,
+				    archive->priv->cancellable,
+				    add_dropped_items__group_listed,
+				    data);
+		return;
+	}
+
+	fr_archive_action_completed (archive,
+				     FR_ACTION_GETTING_FILE_LIST,
+				     FR_PROC_ERROR_NONE,
+				     NULL);
+
+	g_object_set (archive->command,
+		      "password", data->password,
+		      "encrypt_header", data->encrypt_header,
+		      "compression", data->compression,
+		      "volume_size", data->volume_size,
+		      NULL);
+	fr_process_clear (archive->process);
+	download_remote_listed_archive (archive);
+	add_groups_to_archive (archive, data->groups, data->dest_dir, data->update, FALSE, NULL);
+	fr_process_start (archive->process);
+
+	dropped_items_data_free (archive->priv->dropped_items_data);
+	archive->priv->dropped_items_data = NULL;
+}
+
+
+static void
+add_dropped_items (DroppedItemsData *data)
+{
+	FrArchive *archive = data->archive;
+	GList     *list = data->item_list;
+	GList     *scan;
+
+	if (list == NULL) {
+		dropped_items_data_free (archive->priv->dropped_items_data);
+		archive->priv->dropped_items_data = NULL;
+		fr_archive_action_completed (archive,
+					     FR_ACTION_ADDING_FILES,
+					     FR_PROC_ERROR_NONE,
+					     NULL);
+		return;
+	}
+
+	/* if all files/dirs are in the same directory call fr_archive_add_items... */
+
+	if (all_files_in_same_dir (list)) {
+		char *first_base_dir;
+
+		first_base_dir = remove_level_from_path (list->data);
+		fr_archive_add_items (data->archive,
+				      list,
+				      first_base_dir,
+				      data->dest_dir,
+				      data->update,
+				      data->password,
+				      data->encrypt_header,
+				      data->compression,
+				      data->volume_size);
+		g_free (first_base_dir);
+
+		dropped_items_data_free (archive->priv->dropped_items_data);
+		archive->priv->dropped_items_data = NULL;
+
+		return;
+	}
+
+	/* ...else list the items of each folder and add them all with a
+	 * single rewrite of the archive. */
+
+	if (all_items_are_local (list)) {
+		data->groups = group_items_by_folder (list);
+		data->current_group = data->groups;
+
+		g_signal_emit (G_OBJECT (archive),
+			       fr_archive_signals[START],
+			       0,
+			       FR_ACTION_GETTING_FILE_LIST);
+
+		add_dropped_items__list_next_group (data);
+		return;
+	}
+
+	/* ...else add a directory at a time, remote directories are
+	 * copied locally first. */
+
+	for (scan = list; scan; scan = scan->next) {
+		char *path = scan->data;
+		char *base_dir;
+
+		if (! uri_is_dir (path))
+			continue;
+
+		data->item_list = g_list_remove_link (list, scan);
+		if (data->item_list != NULL)
+			archive->priv->continue_adding_dropped_items = TRUE;
+		base_dir = remove_level_from_path (path);
+
+		fr_archive_add_directory (archive,
+					  file_name_from_path (path),
+					  base_dir,
+					  data->dest_dir,
+					  data->update,
+					  data->password,
+					  data->encrypt_header,
+					  data->compression,
+					  data->volume_size);
+
+		g_free (base_dir);
+		g_free (path);
+
+		return;
+	}
+
+	/* if all files are in the same directory call fr_archive_add_files. */
+
+	if (all_files_in_same_dir (list)) {
+		char  *first_basedir;
+		GList *only_names_list = NULL;
+
+		first_basedir = remove_level_from_path (list->data);
+
+		for (scan = list; scan; scan = scan->next) {
+			char *name;
+
+			name = g_uri_unescape_string (file_name_from_path (scan->data), NULL);
+			only_names_list = g_list_prepend (only_names_list, name);
+		}
+
+		fr_archive_add_files (archive,
+				      only_names_list,
+				      first_basedir,
+				      data->dest_dir,
+				      data->update,
+				      data->password,
+				      data->encrypt_header,
+				      data->compression,
+				      data->volume_size);
+
+		path_list_free (only_names_list);
+		g_free (first_basedir);
+
+		return;
+	}
+
+	/* ...else call fr_command_add for each file.  This is needed to add
+	 * files without path info. FIXME: doesn't work with remote files. */
+
+	fr_archive_stoppable (archive, FALSE);
+	archive->command->creating_archive = (! archive->priv->remote_listing
+					      && ! g_file_query_exists (archive->local_copy, archive->priv->cancellable));
+	g_object_set (archive->command,
+		      "file", archive->local_copy,
+		      "password", data->password,
+		      "encrypt_header", data->encrypt_header,
+		      "compression", data->compression,
+		      "volume_size", data->volume_size,
+		      NULL);
+	fr_process_clear (archive->process);
+	download_remote_listed_archive (archive);
+	fr_command_uncompress (archive->command);
+	for (scan = list; scan; scan = scan->next) {
+		char  *fullpath = scan->data;
+		char  *basedir;
+		GList *singleton;
+
+		basedir = remove_level_from_path (fullpath);
+		singleton = g_list_prepend (NULL, (char*)file_name_from_path (fullpath));
+		fr_command_add (archive->command,
+				NULL,
+				singleton,
+				basedir,
+				data->update,
+				FALSE);
+		g_list_free (singleton);
+		g_free (basedir);
+	}
+	fr_command_recompress (archive->command);
+	fr_process_start (archive->process);
+
+	path_list_free (data->item_list);
+	data->item_list = NULL;
+}
+
+
+void
+fr_archive_add_dropped_items (FrArchive     *archive,
+			      GList         *item_list,
+			      const char    *base_dir,
+			      const char    *dest_dir,
+			      gboolean       update,
+			      const char    *password,
+			      gboolean       encrypt_header,
+			      FrCompression  compression,
+			      guint          volume_size)
+{
+	GList *scan;
+	char  *archive_uri;
+
+	if (archive->read_only) {
+		fr_archive_action_completed (archive,
+					     FR_ACTION_ADDING_FILES,
+					     FR_PROC_ERROR_GENERIC,
+					     ! archive->have_permissions ? _("You don't have the right permissions.") : _("This archive type cannot be modified"));
+		return;
+	}
+
+	/* FIXME: make this check for all the add actions */
+	archive_uri = g_file_get_uri (archive->file);
+	for (scan = item_list; scan; scan = scan->next) {
+		if (uricmp (scan->data, archive_uri) == 0) {
+			g_free (archive_uri);
+			fr_archive_action_completed (archive,
+						     FR_ACTION_ADDING_FILES,
+						     FR_PROC_ERROR_GENERIC,
+						     _("You can't add an archive to itself."));
+			return;
+		}
+	}
+	g_free (archive_uri);
+
+	if (archive->priv->dropped_items_data != NULL)
+		dropped_items_data_free (archive->priv->dropped_items_data);
+	archive->priv->dropped_items_data = dropped_items_data_new (
+						archive,
+				       		item_list,
+				       		base_dir,
+				       		dest_dir,
+				       		update,
+				       		password,
+				       		encrypt_header,
+				       		compression,
+				       		volume_size);
+	add_dropped_items (archive->priv->dropped_items_data);
+}
+
+
+/* -- remove -- */
+
+
+static gboolean
+archive_type_has_issues_deleting_non_empty_folders (FrArchive *archive)
+{
+       return ! archive->command->propCanDeleteNonEmptyFolders;
+}
+
+
+/* Returns the list of the files to pass to the delete command, the
+ * strings are not copied.  file_list == NULL means delete all the files
+ * in the archive. */
+static GList *
+get_files_to_delete (FrArchive *archive,
+		     GList     *file_list)
+{
+	gboolean  file_list_created = FALSE;
+	GList    *tmp_file_list = NULL;
+	gboolean  tmp_file_list_created = FALSE;
+	GList    *scan;
+
+	if (file_list == NULL) {
+		int i;
+
+		for (i = 0; i < archive->command->files->len; i++) {
+			FileData *fdata = g_ptr_array_index (archive->command->files, i);
+			file_list = g_list_prepend (file_list, fdata->original_path);
+		}
+
+		file_list_created = TRUE;
+	}
+
+	if (archive_type_has_issues_deleting_non_empty_folders (archive)) {
+		GList *folders_to_remove;
+
+		/* remove from the list the files contained in folders to be
+		 * removed. */
+
+		folders_to_remove = NULL;
+		for (scan = file_list; scan != NULL; scan = scan->next) {
+			char *path = scan->data;
+
+			if (path[strlen (path) - 1] == '/')
+				folders_to_remove = g_list_prepend (folders_to_remove, path);
+		}
+
+		if (folders_to_remove != NULL) {
+			PathSet *folder_set;
+
+			folder_set = path_set_new (folders_to_remove);
+			tmp_file_list = NULL;
+			for (scan = file_list; scan != NULL; scan = scan->next) {
+				char *path = scan->data;
+
+				if (! path_set_has_folder_of (folder_set, path))
+					tmp_file_list = g_list_prepend (tmp_file_list, path);
+			}
+			tmp_file_list_created = TRUE;
+			path_set_free (folder_set);
+			g_list_free (folders_to_remove);
+		}
+	}
+
+	if (! tmp_file_list_created)
+		tmp_file_list = g_list_copy (file_list);
+
+	if (file_list_created)
+		g_list_free (file_list);
+
+	return tmp_file_list;
+}
+
+
+/* Deletes the files with a single command, each command rewrites the
+ * whole archive.  The names are passed in a list file when the format
+ * supports it, whatever their number, and are split in command lines
+ * only for the other formats or if the list cannot be saved. */
+static void
+delete_from_archive (FrArchive *archive,
+		     GList     *file_list)
+{
+	GList *tmp_file_list;
+	GList *scan;
+
+	tmp_file_list = get_files_to_delete (archive, file_list);
+
+	fr_command_set_n_files (archive->command, g_list_length (tmp_file_list));
+
+	if ((archive->command->propListFromFile || archive->command->propDeleteFromFile)
+	    && (tmp_file_list != NULL))
+	{
+		char *list_dir;
+		char *list_filename;
+
+		if (save_list_to_temp_file (tmp_file_list, &list_dir, &list_filename, NULL)) {
+			fr_command_delete (archive->command,
+					   list_filename,
+					   tmp_file_list);
+			remove_temp_dir (archive, list_dir);
+
+			g_free (list_filename);
+			g_free (list_dir);
+			g_list_free (tmp_file_list);
+
+			return;
+		}
+
+		g_free (list_filename);
+		g_free (list_dir);
+	}
+
+	for (scan = tmp_file_list; scan != NULL; ) {
+		GList *prev = scan->prev;
+		GList *chunk_list;
+		int    l;
+
+		chunk_list = scan;
+		l = 0;
+		while ((scan != NULL) && (l < MAX_CHUNK_LEN)) {
+			if (l == 0)
+				l = strlen (scan->data);
+			prev = scan;
+			scan = scan->next;
+			if (scan != NULL)
+				l += strlen (scan->data);
+		}
+
+		prev->next = NULL;
+		fr_command_delete (archive->command, NULL, chunk_list);
+		prev->next = scan;
+	}
+
+	g_list_free (tmp_file_list);
+}
+
+
+void
+fr_archive_remove_paths (FrArchive     *archive,
+			 PathArray     *paths,
+			 FrCompression  compression)
+{
+	GList *file_list;
+
+	file_list = path_array_to_list (paths);
+	fr_archive_remove (archive, file_list, compression);
+	g_list_free (file_list);
+}
+
+
+void
+fr_archive_remove (FrArchive     *archive,
+		   GList         *file_list,
+		   FrCompression  compression)
+{
+	char *tmp_archive_dir = NULL;
+	char *archive_filename = NULL;
+	char *tmp_archive_filename = NULL;
+
+	g_return_if_fail (archive != NULL);
+
+	if (archive->read_only)
+		return;
+
+	fr_archive_stoppable (archive, TRUE);
+	archive->command->creating_archive = FALSE;
+	g_object_set (archive->command, "compression", compression, NULL);
+
+	download_remote_listed_archive (archive);
+
+	if (can_rewrite_in_one_pass (archive)) {
+		GList *del_list;
+
+		del_list = get_files_to_delete (archive, file_list);
+		rewrite_archive (archive, del_list, NULL, NULL, FALSE);
+		g_list_free (del_list);
+
+		return;
+	}
+
+	tmp_archive_dir = prepare_working_copy (archive,
+						TRUE,
+						&archive_filename,
+						&tmp_archive_filename);
+
+	/* uncompress, delete and recompress */
+
+	fr_command_uncompress (archive->command);
+	delete_from_archive (archive, file_list);
+	fr_command_recompress (archive->command);
+
+	if (tmp_archive_dir != NULL) {
+		/* move the new archive to the original position */
+
+		fr_process_begin_command (archive->process, "mv");
+		fr_process_add_arg (archive->process, "-f");
+		fr_process_add_arg (archive->process, tmp_archive_filename);
+		fr_process_add_arg (archive->process, archive_filename);
+		fr_process_end_command (archive->process);
+
+		/* remove the temp sub-directory */
+
+		fr_process_begin_command (archive->process, "rm");
+		fr_process_set_working_dir (archive->process, g_get_tmp_dir());
+		fr_process_set_sticky (archive->process, TRUE);
+		fr_process_add_arg (archive->process, "-rf");
+		fr_process_add_arg (archive->process, tmp_archive_dir);
+		fr_process_end_command (archive->process);
+	}
+
+	g_free (tmp_archive_filename);
+	g_free (archive_filename);
+	g_free (tmp_archive_dir);
+}
+
+
+/* -- extract -- */
+
+
+static void
+move_files_to_dir (FrArchive  *archive,
+		   GList      *file_list,
+		   const char *source_dir,
+		   const char *dest_dir,
+		   gboolean    overwrite)
+{
+	GList *list;
+	GList *scan;
+
+	/* we prefer mv instead of cp for performance reasons,
+	 * but if the destination folder already exists mv
+	 * doesn't work correctly. (bug #590027) */
+
+	list = g_list_copy (file_list);
+	for (scan = list; scan; /* void */) {
+		GList *next = scan->next;
+		char  *filename = scan->data;
+		char  *basename;
+		char  *destname;
 
+		basename = g_path_get_basename (filename);
+		destname = g_build_filename (dest_dir, basename, NULL);
+		if (g_file_test (destname, G_FILE_TEST_IS_DIR)) {
+			fr_process_begin_command (archive->process, "cp");
+			fr_process_add_arg (archive->process, "-R");
+			if (overwrite)
+				fr_process_add_arg (archive->process, "-f");
+			else
+				fr_process_add_arg (archive->process, "-n");
+			if (filename[0] == '/')
+				fr_process_add_arg_concat (archive->process, source_dir, filename, NULL);
+			else
+				fr_process_add_arg_concat (archive->process, source_dir, "/", filename, NULL);
+			fr_process_add_arg (archive->process, dest_dir);
+			fr_process_end_command (archive->process);
 
-static void
-delete_from_archive (FrArchive *archive,
-		     GList     *file_list)
-{
-	gboolean  file_list_created = FALSE;
-	GList    *tmp_file_list = NULL;
-	gboolean  tmp_file_list_created = FALSE;
-	GList    *scan;
+			list = g_list_remove_link (list, scan);
+			g_list_free (scan);
+		}
 
-	/* file_list == NULL means delete all the files in the archive. */
+		g_free (destname);
+		g_free (basename);
 
-	if (file_list == NULL) {
-		int i;
+		scan = next;
+	}
 
-		for (i = 0; i < archive->command->files->len; i++) {
-			FileData *fdata = g_ptr_array_index (archive->command->files, i);
-			file_list = g_list_prepend (file_list, fdata->original_path);
-		}
+	if (list == NULL)
+		return;
 
-		file_list_created = TRUE;
+	/* 'list' now contains the files that can be moved without problems */
+
+	fr_process_begin_command (archive->process, "mv");
+	if (overwrite)
+		fr_process_add_arg (archive->process, "-f");
+	else
+		fr_process_add_arg (archive->process, "-n");
+	for (scan = list; scan; scan = scan->next) {
+		char *filename = scan->data;
+
+		if (filename[0] == '/')
+			fr_process_add_arg_concat (archive->process, source_dir, filename, NULL);
+		else
+			fr_process_add_arg_concat (archive->process, source_dir, "/", filename, NULL);
 	}
+	fr_process_add_arg (archive->process, dest_dir);
+	fr_process_end_command (archive->process);
 
-	if (archive_type_has_issues_deleting_non_empty_folders (archive)) {
-		GList *folders_to_remove;
+	g_list_free (list);
+}
 
-		/* remove from the list the files contained in folders to be
-		 * removed. */
 
-		folders_to_remove = NULL;
-		for (scan = file_list; scan != NULL; scan = scan->next) {
-			char *path = scan->data;
+/* moves all the files with a single process that renames them, copying
+ * only the ones that cannot be renamed to another file system. */
+static gboolean
+move_files_with_command (FrArchive  *archive,
+			 GList      *file_list,
+			 const char *temp_dir,
+			 const char *dest_dir,
+			 gboolean    overwrite)
+{
+	char  *list_dir = NULL;
+	char  *list_filename = NULL;
+	GList *scan;
 
-			if (path[strlen (path) - 1] == '/')
-				folders_to_remove = g_list_prepend (folders_to_remove, path);
-		}
+	if (! g_file_test (MOVE_FILES_COMMAND, G_FILE_TEST_IS_EXECUTABLE))
+		return FALSE;
 
-		if (folders_to_remove != NULL) {
-			tmp_file_list = NULL;
-			for (scan = file_list; scan != NULL; scan = scan->next) {
-				char *path = scan->data;
+	if ((g_list_length (file_list) > LIST_LENGTH_TO_USE_FILE)
+	    && ! save_list_to_temp_file (file_list, &list_dir, &list_filename, NULL))
+	{
+		return FALSE;
+	}
 
-				if (! file_is_in_subfolder_of (path, folders_to_remove))
-					tmp_file_list = g_list_prepend (tmp_file_list, path);
-			}
-			tmp_file_list_created = TRUE;
-			g_list_free (folders_to_remove);
-		}
+	fr_process_begin_command (archive->process, MOVE_FILES_COMMAND);
+	if (overwrite)
+		fr_process_add_arg (archive->process, "--overwrite");
+	if (list_filename != NULL)
+		fr_process_add_arg_concat (archive->process, "--list=", list_filename, NULL);
+	fr_process_add_arg (archive->process, "--");
+	fr_process_add_arg (archive->process, temp_dir);
+	fr_process_add_arg (archive->process, dest_dir);
+	if (list_filename == NULL)
+		for (scan = file_list; scan; scan = scan->next)
+			fr_process_add_arg (archive->process, scan->data);
+	fr_process_end_command (archive->process);
+
+	if (list_dir != NULL) {
+		/* remove the temp dir */
+
+		fr_process_begin_command (archive->process, "rm");
+		fr_process_set_working_dir (archive->process, g_get_tmp_dir());
+		fr_process_set_sticky (archive->process, TRUE);
+		fr_process_add_arg (archive->process, "-rf");
+		fr_process_add_arg (archive->process, list_dir);
+		fr_process_end_command (archive->process);
 	}
 
-	if (! tmp_file_list_created)
-		tmp_file_list = g_list_copy (file_list);
+	g_free (list_filename);
+	g_free (list_dir);
 
-	if (file_list_created)
-		g_list_free (file_list);
+	return TRUE;
+}
 
-	fr_command_set_n_files (archive->command, g_list_length (tmp_file_list));
 
-	if (archive->command->propListFromFile
-	    && (archive->command->n_files > LIST_LENGTH_TO_USE_FILE))
-	{
-		char *list_dir;
-		char *list_filename;
+static void
+move_files_in_chunks (FrArchive  *archive,
+		      GList      *file_list,
+		      const char *temp_dir,
+		      const char *dest_dir,
+		      gboolean    overwrite)
+{
+	GList *scan;
+	int    temp_dir_l;
 
-		if (save_list_to_temp_file (tmp_file_list, &list_dir, &list_filename, NULL)) {
-			fr_command_delete (archive->command,
-					   list_filename,
-					   tmp_file_list);
+	if (move_files_with_command (archive, file_list, temp_dir, dest_dir, overwrite))
+		return;
 
-			/* remove the temp dir */
+	temp_dir_l = strlen (temp_dir);
 
-			fr_process_begin_command (archive->process, "rm");
-			fr_process_set_working_dir (archive->process, g_get_tmp_dir());
-			fr_process_set_sticky (archive->process, TRUE);
-			fr_process_add_arg (archive->process, "-rf");
-			fr_process_add_arg (archive->process, list_dir);
-			fr_process_end_command (archive->process);
+	for (scan = file_list; scan != NULL; ) {
+		GList *prev = scan->prev;
+		GList *chunk_list;
+		int    l;
+
+		chunk_list = scan;
+		l = 0;
+		while ((scan != NULL) && (l < MAX_CHUNK_LEN)) {
+			if (l == 0)
+				l = temp_dir_l + 1 + strlen (scan->data);
+			prev = scan;
+			scan = scan->next;
+			if (scan != NULL)
+				l += temp_dir_l + 1 + strlen (scan->data);
 		}
 
-		g_free (list_filename);
-		g_free (list_dir);
+		prev->next = NULL;
+		move_files_to_dir (archive, chunk_list, temp_dir, dest_dir, overwrite);
+		prev->next = scan;
 	}
-	else {
-		for (scan = tmp_file_list; scan != NULL; ) {
-			GList *prev = scan->prev;
-			GList *chunk_list;
-			int    l;
+}
 
-			chunk_list = scan;
-			l = 0;
-			while ((scan != NULL) && (l < MAX_CHUNK_LEN)) {
-				if (l == 0)
-					l = strlen (scan->data);
-				prev = scan;
-				scan = scan->next;
-				if (scan != NULL)
-					l += strlen (scan->data);
-			}
 
-			prev->next = NULL;
-			fr_command_delete (archive->command, NULL, chunk_list);
-			prev->next = scan;
-		}
-	}
+static void
+zip_range_process_line (char     *line,
+			gpointer  data)
+{
+	FrCommand *comm = FR_COMMAND (data);
 
-	g_list_free (tmp_file_list);
+	if (line == NULL)
+		return;
+
+	/* the lines are like "  inflating: name" */
+
+	if (comm->n_files != 0) {
+		const char *name = strstr (line, ": ");
+		fr_command_file_progress (comm, (name != NULL) ? name + 2 : NULL);
+	}
+	else
+		fr_command_message (comm, line);
 }
 
 
-void
-fr_archive_remove (FrArchive     *archive,
-		   GList         *file_list,
-		   FrCompression  compression)
+/* extracts the entries of an archive listed with read_remote_zip_index()
+ * reading only their data from the remote file. */
+static void
+extract_from_remote_archive (FrArchive  *archive,
+			     GList      *file_list,
+			     const char *dest_dir,
+			     gboolean    overwrite,
+			     gboolean    skip_older,
+			     gboolean    junk_paths)
 {
-	char *tmp_archive_dir = NULL;
-	char *archive_filename = NULL;
-	char *tmp_archive_filename = NULL;
+	char  *uri;
+	char  *list_dir = NULL;
+	char  *list_filename = NULL;
+	GList *scan;
 
-	g_return_if_fail (archive != NULL);
+	if (g_list_length (file_list) > LIST_LENGTH_TO_USE_FILE)
+		save_list_to_temp_file (file_list, &list_dir, &list_filename, NULL);
 
-	if (archive->read_only)
-		return;
+	uri = g_file_get_uri (archive->file);
 
-	fr_archive_stoppable (archive, TRUE);
-	archive->command->creating_archive = FALSE;
-	g_object_set (archive->command, "compression", compression, NULL);
+	fr_command_progress (archive->command, -1.0);
+	archive->command->action = FR_ACTION_EXTRACTING_FILES;
+	fr_process_set_out_line_func (archive->process, zip_range_process_line, archive->command);
+	fr_process_set_err_line_func (archive->process, NULL, NULL);
+	fr_process_begin_command (archive->process, ZIP_RANGE_COMMAND);
+	fr_process_add_arg_concat (archive->process, "--extract=", dest_dir, NULL);
+	if (overwrite)
+		fr_process_add_arg (archive->process, "--overwrite");
+	if (skip_older)
+		fr_process_add_arg (archive->process, "--skip-older");
+	if (junk_paths)
+		fr_process_add_arg (archive->process, "--junk-paths");
+	if (list_filename != NULL)
+		fr_process_add_arg_concat (archive->process, "--list=", list_filename, NULL);
+	fr_process_add_arg (archive->process, "--");
+	fr_process_add_arg (archive->process, uri);
+	if (list_filename == NULL)
+		for (scan = file_list; scan; scan = scan->next)
+			fr_process_add_arg (archive->process, scan->data);
+	fr_process_end_command (archive->process);
 
-	/* create the new archive in a temporary sub-directory, this allows
-	 * to cancel the operation without losing the original archive and
-	 * removing possible temporary files created by the command. */
+	if (list_dir != NULL) {
+		fr_process_begin_command (archive->process, "rm");
+		fr_process_set_working_dir (archive->process, g_get_tmp_dir());
+		fr_process_set_sticky (archive->process, TRUE);
+		fr_process_add_arg (archive->process, "-rf");
+		fr_process_add_arg (archive->process, list_dir);
+		fr_process_end_command (archive->process);
+	}
 
-	{
-		GFile *local_copy_parent;
-		char  *archive_dir;
-		GFile *tmp_file;
+	g_free (uri);
+	g_free (list_filename);
+	g_free (list_dir);
+}
 
-		/* create the new archive in a sub-folder of the original
-		 * archive this way the 'mv' command is fast. */
 
-		local_copy_parent = g_file_get_parent (archive->local_copy);
-		archive_dir = g_file_get_path (local_copy_parent);
-		tmp_archive_dir = get_temp_work_dir (archive_dir);
-		archive_filename = g_file_get_path (archive->local_copy);
-		tmp_archive_filename = g_build_filename (tmp_archive_dir, file_name_from_path (archive_filename), NULL);
-		tmp_file = g_file_new_for_path (tmp_archive_filename);
-		g_object_set (archive->command, "file", tmp_file, NULL);
+/* -- extract_in_parallel -- */
 
-		if (! archive->command->creating_archive) {
-			/* copy the original archive to the new position */
 
-			fr_process_begin_command (archive->process, "cp");
-			fr_process_add_arg (archive->process, "-f");
-			fr_process_add_arg (archive->process, archive_filename);
-			fr_process_add_arg (archive->process, tmp_archive_filename);
-			fr_process_end_command (archive->process);
-		}
+typedef struct {
+	GList   *file_list;
+	goffset  size;
+	gsize    length;         /* length of the names in file_list */
+	char    *list_dir;
+	char    *list_filename;
+	GList  **rounds;         /* file_list split in command lines */
+} ExtractShard;
+
+
+static int
+compare_file_data_by_size (gconstpointer a,
+			   gconstpointer b)
+{
+	const FileData *fdata_a = *((FileData **) a);
+	const FileData *fdata_b = *((FileData **) b);
+
+	if (fdata_a->size == fdata_b->size)
+		return 0;
+
+	return (fdata_a->size > fdata_b->size) ? -1 : 1;
+}
 
-		g_object_unref (tmp_file);
-		g_free (archive_dir);
-		g_object_unref (local_copy_parent);
+
+/* the folders that contain other entries, they are created when their
+ * content is extracted. */
+static GHashTable *
+get_non_empty_dirs (FrCommand *command)
+{
+	GHashTable *dirs;
+	guint       i;
+
+	dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; i < command->files->len; i++) {
+		FileData *fdata = g_ptr_array_index (command->files, i);
+		char     *path;
+		char     *sep;
+
+		path = g_strdup (fdata->full_path);
+		while (((sep = strrchr (path, '/')) != NULL) && (sep != path)) {
+			*sep = 0;
+			if (sep[1] == 0)
+				continue; /* the ending separator of a folder */
+			if (g_hash_table_contains (dirs, path))
+				break;
+			g_hash_table_add (dirs, g_strdup (path));
+		}
+		g_free (path);
 	}
 
-	/* uncompress, delete and recompress */
+	return dirs;
+}
 
-	fr_command_uncompress (archive->command);
-	delete_from_archive (archive, file_list);
-	fr_command_recompress (archive->command);
 
-	/* move the new archive to the original position */
+static gboolean
+is_non_empty_dir (GHashTable *non_empty_dirs,
+		  FileData   *fdata)
+{
+	char     *path;
+	gsize     len;
+	gboolean  result;
 
-	fr_process_begin_command (archive->process, "mv");
-	fr_process_add_arg (archive->process, "-f");
-	fr_process_add_arg (archive->process, tmp_archive_filename);
-	fr_process_add_arg (archive->process, archive_filename);
-	fr_process_end_command (archive->process);
+	if (! fdata->dir)
+		return FALSE;
+
+	path = g_strdup (fdata->full_path);
+	len = strlen (path);
+	while ((len > 1) && (path[len - 1] == '/'))
+		path[--len] = 0;
+	result = g_hash_table_contains (non_empty_dirs, path);
+	g_free (path);
+
+	return result;
+}
+
+
+/* Returns the entries to extract, each one once, or NULL when a folder
+ * of file_list must be extracted along with its content: the extractors
+ * extract it recursively so it cannot be split between them. */
+static GPtrArray *
+get_entries_to_extract (FrArchive *archive,
+			GList     *file_list)
+{
+	FrCommand  *command = archive->command;
+	GHashTable *non_empty_dirs;
+	GHashTable *entries_by_path;
+	GPtrArray  *entries;
+	GList      *scan;
+	guint       i;
+
+	non_empty_dirs = get_non_empty_dirs (command);
+	entries_by_path = g_hash_table_new (g_str_hash, g_str_equal);
+	entries = g_ptr_array_new ();
+
+	if (file_list == NULL) {
+		for (i = 0; i < command->files->len; i++) {
+			FileData *fdata = g_ptr_array_index (command->files, i);
+
+			if (is_non_empty_dir (non_empty_dirs, fdata)
+			    || g_hash_table_contains (entries_by_path, fdata->original_path))
+				continue;
+			g_hash_table_add (entries_by_path, fdata->original_path);
+			g_ptr_array_add (entries, fdata);
+		}
+	}
+	else {
+		for (i = 0; i < command->files->len; i++) {
+			FileData *fdata = g_ptr_array_index (command->files, i);
+			g_hash_table_insert (entries_by_path, fdata->original_path, fdata);
+		}
+
+		for (scan = file_list; scan; scan = scan->next) {
+			FileData *fdata;
+
+			if (! g_hash_table_lookup_extended (entries_by_path, scan->data, NULL, (gpointer *) &fdata)
+			    || ((fdata != NULL) && is_non_empty_dir (non_empty_dirs, fdata)))
+			{
+				g_ptr_array_free (entries, TRUE);
+				entries = NULL;
+				break;
+			}
 
-	/* remove the temp sub-directory */
+			if (fdata == NULL)
+				continue; /* listed twice */
+			g_hash_table_insert (entries_by_path, fdata->original_path, NULL);
+			g_ptr_array_add (entries, fdata);
+		}
+	}
 
-	fr_process_begin_command (archive->process, "rm");
-	fr_process_set_working_dir (archive->process, g_get_tmp_dir());
-	fr_process_set_sticky (archive->process, TRUE);
-	fr_process_add_arg (archive->process, "-rf");
-	fr_process_add_arg (archive->process, tmp_archive_dir);
-	fr_process_end_command (archive->process);
+	g_hash_table_destroy (entries_by_path);
+	g_hash_table_destroy (non_empty_dirs);
 
-	g_free (tmp_archive_filename);
-	g_free (archive_filename);
-	g_free (tmp_archive_dir);
+	return entries;
 }
 
 
-/* -- extract -- */
-
-
+/* splits the names of the shard in n_rounds lists of about the same
+ * length, each one given to a command. */
 static void
-move_files_to_dir (FrArchive  *archive,
-		   GList      *file_list,
-		   const char *source_dir,
-		   const char *dest_dir,
-		   gboolean    overwrite)
+split_shard_in_rounds (ExtractShard *shard,
+		       guint         n_rounds)
 {
-	GList *list;
+	gsize  round_length;
+	gsize  l = 0;
 	GList *scan;
+	guint  i;
+
+	round_length = shard->length / n_rounds + 1;
+	shard->rounds = g_new0 (GList *, n_rounds);
+	for (scan = shard->file_list; scan; scan = scan->next) {
+		i = MIN (l / round_length, n_rounds - 1);
+		shard->rounds[i] = g_list_prepend (shard->rounds[i], scan->data);
+		l += strlen (scan->data) + 1;
+	}
+	for (i = 0; i < n_rounds; i++)
+		shard->rounds[i] = g_list_reverse (shard->rounds[i]);
+}
 
-	/* we prefer mv instead of cp for performance reasons,
-	 * but if the destination folder already exists mv
-	 * doesn't work correctly. (bug #590027) */
 
-	list = g_list_copy (file_list);
-	for (scan = list; scan; /* void */) {
-		GList *next = scan->next;
-		char  *filename = scan->data;
-		char  *basename;
-		char  *destname;
+/* Queues the commands that create the folders of dest_dir where the
+ * entries are extracted.  The extractors of the shards would otherwise
+ * create the same folders at the same time, and unzip gives up an entry
+ * when a folder appears between its stat() and its mkdir(). */
+static void
+create_destination_folders (FrArchive  *archive,
+			    GPtrArray  *entries,
+			    const char *dest_dir)
+{
+	GHashTable     *folders;
+	GHashTableIter  iter;
+	gpointer        key;
+	gsize           length = 0;
+	gboolean        started = FALSE;
+	guint           i;
+
+	folders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; i < entries->len; i++) {
+		FileData   *fdata = g_ptr_array_index (entries, i);
+		const char *path = fdata->original_path;
+		const char *end;
+
+		end = path + strlen (path);
+		if ((end > path) && (*(end - 1) == '/'))
+			end--;
+		if (! fdata->dir)
+			while ((end > path) && (*(end - 1) != '/'))
+				end--;
+		while ((end > path) && (*(end - 1) == '/'))
+			end--;
+		if (end > path)
+			g_hash_table_add (folders, g_strndup (path, end - path));
+	}
 
-		basename = g_path_get_basename (filename);
-		destname = g_build_filename (dest_dir, basename, NULL);
-		if (g_file_test (destname, G_FILE_TEST_IS_DIR)) {
-			fr_process_begin_command (archive->process, "cp");
-			fr_process_add_arg (archive->process, "-R");
-			if (overwrite)
-				fr_process_add_arg (archive->process, "-f");
-			else
-				fr_process_add_arg (archive->process, "-n");
-			if (filename[0] == '/')
-				fr_process_add_arg_concat (archive->process, source_dir, filename, NULL);
-			else
-				fr_process_add_arg_concat (archive->process, source_dir, "/", filename, NULL);
-			fr_process_add_arg (archive->process, dest_dir);
-			fr_process_end_command (archive->process);
+	g_hash_table_iter_init (&iter, folders);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		char *folder = g_build_filename (dest_dir, (char *) key, NULL);
 
-			list = g_list_remove_link (list, scan);
-			g_list_free (scan);
+		if (started && (length + strlen (folder) + 1 > MAX_CHUNK_LEN)) {
+			fr_process_end_command (archive->process);
+			started = FALSE;
 		}
-
-		g_free (destname);
-		g_free (basename);
-
-		scan = next;
+		if (! started) {
+			fr_process_begin_command (archive->process, "mkdir");
+			fr_process_add_arg (archive->process, "-p");
+			fr_process_add_arg (archive->process, "--");
+			started = TRUE;
+			length = 0;
+		}
+		fr_process_add_arg (archive->process, folder);
+		length += strlen (folder) + 1;
+		g_free (folder);
 	}
+	if (started)
+		fr_process_end_command (archive->process);
 
-	if (list == NULL)
-		return;
+	g_hash_table_destroy (folders);
+}
 
-	/* 'list' now contains the files that can be moved without problems */
 
-	fr_process_begin_command (archive->process, "mv");
-	if (overwrite)
-		fr_process_add_arg (archive->process, "-f");
-	else
-		fr_process_add_arg (archive->process, "-n");
-	for (scan = list; scan; scan = scan->next) {
-		char *filename = scan->data;
+/* Splits the files between several extractors that write to dest_dir at
+ * the same time, for the formats that can read each file without
+ * decompressing the others.  The largest remaining file goes to the
+ * extractor with less data, so that they end at about the same time.
+ * Returns FALSE if the files must be extracted by a single process. */
+static gboolean
+extract_in_parallel (FrArchive  *archive,
+		     GList      *file_list,
+		     const char *dest_dir,
+		     gboolean    overwrite,
+		     gboolean    skip_older,
+		     gboolean    junk_paths)
+{
+	FrCommand    *command = archive->command;
+	GPtrArray    *entries;
+	ExtractShard *shards;
+	goffset       total_size = 0;
+	guint         n_shards;
+	guint         n_rounds = 1;
+	guint         i, j;
+	gboolean      result = TRUE;
+
+	/* with junk_paths two files can have the same destination, one
+	 * process must extract both to keep the overwrite order. */
+
+	if ((archive->priv->extract_jobs < 2)
+	    || ! command->propExtractRandomAccess
+	    || command->solid
+	    || junk_paths)
+	{
+		return FALSE;
+	}
 
-		if (filename[0] == '/')
-			fr_process_add_arg_concat (archive->process, source_dir, filename, NULL);
-		else
-			fr_process_add_arg_concat (archive->process, source_dir, "/", filename, NULL);
+	entries = get_entries_to_extract (archive, file_list);
+	if (entries == NULL)
+		return FALSE;
+
+	for (i = 0; i < entries->len; i++) {
+		FileData *fdata = g_ptr_array_index (entries, i);
+		total_size += fdata->size;
 	}
-	fr_process_add_arg (archive->process, dest_dir);
-	fr_process_end_command (archive->process);
 
-	g_list_free (list);
-}
+	n_shards = MIN (archive->priv->extract_jobs, entries->len);
+	n_shards = MIN (n_shards, total_size / MIN_EXTRACT_SHARD_SIZE);
+	if (n_shards < 2) {
+		g_ptr_array_free (entries, TRUE);
+		return FALSE;
+	}
 
+	g_ptr_array_sort (entries, compare_file_data_by_size);
+	shards = g_new0 (ExtractShard, n_shards);
+	for (i = 0; i < entries->len; i++) {
+		FileData     *fdata = g_ptr_array_index (entries, i);
+		ExtractShard *shard = &shards[0];
 
-static void
-move_files_in_chunks (FrArchive  *archive,
-		      GList      *file_list,
-		      const char *temp_dir,
-		      const char *dest_dir,
-		      gboolean    overwrite)
-{
-	GList *scan;
-	int    temp_dir_l;
+		for (j = 1; j < n_shards; j++)
+			if (shards[j].size < shard->size)
+				shard = &shards[j];
 
-	temp_dir_l = strlen (temp_dir);
+		shard->file_list = g_list_prepend (shard->file_list, fdata->original_path);
+		shard->size += fdata->size;
+		shard->length += strlen (fdata->original_path) + 1;
+	}
 
-	for (scan = file_list; scan != NULL; ) {
-		GList *prev = scan->prev;
-		GList *chunk_list;
-		int    l;
+	/* the long lists are written to a file, otherwise the names of a
+	 * shard are split in rounds of commands whose command line is not
+	 * too long: the shards run a round at a time, the files of each
+	 * shard are split between the rounds so that they end at about the
+	 * same time. */
+
+	for (j = 0; result && (j < n_shards); j++) {
+		if (command->propListFromFile
+		    && (g_list_length (shards[j].file_list) > LIST_LENGTH_TO_USE_FILE))
+		{
+			result = save_list_to_temp_file (shards[j].file_list, &shards[j].list_dir, &shards[j].list_filename, NULL);
+		}
+		else
+			n_rounds = MAX (n_rounds, shards[j].length / (MAX_CHUNK_LEN / 2) + 1);
+	}
 
-		chunk_list = scan;
-		l = 0;
-		while ((scan != NULL) && (l < MAX_CHUNK_LEN)) {
-			if (l == 0)
-				l = temp_dir_l + 1 + strlen (scan->data);
-			prev = scan;
-			scan = scan->next;
-			if (scan != NULL)
-				l += temp_dir_l + 1 + strlen (scan->data);
+	if (result) {
+		debug (DEBUG_INFO, "extracting with %u processes, %u rounds\n", n_shards, n_rounds);
+		create_destination_folders (archive, entries, dest_dir);
+
+		for (j = 0; j < n_shards; j++)
+			if (shards[j].list_filename == NULL)
+				split_shard_in_rounds (&shards[j], n_rounds);
+
+		for (i = 0; i < n_rounds; i++) {
+			for (j = 0; j < n_shards; j++) {
+				GList *chunk;
+
+				if (shards[j].list_filename != NULL) {
+					if (i > 0)
+						continue;
+					chunk = shards[j].file_list;
+				}
+				else
+					chunk = shards[j].rounds[i];
+
+				if (chunk == NULL)
+					continue;
+
+				fr_command_extract (command,
+						    shards[j].list_filename,
+						    chunk,
+						    dest_dir,
+						    overwrite,
+						    skip_older,
+						    junk_paths);
+				fr_process_set_parallel_group (archive->process, i);
+			}
 		}
+	}
 
-		prev->next = NULL;
-		move_files_to_dir (archive, chunk_list, temp_dir, dest_dir, overwrite);
-		prev->next = scan;
+	for (j = 0; j < n_shards; j++) {
+		if (shards[j].list_dir != NULL) {
+			if (result) {
+				/* remove the temp dir */
+
+				fr_process_begin_command (archive->process, "rm");
+				fr_process_set_working_dir (archive->process, g_get_tmp_dir());
+				fr_process_set_sticky (archive->process, TRUE);
+				fr_process_add_arg (archive->process, "-rf");
+				fr_process_add_arg (archive->process, shards[j].list_dir);
+				fr_process_end_command (archive->process);
+			}
+			else
+				remove_local_directory (shards[j].list_dir);
+		}
+		if (shards[j].rounds != NULL) {
+			for (i = 0; i < n_rounds; i++)
+				g_list_free (shards[j].rounds[i]);
+			g_free (shards[j].rounds);
+		}
+		g_list_free (shards[j].file_list);
+		g_free (shards[j].list_dir);
+		g_free (shards[j].list_filename);
 	}
+	g_free (shards);
+	g_ptr_array_free (entries, TRUE);
+
+	return result;
 }
 
 
@@ -2818,8 +4891,16 @@ extract_from_archive (FrArchive  *archive,
 	FrCommand *command = archive->command;
 	GList     *scan;
 
+	if (archive->priv->remote_listing) {
+		extract_from_remote_archive (archive, file_list, dest_dir, overwrite, skip_older, junk_paths);
+		return;
+	}
+
 	g_object_set (command, "password", password, NULL);
 
+	if (extract_in_parallel (archive, file_list, dest_dir, overwrite, skip_older, junk_paths))
+		return;
+
 	if (file_list == NULL) {
 		fr_command_extract (command,
 				    NULL,
@@ -2990,71 +5071,76 @@ archive_type_has_issues_extracting_non_empty_folders (FrArchive *archive)
 }
 
 
-static gboolean
-file_list_contains_files_in_this_dir (GList      *file_list,
-				      const char *dirname)
-{
-	GList *scan;
+static guint64 get_extraction_size (FrArchive *archive, PathArray *paths);
 
-	for (scan = file_list; scan; scan = scan->next) {
-		char *filename = scan->data;
 
-		if (path_in_path (dirname, filename))
-			return TRUE;
-	}
+typedef struct {
+	FileData   *fdata;      /* NULL if the file is skipped */
+	const char *dest_path;  /* relative to the destination */
+	guint       index;      /* in the selection */
+} ExtractCandidate;
 
-	return FALSE;
+
+static int
+compare_extract_candidates (const void *a,
+			    const void *b)
+{
+	return strcmp (((const ExtractCandidate *) a)->dest_path, ((const ExtractCandidate *) b)->dest_path);
 }
 
 
-static GList*
-remove_files_contained_in_this_dir (GList *file_list,
-				    GList *dir_pointer)
+static int
+compare_extract_candidates_by_index (const void *a,
+				     const void *b)
 {
-	char  *dirname = dir_pointer->data;
-	int    dirname_l = strlen (dirname);
-	GList *scan;
+	guint index_a = ((const ExtractCandidate *) a)->index;
+	guint index_b = ((const ExtractCandidate *) b)->index;
 
-	for (scan = dir_pointer->next; scan; /* empty */) {
-		char *filename = scan->data;
-
-		if (strncmp (dirname, filename, dirname_l) != 0)
-			break;
+	return (index_a > index_b) - (index_a < index_b);
+}
 
-		if (path_in_path (dirname, filename)) {
-			GList *next = scan->next;
 
-			file_list = g_list_remove_link (file_list, scan);
-			g_list_free (scan);
+/* returns the paths of all the files of the archive, the strings are
+ * the original_path of the FileData, not copies. */
+static PathArray *
+get_all_paths (FrArchive *archive)
+{
+	PathArray *paths;
+	int        i;
 
-			scan = next;
-		}
-		else
-			scan = scan->next;
+	paths = path_array_new (archive->command->files->len);
+	for (i = 0; i < archive->command->files->len; i++) {
+		FileData *fdata = g_ptr_array_index (archive->command->files, i);
+		path_array_add (paths, fdata->original_path);
 	}
 
-	return file_list;
+	return paths;
 }
 
 
 void
-fr_archive_extract_to_local (FrArchive  *archive,
-			     GList      *file_list,
-			     const char *destination,
-			     const char *base_dir,
-			     gboolean    skip_older,
-			     gboolean    overwrite,
-			     gboolean    junk_paths,
-			     const char *password)
+fr_archive_extract_paths_to_local (FrArchive  *archive,
+				   PathArray  *paths,
+				   const char *destination,
+				   const char *base_dir,
+				   gboolean    skip_older,
+				   gboolean    overwrite,
+				   gboolean    junk_paths,
+				   const char *password)
 {
-	GList    *filtered;
-	GList    *scan;
-	gboolean  extract_all;
-	gboolean  use_base_dir;
-	gboolean  all_options_supported;
-	gboolean  move_to_dest_dir;
-	gboolean  file_list_created = FALSE;
-g_print("dest: %s\n", destination);
+	PathArray *filtered;
+	GList     *filtered_list;
+	gboolean   extract_all;
+	gboolean   use_base_dir;
+	gboolean   all_options_supported;
+	gboolean   move_to_dest_dir;
+	PathSet   *file_set = NULL;
+	ExtractCandidate *candidates;
+	guint      n_candidates;
+	gboolean   emulate_skip_older;
+	gboolean   emulate_no_overwrite;
+	guint      i;
+
 	g_return_if_fail (archive != NULL);
 
 	fr_archive_stoppable (archive, TRUE);
@@ -3072,50 +5158,40 @@ g_print("dest: %s\n", destination);
 				 && ! (skip_older && ! archive->command->propExtractCanSkipOlder)
 				 && ! (junk_paths && ! archive->command->propExtractCanJunkPaths));
 
-	extract_all = (file_list == NULL);
-	if (extract_all && (! all_options_supported || ! archive->command->propCanExtractAll)) {
-		int i;
-
-		file_list = NULL;
-		for (i = 0; i < archive->command->files->len; i++) {
-			FileData *fdata = g_ptr_array_index (archive->command->files, i);
-			file_list = g_list_prepend (file_list, g_strdup (fdata->original_path));
-		}
-		file_list_created = TRUE;
-	}
+	extract_all = (paths == NULL);
+	if (extract_all && (! all_options_supported || ! archive->command->propCanExtractAll))
+		paths = get_all_paths (archive);
+	else if (paths != NULL)
+		path_array_ref (paths);
 
-	if (extract_all && (file_list == NULL))
+	if (paths == NULL)
 		fr_command_set_n_files (archive->command, archive->command->n_regular_files);
 	else
-		fr_command_set_n_files (archive->command, g_list_length (file_list));
+		fr_command_set_n_files (archive->command, paths->len);
+	fr_command_set_n_bytes (archive->command, get_extraction_size (archive, extract_all ? NULL : paths));
 
 	if (all_options_supported) {
-		gboolean created_filtered_list = FALSE;
-
-		if (! extract_all && archive_type_has_issues_extracting_non_empty_folders (archive)) {
-			created_filtered_list = TRUE;
-			filtered = g_list_copy (file_list);
-			filtered = g_list_sort (filtered, (GCompareFunc) strcmp);
-			for (scan = filtered; scan; scan = scan->next)
-				filtered = remove_files_contained_in_this_dir (filtered, scan);
-		}
+		if (paths == NULL)
+			filtered = NULL;
+		else if (! extract_all && archive_type_has_issues_extracting_non_empty_folders (archive))
+			filtered = path_array_remove_contained (paths);
 		else
-			filtered = file_list;
+			filtered = path_array_ref (paths);
 
-		if (! (created_filtered_list && (filtered == NULL)))
+		if ((filtered == NULL) || (filtered->len > 0)) {
+			filtered_list = path_array_to_list (filtered);
 			extract_from_archive (archive,
-					      filtered,
+					      filtered_list,
 					      destination,
 					      overwrite,
 					      skip_older,
 					      junk_paths,
 					      password);
+			g_list_free (filtered_list);
+		}
 
-		if (created_filtered_list && (filtered != NULL))
-			g_list_free (filtered);
-
-		if (file_list_created)
-			path_list_free (file_list);
+		path_array_unref (filtered);
+		path_array_unref (paths);
 
 		return;
 	}
@@ -3126,81 +5202,94 @@ g_print("dest: %s\n", destination);
 			    || ((junk_paths
 				 && ! archive->command->propExtractCanJunkPaths)));
 
-	if (extract_all && ! file_list_created) {
-		int i;
-
-		file_list = NULL;
-		for (i = 0; i < archive->command->files->len; i++) {
-			FileData *fdata = g_ptr_array_index (archive->command->files, i);
-			file_list = g_list_prepend (file_list, g_strdup (fdata->original_path));
-		}
+	if (archive_type_has_issues_extracting_non_empty_folders (archive))
+		file_set = path_set_new_for_array (paths);
 
-		file_list_created = TRUE;
-	}
+	/* get the files to extract and their path in the destination. */
 
-	filtered = NULL;
-	for (scan = file_list; scan; scan = scan->next) {
+	candidates = g_new (ExtractCandidate, paths->len);
+	n_candidates = 0;
+	for (i = 0; i < paths->len; i++) {
 		FileData   *fdata;
-		char       *archive_list_filename = scan->data;
-		char        dest_filename[4096];
+		const char *archive_list_filename = path_array_index (paths, i);
 		const char *filename;
 
-        fdata = find_file_in_archive (archive, archive_list_filename);
-g_print("  fn: %s, p:%p\n", archive_list_filename, fdata);
+		fdata = find_file_in_archive (archive, archive_list_filename);
 		if (fdata == NULL)
 			continue;
 
-		if (archive_type_has_issues_extracting_non_empty_folders (archive)
+		if ((file_set != NULL)
 		    && fdata->dir
-		    && file_list_contains_files_in_this_dir (file_list, archive_list_filename))
+		    && path_set_has_content_of (file_set, archive_list_filename))
 			continue;
 
-		/* get the destination file path. */
-
 		if (! junk_paths)
 			filename = archive_list_filename;
 		else
 			filename = file_name_from_path (archive_list_filename);
+		while (filename[0] == '/')
+			filename++;
 
-		if ((destination[strlen (destination) - 1] == '/')
-		    || (filename[0] == '/'))
-			sprintf (dest_filename, "%s%s", destination, filename);
-		else
-			sprintf (dest_filename, "%s/%s", destination, filename);
+		candidates[n_candidates].fdata = fdata;
+		candidates[n_candidates].dest_path = filename;
+		candidates[n_candidates].index = i;
+		n_candidates++;
+	}
 
-		/*debug (DEBUG_INFO, "-> %s\n", dest_filename);*/
-g_print("dest fn: %s\n", dest_filename);
-		/**/
+	path_set_free (file_set);
 
-		if (! archive->command->propExtractCanSkipOlder
-		    && skip_older
-		    && g_file_test (dest_filename, G_FILE_TEST_EXISTS)
-		    && (fdata->modified < get_file_mtime_for_path (dest_filename)))
-			continue;
+	/* skip the files present in the destination, the destination folders
+	 * are listed once instead of looking up each file, as most of them
+	 * usually don't exist. */
 
-		if (! archive->command->propExtractCanAvoidOverwrite
-		    && ! overwrite
-		    && g_file_test (dest_filename, G_FILE_TEST_EXISTS))
-			continue;
+	emulate_skip_older = (skip_older && ! archive->command->propExtractCanSkipOlder);
+	emulate_no_overwrite = (! overwrite && ! archive->command->propExtractCanAvoidOverwrite);
 
-		filtered = g_list_prepend (filtered, fdata->original_path);
+	if ((emulate_skip_older || emulate_no_overwrite) && (n_candidates > 0)) {
+		FileStat *files;
+
+		qsort (candidates, n_candidates, sizeof (ExtractCandidate), compare_extract_candidates);
+		files = g_new0 (FileStat, n_candidates);
+		for (i = 0; i < n_candidates; i++)
+			files[i].path = candidates[i].dest_path;
+		stat_files_listed (destination, files, n_candidates, emulate_skip_older && ! emulate_no_overwrite);
+
+		for (i = 0; i < n_candidates; i++) {
+			if (! files[i].exists)
+				continue;
+			if (emulate_no_overwrite
+			    || (candidates[i].fdata->modified < files[i].mtime))
+				candidates[i].fdata = NULL;
+		}
+		g_free (files);
+
+		/* keep the order of the selection */
+		qsort (candidates, n_candidates, sizeof (ExtractCandidate), compare_extract_candidates_by_index);
 	}
 
-	if (filtered == NULL) {
+	filtered = path_array_new (n_candidates);
+	for (i = 0; i < n_candidates; i++)
+		if (candidates[i].fdata != NULL)
+			path_array_add (filtered, candidates[i].fdata->original_path);
+	g_free (candidates);
+
+	if (filtered->len == 0) {
 		/* all files got filtered, do nothing. */
 		debug (DEBUG_INFO, "All files got filtered, nothing to do.\n");
 
-		if (extract_all)
-			path_list_free (file_list);
+		path_array_unref (filtered);
+		path_array_unref (paths);
 		return;
 	}
 
+	filtered_list = path_array_to_list (filtered);
+
 	if (move_to_dest_dir) {
 		char *temp_dir;
 
 		temp_dir = get_temp_work_dir (destination);
 		extract_from_archive (archive,
-				      filtered,
+				      filtered_list,
 				      temp_dir,
 				      overwrite,
 				      skip_older,
@@ -3208,13 +5297,13 @@ g_print("dest fn: %s\n", dest_filename);
 				      password);
 
 		if (use_base_dir) {
-			GList *tmp_list = compute_list_base_path (base_dir, filtered, junk_paths, archive->command->propExtractCanJunkPaths);
-			g_list_free (filtered);
-			filtered = tmp_list;
+			GList *tmp_list = compute_list_base_path (base_dir, filtered_list, junk_paths, archive->command->propExtractCanJunkPaths);
+			g_list_free (filtered_list);
+			filtered_list = tmp_list;
 		}
 
 		move_files_in_chunks (archive,
-				      filtered,
+				      filtered_list,
 				      temp_dir,
 				      destination,
 				      overwrite);
@@ -3230,65 +5319,177 @@ g_print("dest fn: %s\n", dest_filename);
 	}
 	else
 		extract_from_archive (archive,
-				      filtered,
+				      filtered_list,
 				      destination,
 				      overwrite,
 				      skip_older,
 				      junk_paths,
 				      password);
 
-	if (filtered != NULL)
-		g_list_free (filtered);
-	if (file_list_created)
-		path_list_free (file_list);
+	g_list_free (filtered_list);
+	path_array_unref (filtered);
+	path_array_unref (paths);
 }
 
 
 void
-fr_archive_extract (FrArchive  *archive,
-		    GList      *file_list,
-		    const char *destination,
-		    const char *base_dir,
-		    gboolean    skip_older,
-		    gboolean    overwrite,
-		    gboolean    junk_paths,
-		    const char *password)
+fr_archive_extract_to_local (FrArchive  *archive,
+			     GList      *file_list,
+			     const char *destination,
+			     const char *base_dir,
+			     gboolean    skip_older,
+			     gboolean    overwrite,
+			     gboolean    junk_paths,
+			     const char *password)
+{
+	PathArray *paths = NULL;
+
+	if (file_list != NULL)
+		paths = path_array_new_from_list (file_list);
+	fr_archive_extract_paths_to_local (archive,
+					   paths,
+					   destination,
+					   base_dir,
+					   skip_older,
+					   overwrite,
+					   junk_paths,
+					   password);
+	path_array_unref (paths);
+}
+
+
+/* Estimates the space taken by the extracted files from the listing, the
+ * files in the folders of paths are included, paths == NULL means all
+ * the files. */
+static guint64
+get_extraction_size (FrArchive *archive,
+		     PathArray *paths)
+{
+	GHashTable *selected;
+	GString    *path;
+	guint64     size = 0;
+	int         i;
+
+	if (paths == NULL)
+		return archive->command->files_size;
+
+	selected = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < paths->len; i++)
+		g_hash_table_add (selected, (char *) path_array_index (paths, i));
+
+	path = g_string_new (NULL);
+	for (i = 0; i < archive->command->files->len; i++) {
+		FileData *fdata = g_ptr_array_index (archive->command->files, i);
+		char     *slash;
+		gboolean  found;
+
+		if (fdata->dir || (fdata->size <= 0))
+			continue;
+
+		/* look for the file and for its parent folders */
+
+		found = g_hash_table_contains (selected, fdata->original_path);
+		if (! found)
+			g_string_assign (path, fdata->original_path);
+		while (! found && ((slash = strrchr (path->str, '/')) != NULL)) {
+			g_string_truncate (path, slash - path->str + 1);
+			found = g_hash_table_contains (selected, path->str);
+			if (! found) {
+				g_string_truncate (path, slash - path->str);
+				found = g_hash_table_contains (selected, path->str);
+			}
+		}
+
+		if (found)
+			size += fdata->size;
+	}
+	g_string_free (path, TRUE);
+	g_hash_table_unref (selected);
+
+	return size;
+}
+
+
+void
+fr_archive_extract_paths (FrArchive  *archive,
+			  PathArray  *paths,
+			  const char *destination,
+			  const char *base_dir,
+			  gboolean    skip_older,
+			  gboolean    overwrite,
+			  gboolean    junk_paths,
+			  const char *password)
 {
+	GFile *destination_file;
+	char  *local_destination;
+
 	g_free (archive->priv->extraction_destination);
 	archive->priv->extraction_destination = g_strdup (destination);
 
 	g_free (archive->priv->temp_extraction_dir);
 	archive->priv->temp_extraction_dir = NULL;
 
-	archive->priv->remote_extraction = ! uri_is_local (destination);
+	/* a mounted remote location has a local path, the files are
+	 * extracted there as in a local folder, so that the work folder is
+	 * placed on the same mount and moved to the destination instead of
+	 * being copied to it afterwards. */
+
+	destination_file = g_file_new_for_uri (destination);
+	local_destination = g_file_get_path (destination_file);
+	g_object_unref (destination_file);
+
+	archive->priv->remote_extraction = (local_destination == NULL);
 	if (archive->priv->remote_extraction) {
-		archive->priv->temp_extraction_dir = get_temp_work_dir (NULL);
-		fr_archive_extract_to_local (archive,
-					     file_list,
-					     archive->priv->temp_extraction_dir,
-					     base_dir,
-					     skip_older,
-					     overwrite,
-					     junk_paths,
-					     password);
+		archive->priv->temp_extraction_dir = get_temp_work_dir_for (NULL, get_extraction_size (archive, paths));
+		fr_archive_extract_paths_to_local (archive,
+						   paths,
+						   archive->priv->temp_extraction_dir,
+						   base_dir,
+						   skip_older,
+						   overwrite,
+						   junk_paths,
+						   password);
 	}
 	else {
-		char *local_destination;
-
-		local_destination = g_filename_from_uri (destination, NULL, NULL);
-		fr_archive_extract_to_local (archive,
-					     file_list,
-					     local_destination,
-					     base_dir,
-					     skip_older,
-					     overwrite,
-					     junk_paths,
-					     password);
+		fr_archive_extract_paths_to_local (archive,
+						   paths,
+						   local_destination,
+						   base_dir,
+						   skip_older,
+						   overwrite,
+						   junk_paths,
+						   password);
 		g_free (local_destination);
 	}
 }
 
 
+void
+fr_archive_extract (FrArchive  *archive,
+		    GList      *file_list,
+		    const char *destination,
+		    const char *base_dir,
+		    gboolean    skip_older,
+		    gboolean    overwrite,
+		    gboolean    junk_paths,
+		    const char *password)
+{
+	PathArray *paths = NULL;
+
+	if (file_list != NULL)
+		paths = path_array_new_from_list (file_list);
+	fr_archive_extract_paths (archive,
+				  paths,
+				  destination,
+				  base_dir,
+				  skip_older,
+				  overwrite,
+				  junk_paths,
+				  password);
+	path_array_unref (paths);
+}
+
+
 static char *
 get_desired_destination_for_archive (GFile *file)
 {
@@ -3418,7 +5619,23 @@ fr_archive_test (FrArchive  *archive,
 		      NULL);
 	fr_process_clear (archive->process);
 	fr_command_set_n_files (archive->command, 0);
-	fr_command_test (archive->command);
+
+	if (archive->priv->remote_listing) {
+		char *uri;
+
+		uri = g_file_get_uri (archive->file);
+		archive->command->action = FR_ACTION_TESTING_ARCHIVE;
+		fr_process_set_out_line_func (archive->process, zip_range_process_line, archive->command);
+		fr_process_begin_command (archive->process, ZIP_RANGE_COMMAND);
+		fr_process_add_arg (archive->process, "--test");
+		fr_process_add_arg (archive->process, "--");
+		fr_process_add_arg (archive->process, uri);
+		fr_process_end_command (archive->process);
+		g_free (uri);
+	}
+	else
+		fr_command_test (archive->command);
+
 	fr_process_start (archive->process);
 }
 
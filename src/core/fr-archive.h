@@ -29,6 +29,7 @@ G_BEGIN_DECLS
 
 #include "fr-process.h"
 #include "fr-command.h"
+#include "path-array.h"
 
 #define FR_TYPE_ARCHIVE            (fr_archive_get_type ())
 #define FR_ARCHIVE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), FR_TYPE_ARCHIVE, FrArchive))
@@ -120,6 +121,10 @@ void        fr_archive_reload                    (FrArchive       *archive,
 
 /**/
 
+void        fr_archive_set_modify_in_place       (FrArchive       *archive,
+						  gboolean         value);
+void        fr_archive_set_extract_jobs          (FrArchive       *archive,
+						  guint            n_jobs);
 void        fr_archive_add                       (FrArchive       *archive,
 						  GList           *file_list,
 						  const char      *base_dir,
@@ -133,6 +138,9 @@ void        fr_archive_add                       (FrArchive       *archive,
 void        fr_archive_remove                    (FrArchive       *archive,
 						  GList           *file_list,
 						  FrCompression    compression);
+void        fr_archive_remove_paths              (FrArchive       *archive,
+						  PathArray       *paths,
+						  FrCompression    compression);
 void        fr_archive_extract                   (FrArchive       *archive,
 						  GList           *file_list,
 						  const char      *dest_uri,
@@ -149,6 +157,22 @@ void        fr_archive_extract_to_local          (FrArchive       *archive,
 						  gboolean         overwrite,
 						  gboolean         junk_path,
 						  const char      *password);
+void        fr_archive_extract_paths             (FrArchive       *archive,
+						  PathArray       *paths,
+						  const char      *dest_uri,
+						  const char      *base_dir,
+						  gboolean         skip_older,
+						  gboolean         overwrite,
+						  gboolean         junk_path,
+						  const char      *password);
+void        fr_archive_extract_paths_to_local    (FrArchive       *archive,
+						  PathArray       *paths,
+						  const char      *dest_path,
+						  const char      *base_dir,
+						  gboolean         skip_older,
+						  gboolean         overwrite,
+						  gboolean         junk_path,
+						  const char      *password);
 gboolean    fr_archive_extract_here              (FrArchive       *archive,
 						  gboolean         skip_older,
 						  gboolean         overwrite,
@@ -189,6 +213,15 @@ void        fr_archive_add_directory             (FrArchive       *archive,
 						  gboolean         encrypt_header,
 						  FrCompression    compression,
 						  guint            volume_size);
+void        fr_archive_sync_directory            (FrArchive       *archive,
+						  const char      *directory,
+						  const char      *base_dir,
+						  const char      *dest_dir,
+						  gboolean         compare_content,
+						  const char      *password,
+						  gboolean         encrypt_header,
+						  FrCompression    compression,
+						  guint            volume_size);
 void        fr_archive_add_items                 (FrArchive       *archive,
 						  GList           *item_list,
 						  const char      *base_dir,
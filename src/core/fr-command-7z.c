@@ -129,6 +129,9 @@ list__process_line (char     *line,
 			comm->multi_volume = (strcmp (fields[1], "+") == 0);
 			g_strfreev (fields);
 		}
+		else if (strncmp (line, "Solid = ", 8) == 0) {
+			comm->solid = (strcmp (line + 8, "+") == 0);
+		}
 		else if (strncmp (line, "Unexpected end of archive", 25) == 0)  { 
 			unexpected_end_of_archive = TRUE;
 		}
@@ -278,7 +281,7 @@ parse_progress_line (FrCommand  *comm,
 
 	prefix_len = strlen (prefix);
 	if (strncmp (line, prefix, prefix_len) == 0)
-		fr_command_progress (comm, (double) ++comm->n_file / (comm->n_files + 1));
+		fr_command_file_progress (comm, line + prefix_len);
 }
 
 
@@ -509,6 +512,48 @@ fr_command_7z_extract (FrCommand  *comm,
 }
 
 
+static char **
+fr_command_7z_get_stream_command (FrCommand  *comm,
+				  const char *path)
+{
+	GPtrArray *argv;
+
+	argv = g_ptr_array_new ();
+	if (is_program_in_path ("7z"))
+		g_ptr_array_add (argv, g_strdup ("7z"));
+	else if (is_program_in_path ("7za"))
+		g_ptr_array_add (argv, g_strdup ("7za"));
+	else if (is_program_in_path ("7zr"))
+		g_ptr_array_add (argv, g_strdup ("7zr"));
+	else {
+		g_ptr_array_free (argv, TRUE);
+		return NULL;
+	}
+
+	g_ptr_array_add (argv, g_strdup ("e"));
+	g_ptr_array_add (argv, g_strdup ("-so"));
+	g_ptr_array_add (argv, g_strdup ("-bd"));
+	g_ptr_array_add (argv, g_strdup ("-y"));
+
+	/* always specify the password, an empty one makes an encrypted
+	 * file fail instead of waiting for a password on the standard
+	 * input. */
+	g_ptr_array_add (argv, g_strconcat ("-p", (comm->password != NULL) ? comm->password : "", NULL));
+
+	/* files prefixed with '@' need to be handled specially */
+	if (g_str_has_prefix (path, "@"))
+		g_ptr_array_add (argv, g_strconcat ("-i!", path, NULL));
+
+	g_ptr_array_add (argv, g_strdup ("--"));
+	g_ptr_array_add (argv, g_strdup (comm->filename));
+	if (! g_str_has_prefix (path, "@"))
+		g_ptr_array_add (argv, g_strdup (path));
+	g_ptr_array_add (argv, NULL);
+
+	return (char **) g_ptr_array_free (argv, FALSE);
+}
+
+
 static void
 fr_command_7z_test (FrCommand   *comm)
 {
@@ -686,6 +731,7 @@ fr_command_7z_class_init (FrCommand7zClass *class)
     afc->delete_           = fr_command_7z_delete;
 	afc->extract          = fr_command_7z_extract;
 	afc->test             = fr_command_7z_test;
+	afc->get_stream_command = fr_command_7z_get_stream_command;
 	afc->handle_error     = fr_command_7z_handle_error;
 	afc->get_mime_types   = fr_command_7z_get_mime_types;
 	afc->get_capabilities = fr_command_7z_get_capabilities;
@@ -705,6 +751,8 @@ fr_command_7z_init (FrCommand *comm)
 	comm->propPassword                 = TRUE;
 	comm->propTest                     = TRUE;
 	comm->propListFromFile             = TRUE;
+	comm->propExtractRandomAccess      = TRUE;
+	comm->propExtractToStdout          = TRUE;
 }
 
 
@@ -28,12 +28,15 @@
 #include <fcntl.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 
+#include "compress-utils.h"
 #include "file-data.h"
 #include "file-utils.h"
 #include "glib-utils.h"
 #include "fr-command.h"
 #include "fr-command-cfile.h"
+#include "size-probe.h"
 
 
 /* Parent Class */
@@ -94,24 +97,14 @@ get_uncompressed_name_from_archive (FrCommand  *comm,
 
 
 static void
-list__process_line (char     *line,
-		    gpointer  data)
+add_uncompressed_file (FrCommand *comm,
+		       goffset    size)
 {
-	FrCommand  *comm = FR_COMMAND (data);
-	FileData   *fdata;
-	char      **fields;
-	char       *filename;
+	FileData *fdata;
+	char     *filename;
 
 	fdata = file_data_new ();
 
-	fields = split_line (line, 2);
-	if (strcmp (fields[1], "-1") != 0)
-		fdata->size = g_ascii_strtoull (fields[1], NULL, 10);
-	g_strfreev (fields);
-
-	if (fdata->size == 0)
-		fdata->size = get_file_size (comm->filename);
-
 	filename = get_uncompressed_name_from_archive (comm, comm->filename);
 	if (filename == NULL)
 		filename = remove_extension_from_path (comm->filename);
@@ -123,6 +116,7 @@ list__process_line (char     *line,
 
 	fdata->original_path = fdata->full_path + 1;
 	fdata->link = NULL;
+	fdata->size = size;
 	fdata->modified = get_file_mtime_for_path (comm->filename);
 
 	fdata->name = g_strdup (file_name_from_path (fdata->full_path));
@@ -135,61 +129,97 @@ list__process_line (char     *line,
 }
 
 
+static void
+list__process_line (char     *line,
+		    gpointer  data)
+{
+	FrCommand *comm = FR_COMMAND (data);
+	goffset    size;
+
+	/* the output of 'wc -c', an empty file is a valid size */
+
+	size = g_ascii_strtoull (g_strstrip (line), NULL, 10);
+	add_uncompressed_file (comm, size);
+}
+
+
 static void
 fr_command_cfile_list (FrCommand  *comm)
 {
 	FrCommandCFile *comm_cfile = FR_COMMAND_CFILE (comm);
+	char           *command;
+	goffset         size;
 
-	if (is_mime_type (comm->mime_type, "application/x-gzip")) {
-		/* gzip let us known the uncompressed size */
+	/* most formats record the uncompressed size somewhere in the
+	 * file, read it directly. */
 
-		fr_process_set_out_line_func (FR_COMMAND (comm)->process,
+	if (probe_uncompressed_size (comm->filename, comm->mime_type, &size)) {
+		add_uncompressed_file (comm, size);
+
+		comm_cfile->error.type = FR_PROC_ERROR_NONE;
+		comm_cfile->error.status = 0;
+		g_signal_emit_by_name (G_OBJECT (comm),
+				       "done",
+				       comm->action,
+				       &comm_cfile->error);
+		return;
+	}
+
+	/* ... no index available (bzip2, lzop, compress and plain gzip),
+	 * count the decompressed bytes, the free space checks and the
+	 * progress need the real size.  The pipeline needs pipefail to
+	 * report a corrupted stream instead of a truncated size. */
+
+	command = NULL;
+	if (is_program_in_path ("bash"))
+		command = decompressor_get_command_line (comm->mime_type);
+	if (command != NULL) {
+		fr_process_set_out_line_func (comm->process,
 					      list__process_line,
 					      comm);
 
-		fr_process_begin_command (comm->process, "gzip");
-		fr_process_add_arg (comm->process, "-l");
-		fr_process_add_arg (comm->process, "-q");
-		fr_process_add_arg (comm->process, comm->filename);
+		fr_process_begin_command (comm->process, "bash");
+		fr_process_add_arg (comm->process, "-o");
+		fr_process_add_arg (comm->process, "pipefail");
+		fr_process_add_arg (comm->process, "-c");
+		fr_process_add_arg_concat (comm->process, command, " < ", comm->e_filename, " | wc -c", NULL);
 		fr_process_end_command (comm->process);
 		fr_process_start (comm->process);
+		g_free (command);
+		return;
 	}
-	else {
-		/* ... other compressors do not support this feature so
-		 * simply use the archive size, suboptimal but there is no
-		 * alternative. */
 
-		FileData *fdata;
-		char     *filename;
+	/* ... no way to know the uncompressed size, simply use the archive
+	 * size, suboptimal but there is no alternative. */
 
-		fdata = file_data_new ();
+	add_uncompressed_file (comm, get_file_size_for_path (comm->filename));
 
-		filename = remove_extension_from_path (comm->filename);
-		fdata->full_path = g_strconcat ("/",
-						file_name_from_path (filename),
-						NULL);
-		g_free (filename);
+	comm_cfile->error.type = FR_PROC_ERROR_NONE;
+	comm_cfile->error.status = 0;
+	g_signal_emit_by_name (G_OBJECT (comm),
+			       "done",
+			       comm->action,
+			       &comm_cfile->error);
+}
 
-		fdata->original_path = fdata->full_path + 1;
-		fdata->link = NULL;
-		fdata->size = get_file_size_for_path (comm->filename);
-		fdata->modified = get_file_mtime_for_path (comm->filename);
 
-		fdata->name = g_strdup (file_name_from_path (fdata->full_path));
-		fdata->path = remove_level_from_path (fdata->full_path);
+static void
+begin_func__compress (gpointer data)
+{
+	FrCommand *comm = data;
 
-		if (*fdata->name == 0)
-			file_data_free (fdata);
-		else
-			fr_command_add_file (comm, fdata);
+	if (comm->compressor_choice != NULL)
+		compressor_choice_begin (comm->compressor_choice);
+}
 
-		comm_cfile->error.type = FR_PROC_ERROR_NONE;
-		comm_cfile->error.status = 0;
-		g_signal_emit_by_name (G_OBJECT (comm),
-				       "done",
-				       comm->action,
-				       &comm_cfile->error);
-	}
+
+static void
+end_func__compress (gpointer data)
+{
+	FrCommand *comm = data;
+
+	if ((comm->compressor_choice != NULL) && (comm->process->error.type == FR_PROC_ERROR_NONE))
+		compressor_choice_end (comm->compressor_choice, get_file_size_for_path (comm->filename));
 }
 
 
@@ -202,6 +232,10 @@ fr_command_cfile_add (FrCommand     *comm,
 		      gboolean       recursive)
 {
 	const char *filename = NULL;
+	char       *path;
+	goffset     input_size;
+	CompressorChoice *choice;
+	char       *compress_command;
 	char       *temp_dir = NULL;
 	char       *temp_file = NULL;
 	char       *compressed_filename = NULL;
@@ -209,10 +243,56 @@ fr_command_cfile_add (FrCommand     *comm,
 	if ((file_list == NULL) || (file_list->data == NULL))
 		return;
 
-	/* copy file to the temp dir */
+	filename = file_list->data;
+
+	/* compress the file directly to the archive */
+
+	path = g_build_filename ((base_dir != NULL) ? base_dir : "", filename, NULL);
+	input_size = get_file_size_for_path (path);
+	g_free (path);
+
+	/* in adaptive mode a probe queued before the compression chooses
+	 * the level */
+
+	choice = compressor_choice_new (comm->mime_type, comm->compression, input_size);
+	fr_command_set_compressor_choice (comm, choice);
+	if (choice != NULL) {
+		GList *singleton = g_list_prepend (NULL, (gpointer) filename);
+
+		compressor_choice_add_probe_for_files (choice, comm->process, singleton, base_dir);
+		compress_command = g_strdup (compressor_choice_get_command_line (choice));
+		g_list_free (singleton);
+	}
+	else
+		compress_command = compressor_get_command_line (comm->mime_type,
+								comm->compression,
+								input_size);
+	if (compress_command != NULL) {
+		char *e_filename = g_shell_quote (filename);
+
+		fr_process_begin_command (comm->process, "sh");
+		fr_process_set_begin_func (comm->process, begin_func__compress, comm);
+		fr_process_set_end_func (comm->process, end_func__compress, comm);
+		fr_process_set_working_dir (comm->process, base_dir);
+		fr_process_add_arg (comm->process, "-c");
+		fr_process_add_arg_concat (comm->process,
+					   compress_command,
+					   " < ",
+					   e_filename,
+					   " > ",
+					   comm->e_filename,
+					   NULL);
+		fr_process_end_command (comm->process);
+
+		g_free (e_filename);
+		g_free (compress_command);
+
+		return;
+	}
+
+	/* rzip cannot write to stdout: copy file to the temp dir */
 
 	temp_dir = get_temp_work_dir (NULL);
-	filename = file_list->data;
 	temp_file = g_strconcat (temp_dir, "/", filename, NULL);
 
 	fr_process_begin_command (comm->process, "cp");
@@ -225,65 +305,7 @@ fr_command_cfile_add (FrCommand     *comm,
 
 	/**/
 
-	if (is_mime_type (comm->mime_type, "application/x-gzip")) {
-		fr_process_begin_command (comm->process, "gzip");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "--");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".gz", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-bzip")) {
-		fr_process_begin_command (comm->process, "bzip2");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "--");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".bz2", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-compress")) {
-		fr_process_begin_command (comm->process, "compress");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".Z", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzip")) {
-		fr_process_begin_command (comm->process, "lzip");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "--");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".lz", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzma")) {
-		fr_process_begin_command (comm->process, "lzma");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "--");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".lzma", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-xz")) {
-		fr_process_begin_command (comm->process, "xz");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "--");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".xz", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzop")) {
-		fr_process_begin_command (comm->process, "lzop");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "-fU");
-		fr_process_add_arg (comm->process, "--no-stdin");
-		fr_process_add_arg (comm->process, "--");
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-		compressed_filename = g_strconcat (filename, ".lzo", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-rzip")) {
+	if (is_mime_type (comm->mime_type, "application/x-rzip")) {
 		fr_process_begin_command (comm->process, "rzip");
 		fr_process_set_working_dir (comm->process, temp_dir);
 		fr_process_add_arg (comm->process, filename);
@@ -325,6 +347,37 @@ fr_command_cfile_delete (FrCommand  *comm,
 }
 
 
+static gboolean
+gzip_continue_func (gpointer user_data)
+{
+	FrCommand *comm = user_data;
+
+	/* ignore gzip warnings */
+
+	if (comm->process->error.status == 2) {
+		comm->process->error.type = FR_PROC_ERROR_NONE;
+		comm->process->error.status = 0;
+		g_clear_error (&comm->process->error.gerror);
+	}
+
+	return comm->process->error.status == 0;
+}
+
+
+/* the size of the uncompressed file from the listing, 0 if not known */
+static guint64
+get_uncompressed_size (FrCommand *comm)
+{
+	FileData *fdata;
+
+	if (comm->files->len == 0)
+		return 0;
+	fdata = g_ptr_array_index (comm->files, 0);
+
+	return (fdata->size > 0) ? fdata->size : 0;
+}
+
+
 static void
 fr_command_cfile_extract (FrCommand  *comm,
 			  const char *from_file,
@@ -339,91 +392,64 @@ fr_command_cfile_extract (FrCommand  *comm,
 	char *temp_file;
 	char *uncompr_file;
 	char *compr_file;
+	char *decompress_command;
 
-	/* copy file to the temp dir, remove the already existing file first */
+	/* the uncompressed file is moved to dest_dir */
 
-	temp_dir = get_temp_work_dir (NULL);
+	temp_dir = get_temp_work_dir_for (dest_dir, get_uncompressed_size (comm));
 	temp_file = g_strconcat (temp_dir,
 				 "/",
 				 file_name_from_path (comm->filename),
 				 NULL);
 
-	fr_process_begin_command (comm->process, "cp");
-	fr_process_add_arg (comm->process, "-f");
-	fr_process_add_arg (comm->process, comm->filename);
-	fr_process_add_arg (comm->process, temp_file);
-	fr_process_end_command (comm->process);
-
-	/* uncompress the file */
-
-	if (is_mime_type (comm->mime_type, "application/x-gzip")) {
-		fr_process_begin_command (comm->process, "gzip");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, "-d");
-		fr_process_add_arg (comm->process, "-n");
-		fr_process_add_arg (comm->process, temp_file);
+	decompress_command = decompressor_get_command_line (comm->mime_type);
+	if (decompress_command != NULL) {
+		char *e_temp_file;
+
+		/* decompress the archive to the temp dir, without copying it
+		 * first */
+
+		uncompr_file = g_strconcat (temp_file, ".out", NULL);
+		e_temp_file = g_shell_quote (uncompr_file);
+
+		fr_process_begin_command (comm->process, "sh");
+		if (decompressor_has_warning_status (comm->mime_type))
+			fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
+		fr_process_add_arg (comm->process, "-c");
+		fr_process_add_arg_concat (comm->process,
+					   decompress_command,
+					   " < ",
+					   comm->e_filename,
+					   " > ",
+					   e_temp_file,
+					   NULL);
 		fr_process_end_command (comm->process);
+
+		g_free (e_temp_file);
 	}
-	else if (is_mime_type (comm->mime_type, "application/x-bzip")) {
-		fr_process_begin_command (comm->process, "bzip2");
+	else {
+		/* copy file to the temp dir, remove the already existing file first */
+
+		fr_process_begin_command (comm->process, "cp");
 		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, comm->filename);
 		fr_process_add_arg (comm->process, temp_file);
 		fr_process_end_command (comm->process);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-compress")) {
-		if (is_program_in_path ("gzip")) {
-			fr_process_begin_command (comm->process, "gzip");
+
+		/* uncompress the file */
+
+		if (is_mime_type (comm->mime_type, "application/x-rzip")) {
+			fr_process_begin_command (comm->process, "rzip");
+			fr_process_add_arg (comm->process, "-f");
 			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, "-n");
+			fr_process_add_arg (comm->process, temp_file);
+			fr_process_end_command (comm->process);
 		}
-		else
-			fr_process_begin_command (comm->process, "uncompress");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, temp_file);
-		fr_process_end_command (comm->process);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzip")) {
-		fr_process_begin_command (comm->process, "lzip");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, "-d");
-		fr_process_add_arg (comm->process, temp_file);
-		fr_process_end_command (comm->process);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzma")) {
-		fr_process_begin_command (comm->process, "lzma");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, "-d");
-		fr_process_add_arg (comm->process, temp_file);
-		fr_process_end_command (comm->process);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-xz")) {
-		fr_process_begin_command (comm->process, "xz");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, "-d");
-		fr_process_add_arg (comm->process, temp_file);
-		fr_process_end_command (comm->process);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzop")) {
-		fr_process_begin_command (comm->process, "lzop");
-		fr_process_set_working_dir (comm->process, temp_dir);
-		fr_process_add_arg (comm->process, "-d");
-		fr_process_add_arg (comm->process, "-fU");
-		fr_process_add_arg (comm->process, "--no-stdin");
-		fr_process_add_arg (comm->process, temp_file);
-		fr_process_end_command (comm->process);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-rzip")) {
-		fr_process_begin_command (comm->process, "rzip");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, "-d");
-		fr_process_add_arg (comm->process, temp_file);
-		fr_process_end_command (comm->process);
-	}
 
-	/* copy uncompress file to the dest dir */
+		uncompr_file = remove_extension_from_path (temp_file);
+	}
 
-	uncompr_file = remove_extension_from_path (temp_file);
+	/* move the uncompressed file to the dest dir */
 
 	compr_file = get_uncompressed_name_from_archive (comm, comm->filename);
 	if (compr_file == NULL)
@@ -433,7 +459,7 @@ fr_command_cfile_extract (FrCommand  *comm,
 				 compr_file,
 				 NULL);
 
-	fr_process_begin_command (comm->process, "cp");
+	fr_process_begin_command (comm->process, "mv");
 	fr_process_add_arg (comm->process, "-f");
 	fr_process_add_arg (comm->process, uncompr_file);
 	fr_process_add_arg (comm->process, dest_file);
@@ -447,6 +473,7 @@ fr_command_cfile_extract (FrCommand  *comm,
 	fr_process_add_arg (comm->process, temp_dir);
 	fr_process_end_command (comm->process);
 
+	g_free (decompress_command);
 	g_free (dest_file);
 	g_free (compr_file);
 	g_free (uncompr_file);
@@ -463,6 +490,7 @@ const char *cfile_mime_type[] = { "application/x-gzip",
 				  "application/x-lzop",
 				  "application/x-rzip",
 				  "application/x-xz",
+				  "application/zstd",
 				  NULL };
 
 
@@ -515,6 +543,10 @@ fr_command_cfile_get_capabilities (FrCommand  *comm,
 		if (is_program_available ("rzip", check_command))
 			capabilities |= FR_COMMAND_CAN_READ_WRITE;
 	}
+	else if (is_mime_type (mime_type, "application/zstd")) {
+		if (is_program_available ("zstd", check_command))
+			capabilities |= FR_COMMAND_CAN_READ_WRITE;
+	}
 
 	return capabilities;
 }
@@ -552,6 +584,8 @@ fr_command_cfile_get_packages (FrCommand  *comm,
 		return PACKAGES ("lzop");
 	else if (is_mime_type (mime_type, "application/x-rzip"))
 		return PACKAGES ("rzip");
+	else if (is_mime_type (mime_type, "application/zstd"))
+		return PACKAGES ("zstd");
 
 	return NULL;
 }
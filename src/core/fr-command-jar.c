@@ -56,23 +56,28 @@ fr_command_jar_add (FrCommand     *comm,
 		    gboolean       update,
 		    gboolean       recursive)
 {
-	FrProcess *proc = comm->process;
-	GList     *zip_list = NULL, *jardata_list = NULL, *jar_list = NULL;
-	GList     *scan;
-	char      *tmp_dir;
-
-	for (scan = file_list; scan; scan = scan->next) {
+	FrProcess   *proc = comm->process;
+	GList       *zip_list = NULL, *jardata_list = NULL, *jar_list = NULL;
+	GList       *scan;
+	char        *tmp_dir;
+	JavaPackage *packages;
+	guint        n_files;
+	guint        i;
+
+	/* read the packages of all the files at once, in parallel */
+
+	n_files = g_list_length (file_list);
+	packages = g_new (JavaPackage, n_files);
+	for (i = 0, scan = file_list; scan; scan = scan->next, i++)
+		packages[i].path = build_uri (base_dir, scan->data, NULL);
+	get_package_names (packages, n_files);
+
+	for (i = 0, scan = file_list; scan; scan = scan->next, i++) {
 		char *filename = scan->data;
-		char *path = build_uri (base_dir, filename, NULL);
-		char *package = NULL;
-
-		if (file_extension_is (filename, ".java"))
-			package = get_package_name_from_java_file (path);
-		else if (file_extension_is (filename, ".class"))
-			package = get_package_name_from_class_file (path);
+		char *package = packages[i].package;
 
 		if ((package == NULL) || (strlen (package) == 0))
-			zip_list = g_list_append (zip_list, g_strdup (filename));
+			zip_list = g_list_prepend (zip_list, g_strdup (filename));
 		else {
 			JarData *newdata = g_new0 (JarData, 1);
 
@@ -80,12 +85,16 @@ fr_command_jar_add (FrCommand     *comm,
 			newdata->link_name = g_strdup (file_name_from_path (package));
 			newdata->rel_path = remove_level_from_path (filename);
 			newdata->filename = g_strdup (file_name_from_path (filename));
-			jardata_list = g_list_append (jardata_list, newdata);
+			jardata_list = g_list_prepend (jardata_list, newdata);
 		}
 
 		g_free (package);
-		g_free (path);
+		g_free ((char *) packages[i].path);
 	}
+	g_free (packages);
+
+	zip_list = g_list_reverse (zip_list);
+	jardata_list = g_list_reverse (jardata_list);
 
 	tmp_dir = get_temp_work_dir (NULL);
 	for (scan = jardata_list; scan ; scan = scan->next) {
@@ -106,17 +115,19 @@ fr_command_jar_add (FrCommand     *comm,
 
 		retval = symlink (old_link, link_name);
 		if ((retval != -1) || (errno == EEXIST))
-			jar_list = g_list_append (jar_list,
-						  g_build_filename (jdata->package_minus_one_level,
-							            jdata->link_name,
-						      	            jdata->filename,
-						      	            NULL));
+			jar_list = g_list_prepend (jar_list,
+						   g_build_filename (jdata->package_minus_one_level,
+								     jdata->link_name,
+								     jdata->filename,
+								     NULL));
 
 		g_free (link_name);
 		g_free (old_link);
 		g_free (pack_path);
 	}
 
+	jar_list = g_list_reverse (jar_list);
+
 	if (zip_list != NULL)
 		parent_class->add (comm, NULL, zip_list, base_dir, update, FALSE);
 
@@ -262,6 +262,8 @@ process_line (char     *line,
 		}
 		else if (strncmp (line, "Volume ", 7) == 0)
 			comm->multi_volume = TRUE;
+		else if ((strncmp (line, "Details: ", 9) == 0) && (strstr (line, "solid") != NULL))
+			comm->solid = TRUE;
 		return;
 	}
 
@@ -411,8 +413,20 @@ parse_progress_line (FrCommand  *comm,
 		     const char *message_prefix,
 		     const char *line)
 {
-	if (strncmp (line, prefix, strlen (prefix)) == 0)
-		fr_command_progress (comm, (double) ++comm->n_file / (comm->n_files + 1));
+	char *name;
+
+	if (strncmp (line, prefix, strlen (prefix)) != 0)
+		return;
+
+	/* the lines are like "Extracting  name      OK" */
+
+	name = g_strstrip (g_strdup (line + strlen (prefix)));
+	if (g_str_has_suffix (name, "OK")) {
+		name[strlen (name) - 2] = '\0';
+		g_strchomp (name);
+	}
+	fr_command_file_progress (comm, name);
+	g_free (name);
 }
 
 
@@ -637,6 +651,35 @@ fr_command_rar_extract (FrCommand  *comm,
 }
 
 
+static char **
+fr_command_rar_get_stream_command (FrCommand  *comm,
+				   const char *path)
+{
+	GPtrArray *argv;
+
+	argv = g_ptr_array_new ();
+	g_ptr_array_add (argv, g_strdup (have_rar () ? "rar" : "unrar"));
+	g_ptr_array_add (argv, g_strdup ("p"));
+	g_ptr_array_add (argv, g_strdup ("-inul"));
+
+	if ((comm->password != NULL) && (comm->password[0] != '\0')) {
+		if (comm->encrypt_header)
+			g_ptr_array_add (argv, g_strconcat ("-hp", comm->password, NULL));
+		else
+			g_ptr_array_add (argv, g_strconcat ("-p", comm->password, NULL));
+	}
+	else
+		g_ptr_array_add (argv, g_strdup ("-p-"));
+
+	g_ptr_array_add (argv, g_strdup ("--"));
+	g_ptr_array_add (argv, g_strdup (comm->filename));
+	g_ptr_array_add (argv, g_strdup (path));
+	g_ptr_array_add (argv, NULL);
+
+	return (char **) g_ptr_array_free (argv, FALSE);
+}
+
+
 static void
 fr_command_rar_test (FrCommand   *comm)
 {
@@ -779,6 +822,7 @@ fr_command_rar_class_init (FrCommandRarClass *class)
 	afc->delete_           = fr_command_rar_delete;
 	afc->extract          = fr_command_rar_extract;
 	afc->test             = fr_command_rar_test;
+	afc->get_stream_command = fr_command_rar_get_stream_command;
 	afc->handle_error     = fr_command_rar_handle_error;
 	afc->get_mime_types   = fr_command_rar_get_mime_types;
 	afc->get_capabilities = fr_command_rar_get_capabilities;
@@ -798,6 +842,8 @@ fr_command_rar_init (FrCommand *comm)
 	comm->propPassword                 = TRUE;
 	comm->propTest                     = TRUE;
 	comm->propListFromFile             = TRUE;
+	comm->propExtractRandomAccess      = TRUE;
+	comm->propExtractToStdout          = TRUE;
 }
 
 
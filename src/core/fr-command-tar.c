@@ -30,8 +30,10 @@
 #include <time.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include "tr-wrapper.h"
 
+#include "compress-utils.h"
 #include "file-data.h"
 #include "file-utils.h"
 #include "glib-utils.h"
@@ -227,6 +229,9 @@ add_compress_arg (FrCommand *comm)
 	else if (is_mime_type (comm->mime_type, "application/x-lzop-compressed-tar"))
 		fr_process_add_arg (comm->process, "--use-compress-program=lzop");
 
+	else if (is_mime_type (comm->mime_type, "application/x-zstd-compressed-tar"))
+		fr_process_add_arg (comm->process, "--use-compress-program=zstd");
+
 	else if (is_mime_type (comm->mime_type, "application/x-7z-compressed-tar")) {
 		FrCommandTar *comm_tar = (FrCommandTar*) comm;
 		char         *option;
@@ -238,8 +243,229 @@ add_compress_arg (FrCommand *comm)
 }
 
 
+/* the format of the compressed stream that contains the tar archive */
+static const char *
+get_stream_mime_type (FrCommand *comm)
+{
+	static const struct {
+		const char *tar_mime_type;
+		const char *stream_mime_type;
+	} stream_types[] = {
+		{ "application/x-compressed-tar", "application/x-gzip" },
+		{ "application/x-bzip-compressed-tar", "application/x-bzip" },
+		{ "application/x-tarz", "application/x-compress" },
+		{ "application/x-lzip-compressed-tar", "application/x-lzip" },
+		{ "application/x-lzma-compressed-tar", "application/x-lzma" },
+		{ "application/x-xz-compressed-tar", "application/x-xz" },
+		{ "application/x-lzop-compressed-tar", "application/x-lzop" },
+		{ "application/x-zstd-compressed-tar", "application/zstd" },
+	};
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (stream_types); i++)
+		if (is_mime_type (comm->mime_type, stream_types[i].tar_mime_type))
+			return stream_types[i].stream_mime_type;
+
+	return NULL;
+}
+
+
+/* Returns the command that compresses the standard input to the
+ * standard output, or NULL if the archive cannot be written as a
+ * stream.  input_size is an estimate of the size of the uncompressed
+ * archive, -1 if unknown.  In adaptive mode the command runs the level
+ * chosen by the probe queued with add_compress_probe_*. */
+static char *
+get_stream_compress_command (FrCommand *comm,
+			     goffset    input_size)
+{
+	const char *stream_mime_type;
+
+	stream_mime_type = get_stream_mime_type (comm);
+	if (stream_mime_type == NULL)
+		return NULL;
+
+	if (comm->compressor_choice != NULL)
+		return g_strdup (compressor_choice_get_command_line (comm->compressor_choice));
+
+	return compressor_get_command_line (stream_mime_type, comm->compression, input_size);
+}
+
+
+/* Returns a new choice for the adaptive compression, NULL if the
+ * probe must not be queued: the compression is not adaptive, or the
+ * operation already queued a probe, whose choice is used. */
+static CompressorChoice *
+new_compressor_choice (FrCommand *comm,
+		       goffset    input_size)
+{
+	const char       *stream_mime_type;
+	CompressorChoice *choice;
+
+	if (comm->compressor_choice != NULL)
+		return NULL;
+
+	stream_mime_type = get_stream_mime_type (comm);
+	if (stream_mime_type == NULL)
+		return NULL;
+
+	choice = compressor_choice_new (stream_mime_type, comm->compression, input_size);
+	fr_command_set_compressor_choice (comm, choice);
+
+	return choice;
+}
+
+
+/* queues the probe that chooses the compression level sampling the
+ * files, when the previous commands have created them. */
 static void
-begin_tar_command (FrCommand *comm)
+add_compress_probe_for_files (FrCommand  *comm,
+			      GList      *file_list,
+			      const char *base_dir,
+			      goffset     input_size)
+{
+	CompressorChoice *choice;
+
+	choice = new_compressor_choice (comm, input_size);
+	if (choice != NULL)
+		compressor_choice_add_probe_for_files (choice, comm->process, file_list, base_dir);
+}
+
+
+/* the uncompressed archive is at least as large as the compressed one */
+static goffset
+get_archive_size_estimate (const char *filename)
+{
+	if ((filename == NULL) || ! g_file_test (filename, G_FILE_TEST_EXISTS))
+		return -1;
+	return get_file_size_for_path (filename);
+}
+
+
+static goffset
+get_files_size (GList      *file_list,
+		const char *base_dir)
+{
+	goffset  size = 0;
+	GList   *scan;
+
+	for (scan = file_list; scan; scan = scan->next) {
+		char *path;
+
+		path = g_build_filename ((base_dir != NULL) ? base_dir : "", scan->data, NULL);
+		if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+			size += get_file_size_for_path (path);
+		g_free (path);
+	}
+
+	return size;
+}
+
+
+/* Returns the command that decompresses the standard input to the
+ * standard output, or NULL if the archive cannot be read as a stream. */
+static char *
+get_stream_decompress_command (FrCommand *comm)
+{
+	const char *stream_mime_type;
+
+	stream_mime_type = get_stream_mime_type (comm);
+	if (stream_mime_type == NULL)
+		return NULL;
+
+	return decompressor_get_command_line (stream_mime_type);
+}
+
+
+/* queues the probe that chooses the compression level sampling the
+ * uncompressed content of archive. */
+static void
+add_compress_probe_for_archive (FrCommand  *comm,
+				const char *archive)
+{
+	CompressorChoice *choice;
+	char             *decompress_command;
+	char             *e_archive;
+	char             *command;
+
+	decompress_command = get_stream_decompress_command (comm);
+	if (decompress_command == NULL)
+		return;
+
+	choice = new_compressor_choice (comm, get_archive_size_estimate (archive));
+	if (choice != NULL) {
+		e_archive = g_shell_quote (archive);
+		command = g_strconcat (decompress_command, " < ", e_archive, NULL);
+		compressor_choice_add_probe_for_command (choice, comm->process, command, get_archive_size_estimate (archive));
+		g_free (command);
+		g_free (e_archive);
+	}
+
+	g_free (decompress_command);
+}
+
+
+static void
+begin_func__compress (gpointer data)
+{
+	FrCommand *comm = data;
+
+	if (comm->compressor_choice != NULL)
+		compressor_choice_begin (comm->compressor_choice);
+}
+
+
+static void
+end_func__compress (gpointer data)
+{
+	FrCommand *comm = data;
+
+	if ((comm->compressor_choice != NULL) && (comm->process->error.type == FR_PROC_ERROR_NONE))
+		compressor_choice_end (comm->compressor_choice, get_file_size_for_path (comm->filename));
+}
+
+
+/* like add_compress_arg but uses the fastest decompressor available, for
+ * the commands that read the archive. */
+static void
+add_decompress_arg (FrCommand *comm)
+{
+	char *decompress_command;
+
+	decompress_command = get_stream_decompress_command (comm);
+	if (decompress_command == NULL) {
+		add_compress_arg (comm);
+		return;
+	}
+
+	fr_process_add_arg_concat (comm->process, "--use-compress-program=", decompress_command, NULL);
+	g_free (decompress_command);
+}
+
+
+/* like add_compress_arg but uses the fastest compressor available and
+ * the compression level, for the commands that create the archive. */
+static void
+add_create_compress_arg (FrCommand *comm,
+			 goffset    input_size)
+{
+	char *compress_command;
+
+	compress_command = get_stream_compress_command (comm, input_size);
+	if (compress_command == NULL) {
+		add_compress_arg (comm);
+		return;
+	}
+
+	fr_process_add_arg_concat (comm->process, "--use-compress-program=", compress_command, NULL);
+	fr_process_set_begin_func (comm->process, begin_func__compress, comm);
+	fr_process_set_end_func (comm->process, end_func__compress, comm);
+	g_free (compress_command);
+}
+
+
+static char *
+get_tar_command (void)
 {
 	char *command = NULL;
 
@@ -252,10 +478,20 @@ begin_tar_command (FrCommand *comm)
 		command = g_strdup ("/usr/sfw/bin/gtar");
 	}
 #endif
-	if (command != NULL)
-		fr_process_begin_command (comm->process, command);
-	else
-		fr_process_begin_command (comm->process, "tar");
+	if (command == NULL)
+		command = g_strdup ("tar");
+
+	return command;
+}
+
+
+static void
+begin_tar_command (FrCommand *comm)
+{
+	char *command;
+
+	command = get_tar_command ();
+	fr_process_begin_command (comm->process, command);
 	g_free (command);
 }
 
@@ -270,7 +506,7 @@ fr_command_tar_list (FrCommand *comm)
 	fr_process_add_arg (comm->process, "--no-wildcards");
 	fr_process_add_arg (comm->process, "-tvf");
 	fr_process_add_arg (comm->process, comm->filename);
-	add_compress_arg (comm);
+	add_decompress_arg (comm);
 	fr_process_end_command (comm->process);
 	fr_process_start (comm->process);
 }
@@ -296,10 +532,8 @@ process_line__generic (char     *line,
 	if (line[strlen (line) - 1] == '/') /* ignore directories */
 		return;
 
-	if (comm->n_files != 0) {
-		double fraction = (double) ++comm->n_file / (comm->n_files + 1);
-		fr_command_progress (comm, fraction);
-	}
+	if (comm->n_files != 0)
+		fr_command_file_progress (comm, line);
 	else {
 		char *msg = g_strconcat (action_msg, file_name_from_path (line), NULL);
 		fr_command_message (comm, msg);
@@ -327,11 +561,17 @@ fr_command_tar_add (FrCommand     *comm,
 {
 	FrCommandTar *c_tar = FR_COMMAND_TAR (comm);
 	GList        *scan;
+	goffset       input_size = -1;
 
 	fr_process_set_out_line_func (FR_COMMAND (comm)->process,
 				      process_line__add,
 				      comm);
 
+	if (can_create_a_compressed_archive (comm)) {
+		input_size = get_files_size (file_list, base_dir);
+		add_compress_probe_for_files (comm, file_list, base_dir, input_size);
+	}
+
 	begin_tar_command (comm);
 	fr_process_add_arg (comm->process, "--force-local");
 	if (! recursive)
@@ -349,7 +589,7 @@ fr_command_tar_add (FrCommand     *comm,
 	if (can_create_a_compressed_archive (comm)) {
 		fr_process_add_arg (comm->process, "-cf");
 		fr_process_add_arg (comm->process, comm->filename);
-		add_compress_arg (comm);
+		add_create_compress_arg (comm, input_size);
 	}
 	else {
 		if (comm->creating_archive)
@@ -467,7 +707,7 @@ fr_command_tar_extract (FrCommand  *comm,
 
 	fr_process_add_arg (comm->process, "-xf");
 	fr_process_add_arg (comm->process, comm->filename);
-	add_compress_arg (comm);
+	add_decompress_arg (comm);
 
 	if (dest_dir != NULL) {
 		fr_process_add_arg (comm->process, "-C");
@@ -495,6 +735,7 @@ begin_func__recompress (gpointer data)
 	FrCommand *comm = data;
 	fr_command_progress (comm, -1.0);
 	fr_command_message (comm, _("Recompressing archive"));
+	begin_func__compress (comm);
 }
 
 
@@ -520,57 +761,46 @@ fr_command_tar_recompress (FrCommand *comm)
 {
 	FrCommandTar *c_tar = FR_COMMAND_TAR (comm);
 	char         *new_name = NULL;
+	char         *compress_command;
+	goffset       input_size;
 
 	if (can_create_a_compressed_archive (comm))
 		return;
 
-	if (is_mime_type (comm->mime_type, "application/x-compressed-tar")) {
-		fr_process_begin_command (comm->process, "gzip");
-		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
-		switch (comm->compression) {
-		case FR_COMPRESSION_VERY_FAST:
-			fr_process_add_arg (comm->process, "-1"); break;
-		case FR_COMPRESSION_FAST:
-			fr_process_add_arg (comm->process, "-3"); break;
-		case FR_COMPRESSION_NORMAL:
-			fr_process_add_arg (comm->process, "-6"); break;
-		case FR_COMPRESSION_MAXIMUM:
-			fr_process_add_arg (comm->process, "-9"); break;
-		}
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-		fr_process_end_command (comm->process);
+	/* the uncompressed archive is sampled when the previous commands
+	 * have written it */
 
-		new_name = g_strconcat (c_tar->uncomp_filename, ".gz", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-bzip-compressed-tar")) {
-		fr_process_begin_command (comm->process, "bzip2");
-		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		switch (comm->compression) {
-		case FR_COMPRESSION_VERY_FAST:
-			fr_process_add_arg (comm->process, "-1"); break;
-		case FR_COMPRESSION_FAST:
-			fr_process_add_arg (comm->process, "-3"); break;
-		case FR_COMPRESSION_NORMAL:
-			fr_process_add_arg (comm->process, "-6"); break;
-		case FR_COMPRESSION_MAXIMUM:
-			fr_process_add_arg (comm->process, "-9"); break;
-		}
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-		fr_process_end_command (comm->process);
+	input_size = get_archive_size_estimate (comm->filename);
+	if (get_stream_mime_type (comm) != NULL) {
+		GList *file_list = g_list_prepend (NULL, c_tar->uncomp_filename);
 
-		new_name = g_strconcat (c_tar->uncomp_filename, ".bz2", NULL);
+		add_compress_probe_for_files (comm, file_list, NULL, input_size);
+		g_list_free (file_list);
 	}
-	else if (is_mime_type (comm->mime_type, "application/x-tarz")) {
-		fr_process_begin_command (comm->process, "compress");
+
+	compress_command = get_stream_compress_command (comm, input_size);
+	if (compress_command != NULL) {
+		char *e_uncomp_filename = g_shell_quote (c_tar->uncomp_filename);
+
+		/* the compressor writes the archive directly to its final
+		 * position */
+
+		fr_process_begin_command (comm->process, "sh");
 		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
+		fr_process_set_end_func (comm->process, end_func__compress, comm);
+		if (is_mime_type (comm->mime_type, "application/x-compressed-tar"))
+			fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
+		fr_process_add_arg (comm->process, "-c");
+		fr_process_add_arg_concat (comm->process,
+					   compress_command,
+					   " < ",
+					   e_uncomp_filename,
+					   " > ",
+					   comm->e_filename,
+					   NULL);
 		fr_process_end_command (comm->process);
 
-		new_name = g_strconcat (c_tar->uncomp_filename, ".Z", NULL);
+		g_free (e_uncomp_filename);
 	}
 	else if (is_mime_type (comm->mime_type, "application/x-lrzip-compressed-tar")) {
 		fr_process_begin_command (comm->process, "lrzip");
@@ -591,83 +821,6 @@ fr_command_tar_recompress (FrCommand *comm)
 
 		new_name = g_strconcat (c_tar->uncomp_filename, ".lrz", NULL);
 	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzip-compressed-tar")) {
-		fr_process_begin_command (comm->process, "lzip");
-		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		switch (comm->compression) {
-		case FR_COMPRESSION_VERY_FAST:
-			fr_process_add_arg (comm->process, "-1"); break;
-		case FR_COMPRESSION_FAST:
-			fr_process_add_arg (comm->process, "-3"); break;
-		case FR_COMPRESSION_NORMAL:
-			fr_process_add_arg (comm->process, "-6"); break;
-		case FR_COMPRESSION_MAXIMUM:
-			fr_process_add_arg (comm->process, "-9"); break;
-		}
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-		fr_process_end_command (comm->process);
-
-		new_name = g_strconcat (c_tar->uncomp_filename, ".lz", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzma-compressed-tar")) {
-		fr_process_begin_command (comm->process, "lzma");
-		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		switch (comm->compression) {
-		case FR_COMPRESSION_VERY_FAST:
-			fr_process_add_arg (comm->process, "-1"); break;
-		case FR_COMPRESSION_FAST:
-			fr_process_add_arg (comm->process, "-3"); break;
-		case FR_COMPRESSION_NORMAL:
-			fr_process_add_arg (comm->process, "-6"); break;
-		case FR_COMPRESSION_MAXIMUM:
-			fr_process_add_arg (comm->process, "-9"); break;
-		}
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-		fr_process_end_command (comm->process);
-
-		new_name = g_strconcat (c_tar->uncomp_filename, ".lzma", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-xz-compressed-tar")) {
-		fr_process_begin_command (comm->process, "xz");
-		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		switch (comm->compression) {
-		case FR_COMPRESSION_VERY_FAST:
-			fr_process_add_arg (comm->process, "-1"); break;
-		case FR_COMPRESSION_FAST:
-			fr_process_add_arg (comm->process, "-3"); break;
-		case FR_COMPRESSION_NORMAL:
-			fr_process_add_arg (comm->process, "-6"); break;
-		case FR_COMPRESSION_MAXIMUM:
-			fr_process_add_arg (comm->process, "-9"); break;
-		}
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-		fr_process_end_command (comm->process);
-
-		new_name = g_strconcat (c_tar->uncomp_filename, ".xz", NULL);
-	}
-	else if (is_mime_type (comm->mime_type, "application/x-lzop-compressed-tar")) {
-		fr_process_begin_command (comm->process, "lzop");
-		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
-		switch (comm->compression) {
-		case FR_COMPRESSION_VERY_FAST:
-			fr_process_add_arg (comm->process, "-1"); break;
-		case FR_COMPRESSION_FAST:
-			fr_process_add_arg (comm->process, "-3"); break;
-		case FR_COMPRESSION_NORMAL:
-			fr_process_add_arg (comm->process, "-6"); break;
-		case FR_COMPRESSION_MAXIMUM:
-			fr_process_add_arg (comm->process, "-9"); break;
-		}
-		fr_process_add_arg (comm->process, "-fU");
-		fr_process_add_arg (comm->process, "--no-stdin");
-		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-		fr_process_end_command (comm->process);
-
-		new_name = g_strconcat (c_tar->uncomp_filename, ".lzo", NULL);
-	}
 	else if (is_mime_type (comm->mime_type, "application/x-7z-compressed-tar")) {
 		FrCommandTar *comm_tar = (FrCommandTar*) comm;
 
@@ -707,13 +860,15 @@ fr_command_tar_recompress (FrCommand *comm)
 
 		/* Restore original name. */
 
-		fr_process_begin_command (comm->process, "mv");
-		fr_process_add_arg (comm->process, "-f");
-		fr_process_add_arg (comm->process, new_name);
-		fr_process_add_arg (comm->process, comm->filename);
-		fr_process_end_command (comm->process);
+		if (new_name != NULL) {
+			fr_process_begin_command (comm->process, "mv");
+			fr_process_add_arg (comm->process, "-f");
+			fr_process_add_arg (comm->process, new_name);
+			fr_process_add_arg (comm->process, comm->filename);
+			fr_process_end_command (comm->process);
+		}
 
-		tmp_dir = remove_level_from_path (new_name);
+		tmp_dir = remove_level_from_path (c_tar->uncomp_filename);
 
 		fr_process_begin_command (comm->process, "rm");
 		fr_process_set_sticky (comm->process, TRUE);
@@ -724,6 +879,7 @@ fr_command_tar_recompress (FrCommand *comm)
 		g_free (tmp_dir);
 	}
 
+	g_free (compress_command);
 	g_free (new_name);
 	g_free (c_tar->uncomp_filename);
 	c_tar->uncomp_filename = NULL;
@@ -823,6 +979,17 @@ get_uncompressed_name (FrCommandTar *c_tar,
 		else if (file_extension_is (e_filename, ".tar.lzo"))
 			new_name[l - 4] = 0;
 	}
+	else if (is_mime_type (comm->mime_type, "application/x-zstd-compressed-tar")) {
+		/* X.tzst     -->  X.tar
+		 * X.tar.zst  -->  X.tar */
+		if (file_extension_is (e_filename, ".tzst")) {
+			new_name[l - 3] = 'a';
+			new_name[l - 2] = 'r';
+			new_name[l - 1] = 0;
+		}
+		else if (file_extension_is (e_filename, ".tar.zst"))
+			new_name[l - 4] = 0;
+	}
 	else if (is_mime_type (comm->mime_type, "application/x-7z-compressed-tar")) {
 		/* X.tar.7z -->  X.tar */
 		if (file_extension_is (e_filename, ".tar.7z"))
@@ -859,6 +1026,7 @@ fr_command_tar_uncompress (FrCommand *comm)
 {
 	FrCommandTar *c_tar = FR_COMMAND_TAR (comm);
 	char         *tmp_name;
+	char         *decompress_command = NULL;
 	gboolean      archive_exists;
 
 	if (can_create_a_compressed_archive (comm))
@@ -886,34 +1054,44 @@ fr_command_tar_uncompress (FrCommand *comm)
 		tmp_name = g_strdup (comm->filename);
 
 	if (archive_exists) {
-		if (is_mime_type (comm->mime_type, "application/x-compressed-tar")) {
-			fr_process_begin_command (comm->process, "gzip");
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (is_mime_type (comm->mime_type, "application/x-bzip-compressed-tar")) {
-			fr_process_begin_command (comm->process, "bzip2");
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (is_mime_type (comm->mime_type, "application/x-tarz")) {
-			if (is_program_in_path ("gzip")) {
-				fr_process_begin_command (comm->process, "gzip");
-				fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
+		decompress_command = get_stream_decompress_command (comm);
+		if (decompress_command != NULL) {
+			char *uncomp_filename;
+			char *e_tmp_name;
+			char *e_uncomp_filename;
+
+			/* the output must not overwrite the archive when the
+			 * name does not have a known extension */
+
+			uncomp_filename = get_uncompressed_name (c_tar, tmp_name);
+			if (strcmp (uncomp_filename, tmp_name) == 0) {
+				g_free (uncomp_filename);
+				uncomp_filename = g_strconcat (tmp_name, ".tar", NULL);
 			}
-			else
-				fr_process_begin_command (comm->process, "uncompress");
+			c_tar->uncomp_filename = g_strdup (uncomp_filename);
+
+			e_tmp_name = g_shell_quote (tmp_name);
+			e_uncomp_filename = g_shell_quote (uncomp_filename);
+
+			fr_process_begin_command (comm->process, "sh");
 			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, tmp_name);
+			if (decompressor_has_warning_status (get_stream_mime_type (comm)))
+				fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
+			fr_process_add_arg (comm->process, "-c");
+			fr_process_add_arg_concat (comm->process,
+						   decompress_command,
+						   " < ",
+						   e_tmp_name,
+						   " > ",
+						   e_uncomp_filename,
+						   " && rm -f ",
+						   e_tmp_name,
+						   NULL);
 			fr_process_end_command (comm->process);
+
+			g_free (e_uncomp_filename);
+			g_free (e_tmp_name);
+			g_free (uncomp_filename);
 		}
 		else if (is_mime_type (comm->mime_type, "application/x-lrzip-compressed-tar")) {
 			fr_process_begin_command (comm->process, "lrzip");
@@ -923,38 +1101,6 @@ fr_command_tar_uncompress (FrCommand *comm)
 			fr_process_add_arg (comm->process, tmp_name);
 			fr_process_end_command (comm->process);
 		}
-		else if (is_mime_type (comm->mime_type, "application/x-lzip-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lzip");
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (is_mime_type (comm->mime_type, "application/x-lzma-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lzma");
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (is_mime_type (comm->mime_type, "application/x-xz-compressed-tar")) {
-			fr_process_begin_command (comm->process, "xz");
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (is_mime_type (comm->mime_type, "application/x-lzop-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lzop");
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-dfU");
-			fr_process_add_arg (comm->process, "--no-stdin");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
 		else if (is_mime_type (comm->mime_type, "application/x-7z-compressed-tar")) {
 			FrCommandTar *comm_tar = (FrCommandTar*) comm;
 
@@ -975,11 +1121,158 @@ fr_command_tar_uncompress (FrCommand *comm)
 		}
 	}
 
-	c_tar->uncomp_filename = get_uncompressed_name (c_tar, tmp_name);
+	if (c_tar->uncomp_filename == NULL)
+		c_tar->uncomp_filename = get_uncompressed_name (c_tar, tmp_name);
+	g_free (decompress_command);
 	g_free (tmp_name);
 }
 
 
+/* -- rewrite -- */
+
+
+#define TAR_ENTRIES_COMMAND PRIVEXECDIR "tar-entries"
+
+
+static gboolean
+stream_rewrite_is_available (FrCommand *comm)
+{
+	char     *decompress;
+	char     *compress;
+	gboolean  result;
+
+	/* the pipeline needs pipefail to report the failure of any of
+	 * its commands. */
+
+	if (! is_program_in_path ("bash")
+	    || ! g_file_test (TAR_ENTRIES_COMMAND, G_FILE_TEST_IS_EXECUTABLE))
+	{
+		return FALSE;
+	}
+
+	decompress = get_stream_decompress_command (comm);
+	result = (decompress != NULL) && compressor_is_available (get_stream_mime_type (comm));
+
+	g_free (decompress);
+
+	return result;
+}
+
+
+static void
+begin_func__rewrite_delete (gpointer data)
+{
+	begin_func__delete (data);
+	begin_func__compress (data);
+}
+
+
+/* Writes the new archive with a single pipeline:
+ *
+ *   decompress < source | tar --delete | tar-entries ; tar -c new files
+ *     | compress > comm->filename
+ *
+ * tar-entries drops the end-of-archive marker so that the entries
+ * created by the second tar follow the original ones.  Neither the
+ * uncompressed archive nor a copy of the original one is ever written
+ * to disk. */
+static void
+fr_command_tar_rewrite (FrCommand  *comm,
+			const char *source,
+			const char *delete_from_file,
+			const char *add_from_file,
+			const char *base_dir,
+			gboolean    recursive)
+{
+	char     *tar;
+	char     *e_tar;
+	char     *e_source;
+	char     *decompress;
+	char     *compress;
+	gboolean  decompress_warnings;
+	GString  *script;
+
+	tar = get_tar_command ();
+	e_tar = g_shell_quote (tar);
+	e_source = g_shell_quote (source);
+	decompress = get_stream_decompress_command (comm);
+	add_compress_probe_for_archive (comm, source);
+	compress = get_stream_compress_command (comm, get_archive_size_estimate (source));
+	decompress_warnings = decompressor_has_warning_status (get_stream_mime_type (comm));
+
+	/* the status of the compressors is mapped to 2 because tar
+	 * exits with 1 when a file changed while it was read, which is
+	 * not an error.  The decompressor can be killed by SIGPIPE when
+	 * tar does not read the padding after the end of the archive. */
+
+	script = g_string_new ("set -o pipefail; ");
+	if (add_from_file != NULL)
+		g_string_append (script, "{ ");
+
+	g_string_append_printf (script,
+				"( %s < %s || case $? in %s) ;; *) exit 2 ;; esac )",
+				decompress,
+				e_source,
+				decompress_warnings ? "2|141" : "141");
+
+	if (delete_from_file != NULL) {
+		char *e_delete_from_file = g_shell_quote (delete_from_file);
+
+		g_string_append_printf (script,
+					" | %s --force-local --no-wildcards --no-unquote --delete -f - -T %s --",
+					e_tar,
+					e_delete_from_file);
+		g_free (e_delete_from_file);
+	}
+
+	if (add_from_file != NULL) {
+		char *e_add_from_file = g_shell_quote (add_from_file);
+
+		g_string_append_printf (script, " | %s; s=$?; [ $s -le 1 ] || exit $s; ", TAR_ENTRIES_COMMAND);
+		g_string_append_printf (script, "%s --force-local", e_tar);
+		if (! recursive)
+			g_string_append (script, " --no-recursion");
+		g_string_append (script, " --no-wildcards --no-unquote -v -p");
+		if (base_dir != NULL) {
+			char *e_base_dir = g_shell_quote (base_dir);
+
+			g_string_append_printf (script, " -C %s", e_base_dir);
+			g_free (e_base_dir);
+		}
+		g_string_append_printf (script, " -cf - -T %s -- ; }", e_add_from_file);
+		g_free (e_add_from_file);
+	}
+
+	g_string_append_printf (script,
+				" | ( %s || exit 2 ) > %s",
+				compress,
+				comm->e_filename);
+
+	/* tar prints the verbose output on stderr when the archive is
+	 * written to stdout. */
+
+	if (add_from_file != NULL)
+		fr_process_set_err_line_func (comm->process, process_line__add, comm);
+
+	fr_process_begin_command (comm->process, "bash");
+	if (add_from_file == NULL)
+		fr_process_set_begin_func (comm->process, begin_func__rewrite_delete, comm);
+	else
+		fr_process_set_begin_func (comm->process, begin_func__compress, comm);
+	fr_process_set_end_func (comm->process, end_func__compress, comm);
+	fr_process_add_arg (comm->process, "-c");
+	fr_process_add_arg (comm->process, script->str);
+	fr_process_end_command (comm->process);
+
+	g_string_free (script, TRUE);
+	g_free (compress);
+	g_free (decompress);
+	g_free (e_source);
+	g_free (e_tar);
+	g_free (tar);
+}
+
+
 static void
 fr_command_tar_handle_error (FrCommand   *comm,
 			     FrProcError *error)
@@ -1001,6 +1294,7 @@ const char *tar_mime_types[] = { "application/x-compressed-tar",
 			         "application/x-lzop-compressed-tar",
 			         "application/x-tarz",
 				 "application/x-xz-compressed-tar",
+				 "application/x-zstd-compressed-tar",
 			         NULL };
 
 
@@ -1061,6 +1355,10 @@ fr_command_tar_get_capabilities (FrCommand  *comm,
 		if (is_program_available ("lzop", check_command))
 			capabilities |= FR_COMMAND_CAN_READ_WRITE;
 	}
+	else if (is_mime_type (mime_type, "application/x-zstd-compressed-tar")) {
+		if (is_program_available ("zstd", check_command))
+			capabilities |= FR_COMMAND_CAN_READ_WRITE;
+	}
 	else if (is_mime_type (mime_type, "application/x-7z-compressed-tar")) {
 		char *try_command[3] = { "7za", "7zr", "7z" };
 		int   i;
@@ -1082,6 +1380,7 @@ fr_command_tar_set_mime_type (FrCommand  *comm,
 		 	      const char *mime_type)
 {
 	FrCommandTar *comm_tar = FR_COMMAND_TAR (comm);
+	char         *decompress;
 
 	FR_COMMAND_CLASS (parent_class)->set_mime_type (comm, mime_type);
 
@@ -1096,6 +1395,75 @@ fr_command_tar_set_mime_type (FrCommand  *comm,
 			}
 		}
 	}
+
+	comm->propStreamRewrite = stream_rewrite_is_available (comm);
+
+	/* the compressed archives are read through the decompressors
+	 * that work on a stream, the other ones are extracted to a
+	 * folder. */
+	decompress = get_stream_decompress_command (comm);
+	comm->propExtractToStdout = (decompress != NULL) || is_mime_type (mime_type, "application/x-tar");
+	g_free (decompress);
+}
+
+
+static char **
+fr_command_tar_get_stream_command (FrCommand  *comm,
+				   const char *path)
+{
+	char  *tar;
+	char  *decompress;
+	char **argv;
+
+	tar = get_tar_command ();
+	decompress = get_stream_decompress_command (comm);
+
+	if (decompress == NULL) {
+		argv = g_new0 (char *, 9);
+		argv[0] = tar;
+		argv[1] = g_strdup ("--force-local");
+		argv[2] = g_strdup ("--no-wildcards");
+		argv[3] = g_strdup ("--no-unquote");
+		argv[4] = g_strdup ("-xOf");
+		argv[5] = g_strdup (comm->filename);
+		argv[6] = g_strdup ("--");
+		argv[7] = g_strdup (path);
+	}
+	else if (! is_program_in_path ("bash")) {
+		/* a failed decompressor would only truncate the output
+		 * without pipefail, the entry is extracted instead. */
+
+		argv = NULL;
+		g_free (tar);
+	}
+	else {
+		char *e_tar = g_shell_quote (tar);
+		char *e_filename = g_shell_quote (comm->filename);
+		char *e_path = g_shell_quote (path);
+
+		/* pipefail reports a corrupted stream instead of a truncated
+		 * content, the warnings of the decompressor and SIGPIPE are
+		 * not errors, as in fr_command_tar_rewrite(). */
+
+		argv = g_new0 (char *, 4);
+		argv[0] = g_strdup ("bash");
+		argv[1] = g_strdup ("-c");
+		argv[2] = g_strdup_printf ("set -o pipefail; ( %s < %s || case $? in %s) ;; *) exit 2 ;; esac ) | %s --force-local --no-wildcards --no-unquote -xOf - -- %s",
+					   decompress,
+					   e_filename,
+					   decompressor_has_warning_status (get_stream_mime_type (comm)) ? "2|141" : "141",
+					   e_tar,
+					   e_path);
+
+		g_free (e_path);
+		g_free (e_filename);
+		g_free (e_tar);
+		g_free (tar);
+	}
+
+	g_free (decompress);
+
+	return argv;
 }
 
 
@@ -1121,6 +1489,8 @@ fr_command_tar_get_packages (FrCommand  *comm,
 		return PACKAGES ("tar,xz");
 	else if (is_mime_type (mime_type, "application/x-lzop-compressed-tar"))
 		return PACKAGES ("tar,lzop");
+	else if (is_mime_type (mime_type, "application/x-zstd-compressed-tar"))
+		return PACKAGES ("tar,zstd");
 	else if (is_mime_type (mime_type, "application/x-7z-compressed-tar"))
 		return PACKAGES ("tar,p7zip");
 
@@ -1149,6 +1519,8 @@ fr_command_tar_class_init (FrCommandTarClass *class)
 	afc->set_mime_type    = fr_command_tar_set_mime_type;
 	afc->recompress       = fr_command_tar_recompress;
 	afc->uncompress       = fr_command_tar_uncompress;
+	afc->rewrite          = fr_command_tar_rewrite;
+	afc->get_stream_command = fr_command_tar_get_stream_command;
 	afc->get_packages     = fr_command_tar_get_packages;
 }
 
@@ -164,10 +164,8 @@ process_line__extract (char     *line,
 	if (unar_comm->n_line == 1)
 		return;
 
-	if (comm->n_files > 1) {
-		double fraction = (double) ++comm->n_file / (comm->n_files + 1);
-		fr_command_progress (comm, CLAMP (fraction, 0.0, 1.0));
-	}
+	if (comm->n_files > 1)
+		fr_command_file_progress (comm, NULL);
 	else
 		fr_command_message (comm, line);
 }
@@ -206,9 +206,11 @@ process_line__common (char     *line,
 	if (line == NULL)
 		return;
 
+	/* the lines are like "  inflating: name" */
+
 	if (comm->n_files != 0) {
-		double fraction = (double) ++comm->n_file / (comm->n_files + 1);
-		fr_command_progress (comm, fraction);
+		const char *name = strstr (line, ": ");
+		fr_command_file_progress (comm, (name != NULL) ? name + 2 : NULL);
 	}
 	else
 		fr_command_message (comm, line);
@@ -274,6 +276,27 @@ fr_command_zip_delete (FrCommand  *comm,
 				      process_line__common,
 				      comm);
 
+	if (from_file != NULL) {
+		char *e_from_file = g_shell_quote (from_file);
+
+		/* zip reads the names from the standard input, escape the
+		 * wildcards as for the command line. */
+
+		fr_process_begin_command (comm->process, "sh");
+		fr_process_add_arg (comm->process, "-c");
+		fr_process_add_arg_concat (comm->process,
+					   "sed 's/[][*?!^\\\\-]/\\\\&/g' < ",
+					   e_from_file,
+					   " | zip -d ",
+					   comm->e_filename,
+					   " -@",
+					   NULL);
+		fr_process_end_command (comm->process);
+
+		g_free (e_from_file);
+		return;
+	}
+
 	fr_process_begin_command (comm->process, "zip");
 	fr_process_add_arg (comm->process, "-d");
 
@@ -338,6 +361,28 @@ fr_command_zip_extract (FrCommand  *comm,
 }
 
 
+static char **
+fr_command_zip_get_stream_command (FrCommand  *comm,
+				   const char *path)
+{
+	GPtrArray *argv;
+
+	argv = g_ptr_array_new ();
+	g_ptr_array_add (argv, g_strdup ("unzip"));
+	g_ptr_array_add (argv, g_strdup ("-p"));
+	if ((comm->password != NULL) && (comm->password[0] != '\0')) {
+		g_ptr_array_add (argv, g_strdup ("-P"));
+		g_ptr_array_add (argv, g_strdup (comm->password));
+	}
+	g_ptr_array_add (argv, g_strdup ("--"));
+	g_ptr_array_add (argv, g_strdup (comm->filename));
+	g_ptr_array_add (argv, escape_str (path, ZIP_SPECIAL_CHARACTERS));
+	g_ptr_array_add (argv, NULL);
+
+	return (char **) g_ptr_array_free (argv, FALSE);
+}
+
+
 static void
 fr_command_zip_test (FrCommand   *comm)
 {
@@ -441,6 +486,7 @@ fr_command_zip_class_init (FrCommandZipClass *class)
 	afc->delete_           = fr_command_zip_delete;
 	afc->extract          = fr_command_zip_extract;
 	afc->test             = fr_command_zip_test;
+	afc->get_stream_command = fr_command_zip_get_stream_command;
 	afc->handle_error     = fr_command_zip_handle_error;
 	afc->get_mime_types   = fr_command_zip_get_mime_types;
 	afc->get_capabilities = fr_command_zip_get_capabilities;
@@ -459,6 +505,9 @@ fr_command_zip_init (FrCommand *comm)
 	comm->propExtractCanJunkPaths      = TRUE;
 	comm->propPassword                 = TRUE;
 	comm->propTest                     = TRUE;
+	comm->propDeleteFromFile           = TRUE;
+	comm->propExtractRandomAccess      = TRUE;
+	comm->propExtractToStdout          = TRUE;
 
 	FR_COMMAND_ZIP (comm)->is_empty = FALSE;
 }
@@ -162,6 +162,25 @@ base_fr_command_recompress (FrCommand *comm)
 }
 
 
+static void
+base_fr_command_rewrite (FrCommand  *comm,
+			 const char *source,
+			 const char *delete_from_file,
+			 const char *add_from_file,
+			 const char *base_dir,
+			 gboolean    recursive)
+{
+}
+
+
+static char **
+base_fr_command_get_stream_command (FrCommand  *comm,
+				    const char *path)
+{
+	return NULL;
+}
+
+
 static void
 base_fr_command_handle_error (FrCommand   *comm,
 			      FrProcError *error)
@@ -234,6 +253,8 @@ fr_command_done (FrProcess   *process,
 		return;
 	}
 
+	fr_command_set_compressor_choice (comm, NULL);
+
 	if (comm->action == FR_ACTION_LISTING_CONTENT) {
 		/* order the list by name to speed up search */
 		g_ptr_array_sort (comm->files, file_data_compare_by_path);
@@ -378,6 +399,8 @@ fr_command_class_init (FrCommandClass *class)
 	class->test             = base_fr_command_test;
 	class->uncompress       = base_fr_command_uncompress;
 	class->recompress       = base_fr_command_recompress;
+	class->rewrite          = base_fr_command_rewrite;
+	class->get_stream_command = base_fr_command_get_stream_command;
 	class->handle_error     = base_fr_command_handle_error;
 	class->get_mime_types   = base_fr_command_get_mime_types;
 	class->get_capabilities = base_fr_command_get_capabilities;
@@ -519,6 +542,20 @@ fr_command_init (FrCommand *comm)
 	comm->propCanDeleteNonEmptyFolders = TRUE;
 	comm->propCanExtractNonEmptyFolders = TRUE;
 	comm->propListFromFile = FALSE;
+	comm->propDeleteFromFile = FALSE;
+	comm->propStreamRewrite = FALSE;
+	comm->propExtractRandomAccess = FALSE;
+	comm->propExtractToStdout = FALSE;
+}
+
+
+static void
+clear_files_index (FrCommand *comm)
+{
+	if (comm->files_by_path != NULL) {
+		g_hash_table_unref (comm->files_by_path);
+		comm->files_by_path = NULL;
+	}
 }
 
 
@@ -535,6 +572,9 @@ fr_command_finalize (GObject *object)
 	g_free (comm->filename);
 	g_free (comm->e_filename);
 	g_free (comm->password);
+	g_free (comm->extract_dir);
+	compressor_choice_free (comm->compressor_choice);
+	clear_files_index (comm);
 	if (comm->files != NULL)
 		g_ptr_array_free_full (comm->files, (GFunc) file_data_free, NULL);
 	fr_command_set_process (comm, NULL);
@@ -618,12 +658,16 @@ fr_command_list (FrCommand *comm)
 		g_ptr_array_free_full (comm->files, (GFunc) file_data_free, NULL);
 		comm->files = g_ptr_array_sized_new (INITIAL_SIZE);
 	}
+	comm->n_regular_files = 0;
+	comm->files_size = 0;
+	clear_files_index (comm);
 
 	comm->action = FR_ACTION_LISTING_CONTENT;
 	fr_process_set_out_line_func (comm->process, NULL, NULL);
 	fr_process_set_err_line_func (comm->process, NULL, NULL);
 	fr_process_use_standard_locale (comm->process, TRUE);
 	comm->multi_volume = FALSE;
+	comm->solid = FALSE;
 
 	if (! comm->fake_load)
 		FR_COMMAND_GET_CLASS (G_OBJECT (comm))->list (comm);
@@ -636,6 +680,43 @@ fr_command_list (FrCommand *comm)
 }
 
 
+/* Lists the archive from file_list, the FileData read without running the
+ * command, as fr_command_list does.  Takes ownership of the elements. */
+void
+fr_command_list_from_data (FrCommand *comm,
+			   GPtrArray *file_list)
+{
+	FrProcError error;
+	guint       i;
+
+	g_return_if_fail (FR_IS_COMMAND (comm));
+
+	if (comm->files != NULL)
+		g_ptr_array_free_full (comm->files, (GFunc) file_data_free, NULL);
+	comm->files = g_ptr_array_sized_new (MAX (file_list->len, INITIAL_SIZE));
+	comm->n_regular_files = 0;
+	comm->files_size = 0;
+	clear_files_index (comm);
+
+	comm->action = FR_ACTION_LISTING_CONTENT;
+	comm->multi_volume = FALSE;
+	comm->solid = FALSE;
+
+	for (i = 0; i < file_list->len; i++)
+		fr_command_add_file (comm, g_ptr_array_index (file_list, i));
+	g_ptr_array_sort (comm->files, file_data_compare_by_path);
+
+	error.type = FR_PROC_ERROR_NONE;
+	error.status = 0;
+	error.gerror = NULL;
+	g_signal_emit (G_OBJECT (comm),
+		       fr_command_signals[DONE],
+		       0,
+		       comm->action,
+		       &error);
+}
+
+
 void
 fr_command_add (FrCommand     *comm,
 		const char    *from_file,
@@ -689,6 +770,9 @@ fr_command_extract (FrCommand  *comm,
 	fr_process_set_out_line_func (FR_COMMAND (comm)->process, NULL, NULL);
 	fr_process_set_err_line_func (FR_COMMAND (comm)->process, NULL, NULL);
 
+	g_free (comm->extract_dir);
+	comm->extract_dir = g_strdup (dest_dir);
+
 	FR_COMMAND_GET_CLASS (G_OBJECT (comm))->extract (comm,
 							 from_file,
 							 file_list,
@@ -728,6 +812,46 @@ fr_command_recompress (FrCommand *comm)
 }
 
 
+/* Writes to comm->filename the archive source without the files listed
+ * in delete_from_file and with the files listed in add_from_file, in a
+ * single pass.  Only available when propStreamRewrite is set. */
+void
+fr_command_rewrite (FrCommand  *comm,
+		    const char *source,
+		    const char *delete_from_file,
+		    const char *add_from_file,
+		    const char *base_dir,
+		    gboolean    recursive)
+{
+	fr_command_progress (comm, -1.0);
+
+	comm->action = (add_from_file != NULL) ? FR_ACTION_ADDING_FILES : FR_ACTION_DELETING_FILES;
+	fr_process_set_out_line_func (FR_COMMAND (comm)->process, NULL, NULL);
+	fr_process_set_err_line_func (FR_COMMAND (comm)->process, NULL, NULL);
+
+	FR_COMMAND_GET_CLASS (G_OBJECT (comm))->rewrite (comm,
+							 source,
+							 delete_from_file,
+							 add_from_file,
+							 base_dir,
+							 recursive);
+}
+
+
+/* Returns the command line that writes the content of the file path of
+ * the archive to the standard output, or NULL if not available.  Only
+ * available when propExtractToStdout is set, free with g_strfreev(). */
+char **
+fr_command_get_stream_command (FrCommand  *comm,
+			       const char *path)
+{
+	if (! comm->propExtractToStdout || comm->multi_volume)
+		return NULL;
+
+	return FR_COMMAND_GET_CLASS (G_OBJECT (comm))->get_stream_command (comm, path);
+}
+
+
 const char **
 fr_command_get_mime_types (FrCommand *comm)
 {
@@ -812,6 +936,104 @@ fr_command_set_n_files (FrCommand *comm,
 {
 	comm->n_files = n_files;
 	comm->n_file = 0;
+	comm->n_bytes = 0;
+	comm->n_byte = 0;
+}
+
+
+void
+fr_command_set_n_bytes (FrCommand *comm,
+			goffset    n_bytes)
+{
+	comm->n_bytes = n_bytes;
+	comm->n_byte = 0;
+}
+
+
+/* takes ownership of choice, the previous one is freed: an operation
+ * queues a single compression command. */
+void
+fr_command_set_compressor_choice (FrCommand        *comm,
+				  CompressorChoice *choice)
+{
+	compressor_choice_free (comm->compressor_choice);
+	comm->compressor_choice = choice;
+}
+
+
+static FileData *
+find_progress_file (FrCommand  *comm,
+		    const char *path)
+{
+	char       *name;
+	const char *relative_name;
+	FileData   *fdata;
+	guint       i;
+
+	name = g_strchomp (g_strdup (path));
+
+	/* the commands print the destination before the extracted files */
+
+	relative_name = name;
+	if ((comm->extract_dir != NULL) && g_str_has_prefix (name, comm->extract_dir)) {
+		relative_name = name + strlen (comm->extract_dir);
+		while (*relative_name == '/')
+			relative_name++;
+	}
+
+	/* comm->files is sorted by full_path, the commands print the
+	 * original_path */
+
+	if (comm->files_by_path == NULL) {
+		comm->files_by_path = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 0; i < comm->files->len; i++) {
+			FileData *file = g_ptr_array_index (comm->files, i);
+			g_hash_table_insert (comm->files_by_path, file->original_path, file);
+		}
+	}
+
+	fdata = g_hash_table_lookup (comm->files_by_path, relative_name);
+	if ((fdata == NULL) && (*relative_name != '\0')) {
+		/* folders are stored with a trailing slash */
+		char *dir_name = g_strconcat (relative_name, "/", NULL);
+		fdata = g_hash_table_lookup (comm->files_by_path, dir_name);
+		g_free (dir_name);
+	}
+	g_free (name);
+
+	return fdata;
+}
+
+
+/* Reports the progress after the command processed the file path, NULL
+ * if unknown.  When the size of the files is known the progress is
+ * weighted by the size of the file, a file not in the list counts as a
+ * file of average size. */
+void
+fr_command_file_progress (FrCommand  *comm,
+			  const char *path)
+{
+	double fraction;
+
+	comm->n_file++;
+
+	if (comm->n_bytes > 0) {
+		FileData *fdata = NULL;
+
+		if ((path != NULL) && (comm->files != NULL))
+			fdata = find_progress_file (comm, path);
+
+		if (fdata != NULL)
+			comm->n_byte += fdata->size;
+		else if (comm->n_files > 0)
+			comm->n_byte += comm->n_bytes / comm->n_files;
+
+		fraction = MIN ((double) comm->n_byte / comm->n_bytes, 1.0);
+	}
+	else
+		fraction = MIN ((double) comm->n_file / (comm->n_files + 1), 1.0);
+
+	fr_command_progress (comm, fraction);
 }
 
 
@@ -821,8 +1043,12 @@ fr_command_add_file (FrCommand *comm,
 {
 	file_data_update_content_type (fdata);
 	g_ptr_array_add (comm->files, fdata);
-	if (! fdata->dir)
+	if (! fdata->dir) {
 		comm->n_regular_files++;
+		if (fdata->size > 0)
+			comm->files_size += fdata->size;
+	}
+	clear_files_index (comm);
 }
 
 
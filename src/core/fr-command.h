@@ -28,6 +28,7 @@
 
 #include "file-data.h"
 #include "fr-process.h"
+#include "compress-utils.h"
 
 #define PACKAGES(x) (x)
 
@@ -73,12 +74,16 @@ struct _FrCommand
 
 	GPtrArray     *files;           /* Array of FileData* */
 	int            n_regular_files;
+	goffset        files_size;      /* sum of the size of the files */
 	FrProcess     *process;         /* the process object used to execute
 				         * commands. */
 	char          *filename;        /* archive file path. */
 	char          *e_filename;      /* escaped archive filename. */
 	const char    *mime_type;
 	gboolean       multi_volume;
+	gboolean       solid;           /* whether the files are compressed
+					 * together, so that each one is read
+					 * by decompressing the previous ones. */
 
 	/*<protected>*/
 
@@ -104,6 +109,10 @@ struct _FrCommand
 	guint          propCanDeleteNonEmptyFolders : 1;
 	guint          propCanExtractNonEmptyFolders : 1;
 	guint          propListFromFile : 1;
+	guint          propDeleteFromFile : 1;
+	guint          propStreamRewrite : 1;
+	guint          propExtractRandomAccess : 1;
+	guint          propExtractToStdout : 1;
 
 	/*<private>*/
 
@@ -116,6 +125,17 @@ struct _FrCommand
 
 	int            n_file;
 	int            n_files;
+	goffset        n_byte;
+	goffset        n_bytes;         /* size of the files of the operation,
+					 * 0 if unknown. */
+	char          *extract_dir;     /* destination of the extraction, as
+					 * printed before the file names. */
+	GHashTable    *files_by_path;   /* original_path -> FileData, built
+					 * by the first progress lookup. */
+
+	CompressorChoice *compressor_choice; /* the adaptive compression
+					      * queued by the current
+					      * operation, NULL if none. */
 };
 
 struct _FrCommandClass
@@ -144,6 +164,14 @@ struct _FrCommandClass
 	void          (*test)             (FrCommand     *comm);
 	void          (*uncompress)       (FrCommand     *comm);
 	void          (*recompress)       (FrCommand     *comm);
+	void          (*rewrite)          (FrCommand     *comm,
+					   const char    *source,
+					   const char    *delete_from_file,
+					   const char    *add_from_file,
+					   const char    *base_dir,
+					   gboolean       recursive);
+	char **       (*get_stream_command) (FrCommand   *comm,
+					   const char    *path);
 	void          (*handle_error)     (FrCommand     *comm,
 				           FrProcError   *error);
 	const char ** (*get_mime_types)   (FrCommand     *comm);
@@ -176,6 +204,8 @@ void           fr_command_set_file            (FrCommand     *comm,
 void           fr_command_set_multi_volume    (FrCommand     *comm,
 					       GFile         *file);
 void           fr_command_list                (FrCommand     *comm);
+void           fr_command_list_from_data      (FrCommand     *comm,
+					       GPtrArray     *file_list);
 void           fr_command_add                 (FrCommand     *comm,
 					       const char    *from_file,
 					       GList         *file_list,
@@ -195,6 +225,14 @@ void           fr_command_extract             (FrCommand     *comm,
 void           fr_command_test                (FrCommand     *comm);
 void           fr_command_uncompress          (FrCommand     *comm);
 void           fr_command_recompress          (FrCommand     *comm);
+void           fr_command_rewrite             (FrCommand     *comm,
+					       const char    *source,
+					       const char    *delete_from_file,
+					       const char    *add_from_file,
+					       const char    *base_dir,
+					       gboolean       recursive);
+char **        fr_command_get_stream_command  (FrCommand     *comm,
+					       const char    *path);
 gboolean       fr_command_is_capable_of       (FrCommand     *comm,
 					       FrCommandCaps  capabilities);
 const char **  fr_command_get_mime_types      (FrCommand     *comm);
@@ -219,8 +257,15 @@ void           fr_command_working_archive     (FrCommand     *comm,
 		                               const char    *archive_name);
 void           fr_command_set_n_files         (FrCommand     *comm,
 					       int            n_files);
+void           fr_command_set_n_bytes         (FrCommand     *comm,
+					       goffset        n_bytes);
+void           fr_command_file_progress       (FrCommand     *comm,
+					       const char    *path);
 void           fr_command_add_file            (FrCommand     *comm,
 					       FileData      *fdata);
+void           fr_command_set_compressor_choice
+					      (FrCommand        *comm,
+					       CompressorChoice *choice);
 
 /* private functions */
 
@@ -100,7 +100,9 @@ FrMimeTypeDescription mime_type_desc[] = {
 	{ "application/x-xz",                   ".xz",       N_("Xz (.xz)"), 0 },
 	{ "application/x-xz-compressed-tar",    ".tar.xz",   N_("Tar compressed with xz (.tar.xz)"), 0 },
 	{ "application/x-zoo",                  ".zoo",      N_("Zoo (.zoo)"), 0 },
+	{ "application/x-zstd-compressed-tar",  ".tar.zst",  N_("Tar compressed with zstd (.tar.zst)"), 0 },
 	{ "application/zip",                    ".zip",      N_("Zip (.zip)"), 0 },
+	{ "application/zstd",                   ".zst",      NULL, 0 },
 	{ NULL, NULL, NULL, 0 }
 };
 
@@ -145,6 +147,7 @@ FrExtensionType file_ext_type[] = {
 	{ ".tar.lzo", "application/x-lzop-compressed-tar" },
 	{ ".tar.7z", "application/x-7z-compressed-tar" },
 	{ ".tar.xz", "application/x-xz-compressed-tar" },
+	{ ".tar.zst", "application/x-zstd-compressed-tar" },
 	{ ".tar.Z", "application/x-tarz" },
 	{ ".taz", "application/x-tarz" },
 	{ ".tbz", "application/x-bzip-compressed-tar" },
@@ -154,6 +157,7 @@ FrExtensionType file_ext_type[] = {
 	{ ".tlz", "application/x-lzip-compressed-tar" },
 	{ ".tzma", "application/x-lzma-compressed-tar" },
 	{ ".tzo", "application/x-lzop-compressed-tar" },
+	{ ".tzst", "application/x-zstd-compressed-tar" },
 	{ ".war", "application/x-war" },
 	{ ".wim", "application/x-ms-wim" },
 	{ ".xz", "application/x-xz" },
@@ -161,6 +165,7 @@ FrExtensionType file_ext_type[] = {
 	{ ".Z", "application/x-compress" },
 	{ ".zip", "application/zip" },
 	{ ".zoo", "application/x-zoo" },
+	{ ".zst", "application/zstd" },
 	{ NULL, NULL }
 };
 
@@ -62,6 +62,11 @@ typedef struct {
 	guint         ignore_error : 1;  /* whether to continue to execute
 					  * other commands if this command
 					  * fails. */
+	guint         parallel : 1;      /* whether the command runs at the
+					  * same time as the adjacent
+					  * parallel commands. */
+	guint         parallel_group;    /* only the commands of the same
+					  * group run at the same time. */
 	ContinueFunc  continue_func;
 	gpointer      continue_data;
 	ProcFunc      begin_func;
@@ -81,6 +86,7 @@ fr_command_info_new (void)
 	info->dir = NULL;
 	info->sticky = FALSE;
 	info->ignore_error = FALSE;
+	info->parallel = FALSE;
 
 	return info;
 }
@@ -202,6 +208,49 @@ fr_channel_data_set_fd (FrChannelData *channel,
 }
 
 
+/* a command started along with the current one, see
+ * fr_process_set_parallel. */
+typedef struct {
+	GPid           pid;
+	gboolean       exited;
+	int            status;
+	GError        *spawn_error;
+	FrChannelData  out;
+	FrChannelData  err;
+} FrParallelChild;
+
+
+static FrParallelChild *
+fr_parallel_child_new (FrProcess *process)
+{
+	FrParallelChild *child;
+
+	child = g_new0 (FrParallelChild, 1);
+	fr_channel_data_init (&child->out);
+	fr_channel_data_init (&child->err);
+	child->out.line_func = process->out.line_func;
+	child->out.line_data = process->out.line_data;
+	child->err.line_func = process->err.line_func;
+	child->err.line_data = process->err.line_data;
+
+	return child;
+}
+
+
+static void
+fr_parallel_child_free (FrParallelChild *child)
+{
+	if ((child->pid > 0) && ! child->exited) {
+		killpg (child->pid, SIGTERM);
+		waitpid (child->pid, NULL, 0);
+	}
+	g_clear_error (&child->spawn_error);
+	fr_channel_data_free (&child->out);
+	fr_channel_data_free (&child->err);
+	g_free (child);
+}
+
+
 const char *try_charsets[] = { "UTF-8", "ISO-8859-1", "WINDOW-1252" };
 int n_charsets = G_N_ELEMENTS (try_charsets);
 
@@ -212,6 +261,11 @@ struct _FrProcessPrivate {
 	gint         current_comm;        /* currenlty editing command. */
 
 	GPid         command_pid;
+	gboolean     command_exited;
+	int          command_status;
+	GPtrArray   *children;            /* FrParallelChild elements, the
+					   * commands running along with the
+					   * current one. */
 	guint        check_timeout;
 
 	FrProcError  first_error;
@@ -308,6 +362,7 @@ fr_process_init (FrProcess *process)
 	process->priv->current_comm = -1;
 
 	process->priv->command_pid = 0;
+	process->priv->children = g_ptr_array_new_with_free_func ((GDestroyNotify) fr_parallel_child_free);
 	fr_channel_data_init (&process->out);
 	fr_channel_data_init (&process->err);
 
@@ -349,6 +404,7 @@ fr_process_finalize (GObject *object)
 	fr_process_clear (process);
 
 	g_ptr_array_free (process->priv->comm, FALSE);
+	g_ptr_array_free (process->priv->children, TRUE);
 
 	fr_channel_data_free (&process->out);
 	fr_channel_data_free (&process->err);
@@ -451,6 +507,41 @@ fr_process_set_ignore_error (FrProcess *process,
 }
 
 
+/* Runs the command at the same time as the adjacent commands that are
+ * parallel too and in the same group, the next command starts when all
+ * of them are done.  The output lines of all the commands are passed to
+ * the line functions and the first error is reported. */
+void
+fr_process_set_parallel (FrProcess *process,
+			 gboolean   parallel)
+{
+	FrCommandInfo *info;
+
+	g_return_if_fail (process != NULL);
+	g_return_if_fail (process->priv->current_comm >= 0);
+
+	info = g_ptr_array_index (process->priv->comm, process->priv->current_comm);
+	info->parallel = parallel;
+}
+
+
+/* Like fr_process_set_parallel (process, TRUE), adjacent groups of
+ * parallel commands run one after the other. */
+void
+fr_process_set_parallel_group (FrProcess *process,
+			       guint      group)
+{
+	FrCommandInfo *info;
+
+	g_return_if_fail (process != NULL);
+	g_return_if_fail (process->priv->current_comm >= 0);
+
+	info = g_ptr_array_index (process->priv->comm, process->priv->current_comm);
+	info->parallel = TRUE;
+	info->parallel_group = group;
+}
+
+
 void
 fr_process_add_arg (FrProcess  *process,
 		    const char *arg)
@@ -667,6 +758,64 @@ fr_process_get_charset (FrProcess *process)
 }
 
 
+static void
+start_parallel_commands (FrProcess *process)
+{
+	FrCommandInfo *current_info;
+	int            i;
+
+	current_info = g_ptr_array_index (process->priv->comm, process->priv->current_command);
+	for (i = process->priv->current_command + 1; i <= process->priv->n_comm; i++) {
+		FrCommandInfo    *info;
+		FrParallelChild  *child;
+		GList            *scan;
+		char            **argv;
+		int               out_fd, err_fd;
+		int               n = 0;
+
+		info = g_ptr_array_index (process->priv->comm, i);
+		if (! info->parallel || (info->parallel_group != current_info->parallel_group))
+			break;
+
+		child = fr_parallel_child_new (process);
+		g_ptr_array_add (process->priv->children, child);
+
+		argv = g_new (char *, g_list_length (info->args) + 1);
+		for (scan = info->args; scan; scan = scan->next)
+			argv[n++] = scan->data;
+		argv[n] = NULL;
+
+		if (info->begin_func != NULL)
+			(*info->begin_func) (info->begin_data);
+
+		if (! g_spawn_async_with_pipes (info->dir,
+						argv,
+						NULL,
+						(G_SPAWN_LEAVE_DESCRIPTORS_OPEN
+						 | G_SPAWN_SEARCH_PATH
+						 | G_SPAWN_DO_NOT_REAP_CHILD),
+						child_setup,
+						process,
+						&child->pid,
+						NULL,
+						&out_fd,
+						&err_fd,
+						&child->spawn_error))
+		{
+			/* reported when the other commands are done */
+			child->exited = TRUE;
+			g_free (argv);
+			continue;
+		}
+
+		g_free (argv);
+
+		fr_channel_data_set_fd (&child->out, out_fd, fr_process_get_charset (process));
+		fr_channel_data_set_fd (&child->err, err_fd, fr_process_get_charset (process));
+	}
+}
+
+
 static void
 start_current_command (FrProcess *process)
 {
@@ -743,6 +892,8 @@ start_current_command (FrProcess *process)
 	if (info->begin_func != NULL)
 		(*info->begin_func) (info->begin_data);
 
+	process->priv->command_exited = FALSE;
+
 	if (! g_spawn_async_with_pipes (info->dir,
 					argv,
 					NULL,
@@ -771,6 +922,9 @@ start_current_command (FrProcess *process)
 	fr_channel_data_set_fd (&process->out, out_fd, fr_process_get_charset (process));
 	fr_channel_data_set_fd (&process->err, err_fd, fr_process_get_charset (process));
 
+	if (info->parallel)
+		start_parallel_commands (process);
+
 	process->priv->check_timeout = g_timeout_add (REFRESH_RATE,
 					              check_child,
 					              process);
@@ -826,6 +980,113 @@ fr_process_set_error (FrProcess       *process,
 }
 
 
+/* reads the output of the commands started along with the current one
+ * and reaps the ones that exited.  Returns FALSE on a read error. */
+static gboolean
+read_parallel_children (FrProcess *process)
+{
+	guint i;
+
+	for (i = 0; i < process->priv->children->len; i++) {
+		FrParallelChild *child = g_ptr_array_index (process->priv->children, i);
+
+		if ((child->out.source != NULL) && (fr_channel_data_read (&child->out) == G_IO_STATUS_ERROR)) {
+			fr_process_set_error (process, FR_PROC_ERROR_IO_CHANNEL, 0, child->out.error);
+			return FALSE;
+		}
+		if ((child->err.source != NULL) && (fr_channel_data_read (&child->err) == G_IO_STATUS_ERROR)) {
+			fr_process_set_error (process, FR_PROC_ERROR_IO_CHANNEL, 0, child->err.error);
+			return FALSE;
+		}
+		if (! child->exited && (waitpid (child->pid, &child->status, WNOHANG) == child->pid))
+			child->exited = TRUE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean
+parallel_children_exited (FrProcess *process)
+{
+	guint i;
+
+	for (i = 0; i < process->priv->children->len; i++) {
+		FrParallelChild *child = g_ptr_array_index (process->priv->children, i);
+
+		if (! child->exited)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/* returns the exit status of the first command of the group that
+ * failed, or the successful status. */
+static int
+get_parallel_status (FrProcess *process,
+		     int        status)
+{
+	guint i;
+
+	for (i = 0; i < process->priv->children->len; i++) {
+		FrParallelChild *child = g_ptr_array_index (process->priv->children, i);
+
+		if (! WIFEXITED (status) || (WEXITSTATUS (status) != 0))
+			break;
+		status = child->status;
+	}
+
+	return status;
+}
+
+
+static GError *
+get_parallel_spawn_error (FrProcess *process)
+{
+	guint i;
+
+	for (i = 0; i < process->priv->children->len; i++) {
+		FrParallelChild *child = g_ptr_array_index (process->priv->children, i);
+
+		if (child->spawn_error != NULL)
+			return child->spawn_error;
+	}
+
+	return NULL;
+}
+
+
+/* reads the remaining output and adds it to the output of the process. */
+static gboolean
+flush_parallel_children (FrProcess *process)
+{
+	gboolean result = TRUE;
+	guint    i;
+
+	for (i = 0; i < process->priv->children->len; i++) {
+		FrParallelChild *child = g_ptr_array_index (process->priv->children, i);
+
+		if (result && (child->out.source != NULL) && (fr_channel_data_flush (&child->out) == G_IO_STATUS_ERROR)) {
+			fr_process_set_error (process, FR_PROC_ERROR_IO_CHANNEL, 0, child->out.error);
+			result = FALSE;
+		}
+		else if (result && (child->err.source != NULL) && (fr_channel_data_flush (&child->err) == G_IO_STATUS_ERROR)) {
+			fr_process_set_error (process, FR_PROC_ERROR_IO_CHANNEL, 0, child->err.error);
+			result = FALSE;
+		}
+
+		process->out.raw = g_list_concat (child->out.raw, process->out.raw);
+		child->out.raw = NULL;
+		process->err.raw = g_list_concat (child->err.raw, process->err.raw);
+		child->err.raw = NULL;
+	}
+
+	return result;
+}
+
+
 static gint
 check_child (gpointer data)
 {
@@ -835,6 +1096,8 @@ check_child (gpointer data)
 	int             status;
 	gboolean        continue_process;
 	gboolean        channel_error = FALSE;
+	guint           n_parallel;
+	guint           i;
 
 	info = g_ptr_array_index (process->priv->comm, process->priv->current_command);
 
@@ -851,15 +1114,22 @@ check_child (gpointer data)
 		fr_process_set_error (process, FR_PROC_ERROR_IO_CHANNEL, 0, process->err.error);
 		channel_error = TRUE;
 	}
+	else if (! read_parallel_children (process)) {
+		channel_error = TRUE;
+	}
 	else {
-		pid = waitpid (process->priv->command_pid, &status, WNOHANG);
-		if (pid != process->priv->command_pid) {
+		if (! process->priv->command_exited) {
+			pid = waitpid (process->priv->command_pid, &process->priv->command_status, WNOHANG);
+			process->priv->command_exited = (pid == process->priv->command_pid);
+		}
+		if (! process->priv->command_exited || ! parallel_children_exited (process)) {
 			/* Add check again. */
 			process->priv->check_timeout = g_timeout_add (REFRESH_RATE,
 							              check_child,
 							              process);
 			return FALSE;
 		}
+		status = get_parallel_status (process, process->priv->command_status);
 	}
 
 	if (info->ignore_error) {
@@ -881,6 +1151,9 @@ check_child (gpointer data)
 			process->error.type = FR_PROC_ERROR_EXITED_ABNORMALLY;
 			process->error.status = 255;
 		}
+
+		if ((process->error.type == FR_PROC_ERROR_NONE) && (get_parallel_spawn_error (process) != NULL))
+			fr_process_set_error (process, FR_PROC_ERROR_SPAWN, 0, get_parallel_spawn_error (process));
 	}
 
 	process->priv->command_pid = 0;
@@ -893,10 +1166,22 @@ check_child (gpointer data)
 		fr_process_set_error (process, FR_PROC_ERROR_IO_CHANNEL, 0, process->err.error);
 		channel_error = TRUE;
 	}
+	else if (! flush_parallel_children (process))
+		channel_error = TRUE;
 
 	if (info->end_func != NULL)
 		(*info->end_func) (info->end_data);
 
+	n_parallel = process->priv->children->len;
+	for (i = 1; i <= n_parallel; i++) {
+		FrCommandInfo *parallel_info;
+
+		parallel_info = g_ptr_array_index (process->priv->comm, process->priv->current_command + i);
+		if (parallel_info->end_func != NULL)
+			(*parallel_info->end_func) (parallel_info->end_data);
+	}
+	g_ptr_array_set_size (process->priv->children, 0);
+
 	/**/
 
 	if (channel_error
@@ -936,6 +1221,8 @@ check_child (gpointer data)
 #endif
 		}
 
+		process->priv->current_command += n_parallel;
+
 		if (process->priv->sticky_only) {
 			do {
 				process->priv->current_command++;
@@ -1046,8 +1333,17 @@ fr_process_stop_priv (FrProcess *process,
 	if (command_is_sticky (process, process->priv->current_command))
 		allow_sticky_processes_only (process, emit_signal);
 
-	else if (process->term_on_stop && (process->priv->command_pid > 0))
+	else if (process->term_on_stop && (process->priv->command_pid > 0)) {
+		guint i;
+
 		killpg (process->priv->command_pid, SIGTERM);
+		for (i = 0; i < process->priv->children->len; i++) {
+			FrParallelChild *child = g_ptr_array_index (process->priv->children, i);
+
+			if (! child->exited)
+				killpg (child->pid, SIGTERM);
+		}
+	}
 
 	else {
 		if (process->priv->check_timeout != 0) {
@@ -1058,6 +1354,7 @@ fr_process_stop_priv (FrProcess *process,
 		process->priv->command_pid = 0;
 		fr_channel_data_close_source (&process->out);
 		fr_channel_data_close_source (&process->err);
+		g_ptr_array_set_size (process->priv->children, 0);
 
 		process->priv->running = FALSE;
 
@@ -121,6 +121,10 @@ void        fr_process_set_sticky           (FrProcess    *fr_proc,
 					     gboolean      sticky);
 void        fr_process_set_ignore_error     (FrProcess    *fr_proc,
 					     gboolean      ignore_error);
+void        fr_process_set_parallel         (FrProcess    *fr_proc,
+					     gboolean      parallel);
+void        fr_process_set_parallel_group   (FrProcess    *fr_proc,
+					     guint         group);
 void        fr_process_use_standard_locale  (FrProcess    *fr_proc,
 					     gboolean      use_stand_locale);
 void        fr_process_set_out_line_func    (FrProcess    *fr_proc,
@@ -20,21 +20,20 @@
  *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
  */
  
-#include <fcntl.h>
-#include <unistd.h>
-#include <errno.h>
 #include <string.h>
 #include <glib.h>
 #include "java-utils.h"
 
 
 /* 
- * The following code conforms to the JVM specification.(Java 2 Platform)
+ * The following code conforms to the JVM specification.(Java SE 17)
  * For further changes to the classfile structure, please update the 
  * following macros.
  */
 
 
+#define CLASS_MAGIC				0xCAFEBABE
+
 /* Tags that identify structures */
 
 #define CONST_CLASS				 7
@@ -48,6 +47,12 @@
 #define CONST_DOUBLE				 6
 #define CONST_NAMEANDTYPE			12
 #define CONST_UTF8				 1
+#define CONST_METHODHANDLE			15
+#define CONST_METHODTYPE			16
+#define CONST_DYNAMIC				17
+#define CONST_INVOKEDYNAMIC			18
+#define CONST_MODULE				19
+#define CONST_PACKAGE				20
 
 /* Sizes of structures */
 
@@ -61,185 +66,150 @@
 #define CONST_LONG_INFO				 8
 #define CONST_DOUBLE_INFO			 8
 #define CONST_NAMEANDTYPE_INFO			 4
+#define CONST_METHODHANDLE_INFO			 3
+#define CONST_METHODTYPE_INFO			 2
+#define CONST_DYNAMIC_INFO			 4
+#define CONST_INVOKEDYNAMIC_INFO		 4
+#define CONST_MODULE_INFO			 2
+#define CONST_PACKAGE_INFO			 2
+
+
+#define JAVA_FILES_PER_THREAD			64  /* do not start threads for
+						     * fewer files */
 
 
-/* represents the utf8 strings in class file */
-struct utf_string	
+static guint16
+get_u16 (const guint8 *data)
 {
-	guint16  index;
-	guint16  length;
-	char    *str;
-};
+	return (data[0] << 8) | data[1];
+}
+
 
-/* structure that holds class information in a class file */
-struct class_info
+static guint32
+get_u32 (const guint8 *data)
 {
-	guint16 index;
-	guint16 name_index; /* index into the utf_strings */
-};
+	return ((guint32) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
 
-typedef struct {
-	int     fd;
-	
-	guint32 magic_no;		/* 0xCAFEBABE (JVM Specification) :) */
-
-	guint16 major;			/* versions */
-	guint16 minor;
-
-	guint16 const_pool_count;
-	GSList *const_pool_class;	/* (const_pool_count - 1) elements of tye 'CONST_class_info' */
-	GSList *const_pool_utf;		/* (const_pool_count - 1) elements of type 'utf_strings' */
-
-	guint16 access_flags;
-	guint16 this_class;		/* the index of the class the file is named after. */
-	
-#if 0 /* not needed */
-	guint16         super_class;
-	guint16         interfaces_count;
-	guint16        *interfaces;
-	guint16         fields_count;
-	field_info     *fields;
-	guint16         methods_count;
-	method_info    *methods;
-	guint16         attributes_count;
-	attribute_info *attributes;
-#endif
-} JavaClassFile;
-
-
-static JavaClassFile*
-java_class_file_new (void)
+
+/* Returns the size of the data that follows the tag of a constant pool
+ * entry, or 0 if the tag is not known. */
+static gsize
+get_constant_size (const guint8 *data,
+		   gsize         size,
+		   gsize         pos)
 {
-	JavaClassFile *cfile;
-	
-	cfile = g_new0 (JavaClassFile, 1);
-	cfile->fd = -1;
-	
-	return cfile;
+	switch (data[pos]) {
+	case CONST_UTF8:
+		if (pos + 3 > size)
+			return 0;
+		return 2 + get_u16 (data + pos + 1);
+	case CONST_CLASS:
+		return CONST_CLASS_INFO;
+	case CONST_FIELDREF:
+		return CONST_FIELDREF_INFO;
+	case CONST_METHODREF:
+		return CONST_METHODREF_INFO;
+	case CONST_INTERFACEMETHODREF:
+		return CONST_INTERFACEMETHODREF_INFO;
+	case CONST_STRING:
+		return CONST_STRING_INFO;
+	case CONST_INTEGER:
+		return CONST_INTEGER_INFO;
+	case CONST_FLOAT:
+		return CONST_FLOAT_INFO;
+	case CONST_LONG:
+		return CONST_LONG_INFO;
+	case CONST_DOUBLE:
+		return CONST_DOUBLE_INFO;
+	case CONST_NAMEANDTYPE:
+		return CONST_NAMEANDTYPE_INFO;
+	case CONST_METHODHANDLE:
+		return CONST_METHODHANDLE_INFO;
+	case CONST_METHODTYPE:
+		return CONST_METHODTYPE_INFO;
+	case CONST_DYNAMIC:
+		return CONST_DYNAMIC_INFO;
+	case CONST_INVOKEDYNAMIC:
+		return CONST_INVOKEDYNAMIC_INFO;
+	case CONST_MODULE:
+		return CONST_MODULE_INFO;
+	case CONST_PACKAGE:
+		return CONST_PACKAGE_INFO;
+	default:
+		return 0;
+	}
 }
 
 
-static void
-java_class_file_free (JavaClassFile *cfile)
+/* Reads the constant pool in a single pass, keeping the position of each
+ * entry, then looks up the name of this_class, which follows the pool. */
+static char *
+get_package_name_from_class_data (const guint8 *data,
+				  gsize         size)
 {
-	GSList *scan;
+	char       *package = NULL;
+	guint32    *entries;	/* position of the entry tags, by index */
+	guint16     count;
+	guint16     this_class;
+	guint16     name_index;
+	guint16     length;
+	gsize       pos;
+	guint       i;
+	const char *name;
+	const char *slash;
+
+	/* magic, minor and major version, constant pool count */
+
+	if ((size < 10) || (get_u32 (data) != CLASS_MAGIC))
+		return NULL;
+	count = get_u16 (data + 8);
 
-	if (cfile->const_pool_class != NULL) {
-		g_slist_foreach (cfile->const_pool_class, (GFunc)g_free, NULL);
-		g_slist_free (cfile->const_pool_class);
-	}
+	entries = g_new0 (guint32, MAX (count, 1));
+	pos = 10;
+	for (i = 1; i < count; i++) {
+		gsize entry_size;
 
-	for (scan = cfile->const_pool_utf; scan ; scan = scan->next) {
-		struct utf_string *string = scan->data;
-		g_free (string->str);
-	}
-	
-	if (cfile->const_pool_utf != NULL) {
-		g_slist_foreach (cfile->const_pool_utf, (GFunc)g_free, NULL);
-		g_slist_free (cfile->const_pool_utf);
-	}
+		if (pos >= size)
+			goto out;
 
-	if (cfile->fd != -1)
-		close (cfile->fd);
+		entry_size = get_constant_size (data, size, pos);
+		if (entry_size == 0)
+			goto out;	/* unknown tag */
 
-	g_free (cfile);
-}
+		entries[i] = pos;
 
+		/* 8 byte constants take two entries */
+		if ((data[pos] == CONST_LONG) || (data[pos] == CONST_DOUBLE))
+			i++;
 
-/* The following function loads the utf8 strings and class structures from the 
- * class file. */
-static void
-load_constant_pool_utfs (JavaClassFile *cfile)
-{
-	guint8  tag;
-	guint16 i = 0;		/* should be comparable with const_pool_count */
-	
-	while ((i < cfile->const_pool_count - 1) && (read (cfile->fd, &tag, 1) != -1)) {
-		struct utf_string *txt = NULL;
-		struct class_info *class = NULL;
-		
-		switch (tag) {
-		case CONST_CLASS:
-			class = g_new0 (struct class_info, 1);
-			class->index = i + 1;
-			if (read (cfile->fd, &class->name_index, 2) != 2) {
-				g_free (class);
-				return;	/* error reading */
-			}
-			class->name_index = GUINT16_FROM_BE (class->name_index);
-			cfile->const_pool_class = g_slist_append (cfile->const_pool_class, class);
-			break;
-		
-		case CONST_FIELDREF:
-			lseek (cfile->fd, CONST_FIELDREF_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_METHODREF:
-			lseek (cfile->fd, CONST_METHODREF_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_INTERFACEMETHODREF:
-			lseek (cfile->fd, CONST_INTERFACEMETHODREF_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_STRING:
-			lseek (cfile->fd, CONST_STRING_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_INTEGER:
-			lseek (cfile->fd, CONST_INTEGER_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_FLOAT:
-			lseek (cfile->fd, CONST_FLOAT_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_LONG:
-			lseek (cfile->fd, CONST_LONG_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_DOUBLE:
-			lseek (cfile->fd, CONST_DOUBLE_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_NAMEANDTYPE:
-			lseek (cfile->fd, CONST_NAMEANDTYPE_INFO, SEEK_CUR);
-			break;
-		
-		case CONST_UTF8:
-			txt = g_new0 (struct utf_string, 1);
-			txt->index = i + 1;
-			if (read (cfile->fd, &(txt->length), 2) == -1) {
-				g_free (txt);
-				return;	/* error while reading */
-			}
-			txt->length = GUINT16_FROM_BE (txt->length);
-			txt->str = g_new0 (char, txt->length);
-			if (read (cfile->fd, txt->str, txt->length) == -1) {
-				g_free (txt);
-				return;	/* error while reading */
-			}
-			cfile->const_pool_utf = g_slist_append (cfile->const_pool_utf, txt);
-			break;
-		
-		default:
-			return;	/* error - unknown tag in class file */
-			break;
-		}
-		i++;
+		pos += 1 + entry_size;
 	}
-	
-#ifdef DEBUG
-	g_print( "Number of Entries: %d\n", i );
-#endif
-}
 
+	/* access flags and this_class */
 
-static char*
-close_and_exit (JavaClassFile *cfile) 
-{
-	java_class_file_free (cfile);
-	return NULL;
+	if (pos + 4 > size)
+		goto out;
+	this_class = get_u16 (data + pos + 2);
+
+	if ((this_class == 0) || (this_class >= count) || (data[entries[this_class]] != CONST_CLASS))
+		goto out;
+	name_index = get_u16 (data + entries[this_class] + 1);
+
+	if ((name_index == 0) || (name_index >= count) || (data[entries[name_index]] != CONST_UTF8))
+		goto out;
+	length = get_u16 (data + entries[name_index] + 1);
+	name = (const char *) data + entries[name_index] + 3;
+
+	/* the entries are all before pos, no need to check the size */
+
+	slash = g_strrstr_len (name, length, "/");
+	package = g_strndup (name, (slash != NULL) ? slash - name : 0);
+
+out:
+	g_free (entries);
+
+	return package;
 }
 
 
@@ -247,117 +217,90 @@ close_and_exit (JavaClassFile *cfile)
 char*
 get_package_name_from_class_file (char *fname)
 {
-	char          *package = NULL;
-	JavaClassFile *cfile;
-	guint16        length = 0, end = 0, utf_index = 0;
-	guint32        magic;
-	guint16        major, minor, count;
-	int            i = 0;
-	
-	if (! g_file_test (fname, G_FILE_TEST_EXISTS))
+	GMappedFile *mapped;
+	char        *package = NULL;
+
+	mapped = g_mapped_file_new (fname, FALSE, NULL);
+	if (mapped == NULL)
 		return NULL;
 
-	cfile = java_class_file_new ();
-	cfile->fd = open (fname, O_RDONLY);
-	if (cfile->fd == -1)
-		return close_and_exit (cfile);
-
-	if ((i = read (cfile->fd, &magic, 4)) != 4)
-		return close_and_exit (cfile);
-	cfile->magic_no = GUINT32_FROM_BE (magic);
-
-	if (read (cfile->fd, &major, 2 ) != 2)
-		return close_and_exit (cfile);
-	cfile->major = GUINT16_FROM_BE (major);
-
-	if (read (cfile->fd, &minor, 2) != 2)
-		return close_and_exit (cfile);
-	cfile->minor = GUINT16_FROM_BE (minor);
-
-	if (read (cfile->fd, &count, 2) != 2)
-		return close_and_exit (cfile);
-	cfile->const_pool_count = GUINT16_FROM_BE(count);
-	load_constant_pool_utfs (cfile);
-
-	if (read (cfile->fd, &cfile->access_flags, 2) != 2)
-		return close_and_exit (cfile);
-	cfile->access_flags = GUINT16_FROM_BE (cfile->access_flags);
-
-	if (read (cfile->fd, &cfile->this_class, 2) != 2)
-		return close_and_exit (cfile);
-	cfile->this_class = GUINT16_FROM_BE(cfile->this_class);
-
-	/* now search for the class structure with index = cfile->this_class */
-	
-	for (i = 0; (i < g_slist_length (cfile->const_pool_class)) && (utf_index == 0); i++ ) {
-		struct class_info *class = g_slist_nth_data (cfile->const_pool_class, i);
-		if (class->index == cfile->this_class)
-			utf_index = class->name_index; /* terminates loop */
-	}
+	if (g_mapped_file_get_contents (mapped) != NULL)
+		package = get_package_name_from_class_data ((guint8 *) g_mapped_file_get_contents (mapped),
+							    g_mapped_file_get_length (mapped));
+	g_mapped_file_unref (mapped);
 
-	/* now search for the utf8 string with index = utf_index */
-	
-	for (i = 0; i < g_slist_length (cfile->const_pool_utf); i++) {
-		struct utf_string *data = g_slist_nth_data (cfile->const_pool_utf, i);
-		if (data->index == utf_index) {
-			package = g_strndup (data->str, data->length);
-			length = data->length;
-			break;
-		}
-	}
+	return package;
+}
 
-	if (package != NULL) {
-		for (i = length; (i >= 0) && (end == 0); i-- )
-			if (package[i] == '/')
-				end = i;
-		package = g_strndup (package, end);
+
+/* Returns the position after the white space and the comments that
+ * start at p, or NULL if a comment does not end. */
+static const char *
+skip_blanks (const char *p,
+	     const char *end)
+{
+	while (p < end) {
+		if (g_ascii_isspace (*p)) {
+			p++;
+		}
+		else if ((p + 1 < end) && (p[0] == '/') && (p[1] == '/')) {
+			p = memchr (p, '\n', end - p);
+			if (p == NULL)
+				return end;
+		}
+		else if ((p + 1 < end) && (p[0] == '/') && (p[1] == '*')) {
+			for (p += 2; (p + 1 < end) && ! ((p[0] == '*') && (p[1] == '/')); p++)
+				/* void */;
+			if (p + 1 >= end)
+				return NULL;
+			p += 2;
+		}
+		else
+			break;
 	}
 
-	java_class_file_free (cfile);
-	
-	return package;
+	return p;
 }
 
 
-/* This function consumes a comment from the java file 
- * multiline = TRUE implies that comment is multiline */
-static void
-consume_comment (int      fdesc,
-		 gboolean multiline)
+static char *
+get_package_name_from_java_data (const char *data,
+				 gsize       size)
 {
-	gboolean escaped = FALSE;
-	gboolean star = FALSE;
-	char     ch;
-		
-	while (read (fdesc, &ch, 1) == 1) {
-		switch (ch) {
-		case '/':
-			if (escaped)
-				break;
-			else if (star)
-				return;
-			break;
-			
-		case '\n':
-			if (! multiline)
-				return;
-			break;
-			
-		case '*':
-			escaped = FALSE;
-			star = TRUE;
-			break;
-			
-		case '\\':
-			escaped = ! escaped;
-			break;
-			
-		default:
-			escaped = FALSE;
-			star = FALSE;
-			break;
+	const char *p = data;
+	const char *end = data + size;
+	GString    *package;
+
+	/* the byte order mark */
+	if ((size >= 3) && (memcmp (data, "\xef\xbb\xbf", 3) == 0))
+		p += 3;
+
+	/* the package declaration is the first statement */
+
+	p = skip_blanks (p, end);
+	if ((p == NULL) || (end - p < 7) || (strncmp (p, "package", 7) != 0))
+		return NULL;
+	p += 7;
+	if ((p < end) && ! g_ascii_isspace (*p) && (*p != '/'))
+		return NULL;	/* an identifier that starts with "package" */
+
+	package = g_string_new (NULL);
+	for (;;) {
+		p = skip_blanks (p, end);
+		if ((p == NULL) || (p >= end)) {
+			g_string_free (package, TRUE);
+			return NULL;
 		}
+		if (*p == ';')
+			break;
+		if (*p == '.')
+			g_string_append_c (package, '/');
+		else
+			g_string_append_c (package, *p);
+		p++;
 	}
+
+	return g_string_free (package, FALSE);
 }
 
 
@@ -365,77 +308,81 @@ consume_comment (int      fdesc,
 char*
 get_package_name_from_java_file (char *fname)
 {
-	char          *package = NULL;
-	JavaClassFile *cfile;
-	gboolean       prev_char_is_bslash = FALSE;
-	gboolean       valid_char_found = FALSE;
-	char           ch;
-	
-	if (! g_file_test (fname, G_FILE_TEST_EXISTS))
+	GMappedFile *mapped;
+	char        *package = NULL;
+
+	mapped = g_mapped_file_new (fname, FALSE, NULL);
+	if (mapped == NULL)
 		return NULL;
 
-	cfile = java_class_file_new ();
-	cfile->fd = open (fname, O_RDONLY);
-	if (cfile->fd == -1)
-		return close_and_exit (cfile);
-	
-	while (! valid_char_found && (read (cfile->fd, &ch, 1) == 1)) {
-		switch (ch) {
-		case '/':
-			if (prev_char_is_bslash == TRUE) { 
-				consume_comment (cfile->fd, FALSE);
-				prev_char_is_bslash = FALSE;
-			}
-			else
-				prev_char_is_bslash = TRUE;
-			break;
-				
-		case '*':
-			if (prev_char_is_bslash == TRUE)
-				consume_comment (cfile->fd, TRUE);
-			prev_char_is_bslash = FALSE;
-			break;
-			
-		case ' ':
-		case '\t':
-		case '\r':
-		case '\n':
-			prev_char_is_bslash = FALSE;
-			break;
-				
-		default:
-			prev_char_is_bslash = FALSE;
-			valid_char_found = TRUE;
-			break;
-		}
-	}
-	
-	if (ch == 'p')	{
-		char first_valid_word[8] = "";
-		
-		first_valid_word[0] = 'p';
-		if (read (cfile->fd, &first_valid_word[1], 6) != 6) 
-			return close_and_exit (cfile);
-			
-		first_valid_word[7] = 0;
-		if (g_ascii_strcasecmp (first_valid_word, "package") == 0) {
-			char buffer[500];
-			int  index = 0;
-			
-			while (read (cfile->fd, &ch, 1) == 1) {
-				if (ch == ';')
-					break;
-				if (ch == '.')
-					buffer[index++] = '/';
-				else 
-					buffer[index++] = ch;
-			}
-			buffer[index] = 0;
-			package = g_strdup (buffer);
-		}
+	if (g_mapped_file_get_contents (mapped) != NULL)
+		package = get_package_name_from_java_data (g_mapped_file_get_contents (mapped),
+							   g_mapped_file_get_length (mapped));
+	g_mapped_file_unref (mapped);
+
+	return package;
+}
+
+
+/* -- get_package_names -- */
+
+
+typedef struct {
+	JavaPackage *files;
+	guint        n_files;
+	gint         next_file;   /* atomic */
+} PackageJob;
+
+
+static void
+package_job_func (gpointer data,
+		  gpointer user_data)
+{
+	PackageJob *job = user_data;
+	guint       i;
+
+	while ((i = (guint) g_atomic_int_add (&job->next_file, 1)) < job->n_files) {
+		JavaPackage *file = job->files + i;
+
+		if (g_str_has_suffix (file->path, ".java"))
+			file->package = get_package_name_from_java_file ((char *) file->path);
+		else if (g_str_has_suffix (file->path, ".class"))
+			file->package = get_package_name_from_class_file ((char *) file->path);
 	}
+}
 
-	java_class_file_free (cfile);
 
-	return package;
+void
+get_package_names (JavaPackage *files,
+		   guint        n_files)
+{
+	PackageJob   job;
+	GThreadPool *pool = NULL;
+	guint        n_threads;
+	guint        i;
+
+	for (i = 0; i < n_files; i++)
+		files[i].package = NULL;
+
+	job.files = files;
+	job.n_files = n_files;
+	job.next_file = 0;
+
+	n_threads = MIN (n_files / JAVA_FILES_PER_THREAD, g_get_num_processors ());
+	if (n_threads > 1)
+		pool = g_thread_pool_new (package_job_func,
+					  &job,
+					  n_threads,
+					  FALSE,
+					  NULL);
+
+	if (pool != NULL) {
+		for (i = 0; i < n_threads; i++)
+			g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+
+		/* wait for all the files */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+	else
+		package_job_func (NULL, &job);
 }
@@ -24,8 +24,20 @@
 #define JAVA_UTILS_H
 
 
+#include <glib.h>
+
+typedef struct {
+	const char *path;      /* not copied */
+	char       *package;   /* NULL if not found */
+} JavaPackage;
+
 char* get_package_name_from_class_file (char *fname);
 char* get_package_name_from_java_file  (char *fname);
 
+/* Reads the package of the .java and .class files, the files are mapped in
+ * memory and read in parallel when the list is long. */
+void  get_package_names                (JavaPackage *files,
+					guint        n_files);
+
 
 #endif /* JAVA_UTILS_H */
@@ -0,0 +1,156 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "path-array.h"
+
+
+typedef struct {
+	PathArray     array;
+	guint         size;
+	gint          ref_count;
+	GStringChunk *copies;
+} RealPathArray;
+
+
+static void
+path_array_maybe_expand (RealPathArray *rarray,
+			 guint          len)
+{
+	if (rarray->array.len + len <= rarray->size)
+		return;
+
+	rarray->size = MAX (rarray->size * 2, rarray->array.len + len);
+	rarray->size = MAX (rarray->size, 16);
+	rarray->array.paths = g_renew (const char *, rarray->array.paths, rarray->size);
+}
+
+
+PathArray *
+path_array_new (guint reserved_size)
+{
+	RealPathArray *rarray;
+
+	rarray = g_new0 (RealPathArray, 1);
+	rarray->ref_count = 1;
+	if (reserved_size > 0)
+		path_array_maybe_expand (rarray, reserved_size);
+
+	return (PathArray *) rarray;
+}
+
+
+PathArray *
+path_array_new_from_list (GList *path_list)
+{
+	PathArray *array;
+	GList     *scan;
+
+	array = path_array_new (g_list_length (path_list));
+	for (scan = path_list; scan; scan = scan->next)
+		array->paths[array->len++] = scan->data;
+
+	return array;
+}
+
+
+PathArray *
+path_array_ref (PathArray *array)
+{
+	RealPathArray *rarray = (RealPathArray *) array;
+
+	g_return_val_if_fail (array != NULL, NULL);
+
+	g_atomic_int_inc (&rarray->ref_count);
+
+	return array;
+}
+
+
+void
+path_array_unref (PathArray *array)
+{
+	RealPathArray *rarray = (RealPathArray *) array;
+
+	if (array == NULL)
+		return;
+
+	if (! g_atomic_int_dec_and_test (&rarray->ref_count))
+		return;
+
+	if (rarray->copies != NULL)
+		g_string_chunk_free (rarray->copies);
+	g_free (rarray->array.paths);
+	g_free (rarray);
+}
+
+
+void
+path_array_add (PathArray  *array,
+		const char *path)
+{
+	RealPathArray *rarray = (RealPathArray *) array;
+
+	g_return_if_fail (array != NULL);
+	g_return_if_fail (path != NULL);
+
+	path_array_maybe_expand (rarray, 1);
+	array->paths[array->len++] = path;
+}
+
+
+void
+path_array_add_copy (PathArray  *array,
+		     const char *path)
+{
+	RealPathArray *rarray = (RealPathArray *) array;
+
+	g_return_if_fail (array != NULL);
+	g_return_if_fail (path != NULL);
+
+	/* the copies are packed in a few large blocks instead of one
+	 * allocation for each path. */
+
+	if (rarray->copies == NULL)
+		rarray->copies = g_string_chunk_new (4096);
+	path_array_add (array, g_string_chunk_insert (rarray->copies, path));
+}
+
+
+GList *
+path_array_to_list (PathArray *array)
+{
+	GList *list = NULL;
+	guint  i;
+
+	if (array == NULL)
+		return NULL;
+
+	for (i = array->len; i > 0; i--)
+		list = g_list_prepend (list, (char *) array->paths[i - 1]);
+
+	return list;
+}
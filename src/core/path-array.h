@@ -0,0 +1,55 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef PATH_ARRAY_H
+#define PATH_ARRAY_H
+
+#include <glib.h>
+
+/* A reference counted array of archive paths.  The paths added with
+ * path_array_add() are not copied, usually they are the original_path
+ * of the FileData of the archive, and must outlive the array; the
+ * paths added with path_array_add_copy() belong to the array. */
+typedef struct _PathArray PathArray;
+
+struct _PathArray {
+	const char **paths;
+	guint        len;
+};
+
+#define path_array_index(array, i) ((array)->paths[(i)])
+
+PathArray *  path_array_new                   (guint        reserved_size);
+PathArray *  path_array_new_from_list         (GList       *path_list);
+PathArray *  path_array_ref                   (PathArray   *array);
+void         path_array_unref                 (PathArray   *array);
+void         path_array_add                   (PathArray   *array,
+					       const char  *path);
+void         path_array_add_copy              (PathArray   *array,
+					       const char  *path);
+
+/* Returns a list with the paths of the array, for the functions that
+ * still take a GList.  The strings are not copied, free the list with
+ * g_list_free(). */
+GList *      path_array_to_list               (PathArray   *array);
+
+#endif /* PATH_ARRAY_H */
@@ -0,0 +1,292 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "file-utils.h"
+#include "path-set.h"
+
+
+struct _PathSet {
+	const char **paths;
+	guint        n_paths;
+};
+
+
+/* the separator sorts before the other characters, so that the paths
+ * that start with "folder/" follow "folder" without other paths in
+ * between, as "folder-1" would be with strcmp. */
+static int
+get_char_rank (char c)
+{
+	if (c == '\0')
+		return 0;
+	if (c == '/')
+		return 1;
+	return (guchar) c + 1;
+}
+
+
+/* compares path with the first key_len characters of key */
+static int
+compare_path_to_key (const char *path,
+		     const char *key,
+		     gsize       key_len)
+{
+	gsize i;
+
+	for (i = 0; (i < key_len) && (path[i] != '\0') && (path[i] == key[i]); i++)
+		/* void */;
+
+	return get_char_rank (path[i]) - ((i < key_len) ? get_char_rank (key[i]) : 0);
+}
+
+
+static int
+compare_paths (gconstpointer a,
+	       gconstpointer b)
+{
+	const char *path_a = *((const char **) a);
+	const char *path_b = *((const char **) b);
+
+	return compare_path_to_key (path_a, path_b, strlen (path_b));
+}
+
+
+static const char **
+get_sorted_paths (PathArray *paths,
+		  guint     *n_paths)
+{
+	const char **sorted;
+	guint        n = 0;
+
+	if (paths != NULL)
+		n = paths->len;
+	sorted = g_new (const char *, MAX (n, 1));
+	if (n > 0)
+		memcpy (sorted, paths->paths, n * sizeof (const char *));
+	qsort (sorted, n, sizeof (const char *), compare_paths);
+	*n_paths = n;
+
+	return sorted;
+}
+
+
+/* returns the index of the first path not less than the key */
+static guint
+get_lower_bound (PathSet    *set,
+		 const char *key,
+		 gsize       key_len)
+{
+	guint first = 0;
+	guint last = set->n_paths;
+
+	while (first < last) {
+		guint middle = first + (last - first) / 2;
+
+		if (compare_path_to_key (set->paths[middle], key, key_len) < 0)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return first;
+}
+
+
+static gboolean
+contains_key (PathSet    *set,
+	      const char *key,
+	      gsize       key_len)
+{
+	guint i;
+
+	i = get_lower_bound (set, key, key_len);
+
+	return (i < set->n_paths) && (compare_path_to_key (set->paths[i], key, key_len) == 0);
+}
+
+
+PathSet *
+path_set_new (GList *paths)
+{
+	PathArray *array;
+	PathSet   *set;
+
+	array = path_array_new_from_list (paths);
+	set = path_set_new_for_array (array);
+	path_array_unref (array);
+
+	return set;
+}
+
+
+PathSet *
+path_set_new_for_array (PathArray *paths)
+{
+	PathSet *set;
+
+	set = g_new0 (PathSet, 1);
+	set->paths = get_sorted_paths (paths, &set->n_paths);
+
+	return set;
+}
+
+
+void
+path_set_free (PathSet *set)
+{
+	if (set == NULL)
+		return;
+
+	g_free (set->paths);
+	g_free (set);
+}
+
+
+gboolean
+path_set_contains (PathSet    *set,
+		   const char *path)
+{
+	return contains_key (set, path, strlen (path));
+}
+
+
+gboolean
+path_set_has_content_of (PathSet    *set,
+			 const char *dirname)
+{
+	char     *key;
+	gsize     len;
+	guint     i;
+	gboolean  result = FALSE;
+
+	if ((dirname == NULL) || (*dirname == '\0'))
+		return FALSE;
+
+	len = strlen (dirname);
+	while ((len > 0) && (dirname[len - 1] == '/'))
+		len--;
+
+	/* the content is the range of the paths that start with
+	 * "dirname/" */
+
+	key = g_malloc (len + 2);
+	memcpy (key, dirname, len);
+	key[len] = '/';
+	key[len + 1] = '\0';
+
+	for (i = get_lower_bound (set, key, len + 1); i < set->n_paths; i++) {
+		const char *path = set->paths[i];
+
+		if (strncmp (path, key, len + 1) != 0)
+			break;
+		if (path_in_path (dirname, path)) {
+			result = TRUE;
+			break;
+		}
+	}
+
+	g_free (key);
+
+	return result;
+}
+
+
+gboolean
+path_set_has_folder_of (PathSet    *set,
+			const char *path)
+{
+	gsize len;
+	gsize i;
+
+	if (path == NULL)
+		return FALSE;
+
+	/* the folders of path are the parts that end before or after a
+	 * separator, with something after the separator. */
+
+	len = strlen (path);
+	for (i = 0; i + 1 < len; i++) {
+		if (path[i] != '/')
+			continue;
+		if ((i > 0) && contains_key (set, path, i))
+			return TRUE;
+		if (contains_key (set, path, i + 1))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+PathArray *
+path_array_remove_contained (PathArray *paths)
+{
+	const char **sorted;
+	const char  *folder = NULL;
+	PathArray   *result;
+	guint        n_paths;
+	guint        i;
+
+	/* the paths contained in a path follow it, until the next path
+	 * that is not contained in any of the previous ones. */
+
+	sorted = get_sorted_paths (paths, &n_paths);
+	result = path_array_new (n_paths);
+	for (i = 0; i < n_paths; i++) {
+		const char *path = sorted[i];
+
+		if ((folder != NULL)
+		    && ((strcmp (folder, path) == 0) || path_in_path (folder, path)))
+		{
+			continue;
+		}
+
+		path_array_add (result, path);
+		folder = path;
+	}
+	g_free (sorted);
+
+	return result;
+}
+
+
+GList *
+path_list_remove_contained (GList *file_list)
+{
+	PathArray *paths;
+	PathArray *result;
+	GList     *list;
+
+	paths = path_array_new_from_list (file_list);
+	result = path_array_remove_contained (paths);
+	list = path_array_to_list (result);
+	path_array_unref (result);
+	path_array_unref (paths);
+
+	return list;
+}
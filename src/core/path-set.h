@@ -0,0 +1,55 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef PATH_SET_H
+#define PATH_SET_H
+
+#include <glib.h>
+#include "path-array.h"
+
+/* A set of archive paths sorted so that the content of a folder follows
+ * the folder, which answers the path_in_path() questions about a whole
+ * list with a binary search instead of a scan.  The paths are not
+ * copied and must outlive the set. */
+typedef struct _PathSet PathSet;
+
+PathSet *    path_set_new                     (GList       *paths);
+PathSet *    path_set_new_for_array           (PathArray   *paths);
+void         path_set_free                    (PathSet     *set);
+gboolean     path_set_contains                (PathSet     *set,
+					       const char  *path);
+
+/* whether path_in_path (dirname, path) is TRUE for a path of the set */
+gboolean     path_set_has_content_of          (PathSet     *set,
+					       const char  *dirname);
+
+/* whether path_in_path (folder, path) is TRUE for a folder of the set */
+gboolean     path_set_has_folder_of           (PathSet     *set,
+					       const char  *path);
+
+/* Returns a new array with the paths of the given array that are not
+ * contained in another path of the array, each one once.  The strings
+ * are not copied. */
+PathArray *  path_array_remove_contained      (PathArray   *paths);
+GList *      path_list_remove_contained       (GList       *file_list);
+
+#endif /* PATH_SET_H */
@@ -0,0 +1,599 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "file-utils.h"
+#include "size-probe.h"
+
+
+/* refuse to load absurdly large xz indexes or zstd seek tables */
+#define MAX_INDEX_SIZE             (64 * 1024 * 1024)
+
+#define XZ_HEADER_SIZE             12
+#define XZ_FOOTER_SIZE             12
+#define LZIP_HEADER_SIZE           6
+#define LZIP_TRAILER_SIZE          20
+#define ZSTD_MAGIC                 0xFD2FB528U
+#define ZSTD_SKIPPABLE_MAGIC       0x184D2A50U
+#define ZSTD_SKIPPABLE_MASK        0xFFFFFFF0U
+#define ZSTD_SEEKABLE_MAGIC        0x8F92EAB1U
+#define ZSTD_SEEK_FOOTER_SIZE      9
+
+
+static gboolean
+read_at (int      fd,
+	 goffset  offset,
+	 void    *buffer,
+	 gsize    size)
+{
+	guchar *p = buffer;
+
+	while (size > 0) {
+		ssize_t n;
+
+		n = pread (fd, p, size, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		if (n == 0)
+			return FALSE;
+		p += n;
+		size -= n;
+		offset += n;
+	}
+
+	return TRUE;
+}
+
+
+static guint32
+get_le16 (const guchar *p)
+{
+	return (guint32) p[0] | ((guint32) p[1] << 8);
+}
+
+
+static guint32
+get_le32 (const guchar *p)
+{
+	return (guint32) p[0]
+		| ((guint32) p[1] << 8)
+		| ((guint32) p[2] << 16)
+		| ((guint32) p[3] << 24);
+}
+
+
+static guint64
+get_le64 (const guchar *p)
+{
+	return (guint64) get_le32 (p) | ((guint64) get_le32 (p + 4) << 32);
+}
+
+
+static guint32
+get_be32 (const guchar *p)
+{
+	return ((guint32) p[0] << 24)
+		| ((guint32) p[1] << 16)
+		| ((guint32) p[2] << 8)
+		| (guint32) p[3];
+}
+
+
+/* -- gzip -- */
+
+
+static gboolean
+probe_bgzf_blocks (int       fd,
+		   goffset   file_size,
+		   guint64  *size)
+{
+	goffset pos = 0;
+	guint64 total = 0;
+
+	while (pos < file_size) {
+		guchar header[18];
+		guchar trailer[4];
+		goffset block_size;
+
+		if (! read_at (fd, pos, header, sizeof (header)))
+			return FALSE;
+		if ((header[0] != 0x1f) || (header[1] != 0x8b) || ((header[3] & 0x04) == 0))
+			return FALSE;
+		if ((header[12] != 'B') || (header[13] != 'C') || (get_le16 (header + 14) != 2))
+			return FALSE;
+
+		block_size = (goffset) get_le16 (header + 16) + 1;
+		if ((block_size < 26) || (pos + block_size > file_size))
+			return FALSE;
+		if (! read_at (fd, pos + block_size - 4, trailer, sizeof (trailer)))
+			return FALSE;
+
+		total += get_le32 (trailer);
+		pos += block_size;
+	}
+
+	*size = total;
+
+	return TRUE;
+}
+
+
+static gboolean
+probe_gzip (int       fd,
+	    goffset   file_size,
+	    guint64  *size)
+{
+	guchar header[18];
+
+	if (file_size < 18)
+		return FALSE;
+	if (! read_at (fd, 0, header, sizeof (header)))
+		return FALSE;
+	if ((header[0] != 0x1f) || (header[1] != 0x8b) || (header[2] != 8))
+		return FALSE;
+
+	/* bgzip and similar block compressors store every member length in
+	 * the FEXTRA field, so the whole member chain can be walked
+	 * without inflating anything. */
+
+	if (((header[3] & 0x04) != 0)
+	    && (header[12] == 'B')
+	    && (header[13] == 'C'))
+	{
+		return probe_bgzf_blocks (fd, file_size, size);
+	}
+
+	/* otherwise ISIZE is the size of the last member only, modulo 2^32,
+	 * and nothing short of inflating the stream tells whether the file
+	 * has other members: the size is counted by decompressing it. */
+
+	return FALSE;
+}
+
+
+/* -- xz -- */
+
+
+static gboolean
+read_xz_varint (const guchar  *buffer,
+		gsize          buffer_size,
+		gsize         *pos,
+		guint64       *value)
+{
+	int i;
+
+	*value = 0;
+	for (i = 0; (i < 9) && (*pos < buffer_size); i++) {
+		guchar b = buffer[(*pos)++];
+
+		*value |= (guint64) (b & 0x7f) << (i * 7);
+		if ((b & 0x80) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+static gboolean
+parse_xz_index (const guchar  *index,
+		gsize          index_size,
+		guint64       *blocks_size,
+		guint64       *uncompressed_size)
+{
+	gsize   pos = 1;
+	guint64 n_records;
+	guint64 i;
+
+	if ((index_size < 8) || (index[0] != 0x00))
+		return FALSE;
+	if (! read_xz_varint (index, index_size, &pos, &n_records))
+		return FALSE;
+
+	*blocks_size = 0;
+	*uncompressed_size = 0;
+	for (i = 0; i < n_records; i++) {
+		guint64 unpadded;
+		guint64 uncompressed;
+
+		if (! read_xz_varint (index, index_size, &pos, &unpadded))
+			return FALSE;
+		if (! read_xz_varint (index, index_size, &pos, &uncompressed))
+			return FALSE;
+
+		*blocks_size += (unpadded + 3) & ~((guint64) 3);
+		*uncompressed_size += uncompressed;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean
+probe_xz (int       fd,
+	  goffset   file_size,
+	  guint64  *size)
+{
+	goffset pos = file_size;
+	guint64 total = 0;
+
+	/* walk the streams backwards, an .xz file can be a concatenation
+	 * of streams separated by zero padding. */
+
+	while (pos > 0) {
+		guchar   footer[XZ_FOOTER_SIZE];
+		guchar   magic[6];
+		guchar  *index;
+		goffset  index_size;
+		goffset  index_start;
+		guint64  blocks_size;
+		guint64  uncompressed_size;
+		gboolean valid;
+
+		while (pos >= 4) {
+			guchar padding[4];
+
+			if (! read_at (fd, pos - 4, padding, sizeof (padding)))
+				return FALSE;
+			if (get_le32 (padding) != 0)
+				break;
+			pos -= 4;
+		}
+
+		if (pos < XZ_HEADER_SIZE + XZ_FOOTER_SIZE)
+			return FALSE;
+		if (! read_at (fd, pos - XZ_FOOTER_SIZE, footer, sizeof (footer)))
+			return FALSE;
+		if ((footer[10] != 'Y') || (footer[11] != 'Z'))
+			return FALSE;
+
+		index_size = ((goffset) get_le32 (footer + 4) + 1) * 4;
+		index_start = pos - XZ_FOOTER_SIZE - index_size;
+		if ((index_size > MAX_INDEX_SIZE) || (index_start < XZ_HEADER_SIZE))
+			return FALSE;
+
+		index = g_malloc (index_size);
+		valid = read_at (fd, index_start, index, index_size)
+			&& parse_xz_index (index, index_size, &blocks_size, &uncompressed_size);
+		g_free (index);
+		if (! valid)
+			return FALSE;
+
+		if ((guint64) index_start < blocks_size + XZ_HEADER_SIZE)
+			return FALSE;
+		pos = index_start - blocks_size - XZ_HEADER_SIZE;
+
+		if (! read_at (fd, pos, magic, sizeof (magic)))
+			return FALSE;
+		if (memcmp (magic, "\3757zXZ\000", 6) != 0)
+			return FALSE;
+
+		total += uncompressed_size;
+	}
+
+	*size = total;
+
+	return TRUE;
+}
+
+
+/* -- lzip -- */
+
+
+static gboolean
+probe_lzip (int       fd,
+	    goffset   file_size,
+	    guint64  *size)
+{
+	goffset pos = file_size;
+	guint64 total = 0;
+
+	/* every member ends with a trailer holding its uncompressed and
+	 * its compressed size, follow them backwards to the first one. */
+
+	while (pos > 0) {
+		guchar  trailer[LZIP_TRAILER_SIZE];
+		guchar  magic[4];
+		guint64 member_size;
+
+		if (pos < LZIP_HEADER_SIZE + LZIP_TRAILER_SIZE)
+			return FALSE;
+		if (! read_at (fd, pos - LZIP_TRAILER_SIZE, trailer, sizeof (trailer)))
+			return FALSE;
+
+		member_size = get_le64 (trailer + 12);
+		if ((member_size < LZIP_HEADER_SIZE + LZIP_TRAILER_SIZE) || (member_size > (guint64) pos))
+			return FALSE;
+		if (! read_at (fd, pos - member_size, magic, sizeof (magic)))
+			return FALSE;
+		if (memcmp (magic, "LZIP", 4) != 0)
+			return FALSE;
+
+		total += get_le64 (trailer + 4);
+		pos -= member_size;
+	}
+
+	*size = total;
+
+	return TRUE;
+}
+
+
+/* -- zstd -- */
+
+
+static gboolean
+probe_zstd_seek_table (int       fd,
+		       goffset   file_size,
+		       guint64  *size)
+{
+	guchar   footer[ZSTD_SEEK_FOOTER_SIZE];
+	guchar  *table;
+	guint32  n_frames;
+	gsize    entry_size;
+	goffset  table_size;
+	guint32  i;
+	guint64  total = 0;
+
+	if (file_size < ZSTD_SEEK_FOOTER_SIZE + 8)
+		return FALSE;
+	if (! read_at (fd, file_size - ZSTD_SEEK_FOOTER_SIZE, footer, sizeof (footer)))
+		return FALSE;
+	if (get_le32 (footer + 5) != ZSTD_SEEKABLE_MAGIC)
+		return FALSE;
+
+	n_frames = get_le32 (footer);
+	entry_size = ((footer[4] & 0x80) != 0) ? 12 : 8;
+	table_size = (goffset) n_frames * entry_size;
+	if ((table_size > MAX_INDEX_SIZE) || (table_size + ZSTD_SEEK_FOOTER_SIZE > file_size))
+		return FALSE;
+
+	table = g_malloc (table_size + 1);
+	if (! read_at (fd, file_size - ZSTD_SEEK_FOOTER_SIZE - table_size, table, table_size)) {
+		g_free (table);
+		return FALSE;
+	}
+	for (i = 0; i < n_frames; i++)
+		total += get_le32 (table + i * entry_size + 4);
+	g_free (table);
+
+	*size = total;
+
+	return TRUE;
+}
+
+
+static gboolean
+probe_zstd_frames (int       fd,
+		   goffset   file_size,
+		   guint64  *size)
+{
+	static const int dict_id_size[4] = { 0, 1, 2, 4 };
+	goffset pos = 0;
+	guint64 total = 0;
+
+	while (pos < file_size) {
+		guchar  header[18];
+		guint32 magic;
+		guchar  descriptor;
+		int     fcs_flag;
+		int     fcs_size;
+		int     offset;
+		goffset available;
+		guchar *fcs;
+
+		if (! read_at (fd, pos, header, 4))
+			return FALSE;
+		magic = get_le32 (header);
+
+		if ((magic & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC) {
+			if (! read_at (fd, pos + 4, header + 4, 4))
+				return FALSE;
+			pos += 8 + (goffset) get_le32 (header + 4);
+			continue;
+		}
+		if (magic != ZSTD_MAGIC)
+			return FALSE;
+
+		available = MIN (14, file_size - pos - 4);
+		if (available < 2)
+			return FALSE;
+		if (! read_at (fd, pos + 4, header + 4, available))
+			return FALSE;
+
+		descriptor = header[4];
+		fcs_flag = descriptor >> 6;
+		offset = 5 + (((descriptor & 0x20) != 0) ? 0 : 1) + dict_id_size[descriptor & 0x03];
+		if (fcs_flag == 0)
+			fcs_size = ((descriptor & 0x20) != 0) ? 1 : 0;
+		else
+			fcs_size = 1 << fcs_flag;
+
+		/* the frame does not declare its content size */
+		if ((fcs_size == 0) || (offset - 4 + fcs_size > available))
+			return FALSE;
+
+		fcs = header + offset;
+		switch (fcs_size) {
+		case 1:
+			total += fcs[0];
+			break;
+		case 2:
+			total += get_le16 (fcs) + 256;
+			break;
+		case 4:
+			total += get_le32 (fcs);
+			break;
+		default:
+			total += get_le64 (fcs);
+			break;
+		}
+		pos += offset + fcs_size;
+
+		/* skip the blocks to reach the next frame */
+
+		for (;;) {
+			guchar  block[3];
+			guint32 block_header;
+			int     block_type;
+
+			if (! read_at (fd, pos, block, sizeof (block)))
+				return FALSE;
+			block_header = block[0] | (block[1] << 8) | (block[2] << 16);
+			block_type = (block_header >> 1) & 0x03;
+			if (block_type == 3)
+				return FALSE;
+
+			pos += 3 + ((block_type == 1) ? 1 : (block_header >> 3));
+			if ((block_header & 0x01) != 0)
+				break;
+		}
+
+		/* content checksum */
+		if ((descriptor & 0x04) != 0)
+			pos += 4;
+	}
+
+	if (pos != file_size)
+		return FALSE;
+
+	*size = total;
+
+	return TRUE;
+}
+
+
+static gboolean
+probe_zstd (int       fd,
+	    goffset   file_size,
+	    guint64  *size)
+{
+	if (probe_zstd_seek_table (fd, file_size, size))
+		return TRUE;
+	return probe_zstd_frames (fd, file_size, size);
+}
+
+
+/* -- header based formats -- */
+
+
+static gboolean
+probe_lzma (int       fd,
+	    goffset   file_size,
+	    guint64  *size)
+{
+	guchar  header[13];
+	guint64 value;
+
+	if (! read_at (fd, 0, header, sizeof (header)))
+		return FALSE;
+	if (header[0] >= 225)
+		return FALSE;
+
+	value = get_le64 (header + 5);
+	if (value == G_MAXUINT64)
+		return FALSE;
+
+	*size = value;
+
+	return TRUE;
+}
+
+
+static gboolean
+probe_rzip (int       fd,
+	    goffset   file_size,
+	    guint64  *size)
+{
+	guchar header[10];
+
+	if (! read_at (fd, 0, header, sizeof (header)))
+		return FALSE;
+	if (memcmp (header, "RZIP", 4) != 0)
+		return FALSE;
+
+	/* the header stores a 32 bit size only */
+	*size = get_be32 (header + 6);
+
+	return TRUE;
+}
+
+
+gboolean
+probe_uncompressed_size (const char  *filename,
+			 const char  *mime_type,
+			 goffset     *size)
+{
+	gboolean (*probe) (int, goffset, guint64 *) = NULL;
+	struct stat st;
+	guint64  value = 0;
+	gboolean result;
+	int      fd;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (size != NULL, FALSE);
+
+	if (mime_type == NULL)
+		return FALSE;
+
+	if (is_mime_type (mime_type, "application/x-gzip"))
+		probe = probe_gzip;
+	else if (is_mime_type (mime_type, "application/x-xz"))
+		probe = probe_xz;
+	else if (is_mime_type (mime_type, "application/x-lzip"))
+		probe = probe_lzip;
+	else if (is_mime_type (mime_type, "application/zstd"))
+		probe = probe_zstd;
+	else if (is_mime_type (mime_type, "application/x-lzma"))
+		probe = probe_lzma;
+	else if (is_mime_type (mime_type, "application/x-rzip"))
+		probe = probe_rzip;
+	else
+		return FALSE;
+
+	fd = open (filename, O_RDONLY);
+	if (fd < 0)
+		return FALSE;
+
+	result = (fstat (fd, &st) == 0) && probe (fd, st.st_size, &value);
+	close (fd);
+
+	if (result) {
+		if (value > G_MAXINT64)
+			return FALSE;
+		*size = (goffset) value;
+	}
+
+	return result;
+}
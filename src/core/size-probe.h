@@ -0,0 +1,37 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SIZE_PROBE_H
+#define SIZE_PROBE_H
+
+#include <glib.h>
+
+/* Reads the uncompressed size of a single-file compressed stream from
+ * the metadata stored in the file itself (xz index, zstd frame headers
+ * or seek table, lzip member trailers, bgzf block sizes, lzma and
+ * rzip headers).  Returns FALSE when the format does not record the size or
+ * when the recorded value is ambiguous. */
+gboolean     probe_uncompressed_size          (const char  *filename,
+					       const char  *mime_type,
+					       goffset     *size);
+
+#endif /* SIZE_PROBE_H */
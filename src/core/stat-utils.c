@@ -0,0 +1,443 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "stat-utils.h"
+
+
+#define STAT_BLOCK_SIZE   1024  /* files per thread pool task */
+#define STAT_MAX_THREADS  8     /* stat is bound by the file system, not
+				 * by the processors */
+
+
+typedef struct {
+	int       base_fd;
+	FileStat *files;
+	guint     n_files;
+} StatBlock;
+
+
+static void
+stat_block (StatBlock *block)
+{
+	const char *parent = NULL;
+	gsize       parent_len = 0;
+	int         parent_fd = -1;
+	guint       i;
+
+	for (i = 0; i < block->n_files; i++) {
+		FileStat    *file = block->files + i;
+		const char  *slash;
+		const char  *name;
+		int          dir_fd;
+		struct stat  st;
+
+		/* use the parent folder of the file, opened once for all the
+		 * files it contains */
+
+		slash = strrchr (file->path, '/');
+		if ((slash == NULL) || (slash == file->path) || (slash[1] == '\0')) {
+			dir_fd = block->base_fd;
+			name = file->path;
+		}
+		else {
+			gsize len = slash - file->path;
+
+			if ((parent == NULL)
+			    || (len != parent_len)
+			    || (strncmp (parent, file->path, len) != 0))
+			{
+				char *dir;
+
+				if (parent_fd >= 0)
+					close (parent_fd);
+				dir = g_strndup (file->path, len);
+				parent_fd = openat (block->base_fd, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+				g_free (dir);
+
+				parent = file->path;
+				parent_len = len;
+			}
+
+			if (parent_fd >= 0) {
+				dir_fd = parent_fd;
+				name = slash + 1;
+			}
+			else {
+				dir_fd = block->base_fd;
+				name = file->path;
+			}
+		}
+
+		if (fstatat (dir_fd, name, &st, 0) == 0) {
+			file->mtime = st.st_mtime;
+			file->size = st.st_size;
+			file->exists = TRUE;
+		}
+		else {
+			file->mtime = 0;
+			file->size = 0;
+			file->exists = FALSE;
+		}
+	}
+
+	if (parent_fd >= 0)
+		close (parent_fd);
+}
+
+
+static void
+stat_block_func (gpointer data,
+		 gpointer user_data)
+{
+	stat_block ((StatBlock *) data);
+}
+
+
+void
+stat_files (const char *base_dir,
+	    FileStat   *files,
+	    guint       n_files)
+{
+	StatBlock   *blocks;
+	guint        n_blocks;
+	GThreadPool *pool = NULL;
+	guint        i;
+	int          base_fd;
+
+	if (n_files == 0)
+		return;
+
+	base_fd = open ((base_dir != NULL) ? base_dir : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (base_fd < 0) {
+		for (i = 0; i < n_files; i++) {
+			files[i].mtime = 0;
+			files[i].size = 0;
+			files[i].exists = FALSE;
+		}
+		return;
+	}
+
+	n_blocks = (n_files + STAT_BLOCK_SIZE - 1) / STAT_BLOCK_SIZE;
+	blocks = g_new (StatBlock, n_blocks);
+	for (i = 0; i < n_blocks; i++) {
+		blocks[i].base_fd = base_fd;
+		blocks[i].files = files + i * STAT_BLOCK_SIZE;
+		blocks[i].n_files = MIN (STAT_BLOCK_SIZE, n_files - i * STAT_BLOCK_SIZE);
+	}
+
+	if (n_blocks > 1)
+		pool = g_thread_pool_new (stat_block_func,
+					  NULL,
+					  MIN (n_blocks, STAT_MAX_THREADS),
+					  FALSE,
+					  NULL);
+
+	if (pool != NULL) {
+		for (i = 0; i < n_blocks; i++)
+			g_thread_pool_push (pool, blocks + i, NULL);
+
+		/* wait for all the blocks */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+	else
+		for (i = 0; i < n_blocks; i++)
+			stat_block (blocks + i);
+
+	g_free (blocks);
+	close (base_fd);
+}
+
+
+typedef struct {
+	const char *name;
+	guchar      type;   /* the d_type of the entry */
+} ListedEntry;
+
+
+typedef struct {
+	const char   *path;        /* the folder, relative to the base folder,
+				    * not terminated */
+	gsize         path_len;
+	int           fd;          /* -1 if the folder cannot be opened */
+	DIR          *stream;
+	gboolean      listed;      /* FALSE if the folder cannot be read,
+				    * the files are looked up one by one */
+	ListedEntry  *entries;     /* sorted by name */
+	guint         n_entries;
+	GStringChunk *names;
+} ListedDir;
+
+
+static int
+compare_listed_entries (const void *a,
+			const void *b)
+{
+	return strcmp (((const ListedEntry *) a)->name, ((const ListedEntry *) b)->name);
+}
+
+
+static void
+list_dir (ListedDir *dir)
+{
+	GArray        *entries;
+	struct dirent *entry;
+
+	dir->stream = fdopendir (dir->fd);
+	if (dir->stream == NULL)
+		return;
+
+	/* readdir reads the folder in large blocks, a single system call
+	 * returns many entries. */
+
+	entries = g_array_new (FALSE, FALSE, sizeof (ListedEntry));
+	dir->names = g_string_chunk_new (4096);
+	while ((entry = readdir (dir->stream)) != NULL) {
+		ListedEntry listed;
+
+		if ((strcmp (entry->d_name, ".") == 0) || (strcmp (entry->d_name, "..") == 0))
+			continue;
+
+		listed.name = g_string_chunk_insert (dir->names, entry->d_name);
+		listed.type = entry->d_type;
+		g_array_append_val (entries, listed);
+	}
+
+	dir->n_entries = entries->len;
+	dir->entries = (ListedEntry *) g_array_free (entries, FALSE);
+	if (dir->n_entries > 1)
+		qsort (dir->entries, dir->n_entries, sizeof (ListedEntry), compare_listed_entries);
+	dir->listed = TRUE;
+}
+
+
+static ListedDir *
+listed_dir_new (int         parent_fd,
+		const char *path,
+		gsize       path_len,
+		gsize       parent_len)
+{
+	ListedDir *dir;
+	int        error = 0;
+
+	dir = g_new0 (ListedDir, 1);
+	dir->path = path;
+	dir->path_len = path_len;
+	dir->fd = -1;
+
+	if (parent_fd >= 0) {
+		char *relative;
+
+		/* open the folder relative to the closest listed parent */
+
+		if (parent_len > 0)
+			parent_len++;
+		relative = g_strndup (path + parent_len, path_len - parent_len);
+		dir->fd = openat (parent_fd, relative, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		error = errno;
+		g_free (relative);
+	}
+
+	if (dir->fd >= 0)
+		list_dir (dir);
+	else if ((error == ENOENT) || (error == ENOTDIR))
+		dir->listed = TRUE; /* the folder doesn't exist, neither do its files */
+
+	return dir;
+}
+
+
+static void
+listed_dir_free (ListedDir *dir)
+{
+	if (dir->stream != NULL)
+		closedir (dir->stream);
+	else if (dir->fd >= 0)
+		close (dir->fd);
+	g_free (dir->entries);
+	if (dir->names != NULL)
+		g_string_chunk_free (dir->names);
+	g_free (dir);
+}
+
+
+static ListedEntry *
+listed_dir_find (ListedDir  *dir,
+		 const char *name,
+		 gsize       name_len)
+{
+	guint low = 0;
+	guint high = dir->n_entries;
+
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+		int   cmp;
+
+		cmp = strncmp (dir->entries[mid].name, name, name_len);
+		if ((cmp == 0) && (dir->entries[mid].name[name_len] != '\0'))
+			cmp = 1;
+
+		if (cmp == 0)
+			return dir->entries + mid;
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return NULL;
+}
+
+
+/* whether dir is the folder path or one of its parents */
+static gboolean
+listed_dir_contains (ListedDir  *dir,
+		     const char *path,
+		     gsize       path_len)
+{
+	if (dir->path_len == 0)
+		return TRUE;
+
+	return ((dir->path_len <= path_len)
+		&& (strncmp (dir->path, path, dir->path_len) == 0)
+		&& ((dir->path_len == path_len) || (path[dir->path_len] == '/')));
+}
+
+
+static void
+set_file_stat (FileStat   *file,
+	       int         dir_fd,
+	       const char *name,
+	       gboolean    found)
+{
+	struct stat st;
+
+	if (found && (fstatat (dir_fd, name, &st, 0) == 0)) {
+		file->mtime = st.st_mtime;
+		file->size = st.st_size;
+		file->exists = TRUE;
+	}
+	else {
+		file->mtime = 0;
+		file->size = 0;
+		file->exists = FALSE;
+	}
+}
+
+
+void
+stat_files_listed (const char *base_dir,
+		   FileStat   *files,
+		   guint       n_files,
+		   gboolean    need_times)
+{
+	GPtrArray *stack;
+	ListedDir *base;
+	guint      i;
+
+	if (n_files == 0)
+		return;
+
+	/* the folders being read, each one is a parent of the next one.
+	 * Since the files are sorted, once a file is not in a folder, the
+	 * following files are not either and the folder can be dropped. */
+
+	stack = g_ptr_array_new_with_free_func ((GDestroyNotify) listed_dir_free);
+	base = g_new0 (ListedDir, 1);
+	base->path = "";
+	base->fd = open ((base_dir != NULL) ? base_dir : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (base->fd >= 0)
+		list_dir (base);
+	else
+		base->listed = TRUE;
+	g_ptr_array_add (stack, base);
+
+	for (i = 0; i < n_files; i++) {
+		FileStat    *file = files + i;
+		gsize        len;
+		gsize        parent_len;
+		const char  *name;
+		ListedDir   *dir;
+		ListedEntry *entry;
+
+		/* a trailing separator means a folder, it's not part of its name */
+
+		len = strlen (file->path);
+		while ((len > 1) && (file->path[len - 1] == '/'))
+			len--;
+		for (parent_len = len; (parent_len > 0) && (file->path[parent_len - 1] != '/'); parent_len--)
+			/* void */;
+		name = file->path + parent_len;
+		if (parent_len > 0)
+			parent_len--;
+
+		dir = g_ptr_array_index (stack, stack->len - 1);
+		while (! listed_dir_contains (dir, file->path, parent_len)) {
+			g_ptr_array_remove_index (stack, stack->len - 1);
+			dir = g_ptr_array_index (stack, stack->len - 1);
+		}
+		if (dir->path_len != parent_len) {
+			if (dir->listed && (dir->fd < 0)) {
+				/* in a missing folder */
+				set_file_stat (file, -1, NULL, FALSE);
+				continue;
+			}
+			dir = listed_dir_new (dir->fd, file->path, parent_len, dir->path_len);
+			g_ptr_array_add (stack, dir);
+		}
+
+		if (! dir->listed) {
+			/* cannot list the folder, look up the file itself */
+			set_file_stat (file, base->fd, file->path, base->fd >= 0);
+			continue;
+		}
+
+		entry = listed_dir_find (dir, name, file->path + len - name);
+		if (entry == NULL) {
+			set_file_stat (file, -1, NULL, FALSE);
+			continue;
+		}
+
+		/* a link may point to nothing, as an unknown type may be
+		 * anything */
+
+		if (need_times || (entry->type == DT_LNK) || (entry->type == DT_UNKNOWN))
+			set_file_stat (file, dir->fd, entry->name, TRUE);
+		else {
+			file->mtime = 0;
+			file->size = 0;
+			file->exists = TRUE;
+		}
+	}
+
+	g_ptr_array_free (stack, TRUE);
+}
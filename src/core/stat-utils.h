@@ -0,0 +1,57 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef STAT_UTILS_H
+#define STAT_UTILS_H
+
+#include <time.h>
+#include <glib.h>
+
+typedef struct {
+	const char *path;   /* relative to the base folder, not copied */
+	time_t      mtime;  /* 0 if the file cannot be read */
+	goffset     size;
+	gboolean    exists;
+} FileStat;
+
+/* Fills the modification time and the size of n_files files located in
+ * base_dir.  The files are read with fstatat relative to their parent
+ * folder, which is opened once for consecutive files in the same folder,
+ * so sorting the files by path saves lookups.  Large lists are split in
+ * blocks processed by a pool of threads.  Symbolic links are
+ * followed. */
+void         stat_files                       (const char  *base_dir,
+					       FileStat    *files,
+					       guint        n_files);
+
+/* Like stat_files() for files that are likely not to exist, as the files
+ * about to be extracted: each folder is listed once and the files that
+ * are not in the listing are not looked up.  The existing files are read
+ * with fstatat only if need_times is TRUE, otherwise their mtime and size
+ * are 0.  The files must be sorted by path, so that the content of a
+ * folder is contiguous and each folder is listed only once. */
+void         stat_files_listed                (const char  *base_dir,
+					       FileStat    *files,
+					       guint        n_files,
+					       gboolean     need_times);
+
+#endif /* STAT_UTILS_H */
@@ -0,0 +1,362 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "sync-index.h"
+
+
+#define SYNC_INDEX_HEADER     "# lxqt-archiver sync index 2"
+#define SYNC_INDEX_EXTENSION  ".sync-index"
+#define HASH_BUFFER_SIZE      (64 * 1024)
+#define HASH_CHECKSUM_TYPE    G_CHECKSUM_MD5  /* used to detect changes,
+					       * not for security */
+
+
+SyncIndexEntry *
+sync_index_entry_new (const char *path,
+		      goffset     size,
+		      time_t      mtime,
+		      const char *hash)
+{
+	SyncIndexEntry *entry;
+
+	entry = g_new0 (SyncIndexEntry, 1);
+	entry->path = g_strdup (path);
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->hash = g_strdup (hash);
+
+	return entry;
+}
+
+
+void
+sync_index_entry_free (SyncIndexEntry *entry)
+{
+	if (entry == NULL)
+		return;
+	g_free (entry->path);
+	g_free (entry->hash);
+	g_free (entry);
+}
+
+
+static GHashTable *
+sync_index_new (void)
+{
+	return g_hash_table_new_full (g_str_hash,
+				      g_str_equal,
+				      NULL,
+				      (GDestroyNotify) sync_index_entry_free);
+}
+
+
+/* each line is "hash<TAB>size<TAB>mtime<TAB>path", the path is the last
+ * field so that it can contain tabs. */
+static SyncIndexEntry *
+parse_line (char *line)
+{
+	char   *fields[4];
+	char   *end;
+	gint64  size;
+	gint64  mtime;
+	int     i;
+
+	fields[0] = line;
+	for (i = 1; i < 4; i++) {
+		char *tab = strchr (fields[i - 1], '\t');
+
+		if (tab == NULL)
+			return NULL;
+		*tab = '\0';
+		fields[i] = tab + 1;
+	}
+
+	size = g_ascii_strtoll (fields[1], &end, 10);
+	if ((*end != '\0') || (size < 0))
+		return NULL;
+	mtime = g_ascii_strtoll (fields[2], &end, 10);
+	if (*end != '\0')
+		return NULL;
+	if ((fields[0][0] == '\0') || (fields[3][0] == '\0'))
+		return NULL;
+
+	return sync_index_entry_new (fields[3], size, (time_t) mtime, fields[0]);
+}
+
+
+/* the second line of the index identifies the archive it was saved for,
+ * the index of an archive modified by another program does not describe
+ * its content anymore. */
+static char *
+get_archive_identity (const char *archive_filename)
+{
+	struct stat st;
+
+	if (stat (archive_filename, &st) != 0)
+		return NULL;
+
+	return g_strdup_printf ("# archive\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT ".%09ld\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT,
+				(gint64) st.st_size,
+				(gint64) st.st_mtim.tv_sec,
+				(long) st.st_mtim.tv_nsec,
+				(guint64) st.st_dev,
+				(guint64) st.st_ino);
+}
+
+
+GHashTable *
+sync_index_load (const char *filename,
+		 const char *archive_filename)
+{
+	GHashTable  *index;
+	char        *contents;
+	char       **lines;
+	char        *identity;
+	gboolean     valid;
+	int          i;
+
+	index = sync_index_new ();
+
+	if (! g_file_get_contents (filename, &contents, NULL, NULL))
+		return index;
+
+	lines = g_strsplit (contents, "\n", -1);
+	g_free (contents);
+
+	identity = get_archive_identity (archive_filename);
+	valid = (lines[0] != NULL)
+		&& (strcmp (lines[0], SYNC_INDEX_HEADER) == 0)
+		&& (lines[1] != NULL)
+		&& (identity != NULL)
+		&& (strcmp (lines[1], identity) == 0);
+	g_free (identity);
+
+	if (! valid) {
+		g_strfreev (lines);
+		return index;
+	}
+
+	for (i = 2; lines[i] != NULL; i++) {
+		SyncIndexEntry *entry;
+
+		if (lines[i][0] == '\0')
+			continue;
+
+		entry = parse_line (lines[i]);
+		if (entry != NULL)
+			g_hash_table_replace (index, entry->path, entry);
+	}
+
+	g_strfreev (lines);
+
+	return index;
+}
+
+
+static int
+compare_entries_by_path (gconstpointer a,
+			 gconstpointer b)
+{
+	const SyncIndexEntry *entry_a = *((SyncIndexEntry **) a);
+	const SyncIndexEntry *entry_b = *((SyncIndexEntry **) b);
+
+	return strcmp (entry_a->path, entry_b->path);
+}
+
+
+gboolean
+sync_index_save (GHashTable  *index,
+		 const char  *filename,
+		 const char  *archive_filename,
+		 GError     **error)
+{
+	GPtrArray      *entries;
+	GString        *contents;
+	GHashTableIter  iter;
+	gpointer        value;
+	char           *identity;
+	guint           i;
+	gboolean        result;
+
+	identity = get_archive_identity (archive_filename);
+	if (identity == NULL) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno), "%s: %s", archive_filename, g_strerror (errno));
+		return FALSE;
+	}
+
+	/* sorted, so that the file does not change when the index does
+	 * not */
+
+	entries = g_ptr_array_sized_new (g_hash_table_size (index));
+	g_hash_table_iter_init (&iter, index);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		g_ptr_array_add (entries, value);
+	g_ptr_array_sort (entries, compare_entries_by_path);
+
+	contents = g_string_new (SYNC_INDEX_HEADER "\n");
+	g_string_append_printf (contents, "%s\n", identity);
+	g_free (identity);
+	for (i = 0; i < entries->len; i++) {
+		SyncIndexEntry *entry = g_ptr_array_index (entries, i);
+
+		/* the path cannot be saved in a single line */
+		if (strchr (entry->path, '\n') != NULL)
+			continue;
+
+		g_string_append_printf (contents,
+					"%s\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\n",
+					entry->hash,
+					(gint64) entry->size,
+					(gint64) entry->mtime,
+					entry->path);
+	}
+
+	result = g_file_set_contents (filename, contents->str, contents->len, error);
+
+	g_string_free (contents, TRUE);
+	g_ptr_array_free (entries, TRUE);
+
+	return result;
+}
+
+
+char *
+sync_index_get_filename (const char *archive_filename)
+{
+	return g_strconcat (archive_filename, SYNC_INDEX_EXTENSION, NULL);
+}
+
+
+/* -- sync_index_hash_files -- */
+
+
+static char *
+hash_file (int         base_fd,
+	   const char *path,
+	   guchar     *buffer)
+{
+	GChecksum *checksum;
+	char      *hash = NULL;
+	int        fd;
+	ssize_t    n;
+
+	fd = openat (base_fd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	checksum = g_checksum_new (HASH_CHECKSUM_TYPE);
+	for (;;) {
+		n = read (fd, buffer, HASH_BUFFER_SIZE);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			break;
+		g_checksum_update (checksum, buffer, n);
+	}
+	if (n == 0)
+		hash = g_strdup (g_checksum_get_string (checksum));
+
+	g_checksum_free (checksum);
+	close (fd);
+
+	return hash;
+}
+
+
+typedef struct {
+	int       base_fd;
+	FileHash *files;
+	guint     n_files;
+	gint      next_file;   /* atomic */
+} HashJob;
+
+
+/* each thread takes the next file to read, so that a large file does not
+ * delay the files assigned to the same thread. */
+static void
+hash_job_func (gpointer data,
+	       gpointer user_data)
+{
+	HashJob *job = user_data;
+	guchar  *buffer;
+	guint    i;
+
+	buffer = g_malloc (HASH_BUFFER_SIZE);
+	while ((i = (guint) g_atomic_int_add (&job->next_file, 1)) < job->n_files)
+		job->files[i].hash = hash_file (job->base_fd, job->files[i].path, buffer);
+	g_free (buffer);
+}
+
+
+void
+sync_index_hash_files (const char *base_dir,
+		       FileHash   *files,
+		       guint       n_files)
+{
+	HashJob      job;
+	GThreadPool *pool = NULL;
+	guint        n_threads;
+	guint        i;
+
+	for (i = 0; i < n_files; i++)
+		files[i].hash = NULL;
+
+	if (n_files == 0)
+		return;
+
+	job.base_fd = open ((base_dir != NULL) ? base_dir : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (job.base_fd < 0)
+		return;
+	job.files = files;
+	job.n_files = n_files;
+	job.next_file = 0;
+
+	n_threads = MIN (n_files, g_get_num_processors ());
+	if (n_threads > 1)
+		pool = g_thread_pool_new (hash_job_func,
+					  &job,
+					  n_threads,
+					  FALSE,
+					  NULL);
+
+	if (pool != NULL) {
+		for (i = 0; i < n_threads; i++)
+			g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+
+		/* wait for all the files */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+	else
+		hash_job_func (NULL, &job);
+
+	close (job.base_fd);
+}
@@ -0,0 +1,70 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SYNC_INDEX_H
+#define SYNC_INDEX_H
+
+#include <time.h>
+#include <glib.h>
+
+/* The sync index is a text file saved beside an archive that records,
+ * for each file added by a synchronization, the size and the
+ * modification time the file had and a hash of its content.  When only
+ * the modification time of a file changes, the hash tells whether the
+ * archived copy is still up to date. */
+
+typedef struct {
+	char    *path;   /* path in the archive */
+	goffset  size;
+	time_t   mtime;
+	char    *hash;
+} SyncIndexEntry;
+
+typedef struct {
+	const char *path;   /* relative to the base folder, not copied */
+	char       *hash;   /* NULL if the file cannot be read */
+} FileHash;
+
+SyncIndexEntry * sync_index_entry_new         (const char  *path,
+					       goffset      size,
+					       time_t       mtime,
+					       const char  *hash);
+void             sync_index_entry_free        (SyncIndexEntry *entry);
+
+/* Returns a table from the path to its SyncIndexEntry, empty if the
+ * file does not exist, is not valid or was saved for another version of
+ * archive_filename (size, modification time or inode changed). */
+GHashTable *     sync_index_load              (const char  *filename,
+					       const char  *archive_filename);
+gboolean         sync_index_save              (GHashTable  *index,
+					       const char  *filename,
+					       const char  *archive_filename,
+					       GError     **error);
+char *           sync_index_get_filename      (const char  *archive_filename);
+
+/* Computes the hash of the content of n_files files located in base_dir,
+ * the files are read in parallel by a pool of threads. */
+void             sync_index_hash_files        (const char  *base_dir,
+					       FileHash    *files,
+					       guint        n_files);
+
+#endif /* SYNC_INDEX_H */
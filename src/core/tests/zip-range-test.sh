@@ -0,0 +1,86 @@
+#!/bin/sh
+# Checks zip-range on local files.  GIO reads them as seekable streams, as
+# it reads the files of a gvfs or FUSE mount, so they stand in for remote
+# archives.
+#
+#   zip-range-test.sh ZIP_RANGE
+#
+# The archives are written with the zipfile module of python3.  The exit
+# status is 0 on success, 1 on failure and 77 if python3 is missing.
+
+ZIP_RANGE=$1
+
+if ! command -v python3 >/dev/null 2>&1; then
+	echo "python3 not found"
+	exit 77
+fi
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf "$WORK_DIR"' EXIT
+status=0
+
+fail () {
+	echo "FAIL: $1"
+	status=1
+}
+
+# an archive that adds a link to a folder out of the destination, then a
+# file under the link: the file must stay in the destination.
+
+python3 - "$WORK_DIR/link.zip" <<'PYTHON'
+import sys, zipfile
+with zipfile.ZipFile(sys.argv[1], 'w') as archive:
+    link = zipfile.ZipInfo('link')
+    link.create_system = 3
+    link.external_attr = 0o120777 << 16
+    archive.writestr(link, '../outside')
+    archive.writestr('link/escaped.txt', 'escaped\n')
+PYTHON
+
+mkdir "$WORK_DIR/dest" "$WORK_DIR/outside"
+"$ZIP_RANGE" --extract="$WORK_DIR/dest" "$WORK_DIR/link.zip" > "$WORK_DIR/link.out" 2>&1
+if test -e "$WORK_DIR/outside/escaped.txt"; then
+	fail "an entry was extracted through a link of the archive"
+fi
+if ! test -f "$WORK_DIR/dest/link/escaped.txt"; then
+	fail "the entry under the link was not extracted to the destination"
+fi
+
+# a self-extracting zip64 archive: the offset stored in the zip64 locator
+# does not count the program prepended to the archive.
+
+python3 - "$WORK_DIR/zip64.zip" <<'PYTHON'
+import sys, zipfile
+# write the zip64 records for a small archive
+zipfile.ZIP_FILECOUNT_LIMIT = 1
+with zipfile.ZipFile(sys.argv[1], 'w', zipfile.ZIP_DEFLATED) as archive:
+    for i in range(3):
+        archive.writestr('file%d.txt' % i, ('content %d\n' % i) * 100)
+PYTHON
+
+{
+	printf '#!/bin/sh\nexit 0\n'
+	head -c 4096 /dev/zero
+	cat "$WORK_DIR/zip64.zip"
+} > "$WORK_DIR/sfx.zip"
+
+if ! "$ZIP_RANGE" --test "$WORK_DIR/sfx.zip" > "$WORK_DIR/test.out" 2>&1; then
+	cat "$WORK_DIR/test.out"
+	fail "the self-extracting zip64 archive could not be tested"
+elif test `grep -c 'file[0-9]\.txt' "$WORK_DIR/test.out"` -ne 3; then
+	cat "$WORK_DIR/test.out"
+	fail "the self-extracting zip64 archive did not list 3 entries"
+fi
+
+mkdir "$WORK_DIR/sfx"
+"$ZIP_RANGE" --extract="$WORK_DIR/sfx" "$WORK_DIR/sfx.zip" file1.txt > "$WORK_DIR/extract.out" 2>&1
+python3 -c 'import sys; sys.stdout.write("content 1\n" * 100)' > "$WORK_DIR/expected.txt"
+if ! cmp -s "$WORK_DIR/expected.txt" "$WORK_DIR/sfx/file1.txt"; then
+	cat "$WORK_DIR/extract.out"
+	fail "an entry of the self-extracting zip64 archive was not extracted"
+fi
+if test -e "$WORK_DIR/sfx/file0.txt"; then
+	fail "an entry that was not selected was extracted"
+fi
+
+exit $status
@@ -0,0 +1,590 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "zip-index.h"
+
+
+#define EOCD_SIGNATURE          0x06054b50
+#define EOCD_SIZE               22
+#define ZIP64_LOCATOR_SIGNATURE 0x07064b50
+#define ZIP64_LOCATOR_SIZE      20
+#define ZIP64_EOCD_SIGNATURE    0x06064b50
+#define ZIP64_EOCD_SIZE         56
+#define CDFH_SIGNATURE          0x02014b50
+#define CDFH_SIZE               46
+#define LFH_SIGNATURE           0x04034b50
+#define LFH_SIZE                30
+#define MAX_COMMENT_SIZE        65535
+
+#define ZIP64_EXTRA_ID          0x0001
+#define TIMESTAMP_EXTRA_ID      0x5455
+
+#define FLAG_ENCRYPTED          (1 << 0)
+#define FLAG_UTF8               (1 << 11)
+
+#define METHOD_STORED           0
+#define METHOD_DEFLATED         8
+
+#define HOST_UNIX               3
+
+#define EXTRACT_BUFFER_SIZE     65536
+
+/* refuse to load absurdly large central directories */
+#define MAX_CENTRAL_DIRECTORY_SIZE  ((goffset) 1024 * 1024 * 1024)
+
+
+static guint32
+get_le16 (const guchar *p)
+{
+	return (guint32) p[0] | ((guint32) p[1] << 8);
+}
+
+
+static guint32
+get_le32 (const guchar *p)
+{
+	return (guint32) p[0]
+		| ((guint32) p[1] << 8)
+		| ((guint32) p[2] << 16)
+		| ((guint32) p[3] << 24);
+}
+
+
+static guint64
+get_le64 (const guchar *p)
+{
+	return (guint64) get_le32 (p) | ((guint64) get_le32 (p + 4) << 32);
+}
+
+
+static gboolean
+read_at (GInputStream  *stream,
+	 goffset        offset,
+	 void          *buffer,
+	 gsize          size,
+	 GCancellable  *cancellable,
+	 GError       **error)
+{
+	gsize bytes_read;
+
+	if (! g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, cancellable, error))
+		return FALSE;
+
+	if (! g_input_stream_read_all (stream, buffer, size, &bytes_read, cancellable, error))
+		return FALSE;
+
+	if (bytes_read != size) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Truncated zip archive");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean
+set_invalid_data_error (GError **error)
+{
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid zip archive");
+	return FALSE;
+}
+
+
+void
+zip_entry_free (ZipEntry *entry)
+{
+	if (entry == NULL)
+		return;
+	g_free (entry->name);
+	g_free (entry);
+}
+
+
+static time_t
+dos_time_to_time (guint32 dos_time,
+		  guint32 dos_date)
+{
+	struct tm tm;
+
+	/* DOS times are local times */
+
+	memset (&tm, 0, sizeof (tm));
+	tm.tm_sec = (dos_time & 0x1f) * 2;
+	tm.tm_min = (dos_time >> 5) & 0x3f;
+	tm.tm_hour = (dos_time >> 11) & 0x1f;
+	tm.tm_mday = dos_date & 0x1f;
+	tm.tm_mon = ((dos_date >> 5) & 0x0f) - 1;
+	tm.tm_year = ((dos_date >> 9) & 0x7f) + 80;
+	tm.tm_isdst = -1;
+
+	return mktime (&tm);
+}
+
+
+static char *
+get_entry_name (const guchar *name,
+		gsize         len,
+		guint16       flags)
+{
+	char *utf8_name;
+
+	/* names are UTF-8 when the flag is set, the OEM code page
+	 * otherwise, but many tools store UTF-8 without the flag. */
+
+	if ((flags & FLAG_UTF8) || g_utf8_validate ((const char *) name, len, NULL))
+		return g_strndup ((const char *) name, len);
+
+	utf8_name = g_convert ((const char *) name, len, "UTF-8", "CP437", NULL, NULL, NULL);
+	if (utf8_name == NULL)
+		utf8_name = g_convert ((const char *) name, len, "UTF-8", "ISO-8859-1", NULL, NULL, NULL);
+
+	return utf8_name;
+}
+
+
+/* reads the zip64 sizes and offset and the extended timestamp from the
+ * extra fields of a central directory header */
+static void
+parse_extra_fields (const guchar *extra,
+		    gsize         len,
+		    ZipEntry     *entry,
+		    gboolean      size_in_zip64,
+		    gboolean      compressed_size_in_zip64,
+		    gboolean      offset_in_zip64)
+{
+	gsize pos = 0;
+
+	while (pos + 4 <= len) {
+		guint32       id = get_le16 (extra + pos);
+		guint32       size = get_le16 (extra + pos + 2);
+		const guchar *data = extra + pos + 4;
+		const guchar *end;
+
+		if (pos + 4 + size > len)
+			break;
+		end = data + size;
+
+		if (id == ZIP64_EXTRA_ID) {
+			/* only the fields that overflowed are present, in
+			 * this order */
+
+			if (size_in_zip64 && (data + 8 <= end)) {
+				entry->size = get_le64 (data);
+				data += 8;
+			}
+			if (compressed_size_in_zip64 && (data + 8 <= end)) {
+				entry->compressed_size = get_le64 (data);
+				data += 8;
+			}
+			if (offset_in_zip64 && (data + 8 <= end))
+				entry->local_header_offset = get_le64 (data);
+		}
+		else if (id == TIMESTAMP_EXTRA_ID) {
+			/* the central directory only has the modification
+			 * time */
+
+			if ((size >= 5) && (data[0] & 1))
+				entry->modified = (gint32) get_le32 (data + 1);
+		}
+
+		pos += 4 + size;
+	}
+}
+
+
+static gboolean
+parse_central_directory (const guchar  *cd,
+			 gsize          cd_size,
+			 guint64        n_entries,
+			 goffset        offset_delta,
+			 GPtrArray     *entries,
+			 GError       **error)
+{
+	gsize   pos = 0;
+	guint64 i;
+
+	for (i = 0; i < n_entries; i++) {
+		const guchar *header = cd + pos;
+		ZipEntry     *entry;
+		guint32       name_len;
+		guint32       extra_len;
+		guint32       comment_len;
+		guint32       compressed_size;
+		guint32       size;
+		guint32       offset;
+		guint32       host;
+		guint32       mode;
+
+		if ((pos + CDFH_SIZE > cd_size) || (get_le32 (header) != CDFH_SIGNATURE))
+			return set_invalid_data_error (error);
+
+		name_len = get_le16 (header + 28);
+		extra_len = get_le16 (header + 30);
+		comment_len = get_le16 (header + 32);
+		if (pos + CDFH_SIZE + name_len + extra_len + comment_len > cd_size)
+			return set_invalid_data_error (error);
+
+		entry = g_new0 (ZipEntry, 1);
+		entry->flags = get_le16 (header + 8);
+		entry->method = get_le16 (header + 10);
+		entry->crc32 = get_le32 (header + 16);
+		entry->modified = dos_time_to_time (get_le16 (header + 12), get_le16 (header + 14));
+		compressed_size = get_le32 (header + 20);
+		size = get_le32 (header + 24);
+		offset = get_le32 (header + 42);
+		entry->compressed_size = compressed_size;
+		entry->size = size;
+		entry->local_header_offset = offset;
+
+		parse_extra_fields (header + CDFH_SIZE + name_len,
+				    extra_len,
+				    entry,
+				    size == G_MAXUINT32,
+				    compressed_size == G_MAXUINT32,
+				    offset == G_MAXUINT32);
+		entry->local_header_offset += offset_delta;
+
+		entry->name = get_entry_name (header + CDFH_SIZE, name_len, entry->flags);
+		if (entry->name == NULL) {
+			zip_entry_free (entry);
+			return set_invalid_data_error (error);
+		}
+		entry->dir = g_str_has_suffix (entry->name, "/");
+
+		host = get_le16 (header + 4) >> 8;
+		mode = get_le32 (header + 38) >> 16;
+		if (host == HOST_UNIX) {
+			entry->mode = mode & 07777;
+			entry->link = (mode & S_IFMT) == S_IFLNK;
+			if ((mode & S_IFMT) == S_IFDIR)
+				entry->dir = TRUE;
+		}
+
+		g_ptr_array_add (entries, entry);
+
+		pos += CDFH_SIZE + name_len + extra_len + comment_len;
+	}
+
+	return TRUE;
+}
+
+
+GPtrArray *
+zip_index_read (GInputStream  *stream,
+		GCancellable  *cancellable,
+		GError       **error)
+{
+	goffset    file_size;
+	goffset    tail_offset;
+	gsize      tail_size;
+	guchar    *tail;
+	goffset    eocd_offset = -1;
+	guint64    n_entries;
+	goffset    cd_size;
+	goffset    cd_offset;
+	goffset    cd_end;
+	guchar    *cd;
+	GPtrArray *entries;
+	gssize     i;
+
+	if (! G_IS_SEEKABLE (stream) || ! g_seekable_can_seek (G_SEEKABLE (stream))) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "The stream is not seekable");
+		return NULL;
+	}
+
+	if (! g_seekable_seek (G_SEEKABLE (stream), 0, G_SEEK_END, cancellable, error))
+		return NULL;
+	file_size = g_seekable_tell (G_SEEKABLE (stream));
+	if (file_size < EOCD_SIZE) {
+		set_invalid_data_error (error);
+		return NULL;
+	}
+
+	/* the end of central directory record is followed by a comment of
+	 * at most 64 KiB, read the whole range once. */
+
+	tail_size = MIN (file_size, EOCD_SIZE + MAX_COMMENT_SIZE + ZIP64_LOCATOR_SIZE);
+	tail_offset = file_size - tail_size;
+	tail = g_malloc (tail_size);
+	if (! read_at (stream, tail_offset, tail, tail_size, cancellable, error)) {
+		g_free (tail);
+		return NULL;
+	}
+
+	for (i = tail_size - EOCD_SIZE; i >= 0; i--)
+		if ((get_le32 (tail + i) == EOCD_SIGNATURE)
+		    && (i + EOCD_SIZE + get_le16 (tail + i + 20) <= tail_size))
+		{
+			eocd_offset = i;
+			break;
+		}
+
+	if (eocd_offset < 0) {
+		g_free (tail);
+		set_invalid_data_error (error);
+		return NULL;
+	}
+
+	if ((get_le16 (tail + eocd_offset + 4) != 0) || (get_le16 (tail + eocd_offset + 6) != 0)) {
+		g_free (tail);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Split zip archives are not supported");
+		return NULL;
+	}
+
+	n_entries = get_le16 (tail + eocd_offset + 10);
+	cd_size = get_le32 (tail + eocd_offset + 12);
+	cd_offset = get_le32 (tail + eocd_offset + 16);
+	cd_end = tail_offset + eocd_offset;
+
+	/* zip64: the real values are in the zip64 end of central directory
+	 * record, found with the locator that precedes the record above */
+
+	if ((eocd_offset >= ZIP64_LOCATOR_SIZE)
+	    && (get_le32 (tail + eocd_offset - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE))
+	{
+		guchar  zip64_eocd[ZIP64_EOCD_SIZE];
+		goffset locator_offset;
+		goffset zip64_eocd_offset;
+
+		/* the offset in the locator doesn't count the data prepended
+		 * to the archive, the record usually precedes the locator
+		 * directly, so look there first. */
+
+		locator_offset = tail_offset + eocd_offset - ZIP64_LOCATOR_SIZE;
+		zip64_eocd_offset = locator_offset - ZIP64_EOCD_SIZE;
+		if ((zip64_eocd_offset < 0)
+		    || ! read_at (stream, zip64_eocd_offset, zip64_eocd, ZIP64_EOCD_SIZE, cancellable, NULL)
+		    || (get_le32 (zip64_eocd) != ZIP64_EOCD_SIGNATURE))
+		{
+			zip64_eocd_offset = get_le64 (tail + eocd_offset - ZIP64_LOCATOR_SIZE + 8);
+			if (! read_at (stream, zip64_eocd_offset, zip64_eocd, ZIP64_EOCD_SIZE, cancellable, error)) {
+				g_free (tail);
+				return NULL;
+			}
+			if (get_le32 (zip64_eocd) != ZIP64_EOCD_SIGNATURE) {
+				g_free (tail);
+				set_invalid_data_error (error);
+				return NULL;
+			}
+		}
+		n_entries = get_le64 (zip64_eocd + 32);
+		cd_size = get_le64 (zip64_eocd + 40);
+		cd_offset = get_le64 (zip64_eocd + 48);
+		cd_end = zip64_eocd_offset;
+	}
+	g_free (tail);
+
+	if ((cd_size > cd_end) || (cd_size > MAX_CENTRAL_DIRECTORY_SIZE)) {
+		set_invalid_data_error (error);
+		return NULL;
+	}
+
+	/* data prepended to the archive (self-extracting archives) shifts
+	 * all the offsets, as unzip does use the position of the central
+	 * directory to find it. */
+
+	cd = g_malloc (MAX (cd_size, 1));
+	if (! read_at (stream, cd_end - cd_size, cd, cd_size, cancellable, error)) {
+		g_free (cd);
+		return NULL;
+	}
+
+	entries = g_ptr_array_new_with_free_func ((GDestroyNotify) zip_entry_free);
+	if (! parse_central_directory (cd, cd_size, n_entries, (cd_end - cd_size) - cd_offset, entries, error)) {
+		g_ptr_array_free (entries, TRUE);
+		entries = NULL;
+	}
+	g_free (cd);
+
+	return entries;
+}
+
+
+gboolean
+zip_entry_can_extract (ZipEntry *entry)
+{
+	return ! (entry->flags & FLAG_ENCRYPTED)
+		&& ((entry->method == METHOD_STORED) || (entry->method == METHOD_DEFLATED));
+}
+
+
+static guint32
+update_crc32 (guint32       crc,
+	      const guchar *data,
+	      gsize         len)
+{
+	static guint32 table[256];
+	static gsize   table_initialized = 0;
+	gsize          i;
+
+	if (g_once_init_enter (&table_initialized)) {
+		guint32 n;
+
+		for (n = 0; n < 256; n++) {
+			guint32 c = n;
+			int     k;
+
+			for (k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		g_once_init_leave (&table_initialized, 1);
+	}
+
+	crc = crc ^ 0xffffffff;
+	for (i = 0; i < len; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return crc ^ 0xffffffff;
+}
+
+
+gboolean
+zip_entry_extract (GInputStream   *stream,
+		   ZipEntry       *entry,
+		   GOutputStream  *output,
+		   GCancellable   *cancellable,
+		   GError        **error)
+{
+	guchar        header[LFH_SIZE];
+	guchar       *in_buffer;
+	guchar       *out_buffer;
+	gsize         in_len = 0;
+	goffset       remaining;
+	goffset       size = 0;
+	guint32       crc = 0;
+	GConverter   *converter = NULL;
+	gboolean      finished = FALSE;
+	gboolean      result = TRUE;
+
+	if (! zip_entry_can_extract (entry)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unsupported zip entry");
+		return FALSE;
+	}
+
+	/* the local header can have different extra fields, only its
+	 * lengths are used. */
+
+	if (! read_at (stream, entry->local_header_offset, header, LFH_SIZE, cancellable, error))
+		return FALSE;
+	if (get_le32 (header) != LFH_SIGNATURE)
+		return set_invalid_data_error (error);
+
+	if (! g_seekable_seek (G_SEEKABLE (stream),
+			       entry->local_header_offset + LFH_SIZE + get_le16 (header + 26) + get_le16 (header + 28),
+			       G_SEEK_SET,
+			       cancellable,
+			       error))
+	{
+		return FALSE;
+	}
+
+	if (entry->method == METHOD_DEFLATED)
+		converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+
+	in_buffer = g_malloc (EXTRACT_BUFFER_SIZE);
+	out_buffer = g_malloc (EXTRACT_BUFFER_SIZE);
+	remaining = entry->compressed_size;
+
+	while (result && ! finished) {
+		const guchar *data;
+		gsize         data_len;
+
+		if ((remaining > 0) && (in_len < EXTRACT_BUFFER_SIZE)) {
+			gsize bytes_read;
+
+			result = g_input_stream_read_all (stream,
+							  in_buffer + in_len,
+							  MIN (remaining, EXTRACT_BUFFER_SIZE - in_len),
+							  &bytes_read,
+							  cancellable,
+							  error);
+			if (result && (bytes_read == 0))
+				result = set_invalid_data_error (error);
+			if (! result)
+				break;
+			in_len += bytes_read;
+			remaining -= bytes_read;
+		}
+
+		if (converter != NULL) {
+			GConverterResult  converter_result;
+			gsize             bytes_read;
+			GError           *local_error = NULL;
+
+			converter_result = g_converter_convert (converter,
+								in_buffer,
+								in_len,
+								out_buffer,
+								EXTRACT_BUFFER_SIZE,
+								(remaining == 0) ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+								&bytes_read,
+								&data_len,
+								&local_error);
+			if (converter_result == G_CONVERTER_ERROR) {
+				if ((remaining > 0) && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT)) {
+					g_clear_error (&local_error);
+					continue;
+				}
+				g_propagate_error (error, local_error);
+				result = FALSE;
+				break;
+			}
+
+			memmove (in_buffer, in_buffer + bytes_read, in_len - bytes_read);
+			in_len -= bytes_read;
+			data = out_buffer;
+			finished = (converter_result == G_CONVERTER_FINISHED);
+		}
+		else {
+			data = in_buffer;
+			data_len = in_len;
+			in_len = 0;
+			finished = (remaining == 0);
+		}
+
+		crc = update_crc32 (crc, data, data_len);
+		size += data_len;
+		if (output != NULL)
+			result = g_output_stream_write_all (output, data, data_len, NULL, cancellable, error);
+	}
+
+	if (result && ((size != entry->size) || (crc != entry->crc32))) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Bad CRC for %s", entry->name);
+		result = FALSE;
+	}
+
+	if (converter != NULL)
+		g_object_unref (converter);
+	g_free (out_buffer);
+	g_free (in_buffer);
+
+	return result;
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  Engrampa
+ *
+ *  Copyright (C) 2001 The Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Street #330, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef ZIP_INDEX_H
+#define ZIP_INDEX_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+typedef struct {
+	char     *name;               /* UTF-8 path stored in the archive */
+	goffset   local_header_offset;
+	goffset   compressed_size;
+	goffset   size;
+	guint32   crc32;
+	time_t    modified;
+	guint32   mode;               /* unix permissions, 0 if not stored */
+	guint16   flags;
+	guint16   method;
+	gboolean  dir;
+	gboolean  link;
+} ZipEntry;
+
+/* Reads the entries of a zip archive from its end of central directory
+ * record and its central directory only, the stream must be seekable,
+ * so that a remote archive can be listed without reading the whole
+ * file.  Zip64 archives are supported, split archives are not.  Returns
+ * an array of ZipEntry, NULL on error. */
+GPtrArray *  zip_index_read                   (GInputStream  *stream,
+					       GCancellable  *cancellable,
+					       GError       **error);
+void         zip_entry_free                   (ZipEntry      *entry);
+
+/* TRUE if zip_entry_extract can extract the entry: not encrypted,
+ * stored or deflated. */
+gboolean     zip_entry_can_extract            (ZipEntry      *entry);
+/* Writes the uncompressed data of the entry to output, reading only its
+ * range of the seekable stream, and checks its size and CRC.  output can
+ * be NULL to check the data only. */
+gboolean     zip_entry_extract                (GInputStream  *stream,
+					       ZipEntry      *entry,
+					       GOutputStream *output,
+					       GCancellable  *cancellable,
+					       GError       **error);
+
+#endif /* ZIP_INDEX_H */
@@ -32,6 +32,7 @@ QObject::tr("War (.war)");
 QObject::tr("Xz (.xz)");
 QObject::tr("Tar compressed with xz (.tar.xz)");
 QObject::tr("Zoo (.zoo)");
+QObject::tr("Tar compressed with zstd (.tar.zst)");
 QObject::tr("Zip (.zip)");
 
 // ./src/core/fr-command-7z.c
@@ -24,6 +24,7 @@
 
 #include "mainwindow.h"
 #include "progressdialog.h"
+#include "batchextractdialog.h"
 #include "archiver.h"
 #include "passworddialog.h"
 #include "createfiledialog.h"
@@ -49,6 +50,7 @@
 #include <QLibraryInfo>
 
 #include <string>
+#include <vector>
 #include <unordered_map>
 
 gint          ForceDirectoryCreation;
@@ -60,6 +62,15 @@ static char*  extract_to = NULL;
 static int    extract;
 static int    extract_here;
 static char*  default_url = NULL;
+static double compression_speed = 0;
+static int    compression_deadline = 0;
+static int    compression_threads = 0;
+static int    sync_folders;
+static int    sync_content;
+static int    extract_jobs = 0;
+static int    extract_processes = 0;
+static int    modify_in_place;
+static int    print_stats;
 
 /* argv[0] from main(); used as the command to restart the program */
 static const char* program_argv0 = NULL;
@@ -96,12 +107,66 @@ static const GOptionEntry options[] = {
         NULL
     },
 
+    {
+        "jobs", 'j', 0, G_OPTION_ARG_INT, &extract_jobs,
+        N_("Number of archives to extract at the same time, chosen from the processors and the disk by default"),
+        N_("N")
+    },
+
+    {
+        "extract-processes", '\0', 0, G_OPTION_ARG_INT, &extract_processes,
+        N_("Split the extraction of each zip, 7z or rar archive between N processes, faster on solid-state disks (default: one process)"),
+        N_("N")
+    },
+
+    {
+        "modify-in-place", '\0', 0, G_OPTION_ARG_NONE, &modify_in_place,
+        N_("Update zip, 7z and tar archives without working on a copy of the archive"),
+        NULL
+    },
+
+    {
+        "stats", '\0', 0, G_OPTION_ARG_NONE, &print_stats,
+        N_("Print the copies that were avoided and the copies between file systems when quitting"),
+        NULL
+    },
+
     {
         "default-dir", '\0', 0, G_OPTION_ARG_STRING, &default_url,
         N_("Default folder to use for the '--add' and '--extract' commands"),
         N_("FOLDER")
     },
 
+    {
+        "compression-speed", '\0', 0, G_OPTION_ARG_DOUBLE, &compression_speed,
+        N_("Choose the compression level that compresses at least this many MB per second"),
+        N_("MB/S")
+    },
+
+    {
+        "compression-deadline", '\0', 0, G_OPTION_ARG_INT, &compression_deadline,
+        N_("Choose the compression level that compresses the files in this many seconds"),
+        N_("SECONDS")
+    },
+
+    {
+        "compression-threads", '\0', 0, G_OPTION_ARG_INT, &compression_threads,
+        N_("Number of threads used by the parallel compressors, one per processor by default"),
+        N_("N")
+    },
+
+    {
+        "sync", '\0', 0, G_OPTION_ARG_NONE, &sync_folders,
+        N_("With '--add-to', make the archive match the folders: add the new and changed files and delete the missing ones"),
+        NULL
+    },
+
+    {
+        "sync-content", '\0', 0, G_OPTION_ARG_NONE, &sync_content,
+        N_("With '--sync', compare the content of the files whose modification time changed"),
+        NULL
+    },
+
     {
         "force", '\0', 0, G_OPTION_ARG_NONE, &ForceDirectoryCreation,
         N_("Create destination folder without asking confirmation"),
@@ -135,6 +200,17 @@ static int runApp(QApplication& app) {
 
     // handle command line options
 
+    if(compression_speed > 0 || compression_deadline > 0) {
+        Archiver::setCompressionTarget(compression_speed, compression_deadline > 0 ? compression_deadline : 0);
+    }
+
+    if(compression_threads > 0) {
+        Archiver::setCompressionThreads(compression_threads);
+    }
+
+    MainWindow::setExtractProcesses(extract_processes);
+    Archiver::setModifyInPlace(modify_in_place);
+
     if(remaining_args == NULL) {  /* No archive specified. */
         auto mainWin = new MainWindow();
         mainWin->show();
@@ -216,7 +292,34 @@ static int runApp(QApplication& app) {
         dlg.setOperation(QObject::tr("Adding file: "));
 
         dlg.setArchiver(&archiver);
-        archiver.createNewArchive(add_to_uri);
+
+        // the folders are synchronized one after the other, an existing
+        // archive is loaded first to compare its content
+        bool sync = (sync_folders || sync_content);
+        size_t nextSyncFolder = 0;
+        auto syncNextFolder = [&]() {
+            if(nextSyncFolder >= filePaths.size()) {
+                dlg.accept();
+                return;
+            }
+            archiver.syncDirectory(filePaths[nextSyncFolder++],
+                                   default_url, // dest dir
+                                   sync_content,
+                                   addPassword.empty() ? nullptr : addPassword.c_str(),
+                                   addEncryptFileList,
+                                   FR_COMPRESSION_NORMAL,
+                                   addSplitVolumes ? addVolumeSize : 0);
+        };
+
+        GFile* addToFile = g_file_new_for_uri(add_to_uri);
+        bool archiveExists = g_file_query_exists(addToFile, nullptr);
+        g_object_unref(addToFile);
+        if(sync && archiveExists) {
+            archiver.openArchive(add_to_uri, addPassword.empty() ? nullptr : addPassword.c_str());
+        }
+        else {
+            archiver.createNewArchive(add_to_uri);
+        }
 
         // we can only add files after the archive is fully created
         QObject::connect(&archiver, &Archiver::finish, &dlg, [&](FrAction action, ArchiverError err) {
@@ -225,6 +328,19 @@ static int runApp(QApplication& app) {
                 dlg.reject();
                 return;
             }
+            if(sync) {
+                switch(action) {
+                case FR_ACTION_CREATING_NEW_ARCHIVE:
+                case FR_ACTION_LISTING_CONTENT:
+                case FR_ACTION_ADDING_FILES:
+                case FR_ACTION_DELETING_FILES:
+                    syncNextFolder();
+                    break;
+                default:
+                    break;
+                }
+                return;
+            }
             switch(action) {
             case FR_ACTION_CREATING_NEW_ARCHIVE:
                 archiver.addDroppedItems(filePaths, // src files
@@ -245,59 +361,30 @@ static int runApp(QApplication& app) {
         return 0;
     }
     else if((extract_to != NULL) || (extract == 1) || (extract_here == 1)) {
+        /* Extract all archives, several at a time. */
         const char* filename = NULL;
         int i = 0;
-        /* Extract all archives. */
+        std::vector<std::string> archiveUris;
         while((filename = remaining_args[i++]) != NULL) {
             auto archive_uri = Fm::CStrPtr{get_uri_from_command_line(filename)};
-
-            Archiver archiver;
-            ProgressDialog dlg;
-            dlg.setOperation(QObject::tr("Extracting file: "));
-
-            dlg.setArchiver(&archiver);
-            archiver.openArchive(archive_uri.get(), nullptr);
-
-            // we can only start archive extraction after its content is fully loaded
-            QObject::connect(&archiver, &Archiver::finish, &dlg, [&](FrAction action, ArchiverError err) {
-                if(err.hasError()) {
-                    QMessageBox::critical(&dlg, QObject::tr("Error"), err.message());
-                    dlg.reject();
-                    return;
-                }
-                switch(action) {
-                case FR_ACTION_LISTING_CONTENT: {            /* loading the archive from a remote location */
-                    std::string password_;
-                    if(archiver.isEncrypted()) {
-                        password_ = PasswordDialog::askPassword().toStdString();
-                    }
-
-                    if(extract_here) {
-                        archiver.extractHere(extractSkipOlder,
-                                             extractOverwrite,
-                                             extractReCreateFolders,
-                                             password_.empty() ? nullptr : password_.c_str());
-                    }
-                    else {
-                        // a target dir is specified
-                        archiver.extractAll(extract_to_uri,
-                                            extractSkipOlder,
-                                            extractOverwrite,
-                                            extractReCreateFolders,
-                                            password_.empty() ? nullptr : password_.c_str());
-                    }
-                    break;
-                }
-                case FR_ACTION_EXTRACTING_FILES:
-                    dlg.accept();
-                    break;
-                default:
-                    break;
-                };
-            });
-            dlg.exec();
+            archiveUris.emplace_back(archive_uri.get());
+        }
+        if(archiveUris.empty()) {
             return 0;
         }
+
+        const char* destDirUri = extract_here ? nullptr : extract_to_uri;
+        BatchExtractDialog dlg;
+        dlg.setExtractOptions(destDirUri, extractSkipOlder, extractOverwrite, extractReCreateFolders);
+        // the archives are extracted in their folder with --extract-here
+        dlg.setJobCount(extract_jobs > 0 ? extract_jobs
+                                         : Archiver::defaultJobCount(destDirUri ? destDirUri : archiveUris[0].c_str()));
+        dlg.setProcessesPerArchive(extract_processes);
+        dlg.setArchives(archiveUris);
+        dlg.start();
+        int result = dlg.exec();
+        g_free(extract_to_uri);
+        return (result == QDialog::Accepted) ? 0 : 1;
     }
     else { /* Open each archive in a window */
         const char* filename = NULL;
@@ -372,6 +459,19 @@ int main(int argc, char** argv) {
     // FIXME: port command line parsing to Qt
     initialize_data(); // initialize the file-roller core
     status = runApp(app);
+
+    if(print_stats) {
+        unsigned int avoidedCopies;
+        quint64 avoidedBytes;
+        Archiver::avoidedCopyStats(avoidedCopies, avoidedBytes);
+        g_print("copies avoided: %u (%" G_GUINT64_FORMAT " bytes)\n", avoidedCopies, (guint64) avoidedBytes);
+
+        unsigned int crossDeviceCopies;
+        quint64 crossDeviceBytes;
+        Archiver::crossDeviceStats(crossDeviceCopies, crossDeviceBytes);
+        g_print("copies between file systems: %u (%" G_GUINT64_FORMAT " bytes)\n", crossDeviceCopies, (guint64) crossDeviceBytes);
+    }
+
     release_data();
 
     return status;
@@ -8,6 +8,8 @@
 #include "passworddialog.h"
 #include "createfiledialog.h"
 #include "extractfiledialog.h"
+#include "previewcache.h"
+#include "progressdialog.h"
 #include "core/file-utils.h"
 
 #include <QFileDialog>
@@ -54,7 +56,10 @@ MainWindow::MainWindow(QWidget* parent):
     archiver_{std::make_shared<Archiver>()},
     viewMode_{ViewMode::DirTree},
     currentDirItem_{nullptr},
-    encryptHeader_{false} {
+    encryptHeader_{false},
+    previewCache_{new PreviewCache{this}},
+    previewFile_{nullptr},
+    previewLaunch_{false} {
 
     ui_->setupUi(this);
 
@@ -66,6 +71,8 @@ MainWindow::MainWindow(QWidget* parent):
     progressBar_ = new QProgressBar{ui_->statusBar};
     ui_->statusBar->addPermanentWidget(progressBar_);
     progressBar_->hide();
+    bytesPerSecond_ = -1.0;
+    secondsLeft_ = -1;
 
     // view menu
     auto viewModeGroup = new QActionGroup{this};
@@ -108,8 +115,13 @@ MainWindow::MainWindow(QWidget* parent):
     connect(archiver_.get(), &Archiver::start, this, &MainWindow::onActionStarted);
     connect(archiver_.get(), &Archiver::finish, this, &MainWindow::onActionFinished);
     connect(archiver_.get(), &Archiver::progress, this, &MainWindow::onActionProgress);
+    connect(archiver_.get(), &Archiver::throughput, this, &MainWindow::onActionThroughput);
+    connect(archiver_.get(), &Archiver::timeRemaining, this, &MainWindow::onActionTimeRemaining);
     connect(archiver_.get(), &Archiver::message, this, &MainWindow::onMessage);
 
+    connect(previewCache_, &PreviewCache::ready, this, &MainWindow::onPreviewReady);
+    connect(previewCache_, &PreviewCache::failed, this, &MainWindow::onPreviewFailed);
+
     updateUiStates();
 
     // hide stuff we don't support yet
@@ -127,6 +139,7 @@ MainWindow::MainWindow(QWidget* parent):
 }
 
 MainWindow::~MainWindow() {
+    previewCache_->clear();
     if(!tempDir_.isEmpty()) { // remove the temp dir if any
         QDir(tempDir_).removeRecursively();
     }
@@ -150,6 +163,7 @@ void MainWindow::loadFile(const Fm::FilePath &file) {
                        + QDateTime::currentDateTime().toString("yyyyMMddhhmmss");
         }
     }
+    previewCache_->setDir(tempDir_);
 
     archiver_->openArchive(file.uri().get(), nullptr);
 }
@@ -288,6 +302,12 @@ void MainWindow::on_actionSelectAll_triggered(bool /*checked*/) {
     ui_->fileListView->selectAll();
 }
 
+static int extractProcesses = 0;
+
+void MainWindow::setExtractProcesses(int processes) {
+    extractProcesses = processes;
+}
+
 void MainWindow::on_actionExtract_triggered(bool /*checked*/) {
     //qDebug("extract");
     ExtractFileDialog dlg{this};
@@ -315,6 +335,11 @@ void MainWindow::on_actionExtract_triggered(bool /*checked*/) {
             password_ = PasswordDialog::askPassword(this).toStdString();
         }
 
+        // parallel extraction is opt-in with --extract-processes
+        if(extractProcesses > 0) {
+            archiver_->setExtractJobs(extractProcesses);
+        }
+
         if(dlg.extractAll()) {
             archiver_->extractAll(dirUrl.toEncoded().constData(),
                                   dlg.skipOlder(),
@@ -351,49 +376,83 @@ void MainWindow::tempExtractCurFile(bool launch) {
         QModelIndex idx = selModel->currentIndex();
         auto item = itemFromIndex(idx);
         if(item && !item->isDir()) {
-            const QString fileName = tempDir_ + item->fullPath();
-            if(QFile::exists(fileName)) { // already extracted under tmp
+            const QString fileName = previewCache_->lookup(item->data());
+            if(!fileName.isEmpty()) { // viewed recently
                 if(launch) {
-                    Fm::FilePathList paths;
-                    paths.push_back(Fm::FilePath::fromLocalPath(fileName.toLocal8Bit().constData()));
-                    Fm::FileLauncher().launchPaths(nullptr, std::move(paths));
+                    launchFile(fileName);
                 }
                 return;
             }
 
-            if (launch) {
-              launchPath_ = fileName;
-            }
-
-            QString dest = tempDir_;
-            QDir dir(tempDir_);
-            const QString curDirPath = QString::fromStdString(currentDirPath_);
-            if(curDirPath.contains("/")) {
-                dest = tempDir_ + "/" + curDirPath.section("/", 0, -2);
-                dir.mkpath(dest); // also creates "dir" if needed
-            }
-            else if(!dir.exists()) {
-                dir.mkpath(tempDir_);
-            }
-
             if(archiver_->isEncrypted() && password_.empty()) {
                 password_ = PasswordDialog::askPassword(this).toStdString();
             }
-            auto destDir = Fm::FilePath::fromLocalPath(dest.toLocal8Bit().constData());
-            std::vector<const FileData*> files;
-            files.emplace_back(item->data());
-            archiver_->extractFiles(files,
-                                    destDir,
-                                    currentDirPath_.c_str(),
-                                    false,
-                                    false,
-                                    false,
-                                    password_.empty() ? nullptr : password_.c_str()
-            );
+
+            // stream the file from the archiver program when possible
+            auto argv = archiver_->streamCommand(item->data(), password_.empty() ? nullptr : password_.c_str());
+            if(!argv.isEmpty()) {
+                previewFile_ = item->data();
+                previewLaunch_ = launch;
+                if(previewCache_->fetch(item->data(), argv)) {
+                    return;
+                }
+                previewFile_ = nullptr;
+            }
+            tempExtractFile(item->data(), launch);
         }
     }
 }
 
+void MainWindow::tempExtractFile(const FileData* file, bool launch) {
+    if (launch) {
+      launchPath_ = previewCache_->localPath(file);
+    }
+    previewFile_ = file;
+
+    QString dest = tempDir_;
+    QDir dir(tempDir_);
+    const QString curDirPath = QString::fromStdString(currentDirPath_);
+    if(curDirPath.contains("/")) {
+        dest = tempDir_ + "/" + curDirPath.section("/", 0, -2);
+        dir.mkpath(dest); // also creates "dir" if needed
+    }
+    else if(!dir.exists()) {
+        dir.mkpath(tempDir_);
+    }
+
+    auto destDir = Fm::FilePath::fromLocalPath(dest.toLocal8Bit().constData());
+    std::vector<const FileData*> files;
+    files.emplace_back(file);
+    archiver_->extractFiles(files,
+                            destDir,
+                            currentDirPath_.c_str(),
+                            false,
+                            false,
+                            false,
+                            password_.empty() ? nullptr : password_.c_str()
+    );
+}
+
+void MainWindow::launchFile(const QString& localPath) {
+    Fm::FilePathList paths;
+    paths.push_back(Fm::FilePath::fromLocalPath(localPath.toLocal8Bit().constData()));
+    Fm::FileLauncher().launchPaths(this, std::move(paths));
+}
+
+void MainWindow::onPreviewReady(QString localPath) {
+    if(previewLaunch_) {
+        launchFile(localPath);
+    }
+    previewFile_ = nullptr;
+}
+
+void MainWindow::onPreviewFailed(QString /*localPath*/, QString /*message*/) {
+    // extract the file the usual way, which reports the errors
+    if(previewFile_) {
+        tempExtractFile(previewFile_, previewLaunch_);
+    }
+}
+
 void MainWindow::on_actionView_triggered(bool /*checked*/) {
     tempExtractCurFile(true);
 }
@@ -495,13 +554,19 @@ void MainWindow::onInvalidateContent() {
     }
 
     currentDirItem_ = nullptr;
+
+    // the cached files may not match the new content
+    previewCache_->clear();
+    previewFile_ = nullptr;
 }
 
 void MainWindow::onActionStarted(FrAction action) {
     setBusyState(true);
     progressBar_->setValue(0);
     progressBar_->show();
-    progressBar_->setFormat(tr("%p %"));
+    bytesPerSecond_ = -1.0;
+    secondsLeft_ = -1;
+    progressBar_->setFormat(ProgressDialog::progressFormat(bytesPerSecond_, secondsLeft_));
 
     //qDebug("action start: %d", action);
 
@@ -554,6 +619,16 @@ void MainWindow::onActionProgress(double fraction) {
     }
 }
 
+void MainWindow::onActionThroughput(double bytesPerSecond) {
+    bytesPerSecond_ = bytesPerSecond;
+    progressBar_->setFormat(ProgressDialog::progressFormat(bytesPerSecond_, secondsLeft_));
+}
+
+void MainWindow::onActionTimeRemaining(qint64 seconds) {
+    secondsLeft_ = seconds;
+    progressBar_->setFormat(ProgressDialog::progressFormat(bytesPerSecond_, secondsLeft_));
+}
+
 void MainWindow::onActionFinished(FrAction action, ArchiverError err) {
     setBusyState(false);
     progressBar_->hide();
@@ -599,11 +674,15 @@ void MainWindow::onActionFinished(FrAction action, ArchiverError err) {
         archiver_->reloadArchive(nullptr);
         break;
     case FR_ACTION_EXTRACTING_FILES:           /* extracting files */
+        if(previewFile_) {
+            if(!err.hasError()) {
+                previewCache_->insert(previewFile_);
+            }
+            previewFile_ = nullptr;
+        }
         if(!launchPath_.isEmpty()) {
             if(!err.hasError() && QFile::exists(launchPath_)) {
-                Fm::FilePathList paths;
-                paths.push_back(Fm::FilePath::fromLocalPath(launchPath_.toLocal8Bit().constData()));
-                Fm::FileLauncher().launchPaths(this, std::move(paths));
+                launchFile(launchPath_);
             }
             launchPath_.clear();
         }
@@ -699,7 +778,7 @@ QList<QStandardItem *> MainWindow::createFileListRow(const ArchiverItem *file) {
 }
 
 // show all files including files in subdirs in a flat list
-void MainWindow::showFileList(const std::vector<const ArchiverItem *> &files) {
+void MainWindow::showFileList(const ArchiverItemRange &files) {
     auto oldModel = proxyModel_->sourceModel();
 
     QStandardItemModel* model = new QStandardItemModel{this};
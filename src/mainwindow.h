@@ -21,6 +21,7 @@ class QItemSelection;
 class QLineEdit;
 class QMenu;
 class ArchiverProxyModel;
+class PreviewCache;
 
 
 class MainWindow : public QMainWindow {
@@ -54,6 +55,10 @@ public:
 
     void chdir(const ArchiverItem* dir);
 
+    // extractor processes used by the extract action, 0 chooses from the
+    // processors and the destination disk
+    static void setExtractProcesses(int processes);
+
 private Q_SLOTS:
     // action slots
     void on_actionCreateNew_triggered(bool checked);
@@ -109,6 +114,10 @@ private Q_SLOTS:
 
     void onActionProgress(double fraction);
 
+    void onActionThroughput(double bytesPerSecond);
+
+    void onActionTimeRemaining(qint64 seconds);
+
     void onActionFinished(FrAction action, ArchiverError err);
 
     void onMessage(QString message);
@@ -117,12 +126,16 @@ private Q_SLOTS:
 
     void onPropertiesFileInfoJobFinished();
 
+    void onPreviewReady(QString localPath);
+
+    void onPreviewFailed(QString localPath, QString message);
+
 private:
     void setFileName(const QString& fileName);
 
     QList<QStandardItem*> createFileListRow(const ArchiverItem* file);
 
-    void showFileList(const std::vector<const ArchiverItem *>& files);
+    void showFileList(const ArchiverItemRange& files);
 
     void showFlatFileList();
 
@@ -144,10 +157,16 @@ private:
 
     void tempExtractCurFile(bool launch);
 
+    void tempExtractFile(const FileData* file, bool launch);
+
+    void launchFile(const QString& localPath);
+
 private:
     std::unique_ptr<Ui::MainWindow> ui_;
     std::shared_ptr<Archiver> archiver_;
     QProgressBar* progressBar_;
+    double bytesPerSecond_;
+    qint64 secondsLeft_;
     QLineEdit* currentPathEdit_;
     QMenu* popupMenu_;
     ArchiverProxyModel* proxyModel_;
@@ -162,6 +181,9 @@ private:
 
     QString tempDir_;
     QString launchPath_;
+    PreviewCache* previewCache_;
+    const FileData* previewFile_;  // the file being extracted to the preview cache
+    bool previewLaunch_;
     QUrl lasrDir_;
 };
 
@@ -0,0 +1,220 @@
+#include "previewcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#endif
+
+// files up to this size are kept in memory instead of on the disk
+static const qint64 kMaxMemoryFileSize = 8 * 1024 * 1024;
+
+// whether the files of the folder are kept in memory
+static bool isMemoryFileSystem(const QString& dir) {
+#ifdef __linux__
+    struct statfs st;
+    return statfs(QFile::encodeName(dir).constData(), &st) == 0 && st.f_type == TMPFS_MAGIC;
+#else
+    Q_UNUSED(dir);
+    return false;
+#endif
+}
+
+
+PreviewCache::PreviewCache(QObject* parent):
+    QObject(parent),
+    maxDiskSize_{256 * 1024 * 1024},
+    maxMemorySize_{64 * 1024 * 1024},
+    diskSize_{0},
+    memorySize_{0},
+    process_{nullptr},
+    pending_{std::string(), QString(), 0, false} {
+}
+
+PreviewCache::~PreviewCache() {
+    clear();
+}
+
+void PreviewCache::setDir(const QString& dir) {
+    clear();
+    dir_ = dir;
+    memoryDir_ = memoryDirFor(dir);
+}
+
+const QString& PreviewCache::dir() const {
+    return dir_;
+}
+
+void PreviewCache::setMaxSize(qint64 diskSize, qint64 memorySize) {
+    maxDiskSize_ = diskSize;
+    maxMemorySize_ = memorySize;
+    makeRoom(false, 0);
+    makeRoom(true, 0);
+}
+
+void PreviewCache::clear() {
+    cancel();
+    for(const auto& entry: entries_) {
+        removeFile(entry);
+    }
+    entries_.clear();
+    index_.clear();
+    diskSize_ = 0;
+    memorySize_ = 0;
+    if(!memoryDir_.isEmpty()) {
+        QDir(memoryDir_).removeRecursively();
+    }
+}
+
+QString PreviewCache::lookup(const FileData* file) {
+    auto found = index_.find(file->original_path);
+    if(found == index_.end()) {
+        return QString();
+    }
+    auto it = found->second;
+    if(!QFileInfo::exists(it->localPath)) { // removed behind our back
+        removeEntry(it);
+        return QString();
+    }
+    entries_.splice(entries_.begin(), entries_, it);
+    return it->localPath;
+}
+
+QString PreviewCache::localPath(const FileData* file) const {
+    return dir_ + QString::fromUtf8(file->full_path);
+}
+
+void PreviewCache::insert(const FileData* file) {
+    Entry entry{file->original_path, localPath(file), 0, false};
+    entry.size = QFileInfo(entry.localPath).size();
+    addEntry(std::move(entry));
+}
+
+bool PreviewCache::fetch(const FileData* file, const QStringList& argv) {
+    cancel();
+    if(dir_.isEmpty() || argv.isEmpty()) {
+        return false;
+    }
+
+    // the small files are regular files in a folder in memory, the viewers
+    // open them by their name as the other ones
+    bool inMemory = !memoryDir_.isEmpty() && file->size <= kMaxMemoryFileSize && file->size <= maxMemorySize_;
+    pending_ = Entry{file->original_path,
+                     inMemory ? memoryDir_ + QString::fromUtf8(file->full_path) : localPath(file),
+                     0,
+                     inMemory};
+    QDir().mkpath(QFileInfo(pending_.localPath).path());
+    QFile::remove(pending_.localPath);
+    makeRoom(inMemory, file->size);
+
+    // the program writes directly to the file, the data doesn't go through us
+    process_ = new QProcess{this};
+    process_->setStandardOutputFile(pending_.localPath, QIODevice::Truncate);
+    connect(process_, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, &PreviewCache::onFinished);
+    connect(process_, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if(error == QProcess::FailedToStart) {
+            onFinished(-1, QProcess::CrashExit);
+        }
+    });
+    process_->start(argv.first(), argv.mid(1));
+    process_->closeWriteChannel();
+    return true;
+}
+
+void PreviewCache::cancel() {
+    if(process_) {
+        process_->disconnect(this);
+        process_->kill();
+        process_->waitForFinished();
+        delete process_;
+        process_ = nullptr;
+        removeFile(pending_);
+        pending_ = Entry{std::string(), QString(), 0, false};
+    }
+}
+
+void PreviewCache::onFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    if(!process_) {
+        return;
+    }
+    QProcess* process = process_;
+    process_ = nullptr;
+    process->disconnect(this);
+    process->deleteLater();
+
+    Entry entry = std::move(pending_);
+    pending_ = Entry{std::string(), QString(), 0, false};
+
+    bool ok = (exitStatus == QProcess::NormalExit && exitCode == 0);
+    if(ok) {
+        entry.size = QFileInfo(entry.localPath).size();
+    }
+
+    if(!ok) {
+        QString message = QString::fromLocal8Bit(process->readAllStandardError()).trimmed();
+        removeFile(entry);
+        Q_EMIT failed(entry.localPath, message);
+        return;
+    }
+
+    QString localPath = entry.localPath;
+    addEntry(std::move(entry));
+    Q_EMIT ready(localPath);
+}
+
+void PreviewCache::addEntry(Entry entry) {
+    auto found = index_.find(entry.path);
+    if(found != index_.end()) {
+        // replaced by the new file, only forget it
+        auto it = found->second;
+        (it->inMemory ? memorySize_ : diskSize_) -= it->size;
+        index_.erase(found);
+        entries_.erase(it);
+    }
+
+    bool memory = entry.inMemory;
+    makeRoom(memory, entry.size);
+    (memory ? memorySize_ : diskSize_) += entry.size;
+    entries_.push_front(std::move(entry));
+    index_[entries_.front().path] = entries_.begin();
+}
+
+void PreviewCache::removeEntry(EntryList::iterator it) {
+    removeFile(*it);
+    (it->inMemory ? memorySize_ : diskSize_) -= it->size;
+    index_.erase(it->path);
+    entries_.erase(it);
+}
+
+void PreviewCache::makeRoom(bool memory, qint64 size) {
+    // remove the least recently used files of the same kind
+    qint64& used = memory ? memorySize_ : diskSize_;
+    qint64 maxSize = memory ? maxMemorySize_ : maxDiskSize_;
+    auto it = entries_.end();
+    while(used + size > maxSize && it != entries_.begin()) {
+        --it;
+        if(it->inMemory == memory) {
+            removeEntry(it++);
+        }
+    }
+}
+
+void PreviewCache::removeFile(const Entry& entry) {
+    if(!entry.localPath.isEmpty()) {
+        QFile::remove(entry.localPath);
+    }
+}
+
+QString PreviewCache::memoryDirFor(const QString& dir) {
+    // /tmp is often on the disk, the runtime folder of the user is in memory
+    QString runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if(dir.isEmpty() || runtimeDir.isEmpty() || !isMemoryFileSystem(runtimeDir)) {
+        return QString();
+    }
+    return runtimeDir + QLatin1Char('/') + QFileInfo(dir).fileName();
+}
@@ -0,0 +1,96 @@
+#ifndef PREVIEWCACHE_H
+#define PREVIEWCACHE_H
+
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "core/file-data.h"
+
+
+// Keeps the files of the archive extracted to be viewed, so that opening them
+// again is instant.  The files are streamed from the standard output of the
+// archiver programs, the small ones to a folder in memory when there is one,
+// and the least recently used ones are removed when the cache grows over its
+// size.
+class PreviewCache : public QObject {
+    Q_OBJECT
+public:
+    explicit PreviewCache(QObject* parent = nullptr);
+
+    ~PreviewCache();
+
+    // the folder of the extracted files, clears the cache.  The small files
+    // go to a folder of the same name in the runtime folder, if it's in memory.
+    void setDir(const QString& dir);
+
+    const QString& dir() const;
+
+    void setMaxSize(qint64 diskSize, qint64 memorySize);
+
+    void clear();
+
+    // the path of the extracted file, empty if it's not in the cache
+    QString lookup(const FileData* file);
+
+    // the path where the file is extracted
+    QString localPath(const FileData* file) const;
+
+    // adds a file extracted to localPath(file) without fetch()
+    void insert(const FileData* file);
+
+    // streams the file to the cache with the command line argv, which writes
+    // it to its standard output, and emits ready() or failed().
+    bool fetch(const FileData* file, const QStringList& argv);
+
+    void cancel();
+
+Q_SIGNALS:
+    void ready(QString localPath);
+
+    void failed(QString localPath, QString message);
+
+private Q_SLOTS:
+    void onFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    struct Entry {
+        std::string path;   // original path in the archive
+        QString localPath;
+        qint64 size;
+        bool inMemory;      // in the memory folder instead of on the disk
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void addEntry(Entry entry);
+
+    void removeEntry(EntryList::iterator it);
+
+    void makeRoom(bool memory, qint64 size);
+
+    static void removeFile(const Entry& entry);
+
+    static QString memoryDirFor(const QString& dir);
+
+private:
+    EntryList entries_;  // the most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    QString dir_;
+    QString memoryDir_;  // empty if there's no folder in memory
+    qint64 maxDiskSize_;
+    qint64 maxMemorySize_;
+    qint64 diskSize_;
+    qint64 memorySize_;
+
+    // the file being fetched
+    QProcess* process_;
+    Entry pending_;
+};
+
+#endif // PREVIEWCACHE_H
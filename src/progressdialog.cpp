@@ -3,11 +3,17 @@
 #include "ui_progressdialog.h"
 #include "archiver.h"
 
+#include <QTime>
+
+#include <libfm-qt/utilities.h>
+
 
 ProgressDialog::ProgressDialog(QWidget* parent) :
     QDialog(parent),
     ui_{new Ui::ProgressDialog{}},
-    archiver_{nullptr} {
+    archiver_{nullptr},
+    bytesPerSecond_{-1.0},
+    secondsLeft_{-1} {
 
     ui_->setupUi(this);
 
@@ -25,6 +31,8 @@ void ProgressDialog::setArchiver(Archiver* archiver) {
     }
     archiver_ = archiver;
     connect(archiver, &Archiver::progress, this, &ProgressDialog::onProgress);
+    connect(archiver, &Archiver::throughput, this, &ProgressDialog::onThroughput);
+    connect(archiver, &Archiver::timeRemaining, this, &ProgressDialog::onTimeRemaining);
     connect(archiver, &Archiver::message, this, &ProgressDialog::onMessage);
     connect(archiver, &Archiver::workingArchive, this, &ProgressDialog::onWorkingArchive);
 }
@@ -49,6 +57,9 @@ void ProgressDialog::onProgress(double fraction) {
     if(fraction < 0.0) {
         // negative progress indicates that progress is unknown
         ui_->progressBar->setRange(0, 0); // set it to undertermined state
+        bytesPerSecond_ = -1.0;
+        secondsLeft_ = -1;
+        ui_->progressBar->setFormat(progressFormat(bytesPerSecond_, secondsLeft_));
     }
     else {
         ui_->progressBar->setRange(0, 100);
@@ -56,6 +67,31 @@ void ProgressDialog::onProgress(double fraction) {
     }
 }
 
+void ProgressDialog::onThroughput(double bytesPerSecond) {
+    bytesPerSecond_ = bytesPerSecond;
+    ui_->progressBar->setFormat(progressFormat(bytesPerSecond_, secondsLeft_));
+}
+
+void ProgressDialog::onTimeRemaining(qint64 seconds) {
+    secondsLeft_ = seconds;
+    ui_->progressBar->setFormat(progressFormat(bytesPerSecond_, secondsLeft_));
+}
+
+QString ProgressDialog::progressFormat(double bytesPerSecond, qint64 secondsLeft) {
+    QStringList info;
+    if(bytesPerSecond > 0.0) {
+        info << tr("%1/s").arg(Fm::formatFileSize(static_cast<uint64_t>(bytesPerSecond)));
+    }
+    if(secondsLeft >= 0) {
+        QString time = QTime{0, 0}.addSecs(secondsLeft).toString(secondsLeft >= 3600 ? QStringLiteral("h:mm:ss") : QStringLiteral("m:ss"));
+        info << tr("%1 left").arg(time);
+    }
+    if(info.isEmpty()) {
+        return tr("%p %");
+    }
+    return tr("%p % (%1)").arg(info.join(QStringLiteral(", ")));
+}
+
 void ProgressDialog::onFinished(FrAction action, ArchiverError error) {
 }
 
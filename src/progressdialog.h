@@ -29,9 +29,17 @@ public:
 
     void reject() override;
 
+    // the format of the progress bar with the throughput and the time left,
+    // negative values are unknown
+    static QString progressFormat(double bytesPerSecond, qint64 secondsLeft);
+
 private Q_SLOTS:
     void onProgress(double fraction);
 
+    void onThroughput(double bytesPerSecond);
+
+    void onTimeRemaining(qint64 seconds);
+
     void onFinished(FrAction action, ArchiverError error);
 
     void onMessage(QString msg);
@@ -43,6 +51,8 @@ private Q_SLOTS:
 private:
     std::unique_ptr<Ui::ProgressDialog> ui_;
     Archiver* archiver_;
+    double bytesPerSecond_;
+    qint64 secondsLeft_;
 };
 
 #endif // PROGRESSDIALOG_H